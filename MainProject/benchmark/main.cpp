@@ -0,0 +1,2104 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+/**
+* Headless benchmark for the CPU hot paths of the scene: heightmap terrain construction,
+* grass scattering, terrain height queries, scene graph transforms and frustum culling.
+* Terrain index buffers are compared between triangle lists and chunked 16-bit strips.
+* Terrain construction is also measured with 1, 2, 4... threads up to --threads, and its row
+* kernels with every SIMD level the CPU supports, as is the CDLOD patch selection. Heightmap
+* loading is compared between the RGB decode and the single channel / raw memory-mapped one. The
+* bundled heightmaps are stitched into a tile pyramid and streamed along a camera path under
+* a memory budget. Terrain construction is compared with loading its baked buffers from the
+* terrain mesh cache. Height queries are timed one by one and batched through HeightfieldSampler.
+* Terrain raycasts through the min/max pyramid are checked against brute-force ray marching.
+* Sculpting brushes are timed against a full rebuild and checked against one.
+* Procedural noise is timed per SIMD level and thread count, and must not depend on either.
+* Grass scattering is timed on 1 and --threads threads, which must keep the same instances,
+* and compared with placement from a precomputed map, which must always reach the count.
+* Poisson-disk grass must keep its spacing and cover as well as the uniform count with fewer.
+* Grass cell culling is timed around the terrain and must keep every instance in view.
+* It never creates a window or an OpenGL context, so it can run on any Linux host.
+*
+* Usage: GeometricFiguresBenchmark [--assets dir] [--out dir] [--sizes 4096,8192]
+*                                  [--instances 10000,100000] [--repeat N]
+*                                  [--max-memory-mb MB] [--threads N] [--quick]
+*/
+
+#include "../code/Frustum.hpp"
+#include "../code/GrassMesh.hpp"
+#include "../code/HeightfieldSampler.hpp"
+#include "../code/HeightMapTerrain.hpp"
+#include "../code/HeightmapImage.hpp"
+#include "../code/SceneNode.hpp"
+#include "../code/StreamedTerrain.hpp"
+#include "../code/TerrainKernels.hpp"
+#include "../code/TerrainMeshCache.hpp"
+#include "../code/TerrainNoise.hpp"
+#include "../code/TerrainPyramid.hpp"
+#include "../code/ThreadPool.hpp"
+
+#include <SOIL2.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct BenchmarkOptions
+    {
+        std::string assetRoot = "../../../shared/assets";
+        std::string outputDir = ".";
+        std::vector<int> syntheticSizes{ 4096, 8192, 16384 };
+        std::vector<int> instanceCounts{ 10000, 50000, 100000, 500000, 1000000, 5000000 };
+        int repetitions = 3;
+        int heightQueries = 1000000;
+        size_t maxMemoryMB = 8192;
+        int maxThreads = int(std::max(1u, std::thread::hardware_concurrency()));
+    };
+
+    struct BenchmarkResult
+    {
+        std::string benchmark;
+        std::string input;
+        long long parameter;            // Heightmap texels, instance count, node depth...
+        std::vector<double> samplesMs;
+        long long itemsPerRun;          // Work items processed in one run, for throughput
+    };
+
+    double minOf(const std::vector<double>& v) { return *std::min_element(v.begin(), v.end()); }
+    double maxOf(const std::vector<double>& v) { return *std::max_element(v.begin(), v.end()); }
+    double meanOf(const std::vector<double>& v) { return std::accumulate(v.begin(), v.end(), 0.0) / v.size(); }
+
+    double medianOf(std::vector<double> v)
+    {
+        std::sort(v.begin(), v.end());
+        size_t mid = v.size() / 2;
+        return v.size() % 2 ? v[mid] : 0.5 * (v[mid - 1] + v[mid]);
+    }
+
+    // Runs fn the requested number of times and returns the wall time of every run in ms
+    template<typename Function>
+    std::vector<double> measure(int repetitions, Function&& fn)
+    {
+        std::vector<double> samples;
+        samples.reserve(repetitions);
+
+        for (int i = 0; i < repetitions; ++i)
+        {
+            auto start = Clock::now();
+            fn();
+            auto end = Clock::now();
+            samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        return samples;
+    }
+
+    std::vector<int> parseList(const std::string& text)
+    {
+        std::vector<int> values;
+        std::stringstream stream(text);
+        std::string item;
+
+        while (std::getline(stream, item, ','))
+        {
+            if (!item.empty()) values.push_back(std::stoi(item));
+        }
+
+        return values;
+    }
+
+    bool fileExists(const std::string& path)
+    {
+        return std::ifstream(path).good();
+    }
+
+    std::string baseName(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    // Approximate peak memory of a HeightMapTerrain build: decoded RGB image, three vec3 arrays and the indices
+    size_t estimateTerrainBytes(size_t size)
+    {
+        size_t texels = size * size;
+        return texels * 3 + texels * 3 * sizeof(glm::vec3) + (size - 1) * (size - 1) * 6 * sizeof(GLuint);
+    }
+
+    /**
+    * Writes a smooth single channel heightmap of the requested size, unless it already exists.
+    * The files are kept in the output folder so that later runs skip the (slow) PNG encoding.
+    */
+    std::string makeSyntheticHeightmap(const std::string& outputDir, int size)
+    {
+        std::string path = outputDir + "/synthetic_heightmap_" + std::to_string(size) + ".png";
+
+        if (fileExists(path)) return path;
+
+        std::cout << "Generating " << path << "..." << std::endl;
+
+        std::vector<unsigned char> pixels(size_t(size) * size);
+        std::mt19937 gen(1234);
+        std::uniform_int_distribution<int> noise(-4, 4);
+
+        for (int z = 0; z < size; ++z)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                float u = float(x) / size;
+                float v = float(z) / size;
+
+                float h = 0.5f
+                    + 0.25f * std::sin(u * 6.2831f * 3.0f) * std::cos(v * 6.2831f * 2.0f)
+                    + 0.15f * std::sin((u + v) * 6.2831f * 7.0f)
+                    + 0.05f * std::cos(u * 6.2831f * 31.0f) * std::sin(v * 6.2831f * 29.0f);
+
+                int value = int(glm::clamp(h, 0.0f, 1.0f) * 255.0f) + noise(gen);
+                pixels[size_t(z) * size + x] = static_cast<unsigned char>(glm::clamp(value, 0, 255));
+            }
+        }
+
+        if (!SOIL_save_image(path.c_str(), SOIL_SAVE_TYPE_PNG, size, size, 1, pixels.data()))
+        {
+            std::cerr << "Failed to write synthetic heightmap: " << path << std::endl;
+            return std::string();
+        }
+
+        return path;
+    }
+
+    // Projection * view of a 1024x576, 45 degree camera looking at the terrain center
+    glm::mat4 makeBenchmarkClipMatrix(const glm::vec3& camera)
+    {
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1024.0f / 576.0f, 0.1f, 1000.0f);
+        return projection * glm::lookAt(camera, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    // Same placement as the terrain node in Scene
+    glm::mat4 makeTerrainTransform()
+    {
+        space::SceneNode terrainNode("main_terrain");
+        terrainNode.position = glm::vec3(0, 15, 20);
+        return terrainNode.getWorldTransform();
+    }
+
+    void benchmarkTerrainConstruction(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        for (const auto& path : heightmaps)
+        {
+            int width = 0, height = 0;
+            long long texels = 0;
+
+            auto samples = measure(options.repetitions, [&]()
+                {
+                    space::HeightMapTerrain terrain(path, 1.0f, false);
+                    width = terrain.getWidth();
+                    height = terrain.getHeight();
+                });
+
+            texels = (long long)width * height;
+
+            if (texels == 0)
+            {
+                std::cerr << "Skipping " << path << " (failed to load)" << std::endl;
+                continue;
+            }
+
+            results.push_back({ "HeightMapTerrain::initialize", baseName(path), texels, samples, texels });
+
+            // Displacement mode: heights only, the GPU builds the rest
+            auto displacementSamples = measure(options.repetitions, [&]()
+                {
+                    space::HeightMapTerrain terrain(path, 1.0f, false, nullptr, space::HeightMapTerrain::RenderMode::DISPLACEMENT);
+                });
+
+            results.push_back({ "HeightMapTerrain::initialize (displacement)", baseName(path), texels, displacementSamples, texels });
+
+            std::cout << "  terrain " << baseName(path) << " (" << width << "x" << height << "): "
+                << medianOf(samples) << " ms, displacement mode " << medianOf(displacementSamples) << " ms" << std::endl;
+        }
+    }
+
+    template<typename T>
+    bool sameBits(const std::vector<T>& a, const std::vector<T>& b)
+    {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    /**
+    * Builds the same terrain on pools of 1, 2, 4... threads. Every build must match the
+    * single-threaded one bit for bit; a mismatch is reported and makes the run fail.
+    */
+    bool benchmarkTerrainThreadScaling(const BenchmarkOptions& options, const std::string& heightmap, std::vector<BenchmarkResult>& results)
+    {
+        space::ThreadPool serialPool(1);
+        space::HeightMapTerrain reference(heightmap, 1.0f, false, &serialPool);
+
+        if (reference.getWidth() == 0) return true;
+
+        long long texels = (long long)reference.getWidth() * reference.getHeight();
+        double serialMs = 0.0;
+        bool identical = true;
+
+        std::vector<int> threadCounts;
+        for (int threads = 1; threads < options.maxThreads; threads *= 2) threadCounts.push_back(threads);
+        threadCounts.push_back(options.maxThreads);
+
+        for (int threads : threadCounts)
+        {
+            space::ThreadPool pool(threads);
+            bool matches = true;
+
+            auto samples = measure(options.repetitions, [&]()
+                {
+                    space::HeightMapTerrain terrain(heightmap, 1.0f, false, &pool);
+
+                    matches = matches
+                        && sameBits(terrain.getVertices(), reference.getVertices())
+                        && sameBits(terrain.getColors(), reference.getColors())
+                        && sameBits(terrain.getNormals(), reference.getNormals())
+                        && sameBits(terrain.getIndices(), reference.getIndices());
+                });
+
+            if (threads == 1) serialMs = medianOf(samples);
+
+            results.push_back({ "HeightMapTerrain::initialize threads", baseName(heightmap), threads, samples, texels });
+
+            std::cout << "  " << threads << " thread(s): " << medianOf(samples) << " ms, speedup "
+                << serialMs / medianOf(samples) << (matches ? "" : "  MISMATCH with the serial build") << std::endl;
+
+            identical = identical && matches;
+        }
+
+        return identical;
+    }
+
+    /**
+    * Runs the vertex and normal row kernels over a whole heightmap on one thread, once per
+    * SIMD level up to the supported one. Every level must match the scalar output bit for bit.
+    */
+    bool benchmarkTerrainKernels(const BenchmarkOptions& options, const std::string& heightmap, std::vector<BenchmarkResult>& results)
+    {
+        using namespace space::terrain_kernels;
+
+        int width = 0, height = 0, channels = 0;
+        unsigned char* image = SOIL_load_image(heightmap.c_str(), &width, &height, &channels, SOIL_LOAD_RGB);
+
+        if (!image) return true;
+
+        const size_t stride = size_t(width) * 3;
+        const float heightScale = 1.0f;
+
+        std::vector<float> vertices(stride * height), colors(stride * height), normals(stride * height, 0.0f);
+        std::vector<float> scalarVertices, scalarColors, scalarNormals;
+
+        SimdLevel previousLevel = getSimdLevel();
+        bool identical = true;
+        double scalarMs = 0.0;
+
+        for (int level = int(SimdLevel::SCALAR); level <= int(getSupportedSimdLevel()); ++level)
+        {
+            setSimdLevel(SimdLevel(level));
+
+            auto vertexSamples = measure(options.repetitions, [&]()
+                {
+                    for (int z = 0; z < height; ++z)
+                    {
+                        buildVertexRow(image + z * stride, width, height, z, heightScale, &vertices[z * stride], &colors[z * stride]);
+                    }
+                });
+
+            auto normalSamples = measure(options.repetitions, [&]()
+                {
+                    for (int z = 1; z < height - 1; ++z)
+                    {
+                        buildNormalRow(&vertices[(z - 1) * stride], &vertices[z * stride], &vertices[(z + 1) * stride], width, &normals[z * stride]);
+                    }
+                });
+
+            const char* name = getSimdLevelName(SimdLevel(level));
+            long long texels = (long long)width * height;
+
+            results.push_back({ std::string("terrain vertex kernel ") + name, baseName(heightmap), texels, vertexSamples, texels });
+            results.push_back({ std::string("terrain normal kernel ") + name, baseName(heightmap), texels, normalSamples, texels });
+
+            bool matches = true;
+
+            if (level == int(SimdLevel::SCALAR))
+            {
+                scalarVertices = vertices;
+                scalarColors = colors;
+                scalarNormals = normals;
+                scalarMs = medianOf(vertexSamples) + medianOf(normalSamples);
+            }
+            else
+            {
+                matches = sameBits(vertices, scalarVertices) && sameBits(colors, scalarColors) && sameBits(normals, scalarNormals);
+            }
+
+            double totalMs = medianOf(vertexSamples) + medianOf(normalSamples);
+
+            std::cout << "  " << name << ": vertices " << medianOf(vertexSamples) << " ms, normals " << medianOf(normalSamples)
+                << " ms, speedup " << scalarMs / totalMs << (matches ? "" : "  MISMATCH with the scalar kernels") << std::endl;
+
+            identical = identical && matches;
+        }
+
+        setSimdLevel(previousLevel);
+        SOIL_free_image_data(image);
+
+        return identical;
+    }
+
+    // Triangles a mesh draws, restart markers and range base vertices resolved, strips unrolled
+    std::vector<GLuint> expandTriangles(const space::Mesh& mesh)
+    {
+        const std::vector<GLuint>& indices = mesh.getIndices();
+        std::vector<space::Mesh::IndexRange> ranges = mesh.getIndexRanges();
+
+        if (ranges.empty()) ranges.push_back({ 0, GLsizei(indices.size()), 0 });
+
+        std::vector<GLuint> triangles;
+
+        for (const auto& range : ranges)
+        {
+            const GLuint* index = indices.data() + range.first;
+
+            if (mesh.getPrimitiveType() == GL_TRIANGLES)
+            {
+                for (GLsizei i = 0; i < range.count; ++i) triangles.push_back(index[i] + range.base_vertex);
+                continue;
+            }
+
+            // Strips: every index after the first two closes a triangle, odd ones swap their first two vertices
+            GLsizei stripStart = 0;
+
+            for (GLsizei i = 0; i < range.count; ++i)
+            {
+                if (index[i] == space::Mesh::PRIMITIVE_RESTART)
+                {
+                    stripStart = i + 1;
+                    continue;
+                }
+
+                GLsizei position = i - stripStart;
+                if (position < 2) continue;
+
+                GLuint a = index[i - 2], b = index[i - 1];
+                if (position % 2 == 1) std::swap(a, b);
+
+                triangles.insert(triangles.end(), { a + range.base_vertex, b + range.base_vertex, index[i] + range.base_vertex });
+            }
+        }
+
+        return triangles;
+    }
+
+    /**
+    * Index buffer of the full resolution terrain as a 32-bit triangle list and as 16-bit
+    * chunked strips with primitive restart: bytes uploaded (and read by every full draw) and
+    * build time. Both must draw the same triangles in the same order.
+    */
+    bool benchmarkTerrainIndices(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        using space::HeightMapTerrain;
+
+        bool identical = true;
+
+        for (const auto& path : heightmaps)
+        {
+            std::vector<GLuint> listTriangles;
+            size_t listBytes = 0;
+            long long texels = 0;
+
+            auto listSamples = measure(options.repetitions, [&]()
+                {
+                    HeightMapTerrain terrain(path, 1.0f, false, nullptr, HeightMapTerrain::RenderMode::MESH, HeightMapTerrain::IndexMode::TRIANGLE_LIST);
+                    texels = (long long)terrain.getWidth() * terrain.getHeight();
+                    listBytes = terrain.getIndexBufferBytes();
+                    listTriangles = expandTriangles(terrain);
+                });
+
+            if (texels == 0) continue;
+
+            size_t stripBytes = 0;
+            size_t chunks = 0;
+            bool same = false;
+
+            auto stripSamples = measure(options.repetitions, [&]()
+                {
+                    HeightMapTerrain terrain(path, 1.0f, false, nullptr, HeightMapTerrain::RenderMode::MESH, HeightMapTerrain::IndexMode::TRIANGLE_STRIPS);
+                    stripBytes = terrain.getIndexBufferBytes();
+                    chunks = terrain.getIndexRanges().size();
+                    same = expandTriangles(terrain) == listTriangles;
+                });
+
+            identical = identical && same;
+
+            results.push_back({ "HeightMapTerrain index buffer (triangle list)", baseName(path), texels, listSamples, (long long)listBytes });
+            results.push_back({ "HeightMapTerrain index buffer (strips)", baseName(path), texels, stripSamples, (long long)stripBytes });
+
+            std::cout << "  indices " << baseName(path) << ": list " << listBytes / 1024 << " KB, strips "
+                << stripBytes / 1024 << " KB in " << chunks << " chunks (" << double(listBytes) / std::max<size_t>(stripBytes, 1)
+                << "x smaller)" << (same ? "" : " TRIANGLES DIFFER") << std::endl;
+        }
+
+        // The CDLOD patch every instance draws
+        HeightMapTerrain listPatch(heightmaps.front(), 1.0f, false, nullptr, HeightMapTerrain::RenderMode::CDLOD, HeightMapTerrain::IndexMode::TRIANGLE_LIST);
+        HeightMapTerrain stripPatch(heightmaps.front(), 1.0f, false, nullptr, HeightMapTerrain::RenderMode::CDLOD, HeightMapTerrain::IndexMode::TRIANGLE_STRIPS);
+
+        bool samePatch = expandTriangles(listPatch) == expandTriangles(stripPatch);
+        identical = identical && samePatch;
+
+        std::cout << "  cdlod patch: list " << listPatch.getIndices().size() << " indices (" << listPatch.getIndexBufferBytes()
+            << " bytes), strips " << stripPatch.getIndices().size() << " indices (" << stripPatch.getIndexBufferBytes() << " bytes)"
+            << (samePatch ? "" : " TRIANGLES DIFFER") << std::endl;
+
+        return identical;
+    }
+
+    /**
+    * CDLOD patch selection from a camera above the terrain, as in the scene: selection time and
+    * drawn triangles next to the full resolution mesh, without and with frustum culling.
+    */
+    void benchmarkTerrainLodSelection(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        const int patchTriangles = space::HeightMapTerrain::PATCH_QUADS * space::HeightMapTerrain::PATCH_QUADS * 2;
+
+        for (const auto& path : heightmaps)
+        {
+            space::HeightMapTerrain terrain(path, 1.0f, false, nullptr, space::HeightMapTerrain::RenderMode::CDLOD);
+            if (terrain.getWidth() == 0) continue;
+
+            // Local camera of the scene: a 1024x576 view, 45 degrees, at one corner and looking over the terrain
+            const glm::vec3 camera(-8.0f, 6.0f, 12.0f);
+            const space::Frustum frustum(makeBenchmarkClipMatrix(camera));
+
+            auto samples = measure(options.repetitions * 10, [&]()
+                {
+                    terrain.updateLod(camera, 576.0f, glm::radians(45.0f));
+                });
+
+            long long texels = (long long)terrain.getWidth() * terrain.getHeight();
+            long long fullTriangles = (long long)(terrain.getWidth() - 1) * (terrain.getHeight() - 1) * 2;
+            long long lodTriangles = (long long)terrain.getPatchCount() * patchTriangles;
+
+            results.push_back({ "HeightMapTerrain::updateLod", baseName(path), texels, samples, terrain.getPatchCount() });
+
+            std::cout << "  lod " << baseName(path) << ": " << terrain.getLodTree().getLevelCount() << " levels, "
+                << terrain.getPatchCount() << " patches, " << lodTriangles << " triangles (full mesh " << fullTriangles << "), "
+                << medianOf(samples) << " ms" << std::endl;
+
+            auto culledSamples = measure(options.repetitions * 10, [&]()
+                {
+                    terrain.updateLod(camera, 576.0f, glm::radians(45.0f), &frustum);
+                });
+
+            results.push_back({ "HeightMapTerrain::updateLod (frustum)", baseName(path), texels, culledSamples, terrain.getPatchCount() });
+
+            std::cout << "    with frustum culling: " << terrain.getPatchCount() << " patches, "
+                << (long long)terrain.getPatchCount() * patchTriangles << " triangles, "
+                << terrain.getCulledLodNodeCount() << " nodes culled, " << medianOf(culledSamples) << " ms" << std::endl;
+        }
+    }
+
+    /**
+    * Batched sphere culling of scattered objects, the SSE path against the scalar one. The
+    * visibility of both must match.
+    */
+    // Distinct heights of a heightmap, 256 at most for an 8-bit one
+    size_t countHeightLevels(std::vector<float> heights)
+    {
+        std::sort(heights.begin(), heights.end());
+        return size_t(std::unique(heights.begin(), heights.end()) - heights.begin());
+    }
+
+    std::vector<float> loadHeights(const space::HeightmapImage& image)
+    {
+        std::vector<float> heights(size_t(image.getWidth()) * image.getHeight());
+
+        for (int z = 0; z < image.getHeight(); ++z)
+        {
+            image.buildHeightRow(z, 1.0f, heights.data() + size_t(z) * image.getWidth());
+        }
+
+        return heights;
+    }
+
+    /**
+    * Decodes each heightmap as RGB (the SOIL path the terrain used to take) and in its own
+    * format with HeightmapImage, comparing decoded bytes, time and height levels; RGB images
+    * must give the same heights both ways. The 16-bit heightmap and the largest map are also
+    * written as raw .r16 and loaded through the mapping, which must give the same heights too.
+    */
+    bool benchmarkHeightmapFormats(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        using space::HeightmapImage;
+        using space::terrain_kernels::SampleFormat;
+
+        static const char* FORMAT_NAMES[] = { "rgb8", "r8", "r16", "r32f" };
+
+        bool identical = true;
+        std::vector<std::string> rawSources;
+
+        for (const auto& path : heightmaps)
+        {
+            int width = 0, height = 0, channels = 0;
+            std::vector<float> rgbHeights;
+
+            auto rgbSamples = measure(options.repetitions, [&]()
+                {
+                    unsigned char* image = SOIL_load_image(path.c_str(), &width, &height, &channels, SOIL_LOAD_RGB);
+                    if (!image) return;
+
+                    rgbHeights.resize(size_t(width) * height);
+
+                    for (int z = 0; z < height; ++z)
+                    {
+                        space::terrain_kernels::buildHeightRow(image + size_t(z) * width * 3, width, 1.0f, rgbHeights.data() + size_t(z) * width);
+                    }
+
+                    SOIL_free_image_data(image);
+                });
+
+            if (rgbHeights.empty()) continue;
+
+            HeightmapImage image;
+            std::vector<float> heights;
+
+            auto samples = measure(options.repetitions, [&]()
+                {
+                    image.load(path);
+                    heights = loadHeights(image);
+                });
+
+            const long long texels = (long long)width * height;
+            const bool small = texels <= 1024 * 1024;
+
+            results.push_back({ "heightmap decode (SOIL rgb)", baseName(path), texels, rgbSamples, texels });
+            results.push_back({ std::string("HeightmapImage::load (") + FORMAT_NAMES[int(image.getFormat())] + ")", baseName(path), texels, samples, texels });
+
+            if (image.getFormat() == SampleFormat::RGB8)
+            {
+                identical = identical && heights == rgbHeights;
+            }
+
+            std::cout << "  " << baseName(path) << ": rgb " << texels * 3 / 1024 << " KB " << medianOf(rgbSamples) << " ms";
+            if (small) std::cout << " " << countHeightLevels(rgbHeights) << " levels";
+
+            std::cout << "; " << FORMAT_NAMES[int(image.getFormat())] << " " << image.getBytes() / 1024 << " KB " << medianOf(samples) << " ms";
+            if (small) std::cout << " " << countHeightLevels(heights) << " levels";
+            std::cout << std::endl;
+
+            if (image.getFormat() == SampleFormat::R16 || &path == &heightmaps.back())
+            {
+                rawSources.push_back(path);
+            }
+        }
+
+        for (const auto& path : rawSources)
+        {
+            HeightmapImage image;
+            image.load(path);
+            std::vector<float> heights = loadHeights(image);
+
+            // Same samples, widened to 16 bits for the 8-bit maps
+            const std::string name = baseName(path);
+            const std::string rawPath = options.outputDir + "/" + name.substr(0, name.find_last_of('.')) + ".r16";
+            {
+                std::vector<uint16_t> raw(size_t(image.getWidth()) * image.getHeight());
+
+                for (int z = 0; z < image.getHeight(); ++z)
+                {
+                    for (int x = 0; x < image.getWidth(); ++x)
+                    {
+                        const void* row = image.getRow(z);
+
+                        raw[size_t(z) * image.getWidth() + x] = image.getFormat() == SampleFormat::R16
+                            ? static_cast<const uint16_t*>(row)[x] : uint16_t(static_cast<const unsigned char*>(row)[x] * 257);
+                    }
+                }
+
+                std::ofstream file(rawPath, std::ios::binary);
+                file.write(reinterpret_cast<const char*>(raw.data()), raw.size() * sizeof(uint16_t));
+            }
+
+            HeightmapImage rawImage;
+            std::vector<float> rawHeights;
+
+            auto mapSamples = measure(options.repetitions, [&]()
+                {
+                    rawImage.load(rawPath);
+                });
+
+            auto samples = measure(options.repetitions, [&]()
+                {
+                    rawImage.load(rawPath);
+                    rawHeights = loadHeights(rawImage);
+                });
+
+            const long long texels = (long long)rawImage.getWidth() * rawImage.getHeight();
+
+            results.push_back({ "HeightmapImage::load (raw r16, mapped)", baseName(path), texels, samples, texels });
+
+            // 8-bit samples widened by 257 give the same fractions of the largest value
+            const bool same = rawImage.isMapped() && rawHeights.size() == heights.size()
+                && std::equal(heights.begin(), heights.end(), rawHeights.begin(), [](float a, float b) { return std::abs(a - b) <= 1e-6f * std::max(1.0f, std::abs(a)); });
+
+            identical = identical && same;
+
+            std::cout << "  " << baseName(rawPath) << ": mapped in " << medianOf(mapSamples) << " ms, heights in " << medianOf(samples)
+                << " ms, no decode copy" << (same ? "" : " HEIGHTS DIFFER") << std::endl;
+        }
+
+        return identical;
+    }
+
+    /**
+    * Builds terrains with an empty TerrainMeshCache (decode, build and write the baked buffers)
+    * and again with the file in place, for the scene heightmap in both the full mesh and CDLOD
+    * modes and for the smallest synthetic one in CDLOD mode. Returns false if a loaded terrain
+    * has different heights than the one built.
+    */
+    bool benchmarkTerrainCache(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        using space::HeightMapTerrain;
+        using space::TerrainMeshCache;
+
+        const std::string cacheDir = options.outputDir + "/terrain_cache";
+
+        struct Case
+        {
+            const std::string& path;
+            HeightMapTerrain::RenderMode mode;
+            const char* name;
+        };
+
+        std::vector<Case> cases{ { heightmaps[9], HeightMapTerrain::RenderMode::MESH, "mesh" }, { heightmaps[9], HeightMapTerrain::RenderMode::CDLOD, "cdlod" } };
+
+        if (heightmaps.size() > 10)
+        {
+            cases.push_back({ heightmaps[10], HeightMapTerrain::RenderMode::CDLOD, "cdlod" });
+        }
+
+        bool identical = true;
+
+        for (const Case& test : cases)
+        {
+            std::error_code error;
+
+            TerrainMeshCache::setDirectory("");
+            HeightMapTerrain reference(test.path, 1.0f, false, nullptr, test.mode);
+
+            if (reference.getWidth() == 0) continue;
+
+            TerrainMeshCache::setDirectory(cacheDir);
+
+            auto coldSamples = measure(options.repetitions, [&]()
+                {
+                    std::filesystem::remove_all(cacheDir, error);
+                    HeightMapTerrain terrain(test.path, 1.0f, false, nullptr, test.mode);
+                });
+
+            bool same = true;
+
+            auto warmSamples = measure(options.repetitions, [&]()
+                {
+                    HeightMapTerrain terrain(test.path, 1.0f, false, nullptr, test.mode);
+
+                    same = terrain.getVertices().empty() && terrain.getWidth() == reference.getWidth() && terrain.getHeight() == reference.getHeight();
+
+                    for (int i = 0; same && i < reference.getWidth() * reference.getHeight(); ++i)
+                    {
+                        same = terrain.getHeightAtIndex(i) == reference.getHeightAtIndex(i);
+                    }
+                });
+
+            TerrainMeshCache::setDirectory("");
+
+            identical = identical && same;
+
+            size_t cacheBytes = 0;
+
+            for (const auto& entry : std::filesystem::directory_iterator(cacheDir, error))
+            {
+                cacheBytes += size_t(entry.file_size(error));
+            }
+
+            const long long texels = (long long)reference.getWidth() * reference.getHeight();
+            const std::string mode = std::string(" (") + test.name + ")";
+
+            results.push_back({ "HeightMapTerrain cold start" + mode, baseName(test.path), texels, coldSamples, texels });
+            results.push_back({ "HeightMapTerrain warm start" + mode, baseName(test.path), texels, warmSamples, texels });
+
+            std::cout << "  " << baseName(test.path) << " " << test.name << ": cold " << medianOf(coldSamples) << " ms, warm "
+                << medianOf(warmSamples) << " ms, cache " << cacheBytes / 1024 << " KB" << (same ? "" : " HEIGHTS DIFFER") << std::endl;
+
+            std::filesystem::remove_all(cacheDir, error);
+        }
+
+        return identical;
+    }
+
+    /**
+    * Stitches the bundled heightmaps into a 5 column world pyramid and flies a camera across it with
+    * StreamedTerrain (CPU tiles, no GL) under a few budgets. Each step waits for the streaming
+    * thread, as if it always kept up. Returns false if the resident bytes ever went over the
+    * budget.
+    */
+    bool benchmarkTerrainStreaming(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        const std::string pyramidPath = options.outputDir + "/world.pyramid";
+        bool built = false;
+
+        auto buildSamples = measure(1, [&]()
+            {
+                built = space::TerrainPyramid::buildFromImages(heightmaps, 5, 512, 1.0f, 64, pyramidPath);
+            });
+
+        if (!built) return true;
+
+        space::TerrainPyramid pyramid;
+        pyramid.open(pyramidPath);
+
+        results.push_back({ "TerrainPyramid::buildFromImages", "world", (long long)pyramid.getTileCount(), buildSamples, (long long)pyramid.getTileCount() });
+
+        std::cout << "  pyramid: " << pyramid.getWidth() << "x" << pyramid.getHeight() << " samples, " << pyramid.getLevelCount() << " levels, "
+            << pyramid.getTileCount() << " tiles, " << pyramid.getFileSize() / 1024 << " KB, built in " << medianOf(buildSamples) << " ms" << std::endl;
+
+        const space::BoundingBox world = pyramid.getBounds();
+        const int steps = 400;
+        bool withinBudget = true;
+
+        for (size_t budgetMb : { 16, 64 })
+        {
+            const size_t budget = budgetMb << 20;
+            space::StreamedTerrain terrain(pyramidPath, budget, false);
+            const size_t tileBytes = terrain.getStats().residentBytes;
+            size_t drawnTiles = 0;
+
+            auto samples = measure(1, [&]()
+                {
+                    for (int step = 0; step < steps; ++step)
+                    {
+                        // Low over the ground, from one end of the world to the other, looking ahead and down
+                        float t = float(step) / (steps - 1);
+                        glm::vec3 camera(glm::mix(world.min.x, world.max.x, 0.9f * t), world.max.y + 1.0f, 0.25f * world.max.z * std::sin(t * 6.0f));
+
+                        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1024.0f / 576.0f, 0.1f, 1000.0f);
+                        space::Frustum frustum(projection * glm::lookAt(camera, camera + glm::vec3(1.0f, -0.4f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+                        terrain.update(camera, &frustum);
+                        terrain.waitForIdle();
+
+                        drawnTiles += terrain.getStats().drawnTiles;
+                    }
+                });
+
+            const space::StreamedTerrain::Stats& stats = terrain.getStats();
+            withinBudget = withinBudget && stats.peakBytes <= budget;
+
+            results.push_back({ "StreamedTerrain fly-through", "world", (long long)budgetMb, samples, steps });
+
+            std::cout << "  budget " << budgetMb << " MB: peak " << stats.peakBytes / 1024 << " KB resident (everything: "
+                << pyramid.getTileCount() * tileBytes / 1024 << " KB), " << stats.loads << " loads, " << stats.evictions << " evictions, "
+                << stats.dropped << " dropped, " << drawnTiles / steps << " tiles drawn per step, "
+                << medianOf(samples) / steps << " ms per step" << (stats.peakBytes <= budget ? "" : " OVER BUDGET") << std::endl;
+        }
+
+        return withinBudget;
+    }
+
+    bool benchmarkFrustumCulling(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results)
+    {
+        const space::Frustum frustum(makeBenchmarkClipMatrix(glm::vec3(-8.0f, 6.0f, 12.0f)));
+        bool identical = true;
+
+        for (int count : { 1000, 10000, 100000, 1000000 })
+        {
+            // Spheres over a 200 unit square around the terrain, so most of them fall outside
+            std::mt19937 gen(7);
+            std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+            std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+
+            space::FrustumCuller culler;
+            culler.reserve(count);
+
+            for (int i = 0; i < count; ++i)
+            {
+                culler.add(space::BoundingSphere(glm::vec3(position(gen), position(gen) * 0.1f, position(gen)), radius(gen)));
+            }
+
+            std::vector<unsigned char> scalarVisible;
+            std::vector<unsigned char> simdVisible;
+            size_t visible = 0;
+
+            auto scalarSamples = measure(options.repetitions * 3, [&]()
+                {
+                    visible = culler.cullScalar(frustum, scalarVisible);
+                });
+
+            auto simdSamples = measure(options.repetitions * 3, [&]()
+                {
+                    culler.cull(frustum, simdVisible);
+                });
+
+            bool same = scalarVisible == simdVisible;
+            identical = identical && same;
+
+            results.push_back({ "FrustumCuller::cullScalar", "spheres", count, scalarSamples, count });
+            results.push_back({ "FrustumCuller::cull", "spheres", count, simdSamples, count });
+
+            std::cout << "  cull " << count << " spheres (" << visible << " visible): scalar " << medianOf(scalarSamples)
+                << " ms, sse " << medianOf(simdSamples) << " ms" << (same ? "" : " MISMATCH") << std::endl;
+        }
+
+        return identical;
+    }
+
+    /**
+    * Scatters grass on 1 and --threads threads. Both must give the same instances for the
+    * seed, and the batched height sampler the same as the per-position one.
+    */
+    bool benchmarkGrassGeneration(const BenchmarkOptions& options, const std::string& heightmap, std::vector<BenchmarkResult>& results)
+    {
+        space::HeightMapTerrain terrain(heightmap, 1.0f, false);
+        glm::mat4 terrainTransform = makeTerrainTransform();
+        auto heightSampler = terrain.makeGrassHeightSampler(terrainTransform);
+        auto batchSampler = terrain.makeGrassHeightBatchSampler(terrainTransform);
+
+        float worldScale = terrainTransform[0][0] * terrain.getTerrainWorldScale();
+        glm::vec3 terrainWorldPos(terrainTransform[3]);
+
+        space::ThreadPool serialPool(1);
+        space::ThreadPool pool(options.maxThreads);
+
+        bool identical = true;
+
+        for (int count : options.instanceCounts)
+        {
+            std::vector<space::GrassInstance> serialInstances;
+            std::vector<space::GrassInstance> parallelInstances;
+
+            auto serialSamples = measure(options.repetitions, [&]()
+                {
+                    space::GrassMesh grass;
+                    grass.generateInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, batchSampler, &serialPool);
+                    serialInstances = grass.getInstances();
+                });
+
+            auto samples = measure(options.repetitions, [&]()
+                {
+                    space::GrassMesh grass;
+                    grass.generateInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, batchSampler, &pool);
+                    parallelInstances = grass.getInstances();
+                });
+
+            const bool matches = sameBits(serialInstances, parallelInstances);
+            identical = identical && matches;
+
+            results.push_back({ "GrassMesh::generateInstancesForTerrain serial", baseName(heightmap), count, serialSamples, (long long)serialInstances.size() });
+            results.push_back({ "GrassMesh::generateInstancesForTerrain", baseName(heightmap), count, samples, (long long)parallelInstances.size() });
+
+            std::cout << "  grass " << count << " requested, " << parallelInstances.size() << " generated: 1 thread "
+                << medianOf(serialSamples) << " ms, " << options.maxThreads << " thread(s) " << medianOf(samples) << " ms"
+                << (matches ? "" : "  MISMATCH between thread counts") << std::endl;
+        }
+
+        // The per-position sampler goes through the same kernel one position at a time
+        space::GrassMesh batched;
+        batched.generateInstancesForTerrain(options.instanceCounts.front(), worldScale, worldScale, terrainWorldPos, batchSampler, &pool);
+
+        space::GrassMesh single;
+        single.generateInstancesForTerrain(options.instanceCounts.front(), worldScale, worldScale, terrainWorldPos, heightSampler, &pool);
+
+        return identical && sameBits(batched.getInstances(), single.getInstances());
+    }
+
+    /**
+    * Returns false if the batched HeightfieldSampler heights differ between SIMD levels or
+    * stray from getHeightAtWorldPosition by more than float rounding.
+    */
+    bool benchmarkHeightQueries(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        using namespace space::terrain_kernels;
+
+        glm::mat4 terrainTransform = makeTerrainTransform();
+        bool consistent = true;
+
+        for (const auto& path : heightmaps)
+        {
+            space::HeightMapTerrain terrain(path, 1.0f, false);
+            if (terrain.getWidth() == 0) continue;
+
+            // Pre-generate the query positions so only the lookups are timed
+            float halfSpan = terrain.getTerrainWorldScale() * 0.5f;
+            std::mt19937 gen(42);
+            std::uniform_real_distribution<float> distX(terrainTransform[3][0] - halfSpan, terrainTransform[3][0] + halfSpan);
+            std::uniform_real_distribution<float> distZ(terrainTransform[3][2] - halfSpan, terrainTransform[3][2] + halfSpan);
+
+            std::vector<glm::vec2> positions(options.heightQueries);
+            for (auto& p : positions) p = glm::vec2(distX(gen), distZ(gen));
+
+            volatile float sink = 0.0f;
+
+            auto samples = measure(options.repetitions, [&]()
+                {
+                    float sum = 0.0f;
+                    for (const auto& p : positions)
+                    {
+                        sum += terrain.getHeightAtWorldPosition(p.x, p.y, terrainTransform);
+                    }
+                    sink = sum;
+                });
+
+            const long long texels = (long long)terrain.getWidth() * terrain.getHeight();
+
+            results.push_back({ "HeightMapTerrain::getHeightAtWorldPosition", baseName(path), texels, samples, (long long)positions.size() });
+
+            std::cout << "  height queries on " << baseName(path) << ": " << medianOf(samples) << " ms";
+
+            space::HeightfieldSampler sampler(terrain, terrainTransform);
+
+            auto singleSamples = measure(options.repetitions, [&]()
+                {
+                    float sum = 0.0f;
+                    for (const auto& p : positions)
+                    {
+                        sum += sampler.getHeight(p.x, p.y);
+                    }
+                    sink = sum;
+                });
+
+            results.push_back({ "HeightfieldSampler::getHeight", baseName(path), texels, singleSamples, (long long)positions.size() });
+
+            std::cout << ", sampler " << medianOf(singleSamples) << " ms";
+
+            // Batched queries take the coordinates as separate arrays
+            std::vector<float> worldX(positions.size()), worldZ(positions.size());
+
+            for (size_t i = 0; i < positions.size(); ++i)
+            {
+                worldX[i] = positions[i].x;
+                worldZ[i] = positions[i].y;
+            }
+
+            std::vector<float> heights(positions.size()), reference;
+            SimdLevel previousLevel = getSimdLevel();
+
+            for (int level = int(SimdLevel::SCALAR); level <= int(getSupportedSimdLevel()); ++level)
+            {
+                setSimdLevel(SimdLevel(level));
+
+                auto batchSamples = measure(options.repetitions, [&]()
+                    {
+                        sampler.sampleHeights(worldX.data(), worldZ.data(), positions.size(), heights.data());
+                    });
+
+                if (reference.empty())
+                {
+                    reference = heights;
+                }
+
+                consistent = consistent && heights == reference;
+
+                results.push_back({ std::string("HeightfieldSampler::sampleHeights (") + getSimdLevelName(SimdLevel(level)) + ")", baseName(path),
+                    texels, batchSamples, (long long)positions.size() });
+
+                std::cout << ", batched " << getSimdLevelName(SimdLevel(level)) << " " << medianOf(batchSamples) << " ms";
+            }
+
+            setSimdLevel(previousLevel);
+
+            std::vector<float> normalX(positions.size()), normalY(positions.size()), normalZ(positions.size());
+
+            auto normalSamples = measure(options.repetitions, [&]()
+                {
+                    sampler.sampleNormals(worldX.data(), worldZ.data(), positions.size(), normalX.data(), normalY.data(), normalZ.data());
+                });
+
+            auto slopeSamples = measure(options.repetitions, [&]()
+                {
+                    sampler.sampleSlopes(worldX.data(), worldZ.data(), positions.size(), heights.data());
+                });
+
+            results.push_back({ "HeightfieldSampler::sampleNormals", baseName(path), texels, normalSamples, (long long)positions.size() });
+            results.push_back({ "HeightfieldSampler::sampleSlopes", baseName(path), texels, slopeSamples, (long long)positions.size() });
+
+            std::cout << ", normals " << medianOf(normalSamples) << " ms, slopes " << medianOf(slopeSamples) << " ms";
+
+            // The folded texel map rounds differently from the per call inverse
+            float largestError = 0.0f;
+
+            for (size_t i = 0; i < positions.size(); i += 97)
+            {
+                float expected = terrain.getHeightAtWorldPosition(positions[i].x, positions[i].y, terrainTransform);
+                largestError = std::max(largestError, std::abs(reference[i] - expected));
+            }
+
+            const bool agrees = largestError <= 1e-3f;
+            consistent = consistent && agrees;
+
+            std::cout << (agrees ? "" : " HEIGHTS DIFFER") << std::endl;
+        }
+
+        return consistent;
+    }
+
+    /**
+    * Casts rays from above each terrain at grazing to steep angles, as mouse picking and
+    * camera collision would, in batches on 1 and --threads threads. A subset is also marched
+    * in quarter texel steps with getHeightAtWorldPosition. Returns false if a pyramid hit is
+    * off the surface, or later than the first point the marching finds under it.
+    */
+    bool benchmarkTerrainRaycasts(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        using space::HeightMapTerrain;
+        using space::TerrainRay;
+        using space::TerrainHit;
+
+        const glm::mat4 terrainTransform = makeTerrainTransform();
+        const float terrainY = terrainTransform[3][1];
+        const size_t rayCount = size_t(std::max(1000, options.heightQueries / 10));
+        const size_t marchedRays = 200;
+
+        bool correct = true;
+
+        for (const auto& path : heightmaps)
+        {
+            HeightMapTerrain terrain(path, 1.0f, false);
+            if (terrain.getWidth() == 0) continue;
+
+            const float halfSpan = terrain.getTerrainWorldScale() * 0.5f;
+            const glm::vec2 center(terrainTransform[3][0], terrainTransform[3][2]);
+
+            std::mt19937 gen(7);
+            std::uniform_real_distribution<float> spread(-halfSpan, halfSpan);
+            std::uniform_real_distribution<float> heightAbove(0.5f, 8.0f);
+            std::uniform_real_distribution<float> horizontal(-1.0f, 1.0f);
+            std::uniform_real_distribution<float> descent(0.05f, 1.0f);
+
+            std::vector<TerrainRay> rays(rayCount);
+
+            for (TerrainRay& ray : rays)
+            {
+                // Above the surface, so every hit is a real crossing
+                ray.origin = glm::vec3(center.x + spread(gen), 0.0f, center.y + spread(gen));
+                ray.origin.y = terrainY + terrain.getHeightAtWorldPosition(ray.origin.x, ray.origin.z, terrainTransform) + heightAbove(gen);
+                ray.direction = glm::normalize(glm::vec3(horizontal(gen), -descent(gen), horizontal(gen)));
+                ray.maxDistance = 4.0f * halfSpan;
+            }
+
+            std::vector<TerrainHit> hits(rayCount);
+            const long long texels = (long long)terrain.getWidth() * terrain.getHeight();
+
+            std::cout << "  " << baseName(path) << ":";
+
+            for (int threads : { 1, options.maxThreads })
+            {
+                space::ThreadPool pool(threads);
+
+                auto samples = measure(options.repetitions, [&]()
+                    {
+                        terrain.raycast(rays.data(), rays.size(), terrainTransform, hits.data(), &pool);
+                    });
+
+                results.push_back({ "HeightMapTerrain::raycast threads", baseName(path), threads, samples, (long long)rayCount });
+
+                std::cout << " " << threads << " thread(s) " << medianOf(samples) << " ms;";
+
+                if (options.maxThreads == 1) break;
+            }
+
+            size_t hitCount = 0;
+            long long visitedNodes = 0;
+
+            for (size_t i = 0; i < rayCount; ++i)
+            {
+                TerrainHit hit;
+                terrain.raycast(rays[i], terrainTransform, hit);
+                visitedNodes += space::MinMaxPyramid::getLastVisitedNodes();
+
+                if (!hit.hit) continue;
+
+                ++hitCount;
+
+                // Every hit lies on the bilinear surface
+                float surface = terrainY + terrain.getHeightAtWorldPosition(hit.position.x, hit.position.z, terrainTransform);
+                correct = correct && std::abs(hit.position.y - surface) <= 1e-3f;
+            }
+
+            // Brute force: march until the ray is under the surface or leaves the terrain
+            const float step = 0.25f * terrain.getTerrainWorldScale() / (terrain.getWidth() - 1);
+            size_t marchedHits = 0;
+
+            auto marchSamples = measure(1, [&]()
+                {
+                    for (size_t i = 0; i < std::min(marchedRays, rayCount); ++i)
+                    {
+                        const TerrainRay& ray = rays[i];
+
+                        for (float t = 0.0f; t <= ray.maxDistance; t += step)
+                        {
+                            glm::vec3 p = ray.origin + t * ray.direction;
+
+                            if (std::abs(p.x - center.x) > halfSpan || std::abs(p.z - center.y) > halfSpan) break;
+
+                            if (p.y <= terrainY + terrain.getHeightAtWorldPosition(p.x, p.z, terrainTransform))
+                            {
+                                ++marchedHits;
+
+                                // The pyramid must find this point or an earlier one
+                                correct = correct && hits[i].hit && hits[i].distance <= t + 1e-3f;
+                                break;
+                            }
+                        }
+                    }
+                });
+
+            const double marchedMs = medianOf(marchSamples) / std::min(marchedRays, rayCount);
+            const double pyramidMs = medianOf(results.back().samplesMs) / rayCount;
+
+            results.push_back({ "terrain ray marching (quarter texel)", baseName(path), texels, marchSamples, (long long)std::min(marchedRays, rayCount) });
+
+            std::cout << " " << hitCount * 100 / rayCount << "% hit, " << double(visitedNodes) / rayCount << " nodes per ray, pyramid "
+                << terrain.getHeightPyramid().getByteSize() / 1024 << " KB; marching " << marchedMs * 1000.0 << " us per ray vs "
+                << pyramidMs * 1000.0 << " us (" << marchedHits << " of " << std::min(marchedRays, rayCount) << " marched rays hit)" << std::endl;
+        }
+
+        return correct;
+    }
+
+    bool benchmarkTerrainSculpting(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        using space::HeightMapTerrain;
+        using space::TerrainBrush;
+
+        const glm::mat4 terrainTransform = makeTerrainTransform();
+        const int strokeCount = 200;
+        const float radius = 1.0f;
+
+        const TerrainBrush::Mode modes[] = { TerrainBrush::Mode::RAISE, TerrainBrush::Mode::SMOOTH, TerrainBrush::Mode::LOWER, TerrainBrush::Mode::FLATTEN };
+
+        bool correct = true;
+
+        for (const auto& path : heightmaps)
+        {
+            HeightMapTerrain terrain(path, 1.0f, false);
+            if (terrain.getWidth() == 0) continue;
+
+            const int width = terrain.getWidth();
+            const int height = terrain.getHeight();
+            const long long texels = (long long)width * height;
+            const int radiusTexels = int(radius * (width - 1) / terrain.getTerrainWorldScale());
+
+            // Brush centres inside the terrain, in world space
+            const float halfSpan = terrain.getTerrainWorldScale() * 0.5f;
+            std::mt19937 gen(11);
+            std::uniform_real_distribution<float> spread(-halfSpan, halfSpan);
+
+            std::vector<glm::vec3> centers(strokeCount);
+            for (glm::vec3& center : centers)
+            {
+                center = glm::vec3(terrainTransform[3][0] + spread(gen), 0.0f, terrainTransform[3][2] + spread(gen));
+            }
+
+            auto stroke = [&](HeightMapTerrain& target, int i)
+            {
+                TerrainBrush brush;
+                brush.mode = modes[i % 4];
+                brush.radius = radius;
+                brush.strength = brush.mode == TerrainBrush::Mode::RAISE || brush.mode == TerrainBrush::Mode::LOWER ? 0.2f : 0.5f;
+                brush.targetHeight = 2.0f;
+
+                target.sculpt(brush, centers[i], terrainTransform);
+            };
+
+            // What a single stroke leaves to upload, against the whole vertex buffer
+            stroke(terrain, 0);
+            const glm::ivec4 dirty = terrain.getDirtyTexels();
+            const size_t strokeBytes = size_t(dirty.z - dirty.x + 1) * (dirty.w - dirty.y + 1) * space::QuantizedVertexLayout::STRIDE;
+            const size_t meshBytes = size_t(texels) * space::QuantizedVertexLayout::STRIDE;
+
+            auto rebuildSamples = measure(1, [&]()
+                {
+                    HeightMapTerrain rebuilt(path, 1.0f, false);
+                });
+
+            results.push_back({ "HeightMapTerrain full rebuild", baseName(path), texels, rebuildSamples, texels });
+
+            auto meshSamples = measure(options.repetitions, [&]()
+                {
+                    for (int i = 0; i < strokeCount; ++i) stroke(terrain, i);
+                });
+
+            results.push_back({ "HeightMapTerrain::sculpt mesh", baseName(path), radiusTexels, meshSamples, strokeCount });
+
+            // The incremental normals, colours and pyramid match a full pass over the edited heights
+            const std::vector<glm::vec3>& vertices = terrain.getVertices();
+            const std::vector<glm::vec3>& normals = terrain.getNormals();
+            const std::vector<glm::vec3>& colors = terrain.getColors();
+
+            std::vector<glm::vec3> expectedNormals(vertices.size(), glm::vec3(0.0f, 1.0f, 0.0f));
+
+            for (int z = 1; z + 1 < height; ++z)
+            {
+                space::terrain_kernels::buildNormalRow(&vertices[size_t(z - 1) * width].x, &vertices[size_t(z) * width].x,
+                    &vertices[size_t(z + 1) * width].x, width, &expectedNormals[size_t(z) * width].x);
+            }
+
+            for (size_t i = 0; i < vertices.size() && correct; ++i)
+            {
+                glm::vec3 color;
+                space::terrain_kernels::rampColor(vertices[i].y / (space::terrain_kernels::HEIGHT_RANGE * terrain.getHeightScale()), &color.x);
+
+                correct = normals[i] == expectedNormals[i] && colors[i] == color;
+            }
+
+            auto matchesFullBuild = [](const HeightMapTerrain& target)
+            {
+                space::ThreadPool pool(1);
+                space::MinMaxPyramid expected;
+                expected.build(target.getHeightData(), target.getHeightStride(), target.getWidth(), target.getHeight(), pool);
+
+                const space::MinMaxPyramid& pyramid = target.getHeightPyramid();
+
+                for (int level = 0; level < expected.getLevelCount(); ++level)
+                {
+                    for (int z = 0; z < expected.getNodesZ(level); ++z)
+                    {
+                        for (int x = 0; x < expected.getNodesX(level); ++x)
+                        {
+                            if (pyramid.getRange(level, x, z) != expected.getRange(level, x, z)) return false;
+                        }
+                    }
+                }
+
+                return true;
+            };
+
+            correct = correct && matchesFullBuild(terrain);
+
+            // The heightfield modes only edit the heights, the pyramid and the LOD tree
+            HeightMapTerrain lodTerrain(path, 1.0f, false, nullptr, HeightMapTerrain::RenderMode::CDLOD);
+
+            auto lodSamples = measure(options.repetitions, [&]()
+                {
+                    for (int i = 0; i < strokeCount; ++i) stroke(lodTerrain, i);
+                });
+
+            results.push_back({ "HeightMapTerrain::sculpt cdlod", baseName(path), radiusTexels, lodSamples, strokeCount });
+
+            correct = correct && matchesFullBuild(lodTerrain);
+
+            std::cout << "  " << baseName(path) << ": radius " << radiusTexels << " texels, mesh " << medianOf(meshSamples) / strokeCount * 1000.0
+                << " us per stroke, cdlod " << medianOf(lodSamples) / strokeCount * 1000.0 << " us, full rebuild " << medianOf(rebuildSamples)
+                << " ms; " << strokeBytes / 1024 << " KB uploaded per stroke vs " << meshBytes / 1024 << " KB" << std::endl;
+        }
+
+        return correct;
+    }
+
+    /**
+    * Generates fBm, ridged and domain-warped noise windows with every SIMD level and with 1
+    * and --threads threads, then builds headless procedural terrains. Every level and thread
+    * count must give the same bits, and overlapping windows must agree on shared samples.
+    */
+    bool benchmarkProceduralTerrain(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results)
+    {
+        using namespace space::terrain_kernels;
+        using space::TerrainNoise;
+
+        const int size = 1024;
+        const float spacing = 1.0f / 16.0f;     // Exact, so shifted windows land on the same positions
+        const long long samples = (long long)size * size;
+
+        struct Variant
+        {
+            const char* name;
+            TerrainNoise::Fractal fractal;
+            float warp;
+        };
+
+        const Variant variants[] =
+        {
+            { "fbm", TerrainNoise::Fractal::FBM, 0.0f },
+            { "ridged", TerrainNoise::Fractal::RIDGED, 0.0f },
+            { "warped fbm", TerrainNoise::Fractal::FBM, 0.5f },
+        };
+
+        space::ThreadPool serialPool(1);
+        space::ThreadPool pool(options.maxThreads);
+
+        SimdLevel previousLevel = getSimdLevel();
+        bool identical = true;
+
+        for (const Variant& variant : variants)
+        {
+            TerrainNoise::Settings settings;
+            settings.fractal = variant.fractal;
+            settings.warp = variant.warp;
+
+            const TerrainNoise noise(settings);
+
+            setSimdLevel(SimdLevel::SCALAR);
+            std::vector<float> reference(size_t(size) * size);
+            noise.generate(0.0f, 0.0f, spacing, size, size, reference.data(), serialPool);
+
+            std::vector<float> heights(reference.size());
+
+            for (int level = int(SimdLevel::SCALAR); level <= int(getSupportedSimdLevel()); ++level)
+            {
+                setSimdLevel(SimdLevel(level));
+
+                auto levelSamples = measure(options.repetitions, [&]()
+                    {
+                        noise.generate(0.0f, 0.0f, spacing, size, size, heights.data(), serialPool);
+                    });
+
+                const bool matches = sameBits(heights, reference);
+                identical = identical && matches;
+
+                results.push_back({ std::string("TerrainNoise::generate ") + variant.name + " " + getSimdLevelName(SimdLevel(level)), "procedural", size, levelSamples, samples });
+
+                std::cout << "  " << variant.name << " " << getSimdLevelName(SimdLevel(level)) << ": " << medianOf(levelSamples) << " ms, "
+                    << samples / medianOf(levelSamples) / 1000.0 << " Msamples/s" << (matches ? "" : "  MISMATCH with scalar") << std::endl;
+            }
+
+            setSimdLevel(previousLevel);
+
+            auto threadSamples = measure(options.repetitions, [&]()
+                {
+                    noise.generate(0.0f, 0.0f, spacing, size, size, heights.data(), pool);
+                });
+
+            identical = identical && sameBits(heights, reference);
+
+            results.push_back({ std::string("TerrainNoise::generate ") + variant.name + " threads", "procedural", options.maxThreads, threadSamples, samples });
+
+            std::cout << "  " << variant.name << " " << options.maxThreads << " thread(s): " << medianOf(threadSamples) << " ms" << std::endl;
+
+            // A window starting at sample (512, 256) of the reference, and single samples
+            const int windowSize = size / 2;
+            std::vector<float> window(size_t(windowSize) * windowSize);
+            noise.generate(512 * spacing, 256 * spacing, spacing, windowSize, windowSize, window.data(), pool);
+
+            for (int z = 0; z < windowSize && identical; ++z)
+            {
+                identical = std::memcmp(&window[size_t(z) * windowSize], &reference[size_t(z + 256) * size + 512], windowSize * sizeof(float)) == 0;
+            }
+
+            identical = identical && noise.sample(100 * spacing, 700 * spacing) == reference[size_t(700) * size + 100];
+        }
+
+        // Headless terrains, noise included; the cache is left as the options set it
+        for (auto mode : { space::HeightMapTerrain::RenderMode::MESH, space::HeightMapTerrain::RenderMode::CDLOD })
+        {
+            const bool mesh = mode == space::HeightMapTerrain::RenderMode::MESH;
+
+            auto terrainSamples = measure(options.repetitions, [&]()
+                {
+                    space::HeightMapTerrain terrain(TerrainNoise(), size, glm::vec2(0.0f), 1.0f, false, &pool, mode);
+                });
+
+            results.push_back({ mesh ? "HeightMapTerrain procedural mesh" : "HeightMapTerrain procedural cdlod", "procedural", size, terrainSamples, samples });
+
+            std::cout << "  " << size << "x" << size << " procedural terrain, " << (mesh ? "mesh" : "cdlod") << ": " << medianOf(terrainSamples) << " ms" << std::endl;
+        }
+
+        return identical;
+    }
+
+    /**
+    * Scatters the same count over every heightmap by rejection and from a placement map. The
+    * placement map must reach the count on every terrain, the same on 1 and --threads
+    * threads, with every instance within the height range. So must a rejection scatter over
+    * a narrow height band, which comes up short, once topped up from the map of that band;
+    * and the share of the terrain createGrassForTerrain checks must bound the eligible one.
+    */
+    bool benchmarkGrassPlacement(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        const glm::mat4 terrainTransform = makeTerrainTransform();
+        const glm::vec3 terrainWorldPos(terrainTransform[3]);
+        const int count = options.instanceCounts.back();
+
+        space::ThreadPool serialPool(1);
+        space::ThreadPool pool(options.maxThreads);
+
+        const space::GrassMesh settings;
+        bool correct = true;
+
+        for (const auto& path : heightmaps)
+        {
+            space::HeightMapTerrain terrain(path, 1.0f, false);
+            if (terrain.getWidth() == 0) continue;
+
+            const float worldScale = terrainTransform[0][0] * terrain.getTerrainWorldScale();
+            const auto heightSampler = terrain.makeGrassHeightSampler(terrainTransform);
+            const auto batchSampler = terrain.makeGrassHeightBatchSampler(terrainTransform);
+            const long long texels = (long long)terrain.getWidth() * terrain.getHeight();
+
+            space::GrassPlacementMap placement;
+
+            auto mapSamples = measure(options.repetitions, [&]()
+                {
+                    placement = terrain.makeGrassPlacementMap(terrainTransform, settings.getMinHeight(), settings.getMaxHeight(), &pool);
+                });
+
+            // Reused, so that both time the generation and not the allocation of the instances
+            space::GrassMesh rejection;
+            space::GrassMesh placed;
+
+            auto rejectionSamples = measure(options.repetitions, [&]()
+                {
+                    rejection.generateInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, batchSampler, &pool);
+                });
+
+            auto placementSamples = measure(options.repetitions, [&]()
+                {
+                    placed.generateInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, placement, batchSampler, &pool);
+                });
+
+            const std::vector<space::GrassInstance>& instances = placed.getInstances();
+
+            results.push_back({ "GrassPlacementMap::build", baseName(path), texels, mapSamples, texels });
+            results.push_back({ "GrassMesh::generateInstancesForTerrain rejection", baseName(path), count, rejectionSamples, (long long)rejection.getInstanceCount() });
+            results.push_back({ "GrassMesh::generateInstancesForTerrain placement map", baseName(path), count, placementSamples, (long long)instances.size() });
+
+            // Only the points of the eligible part of a quad taken after the last retry may be
+            // off, and only by rounding
+            auto withinBand = [&](const space::GrassMesh& grass, float minHeight, float maxHeight)
+            {
+                bool within = true;
+
+                for (size_t i = 0; i < grass.getInstances().size() && within; i += 97)
+                {
+                    const glm::vec3& position = grass.getInstances()[i].position;
+                    const float normalizedHeight = heightSampler(position.x, position.z).normalizedHeight;
+
+                    within = normalizedHeight >= minHeight - 1e-4f && normalizedHeight <= maxHeight + 1e-4f;
+                }
+
+                return within;
+            };
+
+            // Nothing eligible is the only excuse for coming up short
+            bool matches = instances.size() == (placement.isEmpty() ? 0 : size_t(count)) && withinBand(placed, settings.getMinHeight(), settings.getMaxHeight());
+
+            space::GrassMesh serial;
+            serial.generateInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, placement, batchSampler, &serialPool);
+            matches = matches && sameBits(serial.getInstances(), instances);
+
+            const double eligibleShare = placement.getEligibleQuads() / ((terrain.getWidth() - 1.0) * (terrain.getHeight() - 1.0));
+            const double maxShare = terrain.getMaxGrassShare(terrainTransform, settings.getMinHeight(), settings.getMaxHeight());
+            matches = matches && maxShare >= eligibleShare;
+
+            // A band a tenth as high as the grass range, halfway up it
+            space::GrassMesh band;
+            const float bandMin = settings.getMinHeight() + 0.45f * (settings.getMaxHeight() - settings.getMinHeight());
+            const float bandMax = bandMin + 0.1f * (settings.getMaxHeight() - settings.getMinHeight());
+            band.setHeightRange(bandMin, bandMax);
+
+            const space::GrassPlacementMap bandPlacement = terrain.makeGrassPlacementMap(terrainTransform, bandMin, bandMax, &pool);
+
+            band.generateInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, batchSampler, &pool);
+            const size_t bandRejected = band.getInstanceCount();
+
+            band.fillInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, bandPlacement, batchSampler, &pool);
+            matches = matches && band.getInstanceCount() == (bandPlacement.isEmpty() ? bandRejected : size_t(count)) && withinBand(band, bandMin, bandMax);
+
+            correct = correct && matches;
+
+            std::cout << "  " << baseName(path) << ": " << int(100.0 * eligibleShare) << "% eligible (at most " << int(100.0 * maxShare)
+                << "%), map " << medianOf(mapSamples) << " ms, " << placement.getByteSize() / 1024 << " KB; rejection " << rejection.getInstanceCount() << " in "
+                << medianOf(rejectionSamples) << " ms, placement map " << instances.size() << " in " << medianOf(placementSamples) << " ms ("
+                << medianOf(mapSamples) + medianOf(placementSamples) << " ms with the map); narrow band " << bandRejected << " by rejection, "
+                << band.getInstanceCount() << " topped up" << (matches ? "" : "  WRONG placement") << std::endl;
+        }
+
+        return correct;
+    }
+
+    /**
+    * Share of the eligible ground, sampled on a resolution x resolution raster, farther than
+    * spacing times the zone spacing factor of its height from every instance: the bald
+    * patches a scatter leaves at the density each zone asks for.
+    */
+    double gapFraction(const std::vector<space::GrassInstance>& instances, const std::function<space::GrassHeightInfo(float, float)>& heightSampler,
+        const space::GrassMesh& settings, const glm::vec2& minCorner, float worldScale, float spacing, int resolution)
+    {
+        const glm::vec3 zoneSpacing = settings.getZoneSpacing();
+        const float radius = spacing * std::max(std::max(std::max(zoneSpacing.x, zoneSpacing.y), zoneSpacing.z), settings.getSpacingForHeight(settings.getMaxHeight()));
+
+        // Buckets of the largest radius, so the instances within it of a point are in its 3x3 buckets
+        const int buckets = std::max(1, int(worldScale / radius) + 1);
+        std::vector<std::vector<glm::vec2>> grid(size_t(buckets) * buckets);
+
+        auto bucketOf = [&](float x, float z)
+        {
+            const int bx = std::min(std::max(int((x - minCorner.x) / radius), 0), buckets - 1);
+            const int bz = std::min(std::max(int((z - minCorner.y) / radius), 0), buckets - 1);
+            return glm::ivec2(bx, bz);
+        };
+
+        for (const space::GrassInstance& instance : instances)
+        {
+            const glm::ivec2 bucket = bucketOf(instance.position.x, instance.position.z);
+            grid[size_t(bucket.y) * buckets + bucket.x].push_back(glm::vec2(instance.position.x, instance.position.z));
+        }
+
+        long long eligible = 0;
+        long long gaps = 0;
+
+        for (int row = 0; row < resolution; ++row)
+        {
+            for (int column = 0; column < resolution; ++column)
+            {
+                const glm::vec2 point = minCorner + glm::vec2(column + 0.5f, row + 0.5f) * (worldScale / resolution);
+                const float normalizedHeight = heightSampler(point.x, point.y).normalizedHeight;
+
+                if (normalizedHeight < settings.getMinHeight() || normalizedHeight > settings.getMaxHeight()) continue;
+
+                ++eligible;
+
+                const float pointRadius = spacing * settings.getSpacingForHeight(normalizedHeight);
+                const glm::ivec2 bucket = bucketOf(point.x, point.y);
+                bool covered = false;
+
+                for (int bz = std::max(bucket.y - 1, 0); bz <= std::min(bucket.y + 1, buckets - 1) && !covered; ++bz)
+                {
+                    for (int bx = std::max(bucket.x - 1, 0); bx <= std::min(bucket.x + 1, buckets - 1) && !covered; ++bx)
+                    {
+                        for (const glm::vec2& position : grid[size_t(bz) * buckets + bx])
+                        {
+                            if (glm::dot(position - point, position - point) <= pointRadius * pointRadius)
+                            {
+                                covered = true;
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                if (!covered) ++gaps;
+            }
+        }
+
+        return eligible > 0 ? double(gaps) / double(eligible) : 0.0;
+    }
+
+    /**
+    * Poisson-disk grass against the uniform count it stands in for, spaced as
+    * createGrassForTerrain spaces it. It must keep its minimum distance, give the same
+    * instances on 1 and --threads threads, and leave no more bald ground (farther than the
+    * uniform mean spacing, times the zone factor, from any instance) than the uniform scatter
+    * with fewer instances.
+    */
+    bool benchmarkPoissonGrass(const BenchmarkOptions& options, const std::vector<std::string>& heightmaps, std::vector<BenchmarkResult>& results)
+    {
+        const glm::mat4 terrainTransform = makeTerrainTransform();
+        const glm::vec3 terrainWorldPos(terrainTransform[3]);
+        const int count = options.instanceCounts.back();
+
+        space::ThreadPool serialPool(1);
+        space::ThreadPool pool(options.maxThreads);
+
+        const space::GrassMesh settings;
+        const glm::vec3 zoneSpacing = settings.getZoneSpacing();
+        const float lowestFactor = std::min(std::min(zoneSpacing.x, zoneSpacing.y), zoneSpacing.z);
+
+        bool correct = true;
+
+        for (const auto& path : heightmaps)
+        {
+            space::HeightMapTerrain terrain(path, 1.0f, false);
+            if (terrain.getWidth() == 0) continue;
+
+            const float worldScale = terrainTransform[0][0] * terrain.getTerrainWorldScale();
+            const glm::vec2 minCorner(terrainWorldPos.x - worldScale / 2.0f, terrainWorldPos.z - worldScale / 2.0f);
+            const auto heightSampler = terrain.makeGrassHeightSampler(terrainTransform);
+            const auto batchSampler = terrain.makeGrassHeightBatchSampler(terrainTransform);
+
+            const space::GrassPlacementMap placement = terrain.makeGrassPlacementMap(terrainTransform, settings.getMinHeight(), settings.getMaxHeight(), &pool);
+            if (placement.isEmpty()) continue;
+
+            // As createGrassForTerrain spaces it
+            const double eligibleArea = double(worldScale) * worldScale * placement.getEligibleQuads() / ((terrain.getWidth() - 1.0) * (terrain.getHeight() - 1.0));
+            const float uniformSpacing = float(std::sqrt(eligibleArea / count));
+            const float spacing = space::HeightMapTerrain::POISSON_GRASS_SPACING * uniformSpacing;
+
+            space::GrassMesh uniform;
+            space::GrassMesh poisson;
+
+            auto uniformSamples = measure(options.repetitions, [&]()
+                {
+                    uniform.generateInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, placement, batchSampler, &pool);
+                });
+
+            auto poissonSamples = measure(options.repetitions, [&]()
+                {
+                    poisson.generatePoissonInstancesForTerrain(spacing, worldScale, worldScale, terrainWorldPos, batchSampler, &pool);
+                });
+
+            const std::vector<space::GrassInstance>& instances = poisson.getInstances();
+
+            results.push_back({ "GrassMesh::generateInstancesForTerrain placement map", baseName(path), count, uniformSamples, (long long)uniform.getInstanceCount() });
+            results.push_back({ "GrassMesh::generatePoissonInstancesForTerrain", baseName(path), count, poissonSamples, (long long)instances.size() });
+
+            // No two instances closer than the smallest zone spacing, tested through buckets of that size
+            const float minimumDistance = spacing * lowestFactor * 0.9999f;
+            const int buckets = int(worldScale / minimumDistance) + 1;
+            std::vector<std::vector<glm::vec2>> grid(size_t(buckets) * buckets);
+            bool spaced = true;
+
+            for (const space::GrassInstance& instance : instances)
+            {
+                const glm::vec2 position(instance.position.x, instance.position.z);
+                const int bx = std::min(std::max(int((position.x - minCorner.x) / minimumDistance), 0), buckets - 1);
+                const int bz = std::min(std::max(int((position.y - minCorner.y) / minimumDistance), 0), buckets - 1);
+
+                for (int z = std::max(bz - 1, 0); z <= std::min(bz + 1, buckets - 1) && spaced; ++z)
+                {
+                    for (int x = std::max(bx - 1, 0); x <= std::min(bx + 1, buckets - 1) && spaced; ++x)
+                    {
+                        for (const glm::vec2& other : grid[size_t(z) * buckets + x])
+                        {
+                            if (glm::dot(other - position, other - position) < minimumDistance * minimumDistance) spaced = false;
+                        }
+                    }
+                }
+
+                grid[size_t(bz) * buckets + bx].push_back(position);
+            }
+
+            space::GrassMesh serial;
+            serial.generatePoissonInstancesForTerrain(spacing, worldScale, worldScale, terrainWorldPos, batchSampler, &serialPool);
+            const bool identical = sameBits(serial.getInstances(), instances);
+
+            const double uniformGaps = gapFraction(uniform.getInstances(), heightSampler, settings, minCorner, worldScale, uniformSpacing, 512);
+            const double poissonGaps = gapFraction(instances, heightSampler, settings, minCorner, worldScale, uniformSpacing, 512);
+            const bool covers = instances.size() < uniform.getInstanceCount() && poissonGaps <= uniformGaps;
+
+            correct = correct && spaced && identical && covers;
+
+            std::cout << "  " << baseName(path) << ": uniform " << uniform.getInstanceCount() << " in " << medianOf(uniformSamples) << " ms, "
+                << 100.0 * uniformGaps << "% bald; Poisson-disk " << instances.size() << " (" << int(100.0 * instances.size() / uniform.getInstanceCount())
+                << "%) in " << medianOf(poissonSamples) << " ms, " << 100.0 * poissonGaps << "% bald"
+                << (spaced ? "" : "  TOO CLOSE") << (identical ? "" : "  DIFFERS between thread counts") << (covers ? "" : "  LESS coverage") << std::endl;
+        }
+
+        return correct;
+    }
+
+    /**
+    * Culls the grass cells for cameras circling the terrain at several distances, some of
+    * them over the grass. The runs drawn must hold every instance inside the frustum and
+    * within the draw distance.
+    */
+    bool benchmarkGrassCulling(const BenchmarkOptions& options, const std::string& heightmap, std::vector<BenchmarkResult>& results)
+    {
+        const glm::mat4 terrainTransform = makeTerrainTransform();
+        const glm::vec3 terrainWorldPos(terrainTransform[3]);
+        const int count = options.instanceCounts.back();
+
+        space::HeightMapTerrain terrain(heightmap, 1.0f, false);
+        const float worldScale = terrainTransform[0][0] * terrain.getTerrainWorldScale();
+
+        space::GrassMesh grass;
+        const space::GrassPlacementMap placement = terrain.makeGrassPlacementMap(terrainTransform, grass.getMinHeight(), grass.getMaxHeight());
+        grass.generateInstancesForTerrain(count, worldScale, worldScale, terrainWorldPos, placement, terrain.makeGrassHeightBatchSampler(terrainTransform));
+
+        const std::vector<space::GrassInstance>& instances = grass.getInstances();
+        const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1024.0f / 576.0f, 0.1f, 1000.0f);
+
+        bool conservative = true;
+
+        for (float orbit : { 4.0f, 15.0f, 40.0f })
+        {
+            std::vector<space::Frustum> frustums;
+            std::vector<glm::vec3> cameras;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const float angle = glm::two_pi<float>() * i / 16.0f;
+                const glm::vec3 camera = terrainWorldPos + glm::vec3(std::cos(angle) * orbit, 3.0f, std::sin(angle) * orbit);
+
+                cameras.push_back(camera);
+                frustums.push_back(space::Frustum(projection * glm::lookAt(camera, terrainWorldPos, glm::vec3(0.0f, 1.0f, 0.0f))));
+            }
+
+            auto samples = measure(options.repetitions, [&]()
+                {
+                    for (size_t i = 0; i < cameras.size(); ++i)
+                    {
+                        grass.cull(frustums[i], cameras[i]);
+                    }
+                });
+
+            size_t drawn = 0;
+            size_t draws = 0;
+
+            for (size_t i = 0; i < cameras.size() && conservative; ++i)
+            {
+                grass.cull(frustums[i], cameras[i]);
+
+                std::vector<unsigned char> inRange(instances.size(), 0);
+
+                for (const space::GrassMesh::DrawRange& range : grass.getDrawRanges())
+                {
+                    std::fill(inRange.begin() + range.first, inRange.begin() + range.first + range.count, 1);
+                }
+
+                for (size_t instance = 0; instance < instances.size() && conservative; ++instance)
+                {
+                    const glm::vec3& position = instances[instance].position;
+                    bool inside = glm::distance(position, cameras[i]) <= grass.getDrawDistance();
+
+                    for (int plane = 0; plane < space::Frustum::PLANE_COUNT && inside; ++plane)
+                    {
+                        inside = glm::dot(glm::vec3(frustums[i].getPlane(plane)), position) + frustums[i].getPlane(plane).w >= 0.0f;
+                    }
+
+                    conservative = !inside || inRange[instance];
+                }
+
+                drawn += grass.getVisibleInstanceCount();
+                draws += grass.getDrawRanges().size();
+            }
+
+            results.push_back({ "GrassMesh::cull", baseName(heightmap), (long long)orbit, samples, (long long)cameras.size() });
+
+            std::cout << "  orbit " << orbit << ": " << grass.getCells().size() << " cells, " << int(100.0 * drawn / (double(instances.size()) * cameras.size()))
+                << "% of the instances drawn in " << double(draws) / cameras.size() << " draws per frame, cull " << medianOf(samples) / cameras.size() * 1000.0
+                << " us" << (conservative ? "" : "  MISSED visible instances") << std::endl;
+        }
+
+        return conservative;
+    }
+
+    void benchmarkWorldTransforms(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results)
+    {
+        const int callsPerRun = 100000;
+
+        for (int depth : { 1, 4, 16, 64 })
+        {
+            // Build a parent chain of the requested depth, each link with a small offset and rotation
+            auto root = std::make_shared<space::SceneNode>("root");
+            auto leaf = root;
+
+            for (int i = 1; i < depth; ++i)
+            {
+                auto child = std::make_shared<space::SceneNode>("node_" + std::to_string(i));
+                child->position = glm::vec3(0.1f, 0.0f, 0.2f);
+                child->rotation = glm::vec3(0.0f, 0.01f, 0.0f);
+                leaf->addChild(child);
+                leaf = child;
+            }
+
+            volatile float sink = 0.0f;
+
+            auto samples = measure(options.repetitions, [&]()
+                {
+                    float sum = 0.0f;
+                    for (int i = 0; i < callsPerRun; ++i)
+                    {
+                        sum += leaf->getWorldTransform()[3][0];
+                    }
+                    sink = sum;
+                });
+
+            results.push_back({ "SceneNode::getWorldTransform", "chain", depth, samples, callsPerRun });
+
+            std::cout << "  world transform depth " << depth << ": " << medianOf(samples) << " ms" << std::endl;
+        }
+    }
+
+    void writeCsv(const std::string& path, const std::vector<BenchmarkResult>& results)
+    {
+        std::ofstream file(path);
+        file << "benchmark,input,parameter,repetitions,min_ms,median_ms,mean_ms,max_ms,items,items_per_second\n";
+
+        for (const auto& r : results)
+        {
+            double median = medianOf(r.samplesMs);
+            file << r.benchmark << ',' << r.input << ',' << r.parameter << ',' << r.samplesMs.size() << ','
+                << minOf(r.samplesMs) << ',' << median << ',' << meanOf(r.samplesMs) << ',' << maxOf(r.samplesMs) << ','
+                << r.itemsPerRun << ',' << (median > 0.0 ? r.itemsPerRun / (median / 1000.0) : 0.0) << '\n';
+        }
+    }
+
+    void writeJson(const std::string& path, const std::vector<BenchmarkResult>& results)
+    {
+        std::ofstream file(path);
+        file << "[\n";
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            double median = medianOf(r.samplesMs);
+
+            file << "  { \"benchmark\": \"" << r.benchmark << "\", \"input\": \"" << r.input
+                << "\", \"parameter\": " << r.parameter
+                << ", \"min_ms\": " << minOf(r.samplesMs)
+                << ", \"median_ms\": " << median
+                << ", \"mean_ms\": " << meanOf(r.samplesMs)
+                << ", \"max_ms\": " << maxOf(r.samplesMs)
+                << ", \"items\": " << r.itemsPerRun
+                << ", \"items_per_second\": " << (median > 0.0 ? r.itemsPerRun / (median / 1000.0) : 0.0)
+                << ", \"samples_ms\": [";
+
+            for (size_t s = 0; s < r.samplesMs.size(); ++s)
+            {
+                file << (s ? ", " : "") << r.samplesMs[s];
+            }
+
+            file << "] }" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+
+        file << "]\n";
+    }
+
+    bool parseArguments(int argc, char* argv[], BenchmarkOptions& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (arg == "--assets" && hasValue) options.assetRoot = argv[++i];
+            else if (arg == "--out" && hasValue) options.outputDir = argv[++i];
+            else if (arg == "--sizes" && hasValue) options.syntheticSizes = parseList(argv[++i]);
+            else if (arg == "--instances" && hasValue) options.instanceCounts = parseList(argv[++i]);
+            else if (arg == "--repeat" && hasValue) options.repetitions = std::max(1, std::stoi(argv[++i]));
+            else if (arg == "--max-memory-mb" && hasValue) options.maxMemoryMB = std::stoul(argv[++i]);
+            else if (arg == "--threads" && hasValue) options.maxThreads = std::max(1, std::stoi(argv[++i]));
+            else if (arg == "--quick")
+            {
+                options.syntheticSizes = { 4096 };
+                options.instanceCounts = { 10000, 100000 };
+                options.repetitions = 1;
+                options.heightQueries = 100000;
+            }
+            else
+            {
+                std::cerr << "Unknown or incomplete argument: " << arg << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+
+    if (!parseArguments(argc, argv, options))
+    {
+        return 1;
+    }
+
+    // Every file the benchmark writes goes there, and some are read back
+    std::error_code outputError;
+    std::filesystem::create_directories(options.outputDir, outputError);
+
+    if (outputError || !std::filesystem::is_directory(options.outputDir))
+    {
+        std::cerr << "Cannot create the output directory " << options.outputDir << ": " << outputError.message() << std::endl;
+        return 1;
+    }
+
+    // The ten bundled heightmaps first, then the synthetic large ones
+    std::vector<std::string> heightmaps;
+
+    for (int i = 1; i <= 10; ++i)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "heightmap_%03d.png", i);
+        heightmaps.push_back(options.assetRoot + "/textures/heightmaps/" + name);
+    }
+
+    for (int size : options.syntheticSizes)
+    {
+        size_t estimateMB = estimateTerrainBytes(size) / (1024 * 1024);
+
+        if (estimateMB > options.maxMemoryMB)
+        {
+            std::cout << "Skipping synthetic " << size << "x" << size << " heightmap: needs ~" << estimateMB
+                << " MB, budget is " << options.maxMemoryMB << " MB (raise with --max-memory-mb)" << std::endl;
+            continue;
+        }
+
+        std::string path = makeSyntheticHeightmap(options.outputDir, size);
+        if (!path.empty()) heightmaps.push_back(path);
+    }
+
+    std::vector<BenchmarkResult> results;
+
+    std::cout << "Terrain construction" << std::endl;
+    benchmarkTerrainConstruction(options, heightmaps, results);
+
+    // Thread scaling on the largest heightmap that was built
+    std::cout << "Terrain construction thread scaling (" << baseName(heightmaps.back()) << ")" << std::endl;
+    bool identicalBuilds = benchmarkTerrainThreadScaling(options, heightmaps.back(), results);
+
+    std::cout << "Terrain row kernels (" << baseName(heightmaps.back()) << ")" << std::endl;
+    identicalBuilds = benchmarkTerrainKernels(options, heightmaps.back(), results) && identicalBuilds;
+
+    std::cout << "Terrain index buffers" << std::endl;
+    bool identicalIndices = benchmarkTerrainIndices(options, heightmaps, results);
+
+    std::cout << "Terrain LOD selection" << std::endl;
+    benchmarkTerrainLodSelection(options, heightmaps, results);
+
+    std::cout << "Heightmap formats" << std::endl;
+    bool identicalHeights = benchmarkHeightmapFormats(options, heightmaps, results);
+
+    std::cout << "Terrain mesh cache" << std::endl;
+    bool identicalCache = benchmarkTerrainCache(options, heightmaps, results);
+
+    std::cout << "Terrain streaming" << std::endl;
+    bool withinBudget = benchmarkTerrainStreaming(options, std::vector<std::string>(heightmaps.begin(), heightmaps.begin() + 10), results);
+
+    std::cout << "Frustum culling" << std::endl;
+    bool identicalCulling = benchmarkFrustumCulling(options, results);
+
+    // Grass is scattered over the same heightmap the scene uses
+    std::cout << "Grass generation" << std::endl;
+    bool identicalGrass = benchmarkGrassGeneration(options, heightmaps[9], results);
+
+    std::cout << "Grass placement (" << options.instanceCounts.back() << " instances)" << std::endl;
+    bool correctPlacement = benchmarkGrassPlacement(options, std::vector<std::string>(heightmaps.begin(), heightmaps.begin() + 10), results);
+
+    std::cout << "Poisson-disk grass (standing in for " << options.instanceCounts.back() << " instances)" << std::endl;
+    bool correctPoisson = benchmarkPoissonGrass(options, std::vector<std::string>(heightmaps.begin(), heightmaps.begin() + 10), results);
+
+    std::cout << "Grass cell culling" << std::endl;
+    bool conservativeGrassCulling = benchmarkGrassCulling(options, heightmaps[9], results);
+
+    std::cout << "Height queries" << std::endl;
+    bool consistentQueries = benchmarkHeightQueries(options, heightmaps, results);
+
+    std::cout << "Terrain raycasts" << std::endl;
+    bool correctRaycasts = benchmarkTerrainRaycasts(options, heightmaps, results);
+
+    std::cout << "Terrain sculpting" << std::endl;
+    bool correctSculpting = benchmarkTerrainSculpting(options, heightmaps, results);
+
+    std::cout << "Procedural terrain" << std::endl;
+    bool identicalNoise = benchmarkProceduralTerrain(options, results);
+
+    std::cout << "Scene graph transforms" << std::endl;
+    benchmarkWorldTransforms(options, results);
+
+    writeCsv(options.outputDir + "/benchmark_results.csv", results);
+    writeJson(options.outputDir + "/benchmark_results.json", results);
+
+    std::cout << "Results written to " << options.outputDir << "/benchmark_results.{csv,json}" << std::endl;
+
+    if (!identicalBuilds)
+    {
+        std::cerr << "Parallel or SIMD terrain builds differ from the serial scalar one" << std::endl;
+        return 1;
+    }
+
+    if (!identicalIndices)
+    {
+        std::cerr << "Strip terrain indices draw different triangles than the triangle list" << std::endl;
+        return 1;
+    }
+
+    if (!identicalCulling)
+    {
+        std::cerr << "SIMD frustum culling differs from the scalar one" << std::endl;
+        return 1;
+    }
+
+    if (!identicalHeights)
+    {
+        std::cerr << "Heightmap loads disagree with the RGB decode or the raw copy" << std::endl;
+        return 1;
+    }
+
+    if (!identicalCache)
+    {
+        std::cerr << "Terrains loaded from the mesh cache differ from the built ones" << std::endl;
+        return 1;
+    }
+
+    if (!identicalGrass)
+    {
+        std::cerr << "Grass instances differ between thread counts or height samplers" << std::endl;
+        return 1;
+    }
+
+    if (!correctPlacement)
+    {
+        std::cerr << "Grass placed from a placement map fell short, outside the height range or differs between thread counts" << std::endl;
+        return 1;
+    }
+
+    if (!correctPoisson)
+    {
+        std::cerr << "Poisson-disk grass broke its minimum distance, differs between thread counts or covers less than the uniform scatter" << std::endl;
+        return 1;
+    }
+
+    if (!conservativeGrassCulling)
+    {
+        std::cerr << "Grass cell culling dropped instances inside the frustum and the draw distance" << std::endl;
+        return 1;
+    }
+
+    if (!consistentQueries)
+    {
+        std::cerr << "Batched height queries differ between SIMD levels or from getHeightAtWorldPosition" << std::endl;
+        return 1;
+    }
+
+    if (!correctRaycasts)
+    {
+        std::cerr << "Terrain raycasts missed or misplaced hits that ray marching found" << std::endl;
+        return 1;
+    }
+
+    if (!correctSculpting)
+    {
+        std::cerr << "Sculpted terrain normals, colours or pyramid differ from a full rebuild" << std::endl;
+        return 1;
+    }
+
+    if (!identicalNoise)
+    {
+        std::cerr << "Procedural noise differs between SIMD levels, thread counts or overlapping windows" << std::endl;
+        return 1;
+    }
+
+    if (!withinBudget)
+    {
+        std::cerr << "Streamed terrain went over its memory budget" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <glm.hpp>
+
+#include <cfloat>
+#include <vector>
+
+namespace space
+{
+    /**
+    * Axis aligned bounding box. A default constructed box is empty (min above max) and
+    * grows with extend().
+    */
+    struct BoundingBox
+    {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        BoundingBox() = default;
+        BoundingBox(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+        static BoundingBox fromPoints(const std::vector<glm::vec3>& points)
+        {
+            BoundingBox box;
+
+            for (const glm::vec3& point : points)
+            {
+                box.extend(point);
+            }
+
+            return box;
+        }
+
+        bool isEmpty() const { return min.x > max.x; }
+
+        glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+        glm::vec3 getExtent() const { return max - min; }
+
+        void extend(const glm::vec3& point)
+        {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        void extend(const BoundingBox& other)
+        {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+
+        /**
+        * Smallest axis aligned box around this one once transformed (Arvo 1990): each output
+        * axis adds the smaller and the larger product of every input axis.
+        */
+        BoundingBox transformed(const glm::mat4& transform) const
+        {
+            if (isEmpty()) return *this;
+
+            glm::vec3 translation(transform[3]);
+            BoundingBox result(translation, translation);
+
+            for (int column = 0; column < 3; ++column)
+            {
+                glm::vec3 axis(transform[column]);
+                glm::vec3 a = axis * min[column];
+                glm::vec3 b = axis * max[column];
+
+                result.min += glm::min(a, b);
+                result.max += glm::max(a, b);
+            }
+
+            return result;
+        }
+    };
+
+    /**
+    * Sphere around the center of a box, reaching its corners. Looser than the box, but a
+    * single plane distance tests it, which is what the batched culling wants.
+    */
+    struct BoundingSphere
+    {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = -1.0f;                   // Negative for an empty sphere
+
+        BoundingSphere() = default;
+        BoundingSphere(const glm::vec3& center, float radius) : center(center), radius(radius) {}
+
+        explicit BoundingSphere(const BoundingBox& box)
+        {
+            if (!box.isEmpty())
+            {
+                center = box.getCenter();
+                radius = glm::length(box.getExtent()) * 0.5f;
+            }
+        }
+    };
+}
@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "SceneNode.hpp"
+#include "Frustum.hpp"
 
 namespace space
 {
@@ -38,6 +39,12 @@ namespace space
         {
             return glm::perspective(glm::radians(fov), aspect, nearPlane, farPlane);
         }
+
+        // View volume in world space
+        Frustum getFrustum() const
+        {
+            return Frustum(getProjectionMatrix() * getViewMatrix());
+        }
         
     };
 }
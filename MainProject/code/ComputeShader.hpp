@@ -0,0 +1,22 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "GLExtensions.hpp"
+#include "Shader.hpp"
+
+namespace space
+{
+	// Needs OpenGL 4.3 or GL_ARB_compute_shader, see glext::compute_shader
+	class ComputeShader : public Shader
+	{
+
+	public:
+
+		ComputeShader() : Shader(GL_COMPUTE_SHADER) {}
+
+	};
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace space
+{
+    /**
+    * Philox4x32-10 counter-based random numbers (Salmon et al., "Parallel random numbers:
+    * as easy as 1, 2, 3").
+    *
+    * There is no state to advance: the same seed and counter always give the same four 32-bit
+    * values, so each item of a parallel job can draw its own numbers from its index, on any
+    * thread and in any order, and the result does not depend on how the work is split.
+    */
+    class CounterRandom
+    {
+    public:
+
+        using Block = std::array<uint32_t, 4>;
+
+        explicit CounterRandom(uint64_t seed) : key0(uint32_t(seed)), key1(uint32_t(seed >> 32)) {}
+
+        // Four independent values for the counter (c0, c1, c2, c3)
+        Block generate(uint32_t c0, uint32_t c1 = 0, uint32_t c2 = 0, uint32_t c3 = 0) const
+        {
+            Block counter{ c0, c1, c2, c3 };
+            uint32_t k0 = key0;
+            uint32_t k1 = key1;
+
+            for (int round = 0; round < 10; ++round)
+            {
+                const uint64_t product0 = uint64_t(MULTIPLIER_0) * counter[0];
+                const uint64_t product1 = uint64_t(MULTIPLIER_1) * counter[2];
+
+                counter = Block{
+                    uint32_t(product1 >> 32) ^ counter[1] ^ k0,
+                    uint32_t(product1),
+                    uint32_t(product0 >> 32) ^ counter[3] ^ k1,
+                    uint32_t(product0) };
+
+                k0 += WEYL_0;
+                k1 += WEYL_1;
+            }
+
+            return counter;
+        }
+
+        // [0, 1) from the top 24 bits, exact in a float
+        static float toUnit(uint32_t bits) { return float(bits >> 8) * (1.0f / 16777216.0f); }
+
+        // [min, max)
+        static float toRange(uint32_t bits, float min, float max) { return min + toUnit(bits) * (max - min); }
+
+        // [0, count) from the 64 bits high:low, as the top half of their product with count
+        static uint64_t toIndex(uint32_t low, uint32_t high, uint64_t count)
+        {
+            const uint64_t countLow = count & 0xFFFFFFFFu;
+            const uint64_t countHigh = count >> 32;
+
+            const uint64_t lowLow = low * countLow;
+            const uint64_t lowHigh = low * countHigh;
+            const uint64_t highLow = high * countLow;
+            const uint64_t middle = (lowLow >> 32) + (lowHigh & 0xFFFFFFFFu) + (highLow & 0xFFFFFFFFu);
+
+            return high * countHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+        }
+
+    private:
+
+        static constexpr uint32_t MULTIPLIER_0 = 0xD2511F53u;
+        static constexpr uint32_t MULTIPLIER_1 = 0xCD9E8D57u;
+        static constexpr uint32_t WEYL_0 = 0x9E3779B9u;
+        static constexpr uint32_t WEYL_1 = 0xBB67AE85u;
+
+        uint32_t key0;
+        uint32_t key1;
+    };
+}
@@ -0,0 +1,124 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace space
+{
+    std::atomic<bool> CpuProfiler::enabled{ false };
+    std::mutex CpuProfiler::buffers_mutex;
+    std::vector<std::shared_ptr<CpuProfiler::ThreadBuffer>> CpuProfiler::buffers;
+
+    CpuProfiler::ThreadBuffer& CpuProfiler::threadBuffer()
+    {
+        // Registered once per thread, the lock is never taken again on the recording path
+        thread_local std::shared_ptr<ThreadBuffer> buffer = []()
+            {
+                auto new_buffer = std::make_shared<ThreadBuffer>();
+                new_buffer->events.resize(EVENTS_PER_THREAD);
+
+                std::lock_guard<std::mutex> lock(buffers_mutex);
+                new_buffer->thread_id = uint32_t(buffers.size() + 1);
+                new_buffer->thread_name = "thread " + std::to_string(new_buffer->thread_id);
+                buffers.push_back(new_buffer);
+
+                return new_buffer;
+            }();
+
+        return *buffer;
+    }
+
+    void CpuProfiler::record(const char* name, int64_t start_ns, int64_t end_ns)
+    {
+        ThreadBuffer& buffer = threadBuffer();
+
+        uint64_t index = buffer.written.load(std::memory_order_relaxed);
+        buffer.events[index % EVENTS_PER_THREAD] = Event{ name, start_ns, end_ns };
+        buffer.written.store(index + 1, std::memory_order_release);
+    }
+
+    void CpuProfiler::setThreadName(const std::string& name)
+    {
+        ThreadBuffer& buffer = threadBuffer();
+
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffer.thread_name = name;
+    }
+
+    bool CpuProfiler::writeChromeTrace(const std::string& path)
+    {
+        std::ofstream file(path);
+
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to open trace file: " << path << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+
+        // Timestamps are written relative to the earliest event, in microseconds
+        int64_t origin_ns = INT64_MAX;
+
+        for (const auto& buffer : buffers)
+        {
+            uint64_t written = buffer->written.load(std::memory_order_acquire);
+            uint64_t first = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+
+            for (uint64_t i = first; i < written; ++i)
+            {
+                origin_ns = std::min(origin_ns, buffer->events[i % EVENTS_PER_THREAD].start_ns);
+            }
+        }
+
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+        bool first_event = true;
+        auto separator = [&]() -> const char*
+            {
+                const char* text = first_event ? "" : ",\n";
+                first_event = false;
+                return text;
+            };
+
+        for (const auto& buffer : buffers)
+        {
+            file << separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+                << ",\"args\":{\"name\":\"" << buffer->thread_name << "\"}}";
+
+            uint64_t written = buffer->written.load(std::memory_order_acquire);
+            uint64_t first = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+
+            for (uint64_t i = first; i < written; ++i)
+            {
+                const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+
+                file << separator() << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                    << ",\"ts\":" << (event.start_ns - origin_ns) / 1000.0
+                    << ",\"dur\":" << (event.end_ns - event.start_ns) / 1000.0 << "}";
+            }
+        }
+
+        file << "\n]}\n";
+
+        std::cout << "CPU trace written to " << path << std::endl;
+
+        return true;
+    }
+
+    void CpuProfiler::clear()
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+
+        for (auto& buffer : buffers)
+        {
+            buffer->written.store(0, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+* Scoped CPU zones, recorded per thread and exported as a Chrome trace_event JSON file that
+* can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+*
+*     void Scene::update(float deltaTime)
+*     {
+*         SPACE_PROFILE_ZONE("Scene::update");
+*         ...
+*     }
+*
+* Zone names must be string literals (only the pointer is stored). Recording is off until
+* CpuProfiler::setEnabled(true); defining SPACE_DISABLE_PROFILER removes the zones entirely.
+*/
+
+#define SPACE_PROFILE_CONCAT_INNER(a, b) a##b
+#define SPACE_PROFILE_CONCAT(a, b) SPACE_PROFILE_CONCAT_INNER(a, b)
+
+#ifdef SPACE_DISABLE_PROFILER
+#define SPACE_PROFILE_ZONE(name)
+#define SPACE_PROFILE_FUNCTION()
+#else
+#define SPACE_PROFILE_ZONE(name) ::space::CpuProfiler::ScopedZone SPACE_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define SPACE_PROFILE_FUNCTION() SPACE_PROFILE_ZONE(__func__)
+#endif
+
+namespace space
+{
+    class CpuProfiler
+    {
+    public:
+
+        // Events kept per thread; once full, the oldest ones are overwritten
+        static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+        struct Event
+        {
+            const char* name;
+            int64_t start_ns;
+            int64_t end_ns;
+        };
+
+        /**
+        * Ring buffer owned by one thread. Only the owner writes; the event count is published
+        * with release semantics so a dump from another thread sees complete events.
+        */
+        struct ThreadBuffer
+        {
+            std::vector<Event> events;
+            std::atomic<uint64_t> written{ 0 };
+            uint32_t thread_id = 0;
+            std::string thread_name;
+        };
+
+        class ScopedZone
+        {
+            const char* name;
+            int64_t start_ns;
+
+        public:
+
+            explicit ScopedZone(const char* zone_name)
+                : name(isEnabled() ? zone_name : nullptr), start_ns(name ? now() : 0)
+            {
+            }
+
+            ~ScopedZone()
+            {
+                if (name)
+                {
+                    record(name, start_ns, now());
+                }
+            }
+
+            ScopedZone(const ScopedZone&) = delete;
+            ScopedZone& operator = (const ScopedZone&) = delete;
+        };
+
+    private:
+
+        static std::atomic<bool> enabled;
+        static std::mutex buffers_mutex;
+        static std::vector<std::shared_ptr<ThreadBuffer>> buffers;  // Outlive their threads until dumped
+
+        static ThreadBuffer& threadBuffer();
+
+    public:
+
+        static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+        static void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        static void record(const char* name, int64_t start_ns, int64_t end_ns);
+
+        // Label shown for the calling thread in the trace viewer
+        static void setThreadName(const std::string& name);
+
+        /**
+        * Writes every recorded zone as Chrome trace_event JSON. Intended to run when the
+        * worker threads are idle (e.g. at exit); zones still being written are skipped.
+        */
+        static bool writeChromeTrace(const std::string& path);
+
+        static void clear();
+    };
+}
@@ -0,0 +1,247 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+namespace space
+{
+    namespace
+    {
+        constexpr double PERCENTILES[] = { 50.0, 95.0, 99.0 };
+
+        unsigned bitLength(uint64_t value)
+        {
+            unsigned length = 0;
+
+            while (value)
+            {
+                value >>= 1;
+                ++length;
+            }
+
+            return length;
+        }
+
+        double toMs(uint64_t value_ns)
+        {
+            return value_ns / 1.0e6;
+        }
+
+        uint64_t toNs(double value_ms)
+        {
+            return value_ms > 0.0 ? uint64_t(value_ms * 1.0e6 + 0.5) : 0;
+        }
+    }
+
+    FrameTimeHistogram::FrameTimeHistogram()
+        : counts(bucketIndex(MAX_VALUE_NS) + 1, 0)
+    {
+    }
+
+    size_t FrameTimeHistogram::bucketIndex(uint64_t value_ns)
+    {
+        if (value_ns < SUB_BUCKETS)
+        {
+            return size_t(value_ns);
+        }
+
+        // Keep the SUB_BUCKET_BITS most significant bits: (value >> shift) is in [SUB_BUCKETS / 2, SUB_BUCKETS)
+        unsigned shift = bitLength(value_ns) - SUB_BUCKET_BITS;
+        uint64_t half = SUB_BUCKETS / 2;
+
+        return size_t(SUB_BUCKETS + (shift - 1) * half + ((value_ns >> shift) - half));
+    }
+
+    uint64_t FrameTimeHistogram::highestEquivalentValue(size_t index)
+    {
+        if (index < SUB_BUCKETS)
+        {
+            return uint64_t(index);
+        }
+
+        uint64_t half = SUB_BUCKETS / 2;
+        unsigned shift = unsigned((index - SUB_BUCKETS) / half) + 1;
+        uint64_t sub_bucket = (index - SUB_BUCKETS) % half + half;
+
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    void FrameTimeHistogram::record(uint64_t value_ns)
+    {
+        value_ns = std::min(value_ns, MAX_VALUE_NS);
+
+        ++counts[bucketIndex(value_ns)];
+        ++total_count;
+        max_value = std::max(max_value, value_ns);
+        sum += value_ns;
+    }
+
+    void FrameTimeHistogram::reset()
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+        total_count = 0;
+        max_value = 0;
+        sum = 0.0;
+    }
+
+    uint64_t FrameTimeHistogram::getValueAtPercentile(double percentile) const
+    {
+        if (total_count == 0)
+        {
+            return 0;
+        }
+
+        uint64_t target = uint64_t(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * total_count));
+        target = std::max<uint64_t>(target, 1);
+
+        uint64_t accumulated = 0;
+
+        for (size_t index = 0; index < counts.size(); ++index)
+        {
+            accumulated += counts[index];
+
+            if (accumulated >= target)
+            {
+                return std::min(highestEquivalentValue(index), max_value);
+            }
+        }
+
+        return max_value;
+    }
+
+    void FrameStats::SampleSet::reset()
+    {
+        for (auto& histogram : histograms)
+        {
+            histogram.reset();
+        }
+
+        hitches = 0;
+        severe_hitches = 0;
+    }
+
+    FrameStats::FrameStats(float report_interval, float hitch_threshold_ms, float severe_hitch_threshold_ms)
+        : hitch_threshold_ms(hitch_threshold_ms), severe_hitch_threshold_ms(severe_hitch_threshold_ms), report_interval(report_interval)
+    {
+        last_report = std::chrono::steady_clock::now();
+    }
+
+    const char* FrameStats::getChannelName(Channel channel)
+    {
+        static const char* names[CHANNEL_COUNT] = { "frame", "update", "render_submit", "swap" };
+
+        return names[channel];
+    }
+
+    void FrameStats::addFrame(double frame_ms, double update_ms, double submit_ms, double swap_ms)
+    {
+        const double values[CHANNEL_COUNT] = { frame_ms, update_ms, submit_ms, swap_ms };
+
+        for (SampleSet* samples : { &interval, &total })
+        {
+            for (int channel = 0; channel < CHANNEL_COUNT; ++channel)
+            {
+                samples->histograms[channel].record(toNs(values[channel]));
+            }
+
+            if (frame_ms >= hitch_threshold_ms) ++samples->hitches;
+            if (frame_ms >= severe_hitch_threshold_ms) ++samples->severe_hitches;
+        }
+
+        if (report_interval > 0.0f)
+        {
+            auto now = std::chrono::steady_clock::now();
+
+            if (std::chrono::duration<float>(now - last_report).count() >= report_interval)
+            {
+                report(std::cout, interval, "last interval");
+                interval.reset();
+                last_report = now;
+            }
+        }
+    }
+
+    void FrameStats::report(std::ostream& out) const
+    {
+        report(out, total, "whole run");
+    }
+
+    void FrameStats::report(std::ostream& out, const SampleSet& samples, const char* label) const
+    {
+        const FrameTimeHistogram& frames = samples.histograms[FRAME];
+
+        out << std::fixed << std::setprecision(2)
+            << "Frame stats (" << label << ", " << frames.getCount() << " frames, "
+            << samples.hitches << " hitches >= " << hitch_threshold_ms << " ms, "
+            << samples.severe_hitches << " >= " << severe_hitch_threshold_ms << " ms), p50/p95/p99/max ms:\n";
+
+        for (int channel = 0; channel < CHANNEL_COUNT; ++channel)
+        {
+            const FrameTimeHistogram& histogram = samples.histograms[channel];
+
+            out << "  " << std::left << std::setw(14) << getChannelName(Channel(channel)) << std::right;
+
+            for (double percentile : PERCENTILES)
+            {
+                out << toMs(histogram.getValueAtPercentile(percentile)) << '/';
+            }
+
+            out << toMs(histogram.getMax()) << '\n';
+        }
+
+        out << std::defaultfloat << std::flush;
+    }
+
+    void FrameStats::writeJson(std::ostream& out) const
+    {
+        const FrameTimeHistogram& frames = total.histograms[FRAME];
+
+        out << std::setprecision(6)
+            << "{\n"
+            << "  \"frames\": " << frames.getCount() << ",\n"
+            << "  \"hitch_threshold_ms\": " << hitch_threshold_ms << ",\n"
+            << "  \"hitches\": " << total.hitches << ",\n"
+            << "  \"severe_hitch_threshold_ms\": " << severe_hitch_threshold_ms << ",\n"
+            << "  \"severe_hitches\": " << total.severe_hitches << ",\n"
+            << "  \"channels\": {\n";
+
+        for (int channel = 0; channel < CHANNEL_COUNT; ++channel)
+        {
+            const FrameTimeHistogram& histogram = total.histograms[channel];
+
+            out << "    \"" << getChannelName(Channel(channel)) << "\": { "
+                << "\"mean_ms\": " << toMs(uint64_t(histogram.getMean())) << ", "
+                << "\"p50_ms\": " << toMs(histogram.getValueAtPercentile(50.0)) << ", "
+                << "\"p95_ms\": " << toMs(histogram.getValueAtPercentile(95.0)) << ", "
+                << "\"p99_ms\": " << toMs(histogram.getValueAtPercentile(99.0)) << ", "
+                << "\"max_ms\": " << toMs(histogram.getMax()) << " }"
+                << (channel + 1 < CHANNEL_COUNT ? ",\n" : "\n");
+        }
+
+        out << "  }\n}\n";
+    }
+
+    bool FrameStats::writeJson(const std::string& path) const
+    {
+        std::ofstream file(path);
+
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to open frame stats file: " << path << std::endl;
+            return false;
+        }
+
+        writeJson(file);
+
+        std::cout << "Frame stats written to " << path << std::endl;
+
+        return true;
+    }
+}
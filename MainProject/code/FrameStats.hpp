@@ -0,0 +1,121 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace space
+{
+    /**
+    * Log-linear histogram of durations in nanoseconds, in the style of HdrHistogram: values
+    * are grouped by their power of two and each power is split in SUB_BUCKETS / 2 linear
+    * buckets, so every recorded value keeps a relative error below 1/64 from 1 ns up to
+    * MAX_VALUE_NS. Recording is a couple of shifts and an increment, with no allocation.
+    */
+    class FrameTimeHistogram
+    {
+    public:
+
+        static constexpr unsigned SUB_BUCKET_BITS = 7;
+        static constexpr uint64_t SUB_BUCKETS = uint64_t(1) << SUB_BUCKET_BITS;
+        static constexpr uint64_t MAX_VALUE_NS = uint64_t(1) << 36;            // ~68 s, longer values are clamped
+
+    private:
+
+        std::vector<uint64_t> counts;
+        uint64_t total_count = 0;
+        uint64_t max_value = 0;
+        long double sum = 0.0;
+
+    public:
+
+        FrameTimeHistogram();
+
+        void record(uint64_t value_ns);
+        void reset();
+
+        uint64_t getCount() const { return total_count; }
+        uint64_t getMax() const { return max_value; }
+        double getMean() const { return total_count ? double(sum / total_count) : 0.0; }
+
+        // Smallest recorded value such that percentile % of the samples are less or equal to it
+        uint64_t getValueAtPercentile(double percentile) const;
+
+    private:
+
+        static size_t bucketIndex(uint64_t value_ns);
+        static uint64_t highestEquivalentValue(size_t index);
+    };
+
+    /**
+    * Collects the CPU cost of every frame split by stage (whole frame, scene update, render
+    * submission and buffer swap) and reports p50/p95/p99/max and hitch counts: every
+    * report_interval seconds for the frames since the previous report, and for the whole run
+    * as JSON at exit. Averages hide the occasional long frame, percentiles and hitch counts don't.
+    */
+    class FrameStats
+    {
+    public:
+
+        enum Channel
+        {
+            FRAME,
+            UPDATE,
+            RENDER_SUBMIT,
+            SWAP,
+            CHANNEL_COUNT
+        };
+
+    private:
+
+        struct SampleSet
+        {
+            FrameTimeHistogram histograms[CHANNEL_COUNT];
+            uint64_t hitches = 0;
+            uint64_t severe_hitches = 0;
+
+            void reset();
+        };
+
+        SampleSet interval;                     // Since the last periodic report
+        SampleSet total;                        // Whole run
+
+        float hitch_threshold_ms;               // Two frames at 60 Hz by default
+        float severe_hitch_threshold_ms;
+
+        float report_interval;                  // Seconds between console reports, 0 disables them
+        std::chrono::steady_clock::time_point last_report;
+
+    public:
+
+        explicit FrameStats(float report_interval = 5.0f, float hitch_threshold_ms = 33.3f, float severe_hitch_threshold_ms = 100.0f);
+
+        /**
+        * Adds one frame, all times in milliseconds. Prints and restarts the interval
+        * statistics when report_interval has elapsed.
+        */
+        void addFrame(double frame_ms, double update_ms, double submit_ms, double swap_ms);
+
+        const FrameTimeHistogram& getHistogram(Channel channel) const { return total.histograms[channel]; }
+        uint64_t getHitchCount() const { return total.hitches; }
+        uint64_t getSevereHitchCount() const { return total.severe_hitches; }
+
+        void report(std::ostream& out = std::cout) const;
+
+        void writeJson(std::ostream& out) const;
+        bool writeJson(const std::string& path) const;
+
+        static const char* getChannelName(Channel channel);
+
+    private:
+
+        void report(std::ostream& out, const SampleSet& samples, const char* label) const;
+    };
+}
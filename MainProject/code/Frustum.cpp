@@ -0,0 +1,239 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "Frustum.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SPACE_FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+namespace space
+{
+    Frustum::Frustum()
+    {
+        for (glm::vec4& plane : planes)
+        {
+            plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+
+        std::fill(normalX, normalX + PADDED_PLANE_COUNT, 0.0f);
+        std::fill(normalY, normalY + PADDED_PLANE_COUNT, 0.0f);
+        std::fill(normalZ, normalZ + PADDED_PLANE_COUNT, 0.0f);
+        std::fill(distance, distance + PADDED_PLANE_COUNT, 1.0f);
+    }
+
+    Frustum::Frustum(const glm::mat4& clipMatrix) : Frustum()
+    {
+        glm::vec4 rows[4];
+
+        for (int row = 0; row < 4; ++row)
+        {
+            rows[row] = glm::vec4(clipMatrix[0][row], clipMatrix[1][row], clipMatrix[2][row], clipMatrix[3][row]);
+        }
+
+        // Left, right, bottom, top, near, far: -w <= x, y, z <= w in clip space
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            planes[axis * 2] = rows[3] + rows[axis];
+            planes[axis * 2 + 1] = rows[3] - rows[axis];
+        }
+
+        for (int index = 0; index < PLANE_COUNT; ++index)
+        {
+            glm::vec4& plane = planes[index];
+            float length = glm::length(glm::vec3(plane));
+
+            if (length > 0.0f)
+            {
+                plane /= length;
+            }
+
+            normalX[index] = plane.x;
+            normalY[index] = plane.y;
+            normalZ[index] = plane.z;
+            distance[index] = plane.w;
+        }
+    }
+
+    Frustum::Containment Frustum::classify(const BoundingBox& box) const
+    {
+        if (box.isEmpty()) return OUTSIDE;
+
+#ifdef SPACE_FRUSTUM_SSE
+
+        // Four planes per step: the corner furthest along each normal decides if the box is
+        // outside, the nearest one if it is completely inside
+        const __m128 minX = _mm_set1_ps(box.min.x), maxX = _mm_set1_ps(box.max.x);
+        const __m128 minY = _mm_set1_ps(box.min.y), maxY = _mm_set1_ps(box.max.y);
+        const __m128 minZ = _mm_set1_ps(box.min.z), maxZ = _mm_set1_ps(box.max.z);
+        const __m128 zero = _mm_setzero_ps();
+
+        int crossing = 0;
+
+        for (int first = 0; first < PADDED_PLANE_COUNT; first += 4)
+        {
+            __m128 nx = _mm_load_ps(normalX + first);
+            __m128 ny = _mm_load_ps(normalY + first);
+            __m128 nz = _mm_load_ps(normalZ + first);
+            __m128 d = _mm_load_ps(distance + first);
+
+            __m128 ax = _mm_mul_ps(nx, minX), bx = _mm_mul_ps(nx, maxX);
+            __m128 ay = _mm_mul_ps(ny, minY), by = _mm_mul_ps(ny, maxY);
+            __m128 az = _mm_mul_ps(nz, minZ), bz = _mm_mul_ps(nz, maxZ);
+
+            __m128 furthest = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_max_ps(ax, bx), _mm_max_ps(ay, by)), _mm_max_ps(az, bz)), d);
+            __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_min_ps(ax, bx), _mm_min_ps(ay, by)), _mm_min_ps(az, bz)), d);
+
+            if (_mm_movemask_ps(_mm_cmplt_ps(furthest, zero))) return OUTSIDE;
+
+            crossing |= _mm_movemask_ps(_mm_cmplt_ps(nearest, zero));
+        }
+
+        return crossing ? INTERSECTS : INSIDE;
+
+#else
+
+        bool crossing = false;
+
+        for (const glm::vec4& plane : planes)
+        {
+            glm::vec3 normal(plane);
+            glm::vec3 a = normal * box.min;
+            glm::vec3 b = normal * box.max;
+
+            glm::vec3 furthest = glm::max(a, b);
+            glm::vec3 nearest = glm::min(a, b);
+
+            if (furthest.x + furthest.y + furthest.z + plane.w < 0.0f) return OUTSIDE;
+
+            crossing = crossing || nearest.x + nearest.y + nearest.z + plane.w < 0.0f;
+        }
+
+        return crossing ? INTERSECTS : INSIDE;
+
+#endif
+    }
+
+    bool Frustum::intersects(const BoundingSphere& sphere) const
+    {
+        if (sphere.radius < 0.0f) return false;
+
+        for (const glm::vec4& plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) return false;
+        }
+
+        return true;
+    }
+
+    void FrustumCuller::clear()
+    {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        radius.clear();
+    }
+
+    void FrustumCuller::reserve(size_t count)
+    {
+        centerX.reserve(count);
+        centerY.reserve(count);
+        centerZ.reserve(count);
+        radius.reserve(count);
+    }
+
+    size_t FrustumCuller::add(const BoundingSphere& sphere)
+    {
+        centerX.push_back(sphere.center.x);
+        centerY.push_back(sphere.center.y);
+        centerZ.push_back(sphere.center.z);
+
+        // No plane distance is below -FLT_MAX, so empty spheres always end up outside
+        radius.push_back(sphere.radius < 0.0f ? -FLT_MAX : sphere.radius);
+
+        return radius.size() - 1;
+    }
+
+    size_t FrustumCuller::cullScalar(const Frustum& frustum, size_t first, unsigned char* visible) const
+    {
+        size_t count = 0;
+
+        for (size_t i = first; i < radius.size(); ++i)
+        {
+            bool inside = true;
+
+            for (int plane = 0; plane < Frustum::PLANE_COUNT; ++plane)
+            {
+                float signedDistance = frustum.normalX[plane] * centerX[i] + frustum.normalY[plane] * centerY[i]
+                    + frustum.normalZ[plane] * centerZ[i] + frustum.distance[plane];
+
+                inside = inside && !(signedDistance < -radius[i]);
+            }
+
+            visible[i] = inside ? 1 : 0;
+            count += visible[i];
+        }
+
+        return count;
+    }
+
+    size_t FrustumCuller::cullScalar(const Frustum& frustum, std::vector<unsigned char>& visible) const
+    {
+        visible.resize(radius.size());
+
+        return cullScalar(frustum, 0, visible.data());
+    }
+
+    size_t FrustumCuller::cull(const Frustum& frustum, std::vector<unsigned char>& visible) const
+    {
+        visible.resize(radius.size());
+
+#ifdef SPACE_FRUSTUM_SSE
+
+        const size_t groups = radius.size() / 4 * 4;
+        size_t count = 0;
+
+        for (size_t i = 0; i < groups; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(centerX.data() + i);
+            __m128 y = _mm_loadu_ps(centerY.data() + i);
+            __m128 z = _mm_loadu_ps(centerZ.data() + i);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius.data() + i));
+
+            __m128 outside = _mm_setzero_ps();
+
+            // Same products and sums, in the same order, as the scalar path
+            for (int plane = 0; plane < Frustum::PLANE_COUNT; ++plane)
+            {
+                __m128 signedDistance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(frustum.normalX[plane]), x),
+                    _mm_mul_ps(_mm_set1_ps(frustum.normalY[plane]), y)),
+                    _mm_mul_ps(_mm_set1_ps(frustum.normalZ[plane]), z)),
+                    _mm_set1_ps(frustum.distance[plane]));
+
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(signedDistance, negativeRadius));
+            }
+
+            int mask = _mm_movemask_ps(outside);
+
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+                count += visible[i + lane];
+            }
+        }
+
+        return count + cullScalar(frustum, groups, visible.data());
+
+#else
+
+        return cullScalar(frustum, 0, visible.data());
+
+#endif
+    }
+}
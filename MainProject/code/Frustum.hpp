@@ -0,0 +1,96 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "Bounds.hpp"
+
+#include <glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace space
+{
+    /**
+    * The six planes of a view volume, extracted from a projection * view (* model) matrix
+    * (Gribb and Hartmann 2001). With the model matrix included the planes are in that model's
+    * local space, which is how the terrain LOD selection tests its quadtree nodes.
+    *
+    * Plane normals point inwards and are normalized, so a plane evaluates to the signed
+    * distance of a point. The planes are also kept as SoA arrays, padded to eight with
+    * planes every point is inside of, so the box test handles four planes per SIMD step.
+    */
+    class Frustum
+    {
+    public:
+
+        static constexpr int PLANE_COUNT = 6;
+
+        enum Containment
+        {
+            OUTSIDE,
+            INTERSECTS,
+            INSIDE
+        };
+
+        Frustum();
+        explicit Frustum(const glm::mat4& clipMatrix);
+
+        const glm::vec4& getPlane(int index) const { return planes[index]; }
+
+        Containment classify(const BoundingBox& box) const;
+        bool intersects(const BoundingSphere& sphere) const;
+
+    private:
+
+        static constexpr int PADDED_PLANE_COUNT = 8;
+
+        glm::vec4 planes[PLANE_COUNT];
+
+        alignas(16) float normalX[PADDED_PLANE_COUNT];
+        alignas(16) float normalY[PADDED_PLANE_COUNT];
+        alignas(16) float normalZ[PADDED_PLANE_COUNT];
+        alignas(16) float distance[PADDED_PLANE_COUNT];
+
+        friend class FrustumCuller;
+    };
+
+    /**
+    * Batch of bounding spheres stored as SoA (one array per coordinate and one for the radii)
+    * and tested against a frustum four at a time with SSE. Meant to be refilled every frame
+    * with the world bounds of what is about to be drawn.
+    */
+    class FrustumCuller
+    {
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> radius;
+
+    public:
+
+        void clear();
+        void reserve(size_t count);
+
+        // Returns the index of the sphere, the one its visibility is written at
+        size_t add(const BoundingSphere& sphere);
+
+        size_t size() const { return radius.size(); }
+
+        /**
+        * Sets visible[i] to 1 for every sphere that reaches inside the frustum and to 0 for
+        * the rest; empty spheres are never visible. Returns the visible count.
+        */
+        size_t cull(const Frustum& frustum, std::vector<unsigned char>& visible) const;
+
+        // Same result one sphere at a time, kept as the reference for the benchmark
+        size_t cullScalar(const Frustum& frustum, std::vector<unsigned char>& visible) const;
+
+    private:
+
+        size_t cullScalar(const Frustum& frustum, size_t first, unsigned char* visible) const;
+    };
+}
@@ -0,0 +1,103 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "GLExtensions.hpp"
+
+#include <cstring>
+
+namespace space
+{
+    namespace glext
+    {
+        bool KHR_debug = false;
+        PushDebugGroupProc PushDebugGroup = nullptr;
+        PopDebugGroupProc PopDebugGroup = nullptr;
+
+        bool ES3_compatibility = false;
+
+        bool base_instance = false;
+        DrawElementsInstancedBaseInstanceProc DrawElementsInstancedBaseInstance = nullptr;
+
+        bool multi_draw_indirect = false;
+        MultiDrawElementsIndirectProc MultiDrawElementsIndirect = nullptr;
+
+        bool draw_indirect = false;
+        DrawElementsIndirectProc DrawElementsIndirect = nullptr;
+
+        bool compute_shader = false;
+        DispatchComputeProc DispatchCompute = nullptr;
+        MemoryBarrierProc IssueMemoryBarrier = nullptr;
+
+        bool isSupported(const char* extension, int core_major, int core_minor)
+        {
+            GLint major = 0, minor = 0;
+            glGetIntegerv(GL_MAJOR_VERSION, &major);
+            glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+            if (major > core_major || (major == core_major && minor >= core_minor))
+            {
+                return true;
+            }
+
+            GLint extension_count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+
+            for (GLint i = 0; i < extension_count; ++i)
+            {
+                const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+
+                if (name && std::strcmp(name, extension) == 0)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void load(GLADloadproc loader)
+        {
+            if (isSupported("GL_KHR_debug", 4, 3))
+            {
+                PushDebugGroup = reinterpret_cast<PushDebugGroupProc>(loader("glPushDebugGroup"));
+                PopDebugGroup = reinterpret_cast<PopDebugGroupProc>(loader("glPopDebugGroup"));
+            }
+
+            KHR_debug = PushDebugGroup && PopDebugGroup;
+
+            ES3_compatibility = isSupported("GL_ARB_ES3_compatibility", 4, 3);
+
+            if (isSupported("GL_ARB_base_instance", 4, 2))
+            {
+                DrawElementsInstancedBaseInstance = reinterpret_cast<DrawElementsInstancedBaseInstanceProc>(loader("glDrawElementsInstancedBaseInstance"));
+            }
+
+            base_instance = DrawElementsInstancedBaseInstance != nullptr;
+
+            if (isSupported("GL_ARB_multi_draw_indirect", 4, 3))
+            {
+                MultiDrawElementsIndirect = reinterpret_cast<MultiDrawElementsIndirectProc>(loader("glMultiDrawElementsIndirect"));
+            }
+
+            multi_draw_indirect = MultiDrawElementsIndirect != nullptr;
+
+            if (isSupported("GL_ARB_draw_indirect", 4, 0))
+            {
+                DrawElementsIndirect = reinterpret_cast<DrawElementsIndirectProc>(loader("glDrawElementsIndirect"));
+            }
+
+            draw_indirect = DrawElementsIndirect != nullptr;
+
+            // Compute shaders are no use without storage buffers to write their results to
+            if (isSupported("GL_ARB_compute_shader", 4, 3) && isSupported("GL_ARB_shader_storage_buffer_object", 4, 3))
+            {
+                DispatchCompute = reinterpret_cast<DispatchComputeProc>(loader("glDispatchCompute"));
+                IssueMemoryBarrier = reinterpret_cast<MemoryBarrierProc>(loader("glMemoryBarrier"));
+            }
+
+            compute_shader = DispatchCompute && IssueMemoryBarrier;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <glad/glad.h>
+
+/**
+* glad was generated for the OpenGL 3.3 core profile only. Entry points from newer versions
+* or extensions are loaded here, after the context exists, and are null when the driver
+* does not provide them. Always check the matching flag before calling one.
+*/
+
+#ifndef GL_DEBUG_SOURCE_APPLICATION
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#endif
+
+#ifndef GL_PRIMITIVE_RESTART_FIXED_INDEX
+#define GL_PRIMITIVE_RESTART_FIXED_INDEX 0x8D69
+#endif
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+
+namespace space
+{
+    namespace glext
+    {
+        typedef void (APIENTRYP PushDebugGroupProc)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+        typedef void (APIENTRYP PopDebugGroupProc)(void);
+        typedef void (APIENTRYP DrawElementsInstancedBaseInstanceProc)(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount, GLuint baseinstance);
+        typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+        typedef void (APIENTRYP DrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect);
+        typedef void (APIENTRYP DispatchComputeProc)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+        typedef void (APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+
+        // GL_KHR_debug (core in 4.3)
+        extern bool KHR_debug;
+        extern PushDebugGroupProc PushDebugGroup;
+        extern PopDebugGroupProc PopDebugGroup;
+
+        // GL_ARB_ES3_compatibility (core in 4.3), for GL_PRIMITIVE_RESTART_FIXED_INDEX
+        extern bool ES3_compatibility;
+
+        // GL_ARB_base_instance (core in 4.2)
+        extern bool base_instance;
+        extern DrawElementsInstancedBaseInstanceProc DrawElementsInstancedBaseInstance;
+
+        /**
+        * GL_ARB_multi_draw_indirect (core in 4.3), commands read from GL_DRAW_INDIRECT_BUFFER.
+        * Their base instance is only honoured with base_instance too.
+        */
+        extern bool multi_draw_indirect;
+        extern MultiDrawElementsIndirectProc MultiDrawElementsIndirect;
+
+        // GL_ARB_draw_indirect (core in 4.0), one command read from GL_DRAW_INDIRECT_BUFFER
+        extern bool draw_indirect;
+        extern DrawElementsIndirectProc DrawElementsIndirect;
+
+        /**
+        * GL_ARB_compute_shader and GL_ARB_shader_storage_buffer_object (both core in 4.3), with
+        * the glMemoryBarrier that makes what a dispatch wrote visible to the draws after it.
+        */
+        extern bool compute_shader;
+        extern DispatchComputeProc DispatchCompute;
+        extern MemoryBarrierProc IssueMemoryBarrier;     // Not MemoryBarrier, a macro of winnt.h
+
+        // Command layout of DrawElementsIndirect and MultiDrawElementsIndirect
+        struct DrawElementsIndirectCommand
+        {
+            GLuint count;
+            GLuint instanceCount;
+            GLuint firstIndex;
+            GLint baseVertex;
+            GLuint baseInstance;
+        };
+
+        /**
+        * Loads every entry point with the same loader glad used (SDL_GL_GetProcAddress,
+        * eglGetProcAddress...). Must be called with the context current.
+        */
+        void load(GLADloadproc loader);
+
+        // Checks the context version and its extension string
+        bool isSupported(const char* extension, int core_major, int core_minor);
+    }
+}
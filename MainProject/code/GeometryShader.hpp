@@ -0,0 +1,20 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "Shader.hpp"
+
+namespace space
+{
+	class GeometryShader : public Shader
+	{
+
+	public:
+
+		GeometryShader() : Shader(GL_GEOMETRY_SHADER) {}
+
+	};
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "GpuProfiler.hpp"
+#include "GLExtensions.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace space
+{
+    GpuProfiler::GpuProfiler(const std::vector<std::string>& pass_names)
+        : pass_names(pass_names), smoothed_ms(pass_names.size(), 0.0f), has_sample(pass_names.size(), false)
+    {
+        for (auto& frame : frames)
+        {
+            frame.query_ids.resize(pass_names.size(), 0);
+            frame.issued.resize(pass_names.size(), false);
+
+            glGenQueries(GLsizei(frame.query_ids.size()), frame.query_ids.data());
+        }
+
+        last_report = std::chrono::steady_clock::now();
+    }
+
+    GpuProfiler::~GpuProfiler()
+    {
+        for (auto& frame : frames)
+        {
+            glDeleteQueries(GLsizei(frame.query_ids.size()), frame.query_ids.data());
+        }
+    }
+
+    void GpuProfiler::collectResults()
+    {
+        for (auto& frame : frames)
+        {
+            for (size_t pass = 0; pass < pass_names.size(); ++pass)
+            {
+                if (!frame.issued[pass]) continue;
+
+                GLint available = 0;
+                glGetQueryObjectiv(frame.query_ids[pass], GL_QUERY_RESULT_AVAILABLE, &available);
+
+                if (!available) continue;
+
+                GLuint64 elapsed_ns = 0;
+                glGetQueryObjectui64v(frame.query_ids[pass], GL_QUERY_RESULT, &elapsed_ns);
+                frame.issued[pass] = false;
+
+                float sample_ms = float(elapsed_ns / 1.0e6);
+
+                smoothed_ms[pass] = has_sample[pass] ? smoothed_ms[pass] + smoothing * (sample_ms - smoothed_ms[pass]) : sample_ms;
+                has_sample[pass] = true;
+            }
+        }
+    }
+
+    void GpuProfiler::beginFrame()
+    {
+        collectResults();
+
+        // If the GPU is more than FRAME_LATENCY frames behind, the oldest results are dropped
+        // rather than waited for
+        FrameQueries& frame = frames[frame_index % FRAME_LATENCY];
+        std::fill(frame.issued.begin(), frame.issued.end(), false);
+    }
+
+    void GpuProfiler::endFrame()
+    {
+        if (active_pass >= 0)
+        {
+            endPass();
+        }
+
+        ++frame_index;
+
+        if (report_interval > 0.0f)
+        {
+            auto now = std::chrono::steady_clock::now();
+
+            if (std::chrono::duration<float>(now - last_report).count() >= report_interval)
+            {
+                report();
+                last_report = now;
+            }
+        }
+    }
+
+    void GpuProfiler::beginPass(size_t pass)
+    {
+        // Timer queries cannot nest, so a pass implicitly ends the previous one
+        if (active_pass >= 0)
+        {
+            endPass();
+        }
+
+        FrameQueries& frame = frames[frame_index % FRAME_LATENCY];
+
+        if (glext::KHR_debug)
+        {
+            glext::PushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, GLuint(pass), -1, pass_names[pass].c_str());
+        }
+
+        glBeginQuery(GL_TIME_ELAPSED, frame.query_ids[pass]);
+        frame.issued[pass] = true;
+        active_pass = int(pass);
+    }
+
+    void GpuProfiler::endPass()
+    {
+        if (active_pass < 0) return;
+
+        glEndQuery(GL_TIME_ELAPSED);
+
+        if (glext::KHR_debug)
+        {
+            glext::PopDebugGroup();
+        }
+
+        active_pass = -1;
+    }
+
+    float GpuProfiler::getTotalTimeMs() const
+    {
+        float total = 0.0f;
+
+        for (float time : smoothed_ms)
+        {
+            total += time;
+        }
+
+        return total;
+    }
+
+    void GpuProfiler::report(std::ostream& out) const
+    {
+        out << "GPU pass times (ms):" << std::fixed << std::setprecision(3);
+
+        for (size_t pass = 0; pass < pass_names.size(); ++pass)
+        {
+            out << " " << pass_names[pass] << " " << smoothed_ms[pass] << " |";
+        }
+
+        out << " total " << getTotalTimeMs() << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,82 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace space
+{
+    /**
+    * Measures the GPU time of each render pass with GL_TIME_ELAPSED queries.
+    *
+    * Queries are kept in a ring of FRAME_LATENCY frames: a frame's results are only read
+    * once the driver reports them available, several frames later, so reading never stalls
+    * the pipeline. Each pass is also wrapped in a KHR_debug group when the driver has it,
+    * so captures in RenderDoc/Nsight show the same pass names.
+    */
+    class GpuProfiler
+    {
+    public:
+
+        static constexpr unsigned FRAME_LATENCY = 4;
+
+    private:
+
+        struct FrameQueries
+        {
+            std::vector<GLuint> query_ids;      // One GL_TIME_ELAPSED query per pass
+            std::vector<bool> issued;           // Pass ran this frame and its result is pending
+        };
+
+        std::vector<std::string> pass_names;
+        FrameQueries frames[FRAME_LATENCY];
+
+        std::vector<float> smoothed_ms;         // Exponential moving average per pass
+        std::vector<bool> has_sample;
+
+        unsigned frame_index = 0;
+        int active_pass = -1;
+
+        float smoothing = 0.1f;                 // Weight of the newest sample
+
+        float report_interval = 0.0f;           // Seconds between console reports, 0 disables them
+        std::chrono::steady_clock::time_point last_report;
+
+    public:
+
+        explicit GpuProfiler(const std::vector<std::string>& pass_names);
+        ~GpuProfiler();
+
+        GpuProfiler(const GpuProfiler&) = delete;
+        GpuProfiler& operator = (const GpuProfiler&) = delete;
+
+        // Collects whatever finished from previous frames and prepares this frame's queries
+        void beginFrame();
+        void endFrame();
+
+        void beginPass(size_t pass);
+        void endPass();
+
+        size_t getPassCount() const { return pass_names.size(); }
+        const std::string& getPassName(size_t pass) const { return pass_names[pass]; }
+
+        // Smoothed GPU time of a pass in milliseconds, 0 until the first result arrives
+        float getPassTimeMs(size_t pass) const { return smoothed_ms[pass]; }
+        float getTotalTimeMs() const;
+
+        void setReportInterval(float seconds) { report_interval = seconds; }
+        void report(std::ostream& out = std::cout) const;
+
+    private:
+
+        void collectResults();
+    };
+}
@@ -0,0 +1,553 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "GrassCuller.hpp"
+#include "ComputeShader.hpp"
+#include "CpuProfiler.hpp"
+#include "FragmentShader.hpp"
+#include "Frustum.hpp"
+#include "GeometryShader.hpp"
+#include "GrassMesh.hpp"
+#include "VertexShader.hpp"
+
+#include <gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+namespace space
+{
+    namespace
+    {
+        // Invocations per compute work group, handed to the shader as GROUP_SIZE
+        constexpr GLuint GROUP_SIZE = 64;
+
+        // Position, color, scale and rotation, as GrassMesh::setupInstanceBuffer() packs them
+        constexpr size_t INSTANCE_FLOATS = 8;
+        constexpr size_t INSTANCE_BYTES = INSTANCE_FLOATS * sizeof(float);
+    }
+
+    GrassCuller::~GrassCuller()
+    {
+        for (Readback& readback : readbacks)
+        {
+            if (readback.fence) glDeleteSync(readback.fence);
+            if (readback.buffer) glDeleteBuffers(1, &readback.buffer);
+        }
+
+        for (Feedback& feedback : feedbacks)
+        {
+            if (feedback.buffer) glDeleteBuffers(1, &feedback.buffer);
+            if (feedback.query) glDeleteQueries(1, &feedback.query);
+        }
+
+        if (depthTexture) glDeleteTextures(1, &depthTexture);
+        if (pyramidTexture) glDeleteTextures(1, &pyramidTexture);
+        if (pyramidFramebuffer) glDeleteFramebuffers(1, &pyramidFramebuffer);
+        if (emptyVao) glDeleteVertexArrays(1, &emptyVao);
+        if (cullVao) glDeleteVertexArrays(1, &cullVao);
+        if (visibleBuffer) glDeleteBuffers(1, &visibleBuffer);
+        if (commandBuffer) glDeleteBuffers(1, &commandBuffer);
+    }
+
+    bool GrassCuller::initialize(const std::string& shaderDirectory, Path requested)
+    {
+        SPACE_PROFILE_ZONE("GrassCuller::initialize");
+
+        path = Path::NONE;
+
+        if (requested == Path::NONE || !buildPyramidProgram(shaderDirectory)) return false;
+
+        if (requested == Path::COMPUTE)
+        {
+            if (glext::compute_shader && glext::draw_indirect && buildComputeProgram(shaderDirectory))
+            {
+                path = Path::COMPUTE;
+            }
+            else
+            {
+                std::cerr << "Compute shader grass culling is not available, using transform feedback" << std::endl;
+            }
+        }
+
+        if (path == Path::NONE)
+        {
+            if (!buildTransformFeedbackProgram(shaderDirectory)) return false;
+            path = Path::TRANSFORM_FEEDBACK;
+        }
+
+        const GLuint program = cullProgram->getProgramID();
+
+        frustumPlanesId = glGetUniformLocation(program, "frustum_planes");
+        cameraPositionId = glGetUniformLocation(program, "camera_position");
+        drawDistanceId = glGetUniformLocation(program, "draw_distance");
+        bladeExtentId = glGetUniformLocation(program, "blade_extent");
+        viewProjectionId = glGetUniformLocation(program, "view_projection_matrix");
+        depthPyramidId = glGetUniformLocation(program, "depth_pyramid");
+        pyramidLevelsId = glGetUniformLocation(program, "depth_pyramid_levels");
+        viewportSizeId = glGetUniformLocation(program, "viewport_size");
+        firstInstanceId = glGetUniformLocation(program, "first_instance");
+        instanceCountId = glGetUniformLocation(program, "instance_count");
+
+        glGenVertexArrays(1, &emptyVao);
+        glGenFramebuffers(1, &pyramidFramebuffer);
+
+        if (path == Path::COMPUTE)
+        {
+            glGenBuffers(1, &visibleBuffer);
+
+            const glext::DrawElementsIndirectCommand command = {};
+
+            glGenBuffers(1, &commandBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+            for (Readback& readback : readbacks)
+            {
+                glGenBuffers(1, &readback.buffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+                glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+            }
+
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        else
+        {
+            glGenVertexArrays(1, &cullVao);
+
+            for (Feedback& feedback : feedbacks)
+            {
+                glGenBuffers(1, &feedback.buffer);
+                glGenQueries(1, &feedback.query);
+            }
+        }
+
+        return true;
+    }
+
+    bool GrassCuller::buildComputeProgram(const std::string& shaderDirectory)
+    {
+        ComputeShader cull_compute_shader;
+        if (!cull_compute_shader.loadFromFiles("#version 430 core\n#define GROUP_SIZE " + std::to_string(GROUP_SIZE) + "\n",
+            { shaderDirectory + "common/grass_cull.glsl", shaderDirectory + "compute/grass_cull_compute_shader.glsl" }))
+        {
+            return false;
+        }
+
+        auto program = std::make_unique<ShaderProgram>();
+        program->attachShader(cull_compute_shader);
+
+        if (!program->link()) return false;
+
+        program->detachAndDeleteShaders({ cull_compute_shader });
+
+        cullProgram = std::move(program);
+        return true;
+    }
+
+    bool GrassCuller::buildTransformFeedbackProgram(const std::string& shaderDirectory)
+    {
+        VertexShader cull_vertex_shader;
+        if (!cull_vertex_shader.loadFromFiles("#version 330 core\n",
+            { shaderDirectory + "common/grass_cull.glsl", shaderDirectory + "vertex/grass_cull_vertex_shader.glsl" }))
+        {
+            return false;
+        }
+
+        GeometryShader cull_geometry_shader;
+        if (!cull_geometry_shader.loadFromFile(shaderDirectory + "geometry/grass_cull_geometry_shader.glsl")) return false;
+
+        auto program = std::make_unique<ShaderProgram>();
+        program->attachShader(cull_vertex_shader);
+        program->attachShader(cull_geometry_shader);
+
+        // Captured in the instance buffer layout
+        program->setTransformFeedbackVaryings({ "visible_position", "visible_color", "visible_scale", "visible_rotation" }, GL_INTERLEAVED_ATTRIBS);
+
+        if (!program->link()) return false;
+
+        program->detachAndDeleteShaders({ cull_vertex_shader, cull_geometry_shader });
+
+        cullProgram = std::move(program);
+        return true;
+    }
+
+    bool GrassCuller::buildPyramidProgram(const std::string& shaderDirectory)
+    {
+        VertexShader fullscreen_vertex_shader;
+        if (!fullscreen_vertex_shader.loadFromFile(shaderDirectory + "vertex/fullscreen_vertex_shader.glsl")) return false;
+
+        FragmentShader pyramid_fragment_shader;
+        if (!pyramid_fragment_shader.loadFromFile(shaderDirectory + "fragment/depth_pyramid_fragment_shader.glsl")) return false;
+
+        auto program = std::make_unique<ShaderProgram>();
+        program->attachShader(fullscreen_vertex_shader);
+        program->attachShader(pyramid_fragment_shader);
+
+        if (!program->link()) return false;
+
+        program->detachAndDeleteShaders({ fullscreen_vertex_shader, pyramid_fragment_shader });
+
+        program->use();
+        glUniform1i(glGetUniformLocation(program->getProgramID(), "source"), 0);
+
+        pyramidProgram = std::move(program);
+        return true;
+    }
+
+    void GrassCuller::resizePyramid(int width, int height)
+    {
+        if (width == viewportSize.x && height == viewportSize.y) return;
+
+        viewportSize = glm::ivec2(width, height);
+
+        if (depthTexture) glDeleteTextures(1, &depthTexture);
+        if (pyramidTexture) glDeleteTextures(1, &pyramidTexture);
+
+        // Copy of the depth buffer, read texel by texel
+        glGenTextures(1, &depthTexture);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+        // Halved (rounding down) level after level, from half the viewport down to 1 x 1
+        pyramidWidth = std::max(1, width / 2);
+        pyramidHeight = std::max(1, height / 2);
+        pyramidLevels = 0;
+
+        glGenTextures(1, &pyramidTexture);
+        glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+
+        for (int levelWidth = pyramidWidth, levelHeight = pyramidHeight; ; levelWidth = std::max(1, levelWidth / 2), levelHeight = std::max(1, levelHeight / 2))
+        {
+            glTexImage2D(GL_TEXTURE_2D, pyramidLevels++, GL_R32F, levelWidth, levelHeight, 0, GL_RED, GL_FLOAT, nullptr);
+
+            if (levelWidth == 1 && levelHeight == 1) break;
+        }
+
+        // Mipmapped filtering, or the levels past the first would not be fetched
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramidLevels - 1);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void GrassCuller::buildDepthPyramid(int width, int height)
+    {
+        SPACE_PROFILE_ZONE("GrassCuller::buildDepthPyramid");
+
+        pyramidValid = false;
+
+        if (path == Path::NONE || width < 1 || height < 1) return;
+
+        resizePyramid(width, height);
+
+        GLint drawFramebuffer = 0, readFramebuffer = 0, viewport[4];
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        const GLboolean blend = glIsEnabled(GL_BLEND);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, pyramidFramebuffer);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+
+        pyramidProgram->use();
+        glBindVertexArray(emptyVao);
+
+        int levelWidth = pyramidWidth;
+        int levelHeight = pyramidHeight;
+
+        for (int level = 0; level < pyramidLevels; ++level)
+        {
+            // Each level reads the one below, the only level left visible so it is not also written
+            if (level > 0)
+            {
+                glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            }
+
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, level);
+            glViewport(0, 0, levelWidth, levelHeight);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            levelWidth = std::max(1, levelWidth / 2);
+            levelHeight = std::max(1, levelHeight / 2);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramidLevels - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindVertexArray(0);
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(drawFramebuffer));
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(readFramebuffer));
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+        if (depthTest) glEnable(GL_DEPTH_TEST);
+        if (blend) glEnable(GL_BLEND);
+
+        pyramidValid = true;
+    }
+
+    void GrassCuller::reserveVisible(size_t instanceCount)
+    {
+        if (instanceCount <= visibleCapacity) return;
+
+        visibleCapacity = instanceCount;
+
+        if (path == Path::COMPUTE)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+            glBufferData(GL_ARRAY_BUFFER, visibleCapacity * INSTANCE_BYTES, nullptr, GL_DYNAMIC_COPY);
+        }
+        else
+        {
+            // The packed instances are gone with the old storage
+            for (Feedback& feedback : feedbacks)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, feedback.buffer);
+                glBufferData(GL_ARRAY_BUFFER, visibleCapacity * INSTANCE_BYTES, nullptr, GL_DYNAMIC_COPY);
+                feedback.packed = false;
+            }
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void GrassCuller::cull(GrassMesh& grass, const glm::mat4& viewProjection, const glm::vec3& cameraPosition)
+    {
+        SPACE_PROFILE_ZONE("GrassCuller::cull");
+
+        culled = false;
+
+        if (path == Path::NONE || grass.getInstanceBuffer() == 0 || grass.getInstanceCount() == 0)
+        {
+            visibleInstances = 0;
+            pyramidValid = false;
+            return;
+        }
+
+        const Frustum frustum(viewProjection);
+
+        // Instances from the first cell run in view to the end of the last, or all of them without cells
+        grass.cull(frustum, cameraPosition);
+
+        GLuint firstInstance = 0;
+        GLuint instanceCount = GLuint(grass.getInstanceCount());
+
+        if (!grass.getCells().empty())
+        {
+            const std::vector<GrassMesh::DrawRange>& ranges = grass.getDrawRanges();
+
+            firstInstance = ranges.empty() ? 0 : ranges.front().first;
+            instanceCount = ranges.empty() ? 0 : ranges.back().first + ranges.back().count - firstInstance;
+        }
+
+        reserveVisible(grass.getInstanceCount());
+
+        glm::vec4 planes[Frustum::PLANE_COUNT];
+
+        for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+        {
+            planes[i] = frustum.getPlane(i);
+        }
+
+        // Without a pyramid of this frame, the test stops at the frustum
+        const bool occlusion = occlusionEnabled && pyramidValid;
+
+        cullProgram->use();
+
+        glUniform4fv(frustumPlanesId, Frustum::PLANE_COUNT, glm::value_ptr(planes[0]));
+        glUniform3fv(cameraPositionId, 1, glm::value_ptr(cameraPosition));
+        glUniform1f(drawDistanceId, grass.getDrawDistance());
+        glUniform3fv(bladeExtentId, 1, glm::value_ptr(grass.getBladeExtent()));
+        glUniformMatrix4fv(viewProjectionId, 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glUniform1i(pyramidLevelsId, occlusion ? pyramidLevels : 0);
+        glUniform2i(viewportSizeId, viewportSize.x, viewportSize.y);
+        glUniform1i(depthPyramidId, 0);
+        glUniform1ui(firstInstanceId, firstInstance);
+        glUniform1ui(instanceCountId, instanceCount);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, occlusion ? pyramidTexture : 0);
+
+        if (path == Path::COMPUTE)
+        {
+            cullWithCompute(grass, instanceCount);
+        }
+        else
+        {
+            cullWithTransformFeedback(grass, firstInstance, instanceCount);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // A pyramid only stands for the frame it was built in
+        pyramidValid = false;
+        culled = true;
+    }
+
+    void GrassCuller::cullWithCompute(const GrassMesh& grass, GLuint instanceCount)
+    {
+        collectReadbacks();
+
+        // The shader counts the survivors into instanceCount
+        const glext::DrawElementsIndirectCommand command = { GLuint(grass.getIndices().size()), 0, 0, 0, 0 };
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(command), &command);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, grass.getInstanceBuffer());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+
+        if (instanceCount > 0)
+        {
+            glext::DispatchCompute((instanceCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+        }
+
+        // The draw reads the command and the packed instances, the copy below the count
+        glext::IssueMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        for (GLuint binding = 0; binding < 3; ++binding)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+        }
+
+        // Count copied aside for getVisibleInstanceCount(), unless every copy is still in flight
+        Readback& readback = readbacks[frameIndex % FRAME_LATENCY];
+
+        if (!readback.fence)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offsetof(glext::DrawElementsIndirectCommand, instanceCount), 0, sizeof(GLuint));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+            readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            ++frameIndex;
+        }
+    }
+
+    void GrassCuller::cullWithTransformFeedback(const GrassMesh& grass, GLuint firstInstance, GLuint instanceCount)
+    {
+        if (instanceCount == 0)
+        {
+            // What was packed before no longer matches the camera
+            for (Feedback& feedback : feedbacks)
+            {
+                feedback.packed = false;
+            }
+
+            visibleInstances = 0;
+            return;
+        }
+
+        Feedback& current = feedbacks[frameIndex % FEEDBACK_BUFFERS];
+        Feedback& previous = feedbacks[(frameIndex + FEEDBACK_BUFFERS - 1) % FEEDBACK_BUFFERS];
+        ++frameIndex;
+
+        // The instances go in as plain vertices, one point each
+        glBindVertexArray(cullVao);
+        glBindBuffer(GL_ARRAY_BUFFER, grass.getInstanceBuffer());
+
+        for (GLuint location = 0; location < 4; ++location)
+        {
+            glEnableVertexAttribArray(location);
+        }
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, GLsizei(INSTANCE_BYTES), (void*)(0));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, GLsizei(INSTANCE_BYTES), (void*)(3 * sizeof(float)));
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, GLsizei(INSTANCE_BYTES), (void*)(6 * sizeof(float)));
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, GLsizei(INSTANCE_BYTES), (void*)(7 * sizeof(float)));
+
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, current.buffer);
+        glEnable(GL_RASTERIZER_DISCARD);
+
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, current.query);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, GLint(firstInstance), GLsizei(instanceCount));
+        glEndTransformFeedback();
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+        glDisable(GL_RASTERIZER_DISCARD);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        current.packed = true;
+        current.counted = false;
+
+        // Nothing in 3.3 feeds a draw from the GPU. The last frame's pass has had a frame to
+        // finish, so it is drawn; only without one (the first pass) is this one waited on.
+        Feedback& drawn = previous.packed ? previous : current;
+
+        if (!drawn.counted)
+        {
+            glGetQueryObjectuiv(drawn.query, GL_QUERY_RESULT, &drawn.count);
+            drawn.counted = true;
+        }
+
+        drawnFeedback = unsigned(&drawn - feedbacks);
+        visibleInstances = drawn.count;
+    }
+
+    void GrassCuller::collectReadbacks()
+    {
+        // Oldest first, so the newest count that landed is the one kept
+        for (unsigned i = 0; i < FRAME_LATENCY; ++i)
+        {
+            Readback& readback = readbacks[(frameIndex + i) % FRAME_LATENCY];
+
+            if (!readback.fence) continue;
+
+            const GLenum status = glClientWaitSync(readback.fence, 0, 0);
+
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+
+            GLuint count = 0;
+            glBindBuffer(GL_COPY_READ_BUFFER, readback.buffer);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(count), &count);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+            glDeleteSync(readback.fence);
+            readback.fence = nullptr;
+
+            visibleInstances = count;
+        }
+    }
+
+    void GrassCuller::render(GrassMesh& grass) const
+    {
+        if (!culled) return;
+
+        if (path == Path::COMPUTE)
+        {
+            grass.renderVisible(visibleBuffer, 0, commandBuffer);
+        }
+        else
+        {
+            grass.renderVisible(feedbacks[drawnFeedback].buffer, GLsizei(visibleInstances), 0);
+        }
+    }
+}
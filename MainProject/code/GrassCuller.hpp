@@ -0,0 +1,181 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "GLExtensions.hpp"
+#include "ShaderProgram.hpp"
+
+#include <glm.hpp>
+
+#include <memory>
+#include <string>
+
+namespace space
+{
+    class GrassMesh;
+
+    /**
+    * Culls the grass instances on the GPU, one test per instance, after the cells on the
+    * CPU (GrassMesh::cull()) have bounded the span of the instance buffer worth testing.
+    *
+    * buildDepthPyramid() reduces the depth buffer, as the opaque geometry drawn before the
+    * grass left it, into a mip chain where every texel holds the farthest depth of the
+    * pixels under it (a Hi-Z pyramid). cull() then tests every instance of the span against
+    * the draw distance, the frustum planes and the pyramid: an instance whose box is behind
+    * the depth of every pixel it covers, read from the level where it spans 2 x 2 texels, is
+    * occluded. The survivors are packed into the visible buffer in the instance buffer
+    * layout, and render() draws them with the grass VAO reading from it.
+    *
+    * Two paths:
+    *  - COMPUTE (OpenGL 4.3): a compute shader appends the survivors with an atomic counter,
+    *    which is the instance count of a DrawElementsIndirect command in a buffer, so the
+    *    draw needs nothing from the CPU.
+    *  - TRANSFORM_FEEDBACK (OpenGL 3.3): the instances are drawn as points with the
+    *    rasterizer off, a geometry shader emits only the survivors and transform feedback
+    *    packs them. 3.3 cannot source a draw from the GPU, so the count comes back from a
+    *    GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN query. Two buffers take turns: each frame
+    *    packs into one and draws what the other kept the frame before, whose query is done
+    *    by then, so the survivors trail the camera by a frame instead of the CPU waiting.
+    */
+    class GrassCuller
+    {
+    public:
+
+        enum class Path
+        {
+            NONE,
+            TRANSFORM_FEEDBACK,
+            COMPUTE
+        };
+
+        // Frames the visible counts of the compute path are read back late, so reading never waits
+        static constexpr unsigned FRAME_LATENCY = 4;
+
+        // Buffers the transform feedback path packs into in turn
+        static constexpr unsigned FEEDBACK_BUFFERS = 2;
+
+        GrassCuller() = default;
+        ~GrassCuller();
+
+        GrassCuller(const GrassCuller&) = delete;
+        GrassCuller& operator = (const GrassCuller&) = delete;
+
+        /**
+        * Builds the programs of path, or of TRANSFORM_FEEDBACK when the context lacks compute
+        * shaders or indirect draws, from the shaders under shaderDirectory (ending with a
+        * slash). Returns false, reporting why, when nothing could be built.
+        */
+        bool initialize(const std::string& shaderDirectory, Path path = Path::COMPUTE);
+
+        Path getPath() const { return path; }
+
+        /**
+        * Rebuilds the depth pyramid from the depth buffer of the bound read framebuffer, width x
+        * height pixels, for the next cull(). Restores the framebuffers, viewport, depth test
+        * and blending it changes.
+        */
+        void buildDepthPyramid(int width, int height);
+
+        // Until false, cull() tests against the frustum and the draw distance only
+        void setOcclusionEnabled(bool enabled) { occlusionEnabled = enabled; }
+        bool isOcclusionEnabled() const { return occlusionEnabled; }
+
+        /**
+        * Culls the cells of grass first (GrassMesh::cull()), then tests every instance from
+        * the first cell run kept to the end of the last against viewProjection (of the
+        * pyramid's frame), the grass draw distance from cameraPosition and the depth pyramid,
+        * all in world space like the instances, and packs the survivors for the next render().
+        */
+        void cull(GrassMesh& grass, const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+
+        /**
+        * Draws what the last cull() kept (the one before it on the transform feedback path),
+        * with the grass shader in use.
+        */
+        void render(GrassMesh& grass) const;
+
+        /**
+        * Instances render() draws. The compute path only learns it FRAME_LATENCY frames
+        * later at most, so it trails the camera by a few frames.
+        */
+        size_t getVisibleInstanceCount() const { return visibleInstances; }
+
+        int getPyramidLevelCount() const { return pyramidLevels; }
+
+    private:
+
+        struct Readback
+        {
+            GLuint buffer = 0;
+            GLsync fence = nullptr;
+        };
+
+        struct Feedback
+        {
+            GLuint buffer = 0;
+            GLuint query = 0;
+            GLuint count = 0;
+            bool packed = false;        // Holds the survivors of a pass
+            bool counted = false;       // Its query was read into count
+        };
+
+        Path path = Path::NONE;
+        bool occlusionEnabled = true;
+
+        std::unique_ptr<ShaderProgram> cullProgram;
+        std::unique_ptr<ShaderProgram> pyramidProgram;
+
+        // Uniforms of the cull program
+        GLint frustumPlanesId = -1;
+        GLint cameraPositionId = -1;
+        GLint drawDistanceId = -1;
+        GLint bladeExtentId = -1;
+        GLint viewProjectionId = -1;
+        GLint depthPyramidId = -1;
+        GLint pyramidLevelsId = -1;
+        GLint viewportSizeId = -1;
+        GLint firstInstanceId = -1;
+        GLint instanceCountId = -1;
+
+        // Depth copy and pyramid
+        GLuint depthTexture = 0;
+        GLuint pyramidTexture = 0;
+        GLuint pyramidFramebuffer = 0;
+        GLuint emptyVao = 0;
+        int pyramidWidth = 0;
+        int pyramidHeight = 0;
+        int pyramidLevels = 0;
+        glm::ivec2 viewportSize = glm::ivec2(0);
+        bool pyramidValid = false;
+
+        // Survivors in the instance buffer layout, and what draws them
+        GLuint cullVao = 0;
+        GLuint visibleBuffer = 0;
+        size_t visibleCapacity = 0;
+        GLuint commandBuffer = 0;
+        size_t visibleInstances = 0;
+        bool culled = false;
+
+        Readback readbacks[FRAME_LATENCY];
+        unsigned frameIndex = 0;
+
+        Feedback feedbacks[FEEDBACK_BUFFERS];
+        unsigned drawnFeedback = 0;
+
+        bool buildComputeProgram(const std::string& shaderDirectory);
+        bool buildTransformFeedbackProgram(const std::string& shaderDirectory);
+        bool buildPyramidProgram(const std::string& shaderDirectory);
+
+        void resizePyramid(int width, int height);
+        void reserveVisible(size_t instanceCount);
+
+        void cullWithCompute(const GrassMesh& grass, GLuint instanceCount);
+        void cullWithTransformFeedback(const GrassMesh& grass, GLuint firstInstance, GLuint instanceCount);
+
+        // Visible counts of earlier compute passes whose copies have landed
+        void collectReadbacks();
+    };
+}
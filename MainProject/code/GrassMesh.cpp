@@ -5,6 +5,15 @@
 
 #include "GrassMesh.hpp"
 #include "HeightMapTerrain.hpp"
+#include "CounterRandom.hpp"
+#include "CpuProfiler.hpp"
+#include "Frustum.hpp"
+#include "GrassPlacementMap.hpp"
+#include "PoissonDiskSampler.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
 #include <functional>
 #include <ext/scalar_constants.hpp>
@@ -13,8 +22,29 @@
 
 namespace space
 {
+    namespace
+    {
+        // Placement attempts per task; the split never changes which instances are kept
+        constexpr uint64_t ATTEMPTS_PER_CHUNK = 16 * 1024;
+
+        // Positions per height sampler call
+        constexpr size_t SAMPLE_BATCH = 256;
+
+        // Instances per task when placing from a GrassPlacementMap
+        constexpr size_t INSTANCES_PER_CHUNK = 16 * 1024;
+
+        // Draws in a partly eligible quad before settling on a point of its eligible part
+        constexpr uint32_t PLACEMENT_ATTEMPTS = 4;
+
+        // Counter stream of the variation of instances placed from a GrassPlacementMap, apart
+        // from the one of the rejection attempts they may top up
+        constexpr uint32_t PLACED_VARIATION_STREAM = 3;
+    }
+
     bool GrassMesh::loadFromFile(const std::string& filepath)
     {
+        SPACE_PROFILE_ZONE("GrassMesh::loadFromFile");
+
         // Load the mesh file using Assimp
         const aiScene* scene = importer->ReadFile(filepath,
             aiProcess_Triangulate |
@@ -34,7 +64,7 @@ namespace space
         if (scene->mNumMeshes > 0)
         {
             processMesh(scene->mMeshes[0]);
-            setUpMesh(); // Call the parent class method to set up VAO/VBOs
+            setUpMesh< VertexLayout< vertex::PositionHalf, vertex::OctahedralNormal > >(); // No per vertex color, the instances bring it
             return true;
         }
 
@@ -52,7 +82,6 @@ namespace space
         // Reserve space for efficiency
         vertices.reserve(mesh->mNumVertices);
         normals.reserve(mesh->mNumVertices);
-        colors.reserve(mesh->mNumVertices);
 
         // Process vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -69,9 +98,6 @@ namespace space
             {
                 normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f)); // Default up normal
             }
-
-            // Color - will be overridden by instance color
-            colors.push_back(glm::vec3(1.0f, 1.0f, 1.0f));
         }
 
         // Process indices
@@ -89,7 +115,7 @@ namespace space
             << indices.size() / 3 << " triangles" << std::endl;
     }
 
-    glm::vec3 GrassMesh::getColorForHeight(float normalizedHeight)
+    glm::vec3 GrassMesh::getColorForHeight(float normalizedHeight) const
     {
         // Determine grass color based on height
         // This matches the terrain coloring scheme
@@ -116,6 +142,23 @@ namespace space
         return grassColor;
     }
 
+    float GrassMesh::getSpacingForHeight(float normalizedHeight) const
+    {
+        // Same zones and blends as getColorForHeight
+        if (normalizedHeight < 0.35f)
+        {
+            return zoneSpacing.x;
+        }
+        else if (normalizedHeight < 0.55f)
+        {
+            float t = (normalizedHeight - 0.35f) / 0.2f;
+            return zoneSpacing.x + t * (zoneSpacing.y - zoneSpacing.x);
+        }
+
+        float t = (normalizedHeight - 0.55f) / 0.15f;
+        return zoneSpacing.y + t * (zoneSpacing.z - zoneSpacing.y);
+    }
+
     void GrassMesh::generateInstances(
         int instanceCount,
         float terrainWidth,
@@ -178,80 +221,121 @@ namespace space
         setupInstanceBuffer();
     }
 
-    void GrassMesh::generateInstancesForTerrain(int instanceCount, float worldWidth, float worldHeight, const glm::vec3& terrainWorldPos, std::function<GrassHeightInfo(float, float)> heightSampler)
+    void GrassMesh::generateInstancesForTerrain(int instanceCount, float worldWidth, float worldHeight, const glm::vec3& terrainWorldPos, std::function<GrassHeightInfo(float, float)> heightSampler, ThreadPool* pool)
     {
-        instances.clear();
-        instances.reserve(instanceCount);
+        generateInstancesForTerrain(instanceCount, worldWidth, worldHeight, terrainWorldPos,
+            [&heightSampler](const float* worldX, const float* worldZ, size_t count, GrassHeightInfo* out)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    out[i] = heightSampler(worldX[i], worldZ[i]);
+                }
+            },
+            pool);
+    }
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
+    void GrassMesh::generateInstancesForTerrain(int instanceCount, float worldWidth, float worldHeight, const glm::vec3& terrainWorldPos, const GrassHeightBatchSampler& heightSampler, ThreadPool* pool)
+    {
+        SPACE_PROFILE_ZONE("GrassMesh::generateInstancesForTerrain");
 
-        // Distribution for random placement in world space
-        // The terrain is centered at terrainWorldPos, so we distribute around it
-        std::uniform_real_distribution<float> posDistX(
-            terrainWorldPos.x - worldWidth / 2.0f,
-            terrainWorldPos.x + worldWidth / 2.0f
-        );
-        std::uniform_real_distribution<float> posDistZ(
-            terrainWorldPos.z - worldHeight / 2.0f,
-            terrainWorldPos.z + worldHeight / 2.0f
-        );
+        instances.clear();
+        instances.reserve(std::max(instanceCount, 0));
 
-        // Random distributions for visual variety
-        std::uniform_real_distribution<float> rotDist(0.0f, 1.5f * glm::pi<float>());
-        std::uniform_real_distribution<float> scaleDist(0.001f, 0.002f);
-        std::uniform_real_distribution<float> heightOffsetDist(-0.05f, 0.05f);
-        std::uniform_real_distribution<float> colorVariation(0.9f, 1.1f);
+        ThreadPool& workers = pool ? *pool : ThreadPool::shared();
+        const CounterRandom random(seed);
 
-        int attemptCount = 0;
-        int maxAttempts = instanceCount * 10;  // Allow multiple attempts for better coverage
+        // The terrain is centered at terrainWorldPos, so we distribute around it
+        const float minX = terrainWorldPos.x - worldWidth / 2.0f;
+        const float maxX = terrainWorldPos.x + worldWidth / 2.0f;
+        const float minZ = terrainWorldPos.z - worldHeight / 2.0f;
+        const float maxZ = terrainWorldPos.z + worldHeight / 2.0f;
 
         // Debug info
         std::cout << "Generating grass in world bounds:" << std::endl;
-        std::cout << "  X: [" << (terrainWorldPos.x - worldWidth / 2)
-            << " to " << (terrainWorldPos.x + worldWidth / 2) << "]" << std::endl;
-        std::cout << "  Z: [" << (terrainWorldPos.z - worldHeight / 2)
-            << " to " << (terrainWorldPos.z + worldHeight / 2) << "]" << std::endl;
+        std::cout << "  X: [" << minX << " to " << maxX << "]" << std::endl;
+        std::cout << "  Z: [" << minZ << " to " << maxZ << "]" << std::endl;
 
-        while (instances.size() < instanceCount && attemptCount < maxAttempts)
+        // Attempt a draws its position from counter (a, 0) and, if kept, its variation from (a, 1)
+        auto generateChunk = [&](uint64_t chunk, std::vector<GrassInstance>& out, std::vector<uint64_t>& outAttempts)
         {
-            attemptCount++;
-
-            // Generate random position in world space
-            float worldX = posDistX(gen);
-            float worldZ = posDistZ(gen);
+            const uint64_t firstAttempt = chunk * ATTEMPTS_PER_CHUNK;
+            const uint64_t lastAttempt = std::min(firstAttempt + ATTEMPTS_PER_CHUNK, uint64_t(instanceCount) * 10);
 
-            // Sample height information at this position
-            GrassHeightInfo heightInfo = heightSampler(worldX, worldZ);
+            float worldX[SAMPLE_BATCH];
+            float worldZ[SAMPLE_BATCH];
+            GrassHeightInfo heightInfo[SAMPLE_BATCH];
 
-            // Check if this height is suitable for grass
-            // normalizedHeight should be between 0 and 1
-            if (heightInfo.normalizedHeight < minHeight || heightInfo.normalizedHeight > maxHeight)
+            for (uint64_t batchStart = firstAttempt; batchStart < lastAttempt; batchStart += SAMPLE_BATCH)
             {
-                continue;  // Skip water and mountain peaks
+                const size_t batch = size_t(std::min<uint64_t>(SAMPLE_BATCH, lastAttempt - batchStart));
+
+                for (size_t i = 0; i < batch; ++i)
+                {
+                    const uint64_t attempt = batchStart + i;
+                    const CounterRandom::Block bits = random.generate(uint32_t(attempt), uint32_t(attempt >> 32));
+
+                    worldX[i] = CounterRandom::toRange(bits[0], minX, maxX);
+                    worldZ[i] = CounterRandom::toRange(bits[1], minZ, maxZ);
+                }
+
+                heightSampler(worldX, worldZ, batch, heightInfo);
+
+                for (size_t i = 0; i < batch; ++i)
+                {
+                    // Skip water and mountain peaks
+                    if (heightInfo[i].normalizedHeight < minHeight || heightInfo[i].normalizedHeight > maxHeight) continue;
+
+                    out.push_back(makeInstance(random, batchStart + i, worldX[i], worldZ[i], heightInfo[i]));
+                    outAttempts.push_back(batchStart + i);
+                }
             }
+        };
 
-            // Use the world height directly from the sampler
-            float worldY = heightInfo.worldHeight;
+        const uint64_t chunkCount = (uint64_t(std::max(instanceCount, 0)) * 10 + ATTEMPTS_PER_CHUNK - 1) / ATTEMPTS_PER_CHUNK;
+        uint64_t nextChunk = 0;
 
-            // Add slight random height offset for natural variation
-            worldY += heightOffsetDist(gen);
+        std::vector<std::vector<GrassInstance>> chunks;
+        std::vector<std::vector<uint64_t>> chunkAttempts;
 
-            // Get appropriate color for this height
-            glm::vec3 grassColor = getColorForHeight(heightInfo.normalizedHeight);
+        // Attempts up to the last instance kept; later ones of its wave were evaluated but not needed
+        uint64_t attemptCount = 0;
+
+        // Waves of chunks until enough instances are kept or the attempts run out
+        while (instances.size() < size_t(std::max(instanceCount, 0)) && nextChunk < chunkCount)
+        {
+            const size_t missing = size_t(instanceCount) - instances.size();
+
+            // Enough chunks for the missing instances at the acceptance seen so far, at least one per thread
+            const double acceptance = nextChunk == 0 ? 1.0 : std::max(double(instances.size()) / double(nextChunk * ATTEMPTS_PER_CHUNK), 0.01);
+            const uint64_t wanted = uint64_t(std::ceil(missing / acceptance / ATTEMPTS_PER_CHUNK));
+            const uint64_t wave = std::min(std::max<uint64_t>(wanted, workers.getThreadCount()), chunkCount - nextChunk);
+
+            chunks.assign(size_t(wave), {});
+            chunkAttempts.assign(size_t(wave), {});
+
+            workers.parallelFor(0, size_t(wave), 1, [&](size_t first, size_t last)
+                {
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        generateChunk(nextChunk + i, chunks[i], chunkAttempts[i]);
+                    }
+                });
+
+            // In attempt order, as a serial loop would have kept them
+            for (size_t i = 0; i < chunks.size(); ++i)
+            {
+                const size_t take = std::min(chunks[i].size(), size_t(instanceCount) - instances.size());
+                instances.insert(instances.end(), chunks[i].begin(), chunks[i].begin() + take);
 
-            // Add some color variation for natural look
-            grassColor *= colorVariation(gen);
-            grassColor = glm::clamp(grassColor, glm::vec3(0.0f), glm::vec3(1.0f));
+                if (take > 0) attemptCount = chunkAttempts[i][take - 1] + 1;
+            }
 
-            // Create grass instance
-            GrassInstance instance;
-            instance.position = glm::vec3(worldX, worldY, worldZ);
-            instance.color = grassColor;
-            instance.scale = scaleDist(gen);
-            instance.rotation = rotDist(gen);
+            nextChunk += wave;
+        }
 
-            instances.push_back(instance);
+        if (instances.empty())
+        {
+            attemptCount = std::min(nextChunk * ATTEMPTS_PER_CHUNK, uint64_t(std::max(instanceCount, 0)) * 10);
         }
 
         std::cout << "Generated " << instances.size() << " grass instances out of "
@@ -262,9 +346,206 @@ namespace space
         setupInstanceBuffer();
     }
 
+    void GrassMesh::generateInstancesForTerrain(int instanceCount, float worldWidth, float worldHeight, const glm::vec3& terrainWorldPos, const GrassPlacementMap& placement, const GrassHeightBatchSampler& heightSampler, ThreadPool* pool)
+    {
+        SPACE_PROFILE_ZONE("GrassMesh::generateInstancesForTerrain (placement map)");
+
+        instances.clear();
+        fillInstancesForTerrain(instanceCount, worldWidth, worldHeight, terrainWorldPos, placement, heightSampler, pool);
+    }
+
+    void GrassMesh::fillInstancesForTerrain(int instanceCount, float worldWidth, float worldHeight, const glm::vec3& terrainWorldPos, const GrassPlacementMap& placement, const GrassHeightBatchSampler& heightSampler, ThreadPool* pool)
+    {
+        SPACE_PROFILE_ZONE("GrassMesh::fillInstancesForTerrain");
+
+        const size_t placed = instances.size();
+
+        if (placed >= size_t(std::max(instanceCount, 0))) return;
+
+        if (placement.isEmpty())
+        {
+            if (placed == 0) std::cout << "No terrain within the grass height range, no grass generated" << std::endl;
+            return;
+        }
+
+        instances.resize(size_t(instanceCount));
+
+        ThreadPool& workers = pool ? *pool : ThreadPool::shared();
+        const CounterRandom random(seed);
+
+        const float minX = terrainWorldPos.x - worldWidth / 2.0f;
+        const float minZ = terrainWorldPos.z - worldHeight / 2.0f;
+
+        std::atomic<uint64_t> retries{ 0 };
+
+        workers.parallelFor(placed, instances.size(), INSTANCES_PER_CHUNK, [&](size_t first, size_t last)
+            {
+                float worldX[SAMPLE_BATCH];
+                float worldZ[SAMPLE_BATCH];
+                GrassPlacementMap::Placement placements[SAMPLE_BATCH];
+                GrassHeightInfo heightInfo[SAMPLE_BATCH];
+
+                // Instances of the batch still without a position, compacted at the front of the arrays
+                uint64_t pending[SAMPLE_BATCH];
+
+                uint64_t chunkRetries = 0;
+
+                for (size_t batchStart = first; batchStart < last; batchStart += SAMPLE_BATCH)
+                {
+                    size_t pendingCount = std::min(SAMPLE_BATCH, last - batchStart);
+
+                    for (size_t i = 0; i < pendingCount; ++i) pending[i] = batchStart + i;
+
+                    for (uint32_t attempt = 0; attempt <= PLACEMENT_ATTEMPTS && pendingCount > 0; ++attempt)
+                    {
+                        const bool lastAttempt = attempt == PLACEMENT_ATTEMPTS;
+
+                        if (!lastAttempt) placement.draw(random, pending, pendingCount, attempt, placements);
+
+                        for (size_t i = 0; i < pendingCount; ++i)
+                        {
+                            const glm::vec2 position = lastAttempt ? placement.getEligiblePoint(placements[i]) : placements[i].position;
+
+                            worldX[i] = minX + position.x * worldWidth;
+                            worldZ[i] = minZ + position.y * worldHeight;
+                        }
+
+                        heightSampler(worldX, worldZ, pendingCount, heightInfo);
+
+                        size_t kept = 0;
+
+                        for (size_t i = 0; i < pendingCount; ++i)
+                        {
+                            const float normalizedHeight = heightInfo[i].normalizedHeight;
+
+                            // The eligible point is taken as it is, whatever the rounding of its height
+                            if (lastAttempt || (normalizedHeight >= minHeight && normalizedHeight <= maxHeight))
+                            {
+                                instances[pending[i]] = makeInstance(random, pending[i], worldX[i], worldZ[i], heightInfo[i], PLACED_VARIATION_STREAM);
+                                continue;
+                            }
+
+                            pending[kept] = pending[i];
+                            placements[kept] = placements[i];
+                            ++kept;
+                        }
+
+                        chunkRetries += kept;
+                        pendingCount = kept;
+                    }
+                }
+
+                retries += chunkRetries;
+            });
+
+        std::cout << "Generated " << instances.size() - placed << " grass instances from a placement map of "
+            << placement.getQuadCount() << " quads (retries: "
+            << (float)retries.load() / (instances.size() - placed) << " per instance)" << std::endl;
+
+        // Set up the instance buffer after generation
+        setupInstanceBuffer();
+    }
+
+    void GrassMesh::generatePoissonInstancesForTerrain(float spacing, float worldWidth, float worldHeight, const glm::vec3& terrainWorldPos, const GrassHeightBatchSampler& heightSampler, ThreadPool* pool)
+    {
+        SPACE_PROFILE_ZONE("GrassMesh::generatePoissonInstancesForTerrain");
+
+        instances.clear();
+
+        ThreadPool& workers = pool ? *pool : ThreadPool::shared();
+        const CounterRandom random(seed);
+
+        // The hill factor keeps growing past the top of the hill zone; the height range bounds it
+        const float lowest = std::min(std::min(zoneSpacing.x, zoneSpacing.y), std::min(zoneSpacing.z, getSpacingForHeight(maxHeight)));
+        const float highest = std::max(std::max(zoneSpacing.x, zoneSpacing.y), std::max(zoneSpacing.z, getSpacingForHeight(maxHeight)));
+
+        if (!(spacing > 0.0f) || !(lowest > 0.0f))
+        {
+            std::cerr << "Poisson-disk grass needs a positive spacing in every zone" << std::endl;
+            return;
+        }
+
+        PoissonDiskSampler sampler;
+
+        sampler.generate(glm::vec2(terrainWorldPos.x - worldWidth / 2.0f, terrainWorldPos.z - worldHeight / 2.0f), glm::vec2(worldWidth, worldHeight),
+            spacing * lowest, spacing * highest,
+            [&](const float* worldX, const float* worldZ, size_t count, float* radius)
+            {
+                GrassHeightInfo heightInfo[PoissonDiskSampler::MAX_BATCH];
+
+                heightSampler(worldX, worldZ, count, heightInfo);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const float normalizedHeight = heightInfo[i].normalizedHeight;
+
+                    // No grass on water or mountain peaks
+                    radius[i] = normalizedHeight < minHeight || normalizedHeight > maxHeight ? 0.0f : spacing * getSpacingForHeight(normalizedHeight);
+                }
+            },
+            random, workers);
+
+        const std::vector<glm::vec2>& points = sampler.getPoints();
+        instances.resize(points.size());
+
+        // Instance i gets its variation from counter (i, 1), as in the other placements
+        workers.parallelFor(0, points.size(), INSTANCES_PER_CHUNK, [&](size_t first, size_t last)
+            {
+                float worldX[SAMPLE_BATCH];
+                float worldZ[SAMPLE_BATCH];
+                GrassHeightInfo heightInfo[SAMPLE_BATCH];
+
+                for (size_t batchStart = first; batchStart < last; batchStart += SAMPLE_BATCH)
+                {
+                    const size_t batch = std::min(SAMPLE_BATCH, last - batchStart);
+
+                    for (size_t i = 0; i < batch; ++i)
+                    {
+                        worldX[i] = points[batchStart + i].x;
+                        worldZ[i] = points[batchStart + i].y;
+                    }
+
+                    heightSampler(worldX, worldZ, batch, heightInfo);
+
+                    for (size_t i = 0; i < batch; ++i)
+                    {
+                        instances[batchStart + i] = makeInstance(random, batchStart + i, worldX[i], worldZ[i], heightInfo[i]);
+                    }
+                }
+            });
+
+        std::cout << "Generated " << instances.size() << " Poisson-disk grass instances, spacing " << spacing
+            << " over " << sampler.getTilesX() << "x" << sampler.getTilesZ() << " tiles (grid: "
+            << sampler.getGridByteSize() / (1024 * 1024) << " MB)" << std::endl;
+
+        // Set up the instance buffer after generation
+        setupInstanceBuffer();
+    }
+
+    GrassInstance GrassMesh::makeInstance(const CounterRandom& random, uint64_t index, float worldX, float worldZ, const GrassHeightInfo& heightInfo, uint32_t stream) const
+    {
+        const CounterRandom::Block bits = random.generate(uint32_t(index), uint32_t(index >> 32), stream);
+
+        // Slight height offset and color variation for a natural look
+        glm::vec3 grassColor = getColorForHeight(heightInfo.normalizedHeight) * CounterRandom::toRange(bits[1], 0.9f, 1.1f);
+
+        GrassInstance instance;
+        instance.position = glm::vec3(worldX, heightInfo.worldHeight + CounterRandom::toRange(bits[0], -0.05f, 0.05f), worldZ);
+        instance.color = glm::clamp(grassColor, glm::vec3(0.0f), glm::vec3(1.0f));
+        instance.scale = CounterRandom::toRange(bits[2], 0.001f, 0.002f);
+        instance.rotation = CounterRandom::toRange(bits[3], 0.0f, 1.5f * glm::pi<float>());
+
+        return instance;
+    }
+
     void GrassMesh::setupInstanceBuffer()
     {
-        if (instances.empty()) return;
+        SPACE_PROFILE_ZONE("GrassMesh::setupInstanceBuffer");
+
+        sortIntoCells();
+
+        // Nothing to attach to until the blade model has been uploaded (headless generation)
+        if (instances.empty() || vao_id == 0) return;
 
         // Delete old buffer if it exists
         if (instanceVBO)
@@ -302,30 +583,160 @@ namespace space
         // Bind VAO to set up instance attributes
         glBindVertexArray(vao_id);
 
-        // Instance position (location = 3)
         glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glVertexAttribDivisor(3, 1); // This attribute advances once per instance
-
-        // Instance color (location = 4)
         glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glVertexAttribDivisor(4, 1);
-
-        // Instance scale (location = 5)
         glEnableVertexAttribArray(5);
-        glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glVertexAttribDivisor(5, 1);
-
-        // Instance rotation (location = 6)
         glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(7 * sizeof(float)));
+
+        // These attributes advance once per instance
+        glVertexAttribDivisor(3, 1);
+        glVertexAttribDivisor(4, 1);
+        glVertexAttribDivisor(5, 1);
         glVertexAttribDivisor(6, 1);
 
+        setInstanceAttributes(instanceVBO, 0);
+
         glBindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
+    void GrassMesh::setInstanceAttributes(GLuint buffer, GLuint firstInstance)
+    {
+        const size_t stride = 8 * sizeof(float);
+        const size_t base = size_t(firstInstance) * stride;
+
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+        // Position (location = 3), color (4), scale (5) and rotation (6)
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, GLsizei(stride), (void*)(base));
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, GLsizei(stride), (void*)(base + 3 * sizeof(float)));
+        glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, GLsizei(stride), (void*)(base + 6 * sizeof(float)));
+        glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, GLsizei(stride), (void*)(base + 7 * sizeof(float)));
+    }
+
+    void GrassMesh::sortIntoCells()
+    {
+        SPACE_PROFILE_ZONE("GrassMesh::sortIntoCells");
+
+        cells.clear();
+        drawRanges.clear();
+        culled = false;
+        visibleCells = 0;
+        visibleInstances = 0;
+
+        if (instances.empty() || !(cellSize > 0.0f)) return;
+
+        glm::vec2 low(instances[0].position.x, instances[0].position.z);
+        glm::vec2 high = low;
+
+        for (const GrassInstance& instance : instances)
+        {
+            low = glm::min(low, glm::vec2(instance.position.x, instance.position.z));
+            high = glm::max(high, glm::vec2(instance.position.x, instance.position.z));
+        }
+
+        const int cellsX = std::max(1, int(std::ceil((high.x - low.x) / cellSize)));
+        const int cellsZ = std::max(1, int(std::ceil((high.y - low.y) / cellSize)));
+
+        auto cellOf = [&](const GrassInstance& instance)
+        {
+            const int x = std::min(int((instance.position.x - low.x) / cellSize), cellsX - 1);
+            const int z = std::min(int((instance.position.z - low.y) / cellSize), cellsZ - 1);
+            return size_t(z) * cellsX + x;
+        };
+
+        // Counts, then first instance of every cell, then each instance to its place in generation order
+        std::vector<uint32_t> offsets(size_t(cellsX) * cellsZ + 1, 0);
+
+        for (const GrassInstance& instance : instances)
+        {
+            ++offsets[cellOf(instance) + 1];
+        }
+
+        for (size_t i = 1; i < offsets.size(); ++i)
+        {
+            offsets[i] += offsets[i - 1];
+        }
+
+        std::vector<GrassInstance> sorted(instances.size());
+        std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+
+        for (const GrassInstance& instance : instances)
+        {
+            sorted[next[cellOf(instance)]++] = instance;
+        }
+
+        instances.swap(sorted);
+
+        // A blade spins about Y and scales with its instance: padded by its XZ radius and height range
+        const glm::vec3 blade = getBladeExtent();
+
+        for (size_t cell = 0; cell + 1 < offsets.size(); ++cell)
+        {
+            if (offsets[cell] == offsets[cell + 1]) continue;
+
+            Cell range;
+            range.firstInstance = offsets[cell];
+            range.instanceCount = offsets[cell + 1] - offsets[cell];
+
+            for (GLuint i = range.firstInstance; i < offsets[cell + 1]; ++i)
+            {
+                const GrassInstance& instance = instances[i];
+                range.bounds.extend(instance.position + glm::vec3(-blade.x, blade.y, -blade.x) * instance.scale);
+                range.bounds.extend(instance.position + glm::vec3(blade.x, blade.z, blade.x) * instance.scale);
+            }
+
+            cells.push_back(range);
+        }
+    }
+
+    glm::vec3 GrassMesh::getBladeExtent() const
+    {
+        const BoundingBox blade = getBounds();
+
+        if (blade.isEmpty()) return glm::vec3(0.0f);
+
+        const float radius = std::sqrt(std::max(blade.min.x * blade.min.x, blade.max.x * blade.max.x) + std::max(blade.min.z * blade.min.z, blade.max.z * blade.max.z));
+
+        return glm::vec3(radius, blade.min.y, blade.max.y);
+    }
+
+    void GrassMesh::cull(const Frustum& frustum, const glm::vec3& cameraPosition)
+    {
+        SPACE_PROFILE_ZONE("GrassMesh::cull");
+
+        drawRanges.clear();
+        visibleCells = 0;
+        visibleInstances = 0;
+
+        // Without cells (a cell size of 0) everything is drawn
+        culled = !cells.empty();
+
+        const float distanceSquared = drawDistance * drawDistance;
+
+        for (const Cell& cell : cells)
+        {
+            // Nearest point of the cell to the camera
+            const glm::vec3 offset = glm::clamp(cameraPosition, cell.bounds.min, cell.bounds.max) - cameraPosition;
+
+            if (glm::dot(offset, offset) > distanceSquared) continue;
+            if (frustum.classify(cell.bounds) == Frustum::OUTSIDE) continue;
+
+            ++visibleCells;
+            visibleInstances += cell.instanceCount;
+
+            // Cells that follow each other in the buffer draw as one run
+            if (!drawRanges.empty() && drawRanges.back().first + drawRanges.back().count == cell.firstInstance)
+            {
+                drawRanges.back().count += cell.instanceCount;
+            }
+            else
+            {
+                drawRanges.push_back({ cell.firstInstance, cell.instanceCount });
+            }
+        }
+    }
+
     void GrassMesh::render()
     {
         if (vao_id == 0 || instances.empty())
@@ -336,12 +747,54 @@ namespace space
 
         glBindVertexArray(vao_id);
 
-        // Use instanced drawing - this is much more efficient than drawing each instance separately
-        glDrawElementsInstanced(GL_TRIANGLES,
-            static_cast<GLsizei>(indices.size()),
-            GL_UNSIGNED_INT,
-            nullptr,
-            static_cast<GLsizei>(instances.size()));
+        const GLsizei indexCount = static_cast<GLsizei>(indices.size());
+
+        if (!culled)
+        {
+            // Use instanced drawing - this is much more efficient than drawing each instance separately
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, index_type, nullptr, static_cast<GLsizei>(instances.size()));
+        }
+        else if (glext::multi_draw_indirect && glext::base_instance)
+        {
+            // Every run in one call, from commands streamed into the indirect buffer
+            if (!drawRanges.empty())
+            {
+                drawCommands.clear();
+
+                for (const DrawRange& range : drawRanges)
+                {
+                    drawCommands.push_back({ GLuint(indexCount), range.count, 0, 0, range.first });
+                }
+
+                if (!indirectBuffer) glGenBuffers(1, &indirectBuffer);
+
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+                glBufferData(GL_DRAW_INDIRECT_BUFFER, drawCommands.size() * sizeof(glext::DrawElementsIndirectCommand), drawCommands.data(), GL_STREAM_DRAW);
+
+                glext::MultiDrawElementsIndirect(GL_TRIANGLES, index_type, nullptr, GLsizei(drawCommands.size()), 0);
+
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            }
+        }
+        else if (glext::base_instance)
+        {
+            for (const DrawRange& range : drawRanges)
+            {
+                glext::DrawElementsInstancedBaseInstance(GL_TRIANGLES, indexCount, index_type, nullptr, GLsizei(range.count), range.first);
+            }
+        }
+        else
+        {
+            // OpenGL 3.3 has no base instance: the attributes themselves start at the run
+            for (const DrawRange& range : drawRanges)
+            {
+                setInstanceAttributes(instanceVBO, range.first);
+                glDrawElementsInstanced(GL_TRIANGLES, indexCount, index_type, nullptr, GLsizei(range.count));
+            }
+
+            setInstanceAttributes(instanceVBO, 0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
 
         glBindVertexArray(0);
 
@@ -352,6 +805,32 @@ namespace space
         }
     }
 
+    void GrassMesh::renderVisible(GLuint visibleBuffer, GLsizei visibleCount, GLuint commandBuffer)
+    {
+        if (vao_id == 0 || instances.empty()) return;
+
+        glBindVertexArray(vao_id);
+
+        // The VAO reads the packed instances for this draw only
+        setInstanceAttributes(visibleBuffer, 0);
+
+        if (commandBuffer)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glext::DrawElementsIndirect(GL_TRIANGLES, index_type, nullptr);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        else if (visibleCount > 0)
+        {
+            glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), index_type, nullptr, visibleCount);
+        }
+
+        setInstanceAttributes(instanceVBO, 0);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
     void GrassMesh::printStatistics() const
     {
         if (instances.empty())
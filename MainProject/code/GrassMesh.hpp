@@ -5,10 +5,13 @@
 
 #pragma once
 
+#include "CounterRandom.hpp"
+#include "GLExtensions.hpp"
 #include "Mesh.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <cstdint>
 #include <memory>
 #include <random>
 #include <functional>
@@ -18,6 +21,13 @@ namespace space
     // Forward declaration from HeightMapTerrain
     struct GrassHeightInfo;
 
+    class Frustum;
+    class GrassPlacementMap;
+    class ThreadPool;
+
+    // Height information of count world positions at once; called from several threads
+    using GrassHeightBatchSampler = std::function<void(const float* worldX, const float* worldZ, size_t count, GrassHeightInfo* out)>;
+
     struct GrassInstance
     {
         glm::vec3 position;
@@ -26,17 +36,57 @@ namespace space
         float rotation;
     };
 
+    /**
+    * Instanced grass blades. setupInstanceBuffer() sorts the instances into a uniform grid of
+    * cells on the XZ plane, so each cell is a contiguous range of the instance buffer. cull()
+    * keeps the cells in view and within the draw distance, merging neighbouring ones into
+    * runs, and render() draws those runs: in one glMultiDrawElementsIndirect with OpenGL 4.3,
+    * one glDrawElementsInstancedBaseInstance per run with 4.2, and by moving the instance
+    * attribute pointers to each run on 3.3.
+    */
     class GrassMesh : public Mesh
     {
+    public:
+
+        // A non-empty cell: its instances and the box their blades fill
+        struct Cell
+        {
+            BoundingBox bounds;
+            GLuint firstInstance;
+            GLuint instanceCount;
+        };
+
+        // Instances [first, first + count) of the buffer, one draw
+        struct DrawRange
+        {
+            GLuint first;
+            GLuint count;
+        };
+
     private:
         std::unique_ptr<Assimp::Importer> importer;
         std::vector<GrassInstance> instances;
         GLuint instanceVBO;
+        GLuint indirectBuffer = 0;
+
+        // Non-empty cells in row order, and the runs of them the last cull() kept
+        float cellSize = 1.0f;
+        float drawDistance = 60.0f;
+        std::vector<Cell> cells;
+        std::vector<DrawRange> drawRanges;
+        std::vector<glext::DrawElementsIndirectCommand> drawCommands;
+        bool culled = false;
+        size_t visibleCells = 0;
+        size_t visibleInstances = 0;
 
         // Grass parameters
         float minHeight = 0.15f;
         float maxHeight = 0.7f;
         float density = 0.5f;
+        uint64_t seed = 1;
+
+        // Poisson-disk minimum distance of the shore, meadow and hill zones, relative to the spacing asked for
+        glm::vec3 zoneSpacing = glm::vec3(0.9f, 1.0f, 1.25f);
 
         // Color constants
         const glm::vec3 SHORE_GRASS_COLOR = glm::vec3(0.4f, 0.8f, 0.3f);
@@ -45,10 +95,19 @@ namespace space
 
         void processMesh(aiMesh* mesh);
         glm::vec3 aiVec3ToGlm(const aiVector3D& vec) { return glm::vec3(vec.x, vec.y, vec.z); }
-        glm::vec3 lerp(const glm::vec3& a, const glm::vec3& b, float t) { return a + t * (b - a); }
+        glm::vec3 lerp(const glm::vec3& a, const glm::vec3& b, float t) const { return a + t * (b - a); }
 
         // New method: determine grass color based on height
-        glm::vec3 getColorForHeight(float normalizedHeight);
+        glm::vec3 getColorForHeight(float normalizedHeight) const;
+
+        // Instance at a placed position, its variation drawn from counter (index, stream)
+        GrassInstance makeInstance(const CounterRandom& random, uint64_t index, float worldX, float worldZ, const GrassHeightInfo& heightInfo, uint32_t stream = 1) const;
+
+        // Stable counting sort of the instances by cell, and the cells' ranges and bounds
+        void sortIntoCells();
+
+        // Points the instance attributes of the VAO at firstInstance of buffer, in the instance buffer layout
+        void setInstanceAttributes(GLuint buffer, GLuint firstInstance);
 
     public:
         GrassMesh() : instanceVBO(0)
@@ -62,6 +121,11 @@ namespace space
             {
                 glDeleteBuffers(1, &instanceVBO);
             }
+
+            if (indirectBuffer)
+            {
+                glDeleteBuffers(1, &indirectBuffer);
+            }
         }
 
         bool loadFromFile(const std::string& filepath);
@@ -73,21 +137,138 @@ namespace space
             std::function<float(float, float)> heightSampler
         );
 
+        /**
+        * Scatters up to instanceCount instances over the terrain, rejecting the positions
+        * outside the height range, with at most 10 attempts per instance.
+        *
+        * Attempts are evaluated in chunks over pool (ThreadPool::shared() by default), each one
+        * drawing its numbers from a counter-based generator keyed by the seed and its attempt
+        * index. The instances kept are those of the first eligible attempts in index order, so
+        * a seed gives the same instances on any number of threads.
+        */
+        void generateInstancesForTerrain(
+            int instanceCount,
+            float worldWidth,
+            float worldHeight,
+            const glm::vec3& terrainWorldPos,
+            const GrassHeightBatchSampler& heightSampler,
+            ThreadPool* pool = nullptr
+        );
+
+        /**
+        * Places exactly instanceCount instances, unless placement is empty, drawing only
+        * eligible positions from placement (built over the same terrain and height range):
+        * one draw per instance, plus a few retries where the interpolated height inside a
+        * partly eligible quad is out of range, then a point of its eligible part. Instance i
+        * only depends on the seed and i, so any thread count gives the same instances.
+        */
+        void generateInstancesForTerrain(
+            int instanceCount,
+            float worldWidth,
+            float worldHeight,
+            const glm::vec3& terrainWorldPos,
+            const GrassPlacementMap& placement,
+            const GrassHeightBatchSampler& heightSampler,
+            ThreadPool* pool = nullptr
+        );
+
+        /**
+        * Same, keeping the instances already generated and drawing the missing ones up to
+        * instanceCount: tops up a rejection scatter that came up short. Placed instances draw
+        * their variation from other counters than the rejection attempts, so the two never
+        * repeat each other.
+        */
+        void fillInstancesForTerrain(
+            int instanceCount,
+            float worldWidth,
+            float worldHeight,
+            const glm::vec3& terrainWorldPos,
+            const GrassPlacementMap& placement,
+            const GrassHeightBatchSampler& heightSampler,
+            ThreadPool* pool = nullptr
+        );
+
+        // Same, sampling the heights one position at a time
         void generateInstancesForTerrain(
             int instanceCount,
             float worldWidth,
             float worldHeight,
             const glm::vec3& terrainWorldPos,
-            std::function<GrassHeightInfo(float, float)> heightSampler
+            std::function<GrassHeightInfo(float, float)> heightSampler,
+            ThreadPool* pool = nullptr
+        );
+
+        /**
+        * Blue-noise instances: no two closer than spacing times the zone factor of the higher
+        * spaced one (see setZoneSpacing), over the terrain within the height range, through a
+        * PoissonDiskSampler run in tiles over pool. A uniform scatter leaves clumps and gaps,
+        * so the even spacing covers the ground as well with fewer instances. The count follows
+        * from the spacing and the eligible area; a seed gives the same instances on any number
+        * of threads.
+        */
+        void generatePoissonInstancesForTerrain(
+            float spacing,
+            float worldWidth,
+            float worldHeight,
+            const glm::vec3& terrainWorldPos,
+            const GrassHeightBatchSampler& heightSampler,
+            ThreadPool* pool = nullptr
         );
 
         void initialize() override {}
+
+        // Draws the runs of cells the last cull() kept, every instance before the first one
         void render() override;
+
+        // Sorts the instances into cells and uploads them, when the blade model is on the GPU
         void setupInstanceBuffer();
 
+        /**
+        * Draws the instances a GrassCuller packed into visibleBuffer, in the layout of the
+        * instance buffer: as many as the DrawElementsIndirect command in commandBuffer says
+        * when it is not 0, else visibleCount of them.
+        */
+        void renderVisible(GLuint visibleBuffer, GLsizei visibleCount, GLuint commandBuffer);
+
+        /**
+        * Keeps the cells whose bounds reach into frustum and come within the draw distance of
+        * cameraPosition, both in world space like the instances, for the next render().
+        */
+        void cull(const Frustum& frustum, const glm::vec3& cameraPosition);
+
+        // Cell side in world units; takes effect on the next setupInstanceBuffer()
+        void setCellSize(float size) { cellSize = size; }
+        float getCellSize() const { return cellSize; }
+
+        // Cells entirely farther than this from the camera are culled
+        void setDrawDistance(float distance) { drawDistance = distance; }
+        float getDrawDistance() const { return drawDistance; }
+
+        const std::vector<Cell>& getCells() const { return cells; }
+        const std::vector<DrawRange>& getDrawRanges() const { return drawRanges; }
+        size_t getVisibleCellCount() const { return visibleCells; }
+        size_t getVisibleInstanceCount() const { return visibleInstances; }
+
         void setHeightRange(float min, float max) { minHeight = min; maxHeight = max; }
+        float getMinHeight() const { return minHeight; }
+        float getMaxHeight() const { return maxHeight; }
         void setDensity(float d) { density = glm::clamp(d, 0.0f, 1.0f); }
+        void setSeed(uint64_t s) { seed = s; }
+        uint64_t getSeed() const { return seed; }
+        void setZoneSpacing(float shore, float meadow, float hill) { zoneSpacing = glm::vec3(shore, meadow, hill); }
+        const glm::vec3& getZoneSpacing() const { return zoneSpacing; }
+
+        // Poisson-disk spacing factor at a height, blended across the zones as the colors are
+        float getSpacingForHeight(float normalizedHeight) const;
+
+        // XZ radius a blade sweeps as it rotates, and its bottom and top, at an instance scale of 1
+        glm::vec3 getBladeExtent() const;
+
+        // 8 floats per instance: position, color, scale and rotation; 0 until uploaded
+        GLuint getInstanceBuffer() const { return instanceVBO; }
+
         size_t getInstanceCount() const { return instances.size(); }
+        const std::vector<GrassInstance>& getInstances() const { return instances; }
 
         void printStatistics() const;
     };
@@ -0,0 +1,263 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "GrassPlacementMap.hpp"
+#include "CpuProfiler.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace space
+{
+    namespace
+    {
+        // Points whose counters are computed ahead of their searches
+        constexpr size_t DRAW_RUN = 64;
+
+        // Rows of quads listed per task
+        constexpr size_t ROWS_PER_TASK = 16;
+
+        // Smallest s in (0, 1] where offset + slope * s + curve * s^2 is zero, 1 when there is none
+        float firstCrossing(double offset, double slope, double curve)
+        {
+            double first = 1.0;
+
+            auto consider = [&](double s)
+            {
+                if (s > 0.0 && s < first) first = s;
+            };
+
+            if (curve == 0.0)
+            {
+                if (slope != 0.0) consider(-offset / slope);
+                return float(first);
+            }
+
+            const double discriminant = slope * slope - 4.0 * curve * offset;
+            if (discriminant < 0.0) return float(first);
+
+            // Both roots without the cancellation of the textbook formula
+            const double q = -0.5 * (slope + std::copysign(std::sqrt(discriminant), slope));
+
+            consider(q / curve);
+            if (q != 0.0) consider(offset / q);
+
+            return float(first);
+        }
+    }
+
+    void GrassPlacementMap::build(const float* heightData, int heightStride, int heightWidth, int heightHeight, float minimum, float maximum, ThreadPool& pool)
+    {
+        SPACE_PROFILE_ZONE("GrassPlacementMap::build");
+
+        rowStarts.clear();
+        rowRuns.clear();
+        rowGuide.clear();
+        runs.clear();
+        eligibleCorners = 0;
+
+        if (!heightData || heightWidth < 2 || heightHeight < 2) return;
+
+        heights = heightData;
+        stride = heightStride;
+        width = heightWidth;
+        height = heightHeight;
+        minHeight = minimum;
+        maxHeight = maximum;
+        texelToUnit = glm::vec2(1.0f / float(width - 1), 1.0f / float(height - 1));
+
+        const size_t quadsX = size_t(width) - 1;
+        const size_t quadsZ = size_t(height) - 1;
+
+        // Each task lists its rows into its own runs, concatenated in row order afterwards
+        const size_t taskCount = (quadsZ + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+        std::vector<std::vector<Run>> taskRuns(taskCount);
+        std::vector<uint64_t> rowCorners(quadsZ, 0);
+
+        rowStarts.assign(quadsZ + 1, 0);
+        rowRuns.assign(quadsZ + 1, 0);
+
+        pool.parallelFor(0, taskCount, 1, [&](size_t firstTask, size_t lastTask)
+            {
+                std::vector<uint8_t> top(width), bottom(width), listed(quadsX);
+
+                for (size_t task = firstTask; task < lastTask; ++task)
+                {
+                    const size_t firstRow = task * ROWS_PER_TASK;
+                    const size_t lastRow = std::min(firstRow + ROWS_PER_TASK, quadsZ);
+                    std::vector<Run>& out = taskRuns[task];
+
+                    for (int x = 0; x < width; ++x) bottom[x] = uint8_t(isEligible(x, int(firstRow)));
+
+                    for (size_t z = firstRow; z < lastRow; ++z)
+                    {
+                        top.swap(bottom);
+
+                        for (int x = 0; x < width; ++x) bottom[x] = uint8_t(isEligible(x, int(z) + 1));
+
+                        uint32_t quadCount = 0;
+                        uint64_t cornerCount = 0;
+
+                        // A plain loop over bytes, so that it vectorizes
+                        for (size_t x = 0; x < quadsX; ++x)
+                        {
+                            const uint8_t corners = uint8_t(top[x] + top[x + 1] + bottom[x] + bottom[x + 1]);
+
+                            listed[x] = uint8_t(corners != 0);
+                            quadCount += listed[x];
+                            cornerCount += corners;
+                        }
+
+                        // A run starts at every listed quad after one that is not
+                        const size_t firstRun = out.size();
+                        uint32_t before = 0;
+                        uint8_t previous = 0;
+
+                        for (size_t x = 0; x < quadsX; ++x)
+                        {
+                            if (listed[x] > previous) out.push_back({ uint32_t(x), before });
+
+                            before += listed[x];
+                            previous = listed[x];
+                        }
+
+                        rowStarts[z + 1] = quadCount;
+                        rowRuns[z + 1] = out.size() - firstRun;
+                        rowCorners[z] = cornerCount;
+                    }
+                }
+            });
+
+        for (size_t z = 0; z < quadsZ; ++z)
+        {
+            rowStarts[z + 1] += rowStarts[z];
+            rowRuns[z + 1] += rowRuns[z];
+            eligibleCorners += rowCorners[z];
+        }
+
+        runs.reserve(size_t(rowRuns.back()));
+
+        for (const std::vector<Run>& listedRuns : taskRuns)
+        {
+            runs.insert(runs.end(), listedRuns.begin(), listedRuns.end());
+        }
+
+        const uint64_t quadCount = rowStarts.back();
+        if (quadCount == 0) return;
+
+        rowGuide.resize(quadsZ);
+
+        for (size_t entry = 0, row = 0; entry < rowGuide.size(); ++entry)
+        {
+            const uint64_t first = entry * quadCount / rowGuide.size();
+
+            while (rowStarts[row + 1] <= first) ++row;
+
+            rowGuide[entry] = uint32_t(row);
+        }
+    }
+
+    GrassPlacementMap::Placement GrassPlacementMap::draw(const CounterRandom& random, uint64_t index, uint32_t attempt) const
+    {
+        return resolve(random.generate(uint32_t(index), uint32_t(index >> 32), 2, attempt));
+    }
+
+    void GrassPlacementMap::draw(const CounterRandom& random, const uint64_t* indices, size_t count, uint32_t attempt, Placement* out) const
+    {
+        CounterRandom::Block bits[DRAW_RUN];
+
+        for (size_t first = 0; first < count; first += DRAW_RUN)
+        {
+            const size_t run = std::min(DRAW_RUN, count - first);
+
+            for (size_t i = 0; i < run; ++i)
+            {
+                bits[i] = random.generate(uint32_t(indices[first + i]), uint32_t(indices[first + i] >> 32), 2, attempt);
+            }
+
+            for (size_t i = 0; i < run; ++i)
+            {
+                out[first + i] = resolve(bits[i]);
+            }
+        }
+    }
+
+    GrassPlacementMap::Placement GrassPlacementMap::resolve(const CounterRandom::Block& bits) const
+    {
+        const uint64_t quad = CounterRandom::toIndex(bits[0], bits[1], rowStarts.back());
+
+        // The same bits over the guide give an entry whose first quad is not past quad, so its
+        // row is at or before the row of quad
+        size_t row = rowGuide[size_t(CounterRandom::toIndex(bits[0], bits[1], rowGuide.size()))];
+
+        while (rowStarts[row + 1] <= quad) ++row;
+
+        // Its run is the last of the row with at most as many listed quads before it
+        const uint32_t rank = uint32_t(quad - rowStarts[row]);
+
+        const Run* rowFirst = runs.data() + rowRuns[row];
+        const Run* rowLast = runs.data() + rowRuns[row + 1];
+        const Run* run = std::upper_bound(rowFirst, rowLast, rank, [](uint32_t value, const Run& other) { return value < other.before; }) - 1;
+
+        const int quadX = int(run->x + (rank - run->before));
+        const int quadZ = int(row);
+
+        const float x = float(quadX) + CounterRandom::toUnit(bits[2]);
+        const float z = float(quadZ) + CounterRandom::toUnit(bits[3]);
+
+        return { glm::vec2(x, z) * texelToUnit, quadX, quadZ };
+    }
+
+    glm::vec2 GrassPlacementMap::getEligiblePoint(const Placement& placement) const
+    {
+        const glm::vec2 origin(float(placement.quadX), float(placement.quadZ));
+        const glm::vec2 local = glm::clamp(placement.position / texelToUnit - origin, 0.0f, 1.0f);
+
+        glm::vec2 corner(0.0f);
+        float nearest = std::numeric_limits<float>::max();
+
+        for (int cornerZ = 0; cornerZ <= 1; ++cornerZ)
+        {
+            for (int cornerX = 0; cornerX <= 1; ++cornerX)
+            {
+                const glm::vec2 candidate = glm::vec2(float(cornerX), float(cornerZ));
+                const glm::vec2 offset = local - candidate;
+                const float distance = glm::dot(offset, offset);
+
+                if (isEligible(placement.quadX + cornerX, placement.quadZ + cornerZ) && distance < nearest)
+                {
+                    nearest = distance;
+                    corner = candidate;
+                }
+            }
+        }
+
+        const double h00 = getHeight(placement.quadX, placement.quadZ);
+        const double h10 = getHeight(placement.quadX + 1, placement.quadZ);
+        const double h01 = getHeight(placement.quadX, placement.quadZ + 1);
+        const double h11 = getHeight(placement.quadX + 1, placement.quadZ + 1);
+
+        // The bilinear height along corner + s * direction is start + slope * s + curve * s^2
+        const glm::vec2 direction = local - corner;
+        const double twist = h00 - h10 - h01 + h11;
+        const double start = h00 + (h10 - h00) * corner.x + (h01 - h00) * corner.y + twist * corner.x * corner.y;
+        const double slope = (h10 - h00) * direction.x + (h01 - h00) * direction.y + twist * (corner.x * direction.y + corner.y * direction.x);
+        const double curve = twist * direction.x * direction.y;
+
+        // Where the segment leaves the range; a corner on a bound it heads out of already does
+        float exit = std::min(firstCrossing(start - minHeight, slope, curve), firstCrossing(start - maxHeight, slope, curve));
+
+        if ((start <= minHeight && slope < 0.0) || (start >= maxHeight && slope > 0.0)) exit = 0.0f;
+
+        return (origin + corner + direction * (0.5f * exit)) * texelToUnit;
+    }
+
+    size_t GrassPlacementMap::getByteSize() const
+    {
+        return (rowStarts.size() + rowRuns.size()) * sizeof(uint64_t) + rowGuide.size() * sizeof(uint32_t) + runs.size() * sizeof(Run);
+    }
+}
@@ -0,0 +1,128 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "CounterRandom.hpp"
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace space
+{
+    class ThreadPool;
+
+    /**
+    * Where grass may grow on a heightfield, preprocessed so that placement draws eligible
+    * positions directly instead of rejecting the rest.
+    *
+    * A texel is eligible when its height is within the grass range, and a quad is listed
+    * when it has an eligible corner. The listed quads are kept as the runs of consecutive
+    * ones in each row, with the count of listed quads before every row and before every run
+    * within its row: memory grows with the rows and the boundary of the eligible ground,
+    * not with its area. A draw picks the k-th listed quad uniformly and a uniform point in
+    * it, without height reads. Its row is found from a guide table with one entry per row,
+    * the first row of each equal share of the listed quads, so a draw scans one or two rows
+    * on average; its run by a binary search over the few runs of the row.
+    * Quads weigh their area, the same whether all their corners are eligible or not.
+    * A point in a quad the range boundary crosses may still interpolate out of the range,
+    * and the caller draws again; retrying within the listed quads is exact rejection sampling
+    * over them, so the points kept are uniform over the eligible ground. Every draw comes
+    * from a single block of counters of a CounterRandom, so it depends only on its index.
+    *
+    * Positions are normalized: (u, v) in [0, 1], texel (x, z) at (x / (width - 1), z / (height - 1)).
+    * The heights are read in place by getEligiblePoint(), so the heightfield must outlive
+    * the map.
+    */
+    class GrassPlacementMap
+    {
+    public:
+
+        struct Placement
+        {
+            glm::vec2 position;
+            int quadX;              // Quad drawn, the one position is in
+            int quadZ;
+        };
+
+        /**
+        * heights has width x height texels, texel (x, z) at heights[(z * width + x) * stride];
+        * the eligible ones are within [minHeight, maxHeight]. Rows of quads are listed over pool.
+        */
+        void build(const float* heights, int stride, int width, int height, float minHeight, float maxHeight, ThreadPool& pool);
+
+        // True when no texel is eligible (or nothing was built): there is nothing to draw
+        bool isEmpty() const { return getQuadCount() == 0; }
+
+        // Eligible corners over all quads, divided by 4: roughly the eligible area in quads
+        double getEligibleQuads() const { return double(eligibleCorners) * 0.25; }
+
+        // Quads with an eligible corner, the ones draws land in
+        uint64_t getQuadCount() const { return rowStarts.empty() ? 0 : rowStarts.back(); }
+
+        /**
+        * Draws point index from counter (index, 2, attempt). Retrying with a higher attempt
+        * gives an independent point, for when the interpolated height at the first one falls
+        * outside the range.
+        */
+        Placement draw(const CounterRandom& random, uint64_t index, uint32_t attempt) const;
+
+        /**
+        * Same as draw() for count indices. The counters of a run of points are computed
+        * before any search, so the reads overlap instead of each waiting for the last.
+        */
+        void draw(const CounterRandom& random, const uint64_t* indices, size_t count, uint32_t attempt, Placement* out) const;
+
+        /**
+        * A point of the quad of placement where the interpolated height is within the range,
+        * for when draws keep landing outside it: from the eligible corner nearest to the
+        * position, halfway to where the segment to the position leaves the range.
+        */
+        glm::vec2 getEligiblePoint(const Placement& placement) const;
+
+        size_t getByteSize() const;
+
+    private:
+
+        // Listed quads [x, x + length) of a row, length up to the next run's before
+        struct Run
+        {
+            uint32_t x;
+            uint32_t before;        // Listed quads of the row left of x
+        };
+
+        const float* heights = nullptr;
+        int stride = 1;
+        int width = 0;
+        int height = 0;
+        float minHeight = 0.0f;
+        float maxHeight = 0.0f;
+        glm::vec2 texelToUnit = glm::vec2(0.0f);
+
+        uint64_t eligibleCorners = 0;
+
+        // Per row of quads and one more: listed quads before the row, and its first run
+        std::vector<uint64_t> rowStarts;
+        std::vector<uint64_t> rowRuns;
+
+        // Row of listed quad floor(g * count / guide size) for entry g
+        std::vector<uint32_t> rowGuide;
+
+        // Runs of every row, in row order
+        std::vector<Run> runs;
+
+        Placement resolve(const CounterRandom::Block& bits) const;
+
+        float getHeight(int x, int z) const { return heights[(size_t(z) * width + x) * stride]; }
+
+        bool isEligible(int x, int z) const
+        {
+            const float value = getHeight(x, z);
+            return value >= minHeight && value <= maxHeight;
+        }
+    };
+}
@@ -4,155 +4,908 @@
 */
 
 #include "HeightMapTerrain.hpp"
+#include "HeightfieldSampler.hpp"
+#include "HeightmapImage.hpp"
+#include "CpuProfiler.hpp"
+#include "TerrainKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 
 namespace space
 {
+    // The row kernels see the vec3 arrays as packed xyz floats
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be tightly packed");
+
+    namespace
+    {
+        // Instance attributes of terrain_vertex_shader.glsl
+        struct PatchInstance
+        {
+            glm::vec3 placement;    // First texel x and z, texel step
+            glm::vec2 morph;        // Distances where the morph starts and ends, equal for none
+        };
+
+        // Everything besides the heightmap, the scale and the modes that shapes the baked
+        // buffers; part of the cache key, so changing a constant invalidates old files
+        struct GenerationParameters
+        {
+            float extent;
+            float heightRange;
+            float weights[3];
+            float rampStarts[terrain_kernels::RAMP_SEGMENTS];
+            float rampLengths[terrain_kernels::RAMP_SEGMENTS];
+            float rampColors[terrain_kernels::RAMP_SEGMENTS + 1][3];
+            int32_t patchQuads;
+            uint32_t patchStride;
+            uint32_t meshStride;
+        };
+
+        uint64_t getGenerationHash(uint32_t patchStride, uint32_t meshStride)
+        {
+            using namespace terrain_kernels;
+
+            GenerationParameters parameters{};
+            parameters.extent = EXTENT;
+            parameters.heightRange = HEIGHT_RANGE;
+            parameters.weights[0] = RED_WEIGHT;
+            parameters.weights[1] = GREEN_WEIGHT;
+            parameters.weights[2] = BLUE_WEIGHT;
+            std::memcpy(parameters.rampStarts, RAMP_STARTS, sizeof(RAMP_STARTS));
+            std::memcpy(parameters.rampLengths, RAMP_LENGTHS, sizeof(RAMP_LENGTHS));
+            std::memcpy(parameters.rampColors, RAMP_COLORS, sizeof(RAMP_COLORS));
+            parameters.patchQuads = HeightMapTerrain::PATCH_QUADS;
+            parameters.patchStride = patchStride;
+            parameters.meshStride = meshStride;
+
+            return TerrainMeshCache::hash(&parameters, sizeof(parameters));
+        }
+    }
+
+    void HeightMapTerrain::setUp(bool uploadToGpu)
+    {
+        TerrainMeshCache::Key key{};
+
+        const bool cached = TerrainMeshCache::isEnabled() && makeCacheKey(key);
+
+        ThreadPool& pool = buildPool ? *buildPool : ThreadPool::shared();
+
+        if (cached && loadCache(key, uploadToGpu))
+        {
+            heightPyramid.build(getHeightData(), getHeightStride(), width, height, pool);
+            return;
+        }
+
+        initialize();
+
+        if (width == 0) return;
+
+        heightPyramid.build(getHeightData(), getHeightStride(), width, height, pool);
+
+        if (!uploadToGpu && !cached) return;
+
+        Buffers buffers = renderMode != RenderMode::MESH ? packBuffers< PatchLayout >() : packBuffers< MeshLayout >();
+
+        if (uploadToGpu)
+        {
+            bounds = buffers.bounds;
+            vertex_decode = buffers.vertex_decode;
+
+            if (renderMode != RenderMode::MESH)
+            {
+                uploadBuffers< PatchLayout >(buffers.vertex_data.data(), buffers.vertex_data.size(), buffers.index_data.data(), buffers.index_data.size(), buffers.index_type);
+                uploadHeightTexture();
+            }
+            else
+            {
+                uploadBuffers< MeshLayout >(buffers.vertex_data.data(), buffers.vertex_data.size(), buffers.index_data.data(), buffers.index_data.size(), buffers.index_type);
+            }
+        }
+
+        if (cached)
+        {
+            saveCache(key, buffers);
+        }
+    }
+
+    bool HeightMapTerrain::makeCacheKey(TerrainMeshCache::Key& key) const
+    {
+        const uint64_t generation = getGenerationHash(uint32_t(PatchLayout::STRIDE), uint32_t(MeshLayout::STRIDE));
+
+        if (!procedural)
+        {
+            return TerrainMeshCache::makeKey(heightMapPath, heightScale, uint32_t(renderMode), uint32_t(indexMode), generation, key);
+        }
+
+        // A procedural heightfield is fully described by its noise and its window
+        const float window[3] = { noiseOrigin.x, noiseOrigin.y, terrainWorldScale };
+
+        key = TerrainMeshCache::Key{};
+        key.contentHash = TerrainMeshCache::hash(window, sizeof(window), noise.hash());
+        key.contentSize = uint64_t(noiseSize) * noiseSize;
+        key.generation = generation;
+        key.heightScale = heightScale;
+        key.renderMode = uint32_t(renderMode);
+        key.indexMode = uint32_t(indexMode);
+
+        return true;
+    }
+
+    bool HeightMapTerrain::loadCache(const TerrainMeshCache::Key& key, bool uploadToGpu)
+    {
+        SPACE_PROFILE_ZONE("HeightMapTerrain cache load");
+
+        TerrainMeshCache cache;
+
+        if (!cache.open(key)) return false;
+
+        const TerrainMeshCache::Contents& contents = cache.getContents();
+        const uint32_t stride = uint32_t(renderMode != RenderMode::MESH ? PatchLayout::STRIDE : MeshLayout::STRIDE);
+
+        if (contents.heightCount != size_t(contents.width) * contents.height || contents.vertexStride != stride || contents.ranges.empty())
+        {
+            std::cerr << "Ignoring the mismatching terrain mesh cache " << TerrainMeshCache::getPath(key) << std::endl;
+            return false;
+        }
+
+        width = contents.width;
+        height = contents.height;
+        heights.assign(contents.heights, contents.heights + contents.heightCount);
+        heightfieldBounds = contents.heightfieldBounds;
+        primitive_type = contents.primitiveType;
+        index_ranges = contents.ranges;
+
+        // Vertex, normal, colour and index arrays stay empty: the GPU gets them from the file
+        vertices.clear();
+        normals.clear();
+        colors.clear();
+        indices.clear();
+
+        if (renderMode != RenderMode::MESH)
+        {
+            buildPatches();
+        }
+
+        if (uploadToGpu)
+        {
+            bounds = contents.bounds;
+            vertex_decode = contents.vertexDecode;
+
+            // Straight from the mapping, the pages are read as the driver copies them
+            if (renderMode != RenderMode::MESH)
+            {
+                uploadBuffers< PatchLayout >(contents.vertexData, contents.vertexBytes, contents.indexData, contents.indexBytes, contents.indexType);
+                uploadHeightTexture();
+            }
+            else
+            {
+                uploadBuffers< MeshLayout >(contents.vertexData, contents.vertexBytes, contents.indexData, contents.indexBytes, contents.indexType);
+            }
+        }
+
+        return true;
+    }
+
+    void HeightMapTerrain::saveCache(const TerrainMeshCache::Key& key, const Buffers& buffers) const
+    {
+        SPACE_PROFILE_ZONE("HeightMapTerrain cache save");
+
+        TerrainMeshCache::Contents contents;
+        contents.width = width;
+        contents.height = height;
+        contents.primitiveType = primitive_type;
+        contents.indexType = buffers.index_type;
+        contents.vertexStride = uint32_t(renderMode != RenderMode::MESH ? PatchLayout::STRIDE : MeshLayout::STRIDE);
+        contents.vertexDecode = buffers.vertex_decode;
+        contents.bounds = buffers.bounds;
+        contents.heightfieldBounds = heightfieldBounds;
+        contents.vertexData = buffers.vertex_data.data();
+        contents.vertexBytes = buffers.vertex_data.size();
+        contents.indexData = buffers.index_data.data();
+        contents.indexBytes = buffers.index_data.size();
+
+        // A loaded mesh has no indices array to count, so every draw goes through a range
+        contents.ranges = index_ranges;
+
+        if (contents.ranges.empty())
+        {
+            contents.ranges.push_back({ 0, GLsizei(indices.size()), 0 });
+        }
+
+        // Full meshes keep their heights in the vertices, the cache stores them apart
+        std::vector<float> meshHeights;
+
+        if (renderMode == RenderMode::MESH)
+        {
+            meshHeights.resize(vertices.size());
+
+            for (size_t i = 0; i < vertices.size(); ++i)
+            {
+                meshHeights[i] = vertices[i].y;
+            }
+        }
+
+        const std::vector<float>& cachedHeights = renderMode == RenderMode::MESH ? meshHeights : heights;
+        contents.heights = cachedHeights.data();
+        contents.heightCount = cachedHeights.size();
+
+        TerrainMeshCache::write(key, contents);
+    }
+
     void HeightMapTerrain::initialize()
     {
-        //Load height map image
-        int channels;
-        unsigned char* image = SOIL_load_image(
-            heightMapPath.c_str(),
-            &width, &height,
-            &channels,
-            SOIL_LOAD_RGB
-        );
+        SPACE_PROFILE_ZONE("HeightMapTerrain::initialize");
+
+        ThreadPool& pool = buildPool ? *buildPool : ThreadPool::shared();
 
-        if (!image)
+        //Load height map image, decoded in its own format or mapped if it is raw, or generate it
+        HeightmapImage image;
+
+        if (procedural && noiseSize >= 2)
+        {
+            image.generate(noise, noiseOrigin.x, noiseOrigin.y, terrainWorldScale / (noiseSize - 1), noiseSize, noiseSize, pool);
+        }
+        else if (!procedural)
         {
-            std::cerr << "Failed to load height map: " << heightMapPath << std::endl;
+            SPACE_PROFILE_ZONE("Heightmap decode");
+            image.load(heightMapPath);
         }
 
-        // Pre-allocate memory for vectors
-        size_t totalVertices = width * height;
-        vertices.reserve(totalVertices);
-        colors.reserve(totalVertices);
-        normals.reserve(totalVertices);
+        if (!image.isLoaded())
+        {
+            std::cerr << "Failed to load height map: " << (procedural ? "procedural noise of " + std::to_string(noiseSize) + " texels" : heightMapPath) << std::endl;
+            width = height = 0;
+            return;
+        }
 
-        // Define base colors for different heights
-        const glm::vec3 WATER_COLOR(0.0f, 0.3f, 1.0f);    // Deep blue for lowest areas
-        const glm::vec3 SHORE_COLOR(0.0f, 0.8f, 0.8f);    // Teal/light blue for shallow water
-        const glm::vec3 GRASS_COLOR(0.0f, 0.7f, 0.0f);    // Green for mid elevations
-        const glm::vec3 MOUNTAIN_COLOR(0.5f, 0.5f, 0.5f); // Gray for higher elevations
-        const glm::vec3 SNOW_COLOR(0.9f, 0.9f, 0.9f);     // White for peaks
+        width = image.getWidth();
+        height = image.getHeight();
 
-        // Linear interpolation helper function (can be added as a utility or inline)
-        auto lerp = [](const glm::vec3& a, const glm::vec3& b, float t) -> glm::vec3 {
-            return a + t * (b - a);
-            };
+        // Rows per task, around 64k vertices so the scheduling cost stays negligible
+        const size_t rowsPerBand = std::max<size_t>(1, ROW_BAND_VERTICES / width);
+
+        if (renderMode != RenderMode::MESH)
+        {
+            initializeDisplacement(image, pool, rowsPerBand);
+            return;
+        }
 
-        //Generate vertices
-        for (int z = 0; z < height; z++)
+        // Every array is sized up front and each row band writes only its own rows, so the
+        // passes can run in parallel and still produce exactly the serial result
+        const size_t totalVertices = size_t(width) * height;
+
+        vertices.assign(totalVertices, glm::vec3(0.0f));
+        colors.assign(totalVertices, glm::vec3(0.0f));
+        normals.assign(totalVertices, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        float* vertexData = &vertices[0].x;
+        float* colorData = &colors[0].x;
+        const size_t rowStride = size_t(width) * 3;           // xyz floats per row
+
+        //Generate vertices and their height colour ramp
         {
-            for (int x = 0; x < width; x++)
+            SPACE_PROFILE_ZONE("Terrain vertices");
+
+            pool.parallelFor(0, height, rowsPerBand, [&](size_t firstRow, size_t lastRow)
+                {
+                    // Colour images go through the SIMD kernels, the rest through their heights
+                    if (image.getFormat() == terrain_kernels::SampleFormat::RGB8)
+                    {
+                        for (size_t z = firstRow; z < lastRow; ++z)
+                        {
+                            terrain_kernels::buildVertexRow(static_cast<const unsigned char*>(image.getRow(int(z))), width, height, int(z), heightScale,
+                                vertexData + z * rowStride, colorData + z * rowStride);
+                        }
+
+                        return;
+                    }
+
+                    std::vector<float> rowHeights(width);
+
+                    for (size_t z = firstRow; z < lastRow; ++z)
+                    {
+                        image.buildHeightRow(int(z), heightScale, rowHeights.data());
+                        terrain_kernels::buildVertexRowFromHeights(rowHeights.data(), width, height, int(z), heightScale,
+                            vertexData + z * rowStride, colorData + z * rowStride);
+                    }
+                });
+        }
+
+        // Second pass: Calculate normals. Reads the neighbouring rows, so it starts once
+        // every vertex exists
+        buildNormals(pool, rowsPerBand);
+
+        buildGridIndices(width, height, pool, rowsPerBand);
+    }
+
+    void HeightMapTerrain::buildNormals(ThreadPool& pool, size_t rowsPerBand)
+    {
+        SPACE_PROFILE_ZONE("Terrain normals");
+
+        const float* vertexData = &vertices[0].x;
+        float* normalData = &normals[0].x;
+        const size_t rowStride = size_t(width) * 3;
+
+        // Border vertices keep the default up normal
+        pool.parallelFor(1, std::max(height - 1, 1), rowsPerBand, [&](size_t firstRow, size_t lastRow)
             {
-                //Get pixel data
-                int index = (x + z * width) * 3;
+                for (size_t z = firstRow; z < lastRow; ++z)
+                {
+                    terrain_kernels::buildNormalRow(vertexData + (z - 1) * rowStride, vertexData + z * rowStride,
+                        vertexData + (z + 1) * rowStride, width, normalData + z * rowStride);
+                }
+            });
+    }
 
-                unsigned char r = image[index];
+    void HeightMapTerrain::buildGridIndices(int columns, int rows, ThreadPool& pool, size_t rowsPerBand)
+    {
+        SPACE_PROFILE_ZONE("Terrain indices");
+
+        const size_t quadRows = size_t(std::max(rows - 1, 0));
 
-                unsigned char g = image[index + 1];
+        indices.clear();
+        index_ranges.clear();
 
-                unsigned char b = image[index + 2];
+        if (indexMode == IndexMode::TRIANGLE_LIST)
+        {
+            primitive_type = GL_TRIANGLES;
+            indices.assign(quadRows * (columns - 1) * 6, 0);  // 6 indices per quad (2 triangles)
 
+            pool.parallelFor(0, quadRows, rowsPerBand, [&](size_t firstRow, size_t lastRow)
+                {
+                    for (size_t z = firstRow; z < lastRow; ++z)
+                    {
+                        GLuint* quad = indices.data() + z * (columns - 1) * 6;
 
-                //Normalize coordinates and scale terrain
-                float xPos = ((float)x / (width - 1) - 0.5f) * 20.0f;
-                float zPos = ((float)z / (height - 1) - 0.5f) * 20.0f;
+                        for (size_t x = 0; x + 1 < size_t(columns); ++x)
+                        {
+                            GLuint topLeft = GLuint(z * columns + x);
+                            GLuint topRight = GLuint(z * columns + x + 1);
+                            GLuint bottomLeft = GLuint((z + 1) * columns + x);
+                            GLuint bottomRight = GLuint((z + 1) * columns + x + 1);
 
-                //Height based on pixel intensity
-                float yPos = rgbToHeight(r, g, b) * 5.0f;
+                            // First triangle
+                            *quad++ = topLeft;
+                            *quad++ = bottomLeft;
+                            *quad++ = topRight;
+
+                            // Second triangle
+                            *quad++ = topRight;
+                            *quad++ = bottomLeft;
+                            *quad++ = bottomRight;
+                        }
+                    }
+                });
+
+            return;
+        }
+
+        primitive_type = GL_TRIANGLE_STRIP;
+
+        if (quadRows == 0) return;
+
+        // Quad rows per chunk, so that the chunk vertices are numbered below the 16-bit restart
+        // value. Rows too wide for two of them to fit stay in a single 32-bit chunk
+        size_t chunkRows = quadRows;
+
+        if (size_t(columns) * 2 <= 0xFFFF)
+        {
+            chunkRows = std::min(quadRows, size_t(0xFFFF / columns - 1));
+        }
 
-                //Add vertex
-                vertices.push_back(glm::vec3(xPos, yPos, zPos));
+        // Each strip alternates the top and bottom vertex of every column, which gives the same
+        // triangles as the list, winding included; all rows but the last end in a restart
+        const size_t stripIndices = size_t(columns) * 2 + 1;
 
-                // Generate color based on normalized height
-                float normalizedHeight = yPos / (5.0f * heightScale); // Properly normalize to 0-1
-                glm::vec3 color;
+        indices.assign(quadRows * stripIndices - 1, 0);
 
-                if (normalizedHeight < 0.2f) {
-                    // Water: Deep blue to shore blue (0-20%)
-                    float t = normalizedHeight / 0.2f;
-                    color = lerp(WATER_COLOR, SHORE_COLOR, t);
+        pool.parallelFor(0, quadRows, rowsPerBand, [&](size_t firstRow, size_t lastRow)
+            {
+                for (size_t z = firstRow; z < lastRow; ++z)
+                {
+                    GLuint* strip = indices.data() + z * stripIndices;
+                    GLuint top = GLuint((z % chunkRows) * columns);
+
+                    for (size_t x = 0; x < size_t(columns); ++x, ++top)
+                    {
+                        *strip++ = top;
+                        *strip++ = top + GLuint(columns);
+                    }
+
+                    if (z + 1 < quadRows)
+                    {
+                        *strip = PRIMITIVE_RESTART;
+                    }
                 }
-                else if (normalizedHeight < 0.4f) {
-                    // Shore to grass (20-40%)
-                    float t = (normalizedHeight - 0.2f) / 0.2f;
-                    color = lerp(SHORE_COLOR, GRASS_COLOR, t);
+            });
+
+        // The restart closing the last row of a chunk is left out of its range
+        for (size_t firstRow = 0; firstRow < quadRows; firstRow += chunkRows)
+        {
+            size_t chunkEnd = std::min(firstRow + chunkRows, quadRows);
+
+            index_ranges.push_back({ firstRow * stripIndices, GLsizei((chunkEnd - firstRow) * stripIndices - 1), GLint(firstRow * columns) });
+        }
+    }
+
+    void HeightMapTerrain::initializeDisplacement(const HeightmapImage& image, ThreadPool& pool, size_t rowsPerBand)
+    {
+        heights.assign(size_t(width) * height, 0.0f);
+
+        {
+            SPACE_PROFILE_ZONE("Terrain heights");
+
+            pool.parallelFor(0, height, rowsPerBand, [&](size_t firstRow, size_t lastRow)
+                {
+                    for (size_t z = firstRow; z < lastRow; ++z)
+                    {
+                        image.buildHeightRow(int(z), heightScale, heights.data() + z * width);
+                    }
+                });
+        }
+
+        using namespace terrain_kernels;
+
+        auto heightRange = std::minmax_element(heights.begin(), heights.end());
+        heightfieldBounds = BoundingBox(glm::vec3(-0.5f * EXTENT, *heightRange.first, -0.5f * EXTENT),
+            glm::vec3(0.5f * EXTENT, *heightRange.second, 0.5f * EXTENT));
+
+        buildPatches();
+
+        // Shared patch: a flat grid with x and z in quads from its corner
+        vertices.clear();
+        normals.clear();
+        colors.clear();
+
+        vertices.reserve((PATCH_QUADS + 1) * (PATCH_QUADS + 1));
+
+        for (int z = 0; z <= PATCH_QUADS; ++z)
+        {
+            for (int x = 0; x <= PATCH_QUADS; ++x)
+            {
+                vertices.emplace_back(float(x), 0.0f, float(z));
+            }
+        }
+
+        // Same triangles and winding as the full mesh
+        buildGridIndices(PATCH_QUADS + 1, PATCH_QUADS + 1, pool, PATCH_QUADS);
+    }
+
+    void HeightMapTerrain::buildPatches()
+    {
+        using namespace terrain_kernels;
+
+        if (renderMode == RenderMode::CDLOD)
+        {
+            glm::vec2 spacing(EXTENT / (width - 1), EXTENT / (height - 1));
+            lodTree.build(heights.data(), width, height, glm::vec2(-0.5f * EXTENT), spacing, PATCH_QUADS);
+        }
+        else
+        {
+            // Enough full resolution patches to cover every quad; the shader clamps the ones
+            // past the last texel onto it
+            patches.clear();
+
+            for (int z = 0; z < height - 1; z += PATCH_QUADS)
+            {
+                for (int x = 0; x < width - 1; x += PATCH_QUADS)
+                {
+                    patches.push_back({ x, z, 0, 0.0f, 0.0f });
                 }
-                else if (normalizedHeight < 0.7f) {
-                    // Grass to mountain (40-70%)
-                    float t = (normalizedHeight - 0.4f) / 0.3f;
-                    color = lerp(GRASS_COLOR, MOUNTAIN_COLOR, t);
+            }
+
+            patchesChanged = true;
+        }
+    }
+
+    void HeightMapTerrain::uploadHeightTexture()
+    {
+        if (heights.empty()) return;
+
+        glGenTextures(1, &heightTexture);
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+
+        // Bilinear for the morphing vertices, which fall between texels. No mipmaps: every
+        // level samples the full resolution heights, so shared vertices agree exactly
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, heights.data());
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // Per patch instance attributes on the patch VAO: first texel and texel step, morph range
+        glGenBuffers(1, &patchInstanceVbo);
+
+        glBindVertexArray(vao_id);
+        glBindBuffer(GL_ARRAY_BUFFER, patchInstanceVbo);
+
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(PatchInstance), reinterpret_cast<const void*>(offsetof(PatchInstance, placement)));
+        glVertexAttribDivisor(3, 1);
+
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(PatchInstance), reinterpret_cast<const void*>(offsetof(PatchInstance, morph)));
+        glVertexAttribDivisor(4, 1);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR)
+        {
+            std::cerr << "OpenGL error uploading the height texture: " << error << std::endl;
+        }
+    }
+
+    void HeightMapTerrain::uploadPatches()
+    {
+        std::vector<PatchInstance> instances;
+        instances.reserve(patches.size());
+
+        for (const TerrainQuadtree::Patch& patch : patches)
+        {
+            instances.push_back({ glm::vec3(float(patch.originX), float(patch.originZ), float(1 << patch.level)), glm::vec2(patch.morphStart, patch.morphEnd) });
+        }
+
+        // Orphan and refill, the selection changes every frame in CDLOD mode
+        glBindBuffer(GL_ARRAY_BUFFER, patchInstanceVbo);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(PatchInstance), instances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        patchesChanged = false;
+    }
+
+    void HeightMapTerrain::updateLod(const glm::vec3& localCameraPosition, float viewportHeight, float verticalFov, const Frustum* localFrustum)
+    {
+        if (renderMode != RenderMode::CDLOD) return;
+
+        SPACE_PROFILE_ZONE("Terrain LOD selection");
+
+        lodTree.setScreenSpaceError(lodPixelError, viewportHeight, verticalFov);
+        lodCulledNodes = lodTree.select(localCameraPosition, localFrustum, patches);
+
+        patchesChanged = true;
+    }
+
+    void HeightMapTerrain::setDisplacementUniforms(GLuint program) const
+    {
+        using namespace terrain_kernels;
+
+        glUniform1i(glGetUniformLocation(program, "height_map"), 1);
+        glUniform2i(glGetUniformLocation(program, "height_map_size"), width, height);
+        glUniform1f(glGetUniformLocation(program, "terrain_extent"), EXTENT);
+        glUniform1f(glGetUniformLocation(program, "height_range"), HEIGHT_RANGE * heightScale);
+
+        glUniform1fv(glGetUniformLocation(program, "ramp_starts"), RAMP_SEGMENTS, RAMP_STARTS);
+        glUniform1fv(glGetUniformLocation(program, "ramp_lengths"), RAMP_SEGMENTS, RAMP_LENGTHS);
+        glUniform3fv(glGetUniformLocation(program, "ramp_colors"), RAMP_SEGMENTS + 1, &RAMP_COLORS[0][0]);
+    }
+
+    void HeightMapTerrain::render()
+    {
+        if (renderMode == RenderMode::MESH)
+        {
+            if (vao_id != 0 && (repackVertices || dirtyTexels.x <= dirtyTexels.z))
+            {
+                uploadDirtyTexels();
+            }
+
+            Mesh::render();
+            return;
+        }
+
+        if (vao_id == 0 || heightTexture == 0)
+        {
+            std::cerr << "Error: terrain VAO or height texture not initialized." << std::endl;
+            return;
+        }
+
+        if (patchesChanged)
+        {
+            uploadPatches();
+        }
+
+        // Unit 0 stays free for the skybox cubemap
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+
+        if (dirtyTexels.x <= dirtyTexels.z)
+        {
+            uploadDirtyTexels();
+        }
+
+        glBindVertexArray(vao_id);
+        drawIndexed(getPatchCount());
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR)
+        {
+            std::cerr << "OpenGL error in terrain render: " << error << std::endl;
+        }
+    }
+
+    bool HeightMapTerrain::sculpt(const TerrainBrush& brush, const glm::vec3& worldPosition, const glm::mat4& terrainTransform)
+    {
+        if (width < 2 || height < 2 || brush.radius <= 0.0f) return false;
+
+        SPACE_PROFILE_ZONE("HeightMapTerrain::sculpt");
+
+        // Brush centre and radius in texels
+        const glm::vec3 local = glm::vec3(glm::inverse(terrainTransform) * glm::vec4(worldPosition, 1.0f));
+        const glm::vec2 toTexel((width - 1) / terrainWorldScale, (height - 1) / terrainWorldScale);
+        const glm::vec2 center = (glm::vec2(local.x, local.z) + terrainWorldScale * 0.5f) * toTexel;
+        const glm::vec2 radius = brush.radius * toTexel;
+
+        const int firstX = std::max(0, int(std::ceil(center.x - radius.x)));
+        const int firstZ = std::max(0, int(std::ceil(center.y - radius.y)));
+        const int lastX = std::min(width - 1, int(std::floor(center.x + radius.x)));
+        const int lastZ = std::min(height - 1, int(std::floor(center.y + radius.y)));
+
+        if (firstX > lastX || firstZ > lastZ) return false;
+
+        // Meshes loaded from the cache only kept their heights
+        if (renderMode == RenderMode::MESH && vertices.empty())
+        {
+            restoreMeshArrays();
+        }
+
+        float* data = renderMode == RenderMode::MESH ? &vertices[0].y : heights.data();
+        const size_t stride = renderMode == RenderMode::MESH ? 3 : 1;
+
+        // Heights before the edit over the brush and one texel around it, which SMOOTH reads,
+        // so the result does not depend on the order the texels are written in
+        const int ringX0 = std::max(0, firstX - 1);
+        const int ringZ0 = std::max(0, firstZ - 1);
+        const int ringX1 = std::min(width - 1, lastX + 1);
+        const int ringZ1 = std::min(height - 1, lastZ + 1);
+        const int ringWidth = ringX1 - ringX0 + 1;
+
+        std::vector<float> before(size_t(ringWidth) * (ringZ1 - ringZ0 + 1));
+
+        for (int z = ringZ0; z <= ringZ1; ++z)
+        {
+            for (int x = ringX0; x <= ringX1; ++x)
+            {
+                before[size_t(z - ringZ0) * ringWidth + (x - ringX0)] = data[(size_t(z) * width + x) * stride];
+            }
+        }
+
+        auto original = [&](int x, int z)
+        {
+            x = glm::clamp(x, ringX0, ringX1);
+            z = glm::clamp(z, ringZ0, ringZ1);
+
+            return before[size_t(z - ringZ0) * ringWidth + (x - ringX0)];
+        };
+
+        const float maxHeight = terrain_kernels::HEIGHT_RANGE * heightScale;
+
+        for (int z = firstZ; z <= lastZ; ++z)
+        {
+            for (int x = firstX; x <= lastX; ++x)
+            {
+                const glm::vec2 offset = (glm::vec2(float(x), float(z)) - center) / radius;
+                const float distance2 = glm::dot(offset, offset);
+
+                if (distance2 >= 1.0f) continue;
+
+                // Full effect at the centre, fading smoothly to none at the rim
+                const float weight = (1.0f - distance2) * (1.0f - distance2);
+                const float blend = std::min(brush.strength * weight, 1.0f);
+
+                float value = original(x, z);
+
+                switch (brush.mode)
+                {
+                case TerrainBrush::Mode::RAISE:
+                    value += brush.strength * weight;
+                    break;
+
+                case TerrainBrush::Mode::LOWER:
+                    value -= brush.strength * weight;
+                    break;
+
+                case TerrainBrush::Mode::SMOOTH:
+                {
+                    float sum = 0.0f;
+
+                    for (int dz = -1; dz <= 1; ++dz)
+                    {
+                        for (int dx = -1; dx <= 1; ++dx)
+                        {
+                            sum += original(x + dx, z + dz);
+                        }
+                    }
+
+                    value += blend * (sum / 9.0f - value);
+                    break;
                 }
-                else {
-                    // Mountain to snow (70-100%)
-                    float t = (normalizedHeight - 0.7f) / 0.3f;
-                    color = lerp(MOUNTAIN_COLOR, SNOW_COLOR, t);
+
+                case TerrainBrush::Mode::FLATTEN:
+                    value += blend * (brush.targetHeight - value);
+                    break;
                 }
 
-                colors.push_back(color);
+                data[(size_t(z) * width + x) * stride] = glm::clamp(value, 0.0f, maxHeight);
+            }
+        }
+
+        // Everything derived from the heights, over the same texels
+        heightPyramid.update(firstX, firstZ, lastX, lastZ);
+
+        const glm::vec2 range = heightPyramid.getRange(heightPyramid.getLevelCount() - 1, 0, 0);
+
+        if (renderMode == RenderMode::MESH)
+        {
+            rebuildMeshRegion(firstX, firstZ, lastX, lastZ);
+
+            if (!bounds.isEmpty())
+            {
+                bounds.min.y = range.x;
+                bounds.max.y = range.y;
 
-                //Generate normals
-                glm::vec3 normal(0.0f, 1.0f, 0.0f);
+                // Quantized positions cannot leave the range they were packed for
+                const float decodeMin = vertex_decode.position_offset.y;
+                const float decodeMax = decodeMin + vertex_decode.position_scale.y;
 
-                normals.push_back(normal);
+                repackVertices = repackVertices || range.x < decodeMin || range.y > decodeMax;
             }
         }
+        else
+        {
+            heightfieldBounds.min.y = range.x;
+            heightfieldBounds.max.y = range.y;
+
+            if (renderMode == RenderMode::CDLOD)
+            {
+                lodTree.update(heights.data(), firstX, firstZ, lastX, lastZ);
+            }
+        }
+
+        // The normals of the texels around the brush changed too
+        const int margin = renderMode == RenderMode::MESH ? 1 : 0;
+        const glm::ivec4 changed(std::max(0, firstX - margin), std::max(0, firstZ - margin),
+            std::min(width - 1, lastX + margin), std::min(height - 1, lastZ + margin));
 
-        // Second pass: Calculate normals
-        for (int z = 0; z < height; ++z)
+        if (dirtyTexels.x > dirtyTexels.z)
         {
-            for (int x = 0; x < width; ++x)
+            dirtyTexels = changed;
+        }
+        else
+        {
+            dirtyTexels = glm::ivec4(glm::min(glm::ivec2(dirtyTexels), glm::ivec2(changed)),
+                glm::max(glm::ivec2(dirtyTexels.z, dirtyTexels.w), glm::ivec2(changed.z, changed.w)));
+        }
+
+        return true;
+    }
+
+    void HeightMapTerrain::restoreMeshArrays()
+    {
+        SPACE_PROFILE_ZONE("Terrain mesh restore");
+
+        ThreadPool& pool = buildPool ? *buildPool : ThreadPool::shared();
+        const size_t rowsPerBand = std::max<size_t>(1, ROW_BAND_VERTICES / width);
+
+        // Same passes as initialize(), from the cached heights instead of the image
+        const size_t totalVertices = size_t(width) * height;
+
+        vertices.assign(totalVertices, glm::vec3(0.0f));
+        colors.assign(totalVertices, glm::vec3(0.0f));
+        normals.assign(totalVertices, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        float* vertexData = &vertices[0].x;
+        float* colorData = &colors[0].x;
+        const size_t rowStride = size_t(width) * 3;
+
+        pool.parallelFor(0, height, rowsPerBand, [&](size_t firstRow, size_t lastRow)
             {
-                if (x > 0 && z > 0 && x < width - 1 && z < height - 1)
+                for (size_t z = firstRow; z < lastRow; ++z)
                 {
-                    size_t currentIndex = z * width + x;
-                    size_t leftIndex = z * width + (x - 1);
-                    size_t rightIndex = z * width + (x + 1);
-                    size_t upIndex = (z - 1) * width + x;
-                    size_t downIndex = (z + 1) * width + x;
-
-                    glm::vec3& left = vertices[leftIndex];
-                    glm::vec3& right = vertices[rightIndex];
-                    glm::vec3& up = vertices[upIndex];
-                    glm::vec3& down = vertices[downIndex];
-
-                    normals[currentIndex] = glm::normalize(glm::cross(down - up, right - left));
+                    terrain_kernels::buildVertexRowFromHeights(heights.data() + z * width, width, height, int(z), heightScale,
+                        vertexData + z * rowStride, colorData + z * rowStride);
                 }
+            });
+
+        buildNormals(pool, rowsPerBand);
+
+        // The heights live in the vertices from now on, where the pyramid has to read them
+        heights.clear();
+        heights.shrink_to_fit();
+
+        heightPyramid.build(getHeightData(), getHeightStride(), width, height, pool);
+    }
+
+    void HeightMapTerrain::rebuildMeshRegion(int firstX, int firstZ, int lastX, int lastZ)
+    {
+        // Colours as the vertex kernels compute them, division included
+        const float heightRange = terrain_kernels::HEIGHT_RANGE * heightScale;
+
+        for (int z = firstZ; z <= lastZ; ++z)
+        {
+            for (int x = firstX; x <= lastX; ++x)
+            {
+                const size_t i = size_t(z) * width + x;
+                terrain_kernels::rampColor(vertices[i].y / heightRange, &colors[i].x);
             }
         }
 
-        // Calculate total number of indices needed
-        size_t totalIndices = (width - 1) * (height - 1) * 6;  // 6 indices per quad (2 triangles)
-        indices.reserve(totalIndices);
+        // Interior normals from one texel around the edit, through the row kernel over the
+        // columns in question: the same values a full rebuild computes
+        const int normalX0 = std::max(1, firstX - 1);
+        const int normalX1 = std::min(width - 2, lastX + 1);
+
+        if (normalX0 > normalX1) return;
+
+        const float* vertexData = &vertices[0].x;
+        float* normalData = &normals[0].x;
+        const size_t rowStride = size_t(width) * 3;
+        const size_t column = size_t(normalX0 - 1) * 3;
+
+        for (int z = std::max(1, firstZ - 1); z <= std::min(height - 2, lastZ + 1); ++z)
+        {
+            terrain_kernels::buildNormalRow(vertexData + (z - 1) * rowStride + column, vertexData + z * rowStride + column,
+                vertexData + (z + 1) * rowStride + column, normalX1 - normalX0 + 3, normalData + z * rowStride + column);
+        }
+    }
+
+    void HeightMapTerrain::uploadDirtyTexels()
+    {
+        SPACE_PROFILE_ZONE("Terrain sculpt upload");
 
-        for (int z = 0; z < height - 1; ++z)
+        if (renderMode == RenderMode::MESH)
         {
-            for (int x = 0; x < width - 1; ++x)
+            if (repackVertices)
             {
-                GLuint topLeft = z * width + x;
-                GLuint topRight = z * width + x + 1;
-                GLuint bottomLeft = (z + 1) * width + x;
-                GLuint bottomRight = (z + 1) * width + x + 1;
+                // Quantize every vertex again over every height a brush can reach, so this
+                // happens once
+                BoundingBox range = bounds;
+                range.min.y = std::min(range.min.y, 0.0f);
+                range.max.y = std::max(range.max.y, terrain_kernels::HEIGHT_RANGE * heightScale);
+
+                VertexSource source{ vertices, normals, colors, range.min, range.getExtent() };
+                vertex_decode = MeshLayout::decode(source);
 
-                // First triangle
-                indices.push_back(topLeft);
-                indices.push_back(bottomLeft);
-                indices.push_back(topRight);
+                updateVertices< MeshLayout >(0, vertices.size());
+            }
+            else
+            {
+                // One range per row, the rows are width vertices apart in the buffer
+                const size_t count = size_t(dirtyTexels.z - dirtyTexels.x + 1);
 
-                // Second triangle
-                indices.push_back(topRight);
-                indices.push_back(bottomLeft);
-                indices.push_back(bottomRight);
+                for (int z = dirtyTexels.y; z <= dirtyTexels.w; ++z)
+                {
+                    updateVertices< MeshLayout >(size_t(z) * width + dirtyTexels.x, count);
+                }
             }
+
+            repackVertices = false;
+        }
+        else
+        {
+            // Only the changed rectangle, read in place from the heights rows; the height
+            // texture is bound by the caller
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, dirtyTexels.x, dirtyTexels.y, dirtyTexels.z - dirtyTexels.x + 1, dirtyTexels.w - dirtyTexels.y + 1,
+                GL_RED, GL_FLOAT, heights.data() + size_t(dirtyTexels.y) * width + dirtyTexels.x);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
         }
 
-        // Free the image
-        SOIL_free_image_data(image);
+        dirtyTexels = glm::ivec4(0, 0, -1, -1);
 
-        // Set up OpenGL buffers
-        setUpMesh();
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR)
+        {
+            std::cerr << "OpenGL error uploading the sculpted terrain: " << error << std::endl;
+        }
     }
 
     float HeightMapTerrain::getHeightAtWorldPosition(float worldX, float worldZ, const glm::mat4& terrainTransform) const
@@ -199,25 +952,75 @@ namespace space
         return height * terrainTransform[1][1];
     }
 
-    std::shared_ptr<GrassMesh> HeightMapTerrain::createGrassForTerrain(
-        const glm::mat4& terrainTransform,
-        const std::string& grassModelPath,
-        int instanceCount)
+    bool HeightMapTerrain::raycast(const TerrainRay& ray, const glm::mat4& terrainTransform, TerrainHit& hit) const
     {
-        // Create grass mesh
-        auto grass = std::make_shared<GrassMesh>();
+        return castRay(ray, glm::inverse(terrainTransform), hit);
+    }
 
-        // Load the grass model
-        if (!grass->loadFromFile(grassModelPath))
-        {
-            std::cerr << "Failed to load grass model: " << grassModelPath << std::endl;
-            return nullptr;
-        }
+    void HeightMapTerrain::raycast(const TerrainRay* rays, size_t count, const glm::mat4& terrainTransform, TerrainHit* hits, ThreadPool* pool) const
+    {
+        ThreadPool& threads = pool ? *pool : ThreadPool::shared();
+        const glm::mat4 inverse = glm::inverse(terrainTransform);
 
-        // Create a height sampling function that properly handles coordinate transforms
-        auto heightSampler = [this, terrainTransform](float worldX, float worldZ) -> GrassHeightInfo {
+        threads.parallelFor(0, count, 256, [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    castRay(rays[i], inverse, hits[i]);
+                }
+            });
+    }
+
+    bool HeightMapTerrain::castRay(const TerrainRay& ray, const glm::mat4& inverse, TerrainHit& hit) const
+    {
+        hit = TerrainHit{};
+
+        if (!heightPyramid.isBuilt()) return false;
+
+        // World to local is affine, and so is local to texel: the ray parameter survives both
+        const glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(ray.origin, 1.0f));
+        const glm::vec3 localDirection = glm::vec3(inverse * glm::vec4(ray.direction, 0.0f));
+
+        const glm::vec3 toTexel((width - 1) / terrainWorldScale, 1.0f, (height - 1) / terrainWorldScale);
+        const glm::vec3 texelOrigin = (localOrigin + glm::vec3(terrainWorldScale * 0.5f, 0.0f, terrainWorldScale * 0.5f)) * toTexel;
+
+        float t;
+
+        if (!heightPyramid.intersect(texelOrigin, localDirection * toTexel, 0.0f, ray.maxDistance, t)) return false;
+
+        hit.hit = true;
+        hit.distance = t;
+        hit.position = ray.origin + t * ray.direction;
+
+        // Gradient of the patch under the hit in texel units, to a local normal, to world
+        const glm::vec3 texel = texelOrigin + t * localDirection * toTexel;
+        const int x0 = glm::clamp(int(texel.x), 0, width - 2);
+        const int z0 = glm::clamp(int(texel.z), 0, height - 2);
+        const float u = glm::clamp(texel.x - x0, 0.0f, 1.0f);
+        const float v = glm::clamp(texel.z - z0, 0.0f, 1.0f);
+
+        const float h00 = getHeightAtGridPoint(x0, z0);
+        const float h10 = getHeightAtGridPoint(x0 + 1, z0);
+        const float h01 = getHeightAtGridPoint(x0, z0 + 1);
+        const float h11 = getHeightAtGridPoint(x0 + 1, z0 + 1);
+
+        const float dx = (h10 - h00) * (1.0f - v) + (h11 - h01) * v;
+        const float dz = (h01 - h00) * (1.0f - u) + (h11 - h10) * u;
+
+        const glm::vec3 localNormal(-dx * toTexel.x, 1.0f, -dz * toTexel.z);
+        hit.normal = glm::normalize(glm::transpose(glm::mat3(inverse)) * localNormal);
+
+        return true;
+    }
+
+    std::function<GrassHeightInfo(float, float)> HeightMapTerrain::makeGrassHeightSampler(const glm::mat4& terrainTransform) const
+    {
+        // The transform is inverted once here instead of on every sample
+        HeightfieldSampler sampler(*this, terrainTransform);
+
+        return [this, sampler, terrainTransform](float worldX, float worldZ) -> GrassHeightInfo {
             // Get the actual height at this world position
-            float localHeight = getHeightAtWorldPosition(worldX, worldZ, terrainTransform);
+            float localHeight = sampler.getHeight(worldX, worldZ);
 
             // Get terrain's world Y position from transform
             float terrainWorldY = terrainTransform[3][1];
@@ -228,11 +1031,94 @@ namespace space
             // Normalize based on expected height range
             // The terrain heights range from 0 to 5*heightScale in local space
             // After transform and offset, they range from (terrainY) to (terrainY + 5*scale*heightScale)
-            float maxHeightRange = 5.0f * heightScale * terrainTransform[1][1];
             float normalizedHeight = localHeight / (5.0f * heightScale);
 
             return GrassHeightInfo{ absoluteWorldHeight, normalizedHeight };
             };
+    }
+
+    std::function<void(const float*, const float*, size_t, GrassHeightInfo*)> HeightMapTerrain::makeGrassHeightBatchSampler(const glm::mat4& terrainTransform) const
+    {
+        HeightfieldSampler sampler(*this, terrainTransform);
+
+        const float terrainWorldY = terrainTransform[3][1];
+        const float heightRange = 5.0f * heightScale;
+
+        return [sampler, terrainWorldY, heightRange](const float* worldX, const float* worldZ, size_t count, GrassHeightInfo* out)
+            {
+                float localHeights[256];
+
+                for (size_t first = 0; first < count; first += 256)
+                {
+                    const size_t batch = std::min<size_t>(256, count - first);
+
+                    sampler.sampleHeights(worldX + first, worldZ + first, batch, localHeights);
+
+                    // Same expressions as makeGrassHeightSampler
+                    for (size_t i = 0; i < batch; ++i)
+                    {
+                        out[first + i] = GrassHeightInfo{ terrainWorldY + localHeights[i], localHeights[i] / heightRange };
+                    }
+                }
+            };
+    }
+
+    GrassPlacementMap HeightMapTerrain::makeGrassPlacementMap(const glm::mat4& terrainTransform, float minHeight, float maxHeight, ThreadPool* pool) const
+    {
+        // Normalized heights are local heights times the Y scale over 5 * heightScale
+        const float toLocal = 5.0f * heightScale / terrainTransform[1][1];
+
+        GrassPlacementMap placement;
+        placement.build(getHeightData(), getHeightStride(), width, height, minHeight * toLocal, maxHeight * toLocal, pool ? *pool : ThreadPool::shared());
+
+        return placement;
+    }
+
+    double HeightMapTerrain::getMaxGrassShare(const glm::mat4& terrainTransform, float minHeight, float maxHeight) const
+    {
+        if (!heightPyramid.isBuilt()) return 0.0;
+
+        // Same conversion as makeGrassPlacementMap
+        const float toLocal = 5.0f * heightScale / terrainTransform[1][1];
+        const float minLocal = minHeight * toLocal;
+        const float maxLocal = maxHeight * toLocal;
+
+        // A leaf may hold eligible ground when its range meets the grass range, even if only
+        // between its texels
+        const int nodesX = heightPyramid.getNodesX(0);
+        const int nodesZ = heightPyramid.getNodesZ(0);
+        size_t candidates = 0;
+
+        for (int z = 0; z < nodesZ; ++z)
+        {
+            for (int x = 0; x < nodesX; ++x)
+            {
+                const glm::vec2 range = heightPyramid.getRange(0, x, z);
+                candidates += size_t(range.y >= minLocal && range.x <= maxLocal);
+            }
+        }
+
+        return double(candidates) / std::max(double(nodesX) * nodesZ, 1.0);
+    }
+
+    std::shared_ptr<GrassMesh> HeightMapTerrain::createGrassForTerrain(
+        const glm::mat4& terrainTransform,
+        const std::string& grassModelPath,
+        int instanceCount,
+        GrassDistribution distribution)
+    {
+        // Create grass mesh
+        auto grass = std::make_shared<GrassMesh>();
+
+        // Load the grass model
+        if (!grass->loadFromFile(grassModelPath))
+        {
+            std::cerr << "Failed to load grass model: " << grassModelPath << std::endl;
+            return nullptr;
+        }
+
+        // Create a height sampling function that properly handles coordinate transforms
+        auto heightSampler = makeGrassHeightBatchSampler(terrainTransform);
 
         // Calculate the world space bounds of the terrain
         float worldScale = terrainTransform[0][0] * terrainWorldScale;  // X scale * terrain size
@@ -240,14 +1126,45 @@ namespace space
         // Get terrain world position
         glm::vec3 terrainWorldPos(terrainTransform[3][0], terrainTransform[3][1], terrainTransform[3][2]);
 
-        // Generate instances with proper world bounds
-        grass->generateInstancesForTerrain(
-            instanceCount,
-            worldScale,        // Actual world width
-            worldScale,        // Actual world height  
-            terrainWorldPos,   // Terrain center in world space
-            heightSampler
-        );
+        if (distribution == GrassDistribution::POISSON_DISK)
+        {
+            // For its eligible area, which sets the spacing
+            GrassPlacementMap placement = makeGrassPlacementMap(terrainTransform, grass->getMinHeight(), grass->getMaxHeight());
+
+            if (placement.isEmpty() || instanceCount <= 0)
+            {
+                std::cout << "No terrain within the grass height range, no grass generated" << std::endl;
+                return grass;
+            }
+
+            // Spaced from the eligible area the uniform count would share
+            const double eligibleArea = double(worldScale) * worldScale * placement.getEligibleQuads() / ((width - 1.0) * (height - 1.0));
+            const float spacing = POISSON_GRASS_SPACING * float(std::sqrt(eligibleArea / instanceCount));
+
+            grass->generatePoissonInstancesForTerrain(spacing, worldScale, worldScale, terrainWorldPos, heightSampler);
+
+            return grass;
+        }
+
+        // Rejection needs no map and wastes few attempts on mostly eligible terrain (see the
+        // benchmark), but gives up after 10 attempts per instance
+        if (getMaxGrassShare(terrainTransform, grass->getMinHeight(), grass->getMaxHeight()) >= REJECTION_GRASS_SHARE)
+        {
+            grass->generateInstancesForTerrain(
+                instanceCount,
+                worldScale,        // Actual world width
+                worldScale,        // Actual world height  
+                terrainWorldPos,   // Terrain center in world space
+                heightSampler
+            );
+
+            if (grass->getInstanceCount() >= size_t(std::max(instanceCount, 0))) return grass;
+        }
+
+        // Whatever rejection did not place, every instance below the share
+        GrassPlacementMap placement = makeGrassPlacementMap(terrainTransform, grass->getMinHeight(), grass->getMaxHeight());
+
+        grass->fillInstancesForTerrain(instanceCount, worldScale, worldScale, terrainWorldPos, placement, heightSampler);
 
         return grass;
     }
@@ -5,18 +5,25 @@
 
 #pragma once
 
+#include "GrassPlacementMap.hpp"
 #include "Mesh.hpp"
+#include "MinMaxPyramid.hpp"
 #include "SceneNode.hpp"
 #include "Scene.hpp"
+#include "TerrainMeshCache.hpp"
+#include "TerrainNoise.hpp"
+#include "TerrainQuadtree.hpp"
+#include "ThreadPool.hpp"
 
-#include <SOIL2.h>
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 #include <iostream>
+#include <functional>
 
 namespace space
 {
     class GrassMesh;
+    class HeightmapImage;
 
     struct GrassHeightInfo
     {
@@ -24,8 +31,95 @@ namespace space
         float normalizedHeight;
     };
 
+    // World space ray for HeightMapTerrain::raycast; distances are in units of direction
+    struct TerrainRay
+    {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        float maxDistance;
+    };
+
+    struct TerrainHit
+    {
+        bool hit = false;
+        float distance = 0.0f;
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    };
+
+    // Brush of HeightMapTerrain::sculpt, in the terrain local units
+    struct TerrainBrush
+    {
+        enum class Mode
+        {
+            RAISE,      // Adds strength height units at the centre
+            LOWER,      // Removes them
+            SMOOTH,     // Moves each height a strength fraction of the way to the mean of its 3x3 texels
+            FLATTEN     // Moves each height a strength fraction of the way to targetHeight
+        };
+
+        Mode mode = Mode::RAISE;
+        float radius = 1.0f;
+        float strength = 0.1f;
+        float targetHeight = 0.0f;
+    };
+
     class HeightMapTerrain : public Mesh
     {
+    public:
+
+        /**
+        * MESH expands every texel into a vertex with its normal and colour. DISPLACEMENT keeps
+        * one float per texel, uploads them once as a texture and draws a shared grid patch
+        * instanced over the heightmap; terrain_vertex_shader.glsl fetches the heights and
+        * derives the normals and the colour ramp. CDLOD draws the same patch over the nodes of
+        * a TerrainQuadtree selected every frame (updateLod()), coarser with the distance.
+        */
+        enum class RenderMode
+        {
+            MESH,
+            DISPLACEMENT,
+            CDLOD
+        };
+
+        /**
+        * TRIANGLE_LIST emits 6 indices per quad. TRIANGLE_STRIPS emits one strip per row of
+        * quads (2 indices per vertex of the row) separated by primitive restart markers, and in
+        * MESH mode splits the rows in chunks of fewer than 64k vertices whose indices are
+        * relative to the chunk, so they upload as 16-bit.
+        */
+        enum class IndexMode
+        {
+            TRIANGLE_LIST,
+            TRIANGLE_STRIPS
+        };
+
+        /**
+        * How createGrassForTerrain scatters the instances. UNIFORM places the count asked for
+        * at independent random positions, by rejection or from a placement map (see
+        * REJECTION_GRASS_SHARE), and always reaches it while any ground is within the grass
+        * height range. POISSON_DISK keeps them a minimum
+        * distance apart, spaced to cover the ground with no more gaps than the uniform count
+        * would leave, which takes about half as many instances.
+        */
+        enum class GrassDistribution
+        {
+            UNIFORM,
+            POISSON_DISK
+        };
+
+        // Poisson-disk spacing over the mean spacing of the uniform count it stands in for
+        static constexpr float POISSON_GRASS_SPACING = 1.25f;
+
+        // Share of the terrain that must possibly be eligible for UNIFORM grass to be scattered
+        // by rejection, topped up from a placement map if it comes up short. Above it, rejection
+        // costs about as much as building the map and drawing from it (see the benchmark);
+        // below it, every instance is drawn from the map
+        static constexpr double REJECTION_GRASS_SHARE = 0.25;
+
+        // Quads per side of the shared patch of the heightfield modes (65x65 vertices)
+        static constexpr int PATCH_QUADS = 64;
+
     private:
 
         int width;
@@ -33,15 +127,52 @@ namespace space
         float heightScale;
         std::string heightMapPath;
 
+        // Procedural terrains: noise over the square of the plane from noiseOrigin, noiseSize texels per side
+        bool procedural = false;
+        TerrainNoise noise;
+        int noiseSize = 0;
+        glm::vec2 noiseOrigin = glm::vec2(0.0f);
+
         // Store terrain parameters for grass generation
         float terrainWorldScale = 20.0f;
 
-        //Converts RGB to grayscale
-        float rgbToHeight(unsigned char r, unsigned char g, unsigned char b)
-        {
-            //Weighted grayscale conversion for more natural height
-            return (0.299f * r + 0.587f * g + 0.114f * b) / 255.0f * heightScale;
-        }
+        // Pool the mesh passes run on, the shared one when null
+        ThreadPool* buildPool;
+
+        RenderMode renderMode;
+        IndexMode indexMode;
+
+        // Displacement mode: texel heights (the CPU copy of the texture) and patch grid
+        std::vector<float> heights;
+        GLuint heightTexture = 0;
+
+        // Patch instances: one per patch in displacement mode, the LOD selection in CDLOD mode
+        GLuint patchInstanceVbo = 0;
+        std::vector<TerrainQuadtree::Patch> patches;
+        bool patchesChanged = false;
+
+        TerrainQuadtree lodTree;
+        float lodPixelError = 2.0f;
+        int lodCulledNodes = 0;
+
+        // Heightfield modes: box of the heightfield, the shared patch says nothing about it
+        BoundingBox heightfieldBounds;
+
+        // Height ranges over the texels, for raycasts
+        MinMaxPyramid heightPyramid;
+
+        // Texels sculpt() changed since the last upload: first x and z, last x and z
+        glm::ivec4 dirtyTexels = glm::ivec4(0, 0, -1, -1);
+
+        // MESH mode: the heights left the range the vertices were quantized over
+        bool repackVertices = false;
+
+        static constexpr size_t ROW_BAND_VERTICES = 64 * 1024;
+
+        // The patch only needs its grid positions, everything else comes from the texture;
+        // full meshes use quantized vertices, 16 bytes each instead of 36
+        using PatchLayout = VertexLayout< vertex::Position >;
+        using MeshLayout = QuantizedVertexLayout;
 
         // Get height at a specific grid point
         float getHeightAtGridPoint(int x, int z) const
@@ -50,27 +181,105 @@ namespace space
             x = glm::clamp(x, 0, width - 1);
             z = glm::clamp(z, 0, height - 1);
 
-            // Calculate vertex index
-            int index = z * width + x;
+            return getHeightAtIndex(z * width + x);
+        }
+
+        void setUp(bool uploadToGpu);
+        bool makeCacheKey(TerrainMeshCache::Key& key) const;
+        bool loadCache(const TerrainMeshCache::Key& key, bool uploadToGpu);
+        void saveCache(const TerrainMeshCache::Key& key, const Buffers& buffers) const;
+
+        void initializeDisplacement(const HeightmapImage& image, ThreadPool& pool, size_t rowsPerBand);
+        void buildNormals(ThreadPool& pool, size_t rowsPerBand);
+        void restoreMeshArrays();
+        void rebuildMeshRegion(int firstX, int firstZ, int lastX, int lastZ);
+        void uploadDirtyTexels();
+        void buildPatches();
+        void buildGridIndices(int columns, int rows, ThreadPool& pool, size_t rowsPerBand);
+        void uploadHeightTexture();
+        bool castRay(const TerrainRay& ray, const glm::mat4& inverseTransform, TerrainHit& hit) const;
+        void uploadPatches();
+
+    public:
 
-            // Return the Y component of the vertex at this position
-            if (index < vertices.size())
+        /**
+        * path is an image or a raw .r16 / .r32 heightmap (see HeightmapImage); single channel
+        * 16-bit and raw ones keep their full precision.
+        * uploadToGpu = false only builds the CPU arrays, which lets the terrain be
+        * generated without a GL context (see the benchmark target).
+        * The vertex, normal and index passes are split in row bands over pool
+        * (ThreadPool::shared() by default); the result does not depend on the thread count.
+        * With a TerrainMeshCache directory set, the baked buffers are saved after a build and
+        * loaded instead of building on later runs with the same heightmap and parameters.
+        */
+        HeightMapTerrain(const std::string& path, float scale = 1.0f, bool uploadToGpu = true, ThreadPool* pool = nullptr, RenderMode mode = RenderMode::MESH,
+            IndexMode indexing = IndexMode::TRIANGLE_STRIPS)
+            : width(0), height(0), heightScale(scale), heightMapPath(path), buildPool(pool), renderMode(mode), indexMode(indexing)
+        {
+            setUp(uploadToGpu);
+        }
+
+        /**
+        * Procedural terrain: size x size texels of noise over the square of the noise plane
+        * that starts at origin and spans getTerrainWorldScale() units, so terrains whose
+        * origins are that far apart continue each other seamlessly. Everything else is built
+        * (and cached, keyed by the noise settings) as for a heightmap.
+        */
+        HeightMapTerrain(const TerrainNoise& noise, int size, const glm::vec2& origin = glm::vec2(0.0f), float scale = 1.0f, bool uploadToGpu = true,
+            ThreadPool* pool = nullptr, RenderMode mode = RenderMode::MESH, IndexMode indexing = IndexMode::TRIANGLE_STRIPS)
+            : width(0), height(0), heightScale(scale), procedural(true), noise(noise), noiseSize(size), noiseOrigin(origin), buildPool(pool),
+            renderMode(mode), indexMode(indexing)
+        {
+            setUp(uploadToGpu);
+        }
+
+        ~HeightMapTerrain() override
+        {
+            if (heightTexture)
             {
-                return vertices[index].y;
+                glDeleteTextures(1, &heightTexture);
             }
 
-            return 0.0f; // Default height
+            if (patchInstanceVbo)
+            {
+                glDeleteBuffers(1, &patchInstanceVbo);
+            }
         }
 
-    public:
+        void initialize() override;
+
+        // Draws the patch instances in displacement mode, the whole mesh otherwise
+        void render() override;
+
+        RenderMode getRenderMode() const { return renderMode; }
+        IndexMode getIndexMode() const { return indexMode; }
+        int getPatchCount() const { return int(patches.size()); }
+
+        // Quadtree nodes and quadrants the frustum rejected in the last updateLod()
+        int getCulledLodNodeCount() const { return lodCulledNodes; }
 
-        HeightMapTerrain(const std::string& path, float scale = 1.0f)
-            : heightMapPath (path), heightScale(scale), width(0), height(0)
+        BoundingBox getBounds() const override
         {
-            initialize();
+            return renderMode == RenderMode::MESH ? Mesh::getBounds() : heightfieldBounds;
         }
 
-        void initialize() override;
+        /**
+        * CDLOD mode: selects the patches for a camera given in the terrain local space, for a
+        * viewport viewportHeight pixels tall with the vertical fov in radians. Nodes outside
+        * localFrustum (also in the terrain local space) are skipped. Only touches the CPU
+        * side; the next render() uploads the selection.
+        */
+        void updateLod(const glm::vec3& localCameraPosition, float viewportHeight, float verticalFov, const Frustum* localFrustum = nullptr);
+
+        // Largest projected vertex spacing, in pixels, the CDLOD selection allows
+        void setLodPixelError(float pixels) { lodPixelError = pixels; }
+        const TerrainQuadtree& getLodTree() const { return lodTree; }
+
+        /**
+        * Sets the heightfield uniforms of terrain_vertex_shader.glsl (texture unit, sizes and
+        * colour ramp) on program, which must be in use. They only change with the terrain.
+        */
+        void setDisplacementUniforms(GLuint program) const;
 
         // Getter for terrain dimensions
         int getWidth() const { return width; }
@@ -78,11 +287,40 @@ namespace space
         float getTerrainWorldScale() const { return terrainWorldScale; }
         float getHeightScale() const { return heightScale; }
 
-        // Get the height at a specific world position
+        /**
+        * Get the height at a specific world position. Inverts the transform on every call:
+        * bulk queries go through a HeightfieldSampler instead.
+        */
         float getHeightAtWorldPosition(float worldX, float worldZ, const glm::mat4& terrainTransform) const;
 
+        /**
+        * Texel heights, row by row, getHeightStride() floats apart: the heights array in the
+        * heightfield modes and meshes loaded from the cache, the vertex y otherwise.
+        * Null when the terrain failed to load.
+        */
+        const float* getHeightData() const
+        {
+            if (renderMode != RenderMode::MESH || vertices.empty())
+            {
+                return heights.empty() ? nullptr : heights.data();
+            }
+
+            return &vertices[0].y;
+        }
+
+        int getHeightStride() const
+        {
+            return renderMode != RenderMode::MESH || vertices.empty() ? 1 : 3;
+        }
+
         float getHeightAtIndex(int index) const
         {
+            // Meshes loaded from the cache keep only the heights
+            if (renderMode != RenderMode::MESH || vertices.empty())
+            {
+                return index >= 0 && index < heights.size() ? heights[index] : 0.0f;
+            }
+
             // Bounds checking to prevent crashes
             if (index >= 0 && index < vertices.size())
             {
@@ -93,10 +331,56 @@ namespace space
             return 0.0f;
         }
 
+        const MinMaxPyramid& getHeightPyramid() const { return heightPyramid; }
+
+        /**
+        * Applies brush around a world position (a raycast hit, say) of the terrain placed with
+        * terrainTransform. Only the texels under the brush change: their heights, the normals
+        * and colours around them in MESH mode, and the pyramid, LOD tree and bounds over the
+        * same texels. Heights stay within [0, HEIGHT_RANGE * heightScale], what a heightmap
+        * can hold. The next render() uploads the changed rows, or texture rectangle, alone.
+        * Returns false when the brush misses the terrain.
+        */
+        bool sculpt(const TerrainBrush& brush, const glm::vec3& worldPosition, const glm::mat4& terrainTransform);
+
+        // Texels changed by sculpt() and not uploaded yet, first x and z then last x and z (empty when .x > .z)
+        glm::ivec4 getDirtyTexels() const { return dirtyTexels; }
+
+        /**
+        * First point where a world space ray meets the terrain placed with terrainTransform,
+        * walking the min/max pyramid so the cost grows with the log of the terrain size. The
+        * surface is the bilinear one of getHeightAtWorldPosition; a ray that starts under it
+        * hits at its origin. hit.distance is in units of the ray direction.
+        */
+        bool raycast(const TerrainRay& ray, const glm::mat4& terrainTransform, TerrainHit& hit) const;
+
+        // Casts count rays, split over pool (ThreadPool::shared() by default)
+        void raycast(const TerrainRay* rays, size_t count, const glm::mat4& terrainTransform, TerrainHit* hits, ThreadPool* pool = nullptr) const;
+
+        // Builds the world-space height sampler used to scatter grass over this terrain
+        std::function<GrassHeightInfo(float, float)> makeGrassHeightSampler(const glm::mat4& terrainTransform) const;
+
+        // Same heights, many positions per call through HeightfieldSampler; safe to call from several threads
+        std::function<void(const float*, const float*, size_t, GrassHeightInfo*)> makeGrassHeightBatchSampler(const glm::mat4& terrainTransform) const;
+
+        /**
+        * Placement map of the texels whose normalized height, as the grass height samplers
+        * compute it, is within [minHeight, maxHeight]. It reads the terrain heights in place.
+        */
+        GrassPlacementMap makeGrassPlacementMap(const glm::mat4& terrainTransform, float minHeight, float maxHeight, ThreadPool* pool = nullptr) const;
+
+        /**
+        * Upper bound on the share of the terrain whose normalized height is within
+        * [minHeight, maxHeight]: the leaves of the min/max pyramid whose range meets it.
+        * Costs a pass over the leaves, not over the texels.
+        */
+        double getMaxGrassShare(const glm::mat4& terrainTransform, float minHeight, float maxHeight) const;
+
         std::shared_ptr<GrassMesh> createGrassForTerrain(
             const glm::mat4& terrainTransform,
             const std::string& grassModelPath,
-            int instanceCount);
+            int instanceCount,
+            GrassDistribution distribution = GrassDistribution::UNIFORM);
 
     };
 
@@ -0,0 +1,160 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "HeightfieldSampler.hpp"
+#include "HeightMapTerrain.hpp"
+#include "TerrainKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace space
+{
+    namespace
+    {
+        // Positions per kernel call, small enough for the texel arrays to stay on the stack
+        constexpr size_t BATCH = 256;
+    }
+
+    HeightfieldSampler::HeightfieldSampler(const HeightMapTerrain& terrain, const glm::mat4& terrainTransform)
+        : heights(terrain.getHeightData()), stride(terrain.getHeightStride()), width(terrain.getWidth()), height(terrain.getHeight()),
+        heightScale(terrainTransform[1][1])
+    {
+        if (width < 2 || height < 2)
+        {
+            heights = nullptr;
+            return;
+        }
+
+        // World (x, 0, z) to terrain local space, then local [-extent / 2, extent / 2] to texels
+        const glm::mat4 inverse = glm::inverse(terrainTransform);
+        const float extent = terrain.getTerrainWorldScale();
+
+        const float scaleX = (width - 1) / extent;
+        const float scaleZ = (height - 1) / extent;
+
+        texelX = glm::vec3(inverse[0][0], inverse[2][0], inverse[3][0] + extent * 0.5f) * scaleX;
+        texelZ = glm::vec3(inverse[0][2], inverse[2][2], inverse[3][2] + extent * 0.5f) * scaleZ;
+    }
+
+    float HeightfieldSampler::getHeight(float worldX, float worldZ) const
+    {
+        float result;
+        sample(&worldX, &worldZ, 1, &result, nullptr, nullptr);
+        return result;
+    }
+
+    glm::vec3 HeightfieldSampler::getNormal(float worldX, float worldZ) const
+    {
+        glm::vec3 normal;
+        sampleNormals(&worldX, &worldZ, 1, &normal.x, &normal.y, &normal.z);
+        return normal;
+    }
+
+    float HeightfieldSampler::getSlope(float worldX, float worldZ) const
+    {
+        float slope;
+        sampleSlopes(&worldX, &worldZ, 1, &slope);
+        return slope;
+    }
+
+    void HeightfieldSampler::sampleHeights(const float* worldX, const float* worldZ, size_t count, float* outHeights) const
+    {
+        sample(worldX, worldZ, count, outHeights, nullptr, nullptr);
+    }
+
+    void HeightfieldSampler::sampleNormals(const float* worldX, const float* worldZ, size_t count, float* normalX, float* normalY, float* normalZ) const
+    {
+        float batchHeights[BATCH];
+
+        for (size_t first = 0; first < count; first += BATCH)
+        {
+            const size_t batch = std::min(BATCH, count - first);
+
+            // Gradient straight into the x and z outputs, then turned into the normal in place
+            sample(worldX + first, worldZ + first, batch, batchHeights, normalX + first, normalZ + first);
+
+            for (size_t i = first; i < first + batch; ++i)
+            {
+                const float inverseLength = 1.0f / std::sqrt(normalX[i] * normalX[i] + 1.0f + normalZ[i] * normalZ[i]);
+
+                normalX[i] = -normalX[i] * inverseLength;
+                normalY[i] = inverseLength;
+                normalZ[i] = -normalZ[i] * inverseLength;
+            }
+        }
+    }
+
+    void HeightfieldSampler::sampleSlopes(const float* worldX, const float* worldZ, size_t count, float* outSlopes) const
+    {
+        float batchHeights[BATCH];
+        float gradientZ[BATCH];
+
+        for (size_t first = 0; first < count; first += BATCH)
+        {
+            const size_t batch = std::min(BATCH, count - first);
+
+            sample(worldX + first, worldZ + first, batch, batchHeights, outSlopes + first, gradientZ);
+
+            for (size_t i = 0; i < batch; ++i)
+            {
+                float& slope = outSlopes[first + i];
+                slope = std::sqrt(slope * slope + gradientZ[i] * gradientZ[i]);
+            }
+        }
+    }
+
+    void HeightfieldSampler::sample(const float* worldX, const float* worldZ, size_t count, float* outHeights, float* gradientX, float* gradientZ) const
+    {
+        if (!heights)
+        {
+            std::fill(outHeights, outHeights + count, 0.0f);
+
+            if (gradientX && gradientZ)
+            {
+                std::fill(gradientX, gradientX + count, 0.0f);
+                std::fill(gradientZ, gradientZ + count, 0.0f);
+            }
+
+            return;
+        }
+
+        const bool gradient = gradientX && gradientZ;
+
+        float tx[BATCH], tz[BATCH];
+        float dx[BATCH], dz[BATCH];
+
+        for (size_t first = 0; first < count; first += BATCH)
+        {
+            const size_t batch = std::min(BATCH, count - first);
+
+            for (size_t i = 0; i < batch; ++i)
+            {
+                const float x = worldX[first + i];
+                const float z = worldZ[first + i];
+
+                tx[i] = texelX.x * x + texelX.y * z + texelX.z;
+                tz[i] = texelZ.x * x + texelZ.y * z + texelZ.z;
+            }
+
+            terrain_kernels::sampleBilinear(heights, stride, width, height, tx, tz, int(batch), outHeights + first,
+                gradient ? dx : nullptr, gradient ? dz : nullptr);
+
+            for (size_t i = 0; i < batch; ++i)
+            {
+                outHeights[first + i] *= heightScale;
+            }
+
+            if (!gradient) continue;
+
+            // Chain rule through the texel map: dh/dworld = dh/dtexel * dtexel/dworld
+            for (size_t i = 0; i < batch; ++i)
+            {
+                gradientX[first + i] = (dx[i] * texelX.x + dz[i] * texelZ.x) * heightScale;
+                gradientZ[first + i] = (dx[i] * texelX.y + dz[i] * texelZ.y) * heightScale;
+            }
+        }
+    }
+}
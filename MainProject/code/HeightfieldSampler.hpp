@@ -0,0 +1,71 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <glm.hpp>
+
+#include <cstddef>
+
+namespace space
+{
+    class HeightMapTerrain;
+
+    /**
+    * World space height, normal and slope queries over a HeightMapTerrain placed with a fixed
+    * transform, for code that samples many points: grass scattering, placement, physics.
+    *
+    * The world to texel mapping is folded into one 2D affine map on construction, so a query
+    * costs no matrix inverse. The batched queries take structure-of-arrays positions and
+    * run the bilinear interpolation through terrain_kernels::sampleBilinear, 8 positions at a
+    * time with the widest SIMD level available.
+    *
+    * Heights are the terrain's local heights times the transform's Y scale, as
+    * HeightMapTerrain::getHeightAtWorldPosition returns them. The sampler reads the terrain
+    * arrays in place: the terrain must outlive it and not be rebuilt meanwhile.
+    */
+    class HeightfieldSampler
+    {
+    public:
+
+        HeightfieldSampler(const HeightMapTerrain& terrain, const glm::mat4& terrainTransform);
+
+        // False when the terrain has no heights (it failed to load); every query returns 0
+        bool isValid() const { return heights != nullptr; }
+
+        float getHeight(float worldX, float worldZ) const;
+
+        // Upward unit normal of the interpolated surface in world space
+        glm::vec3 getNormal(float worldX, float worldZ) const;
+
+        // Rise over run of the interpolated surface: 0 when flat, 1 at 45 degrees
+        float getSlope(float worldX, float worldZ) const;
+
+        void sampleHeights(const float* worldX, const float* worldZ, size_t count, float* outHeights) const;
+
+        void sampleNormals(const float* worldX, const float* worldZ, size_t count, float* normalX, float* normalY, float* normalZ) const;
+
+        void sampleSlopes(const float* worldX, const float* worldZ, size_t count, float* outSlopes) const;
+
+        /**
+        * Heights and, when the gradient arrays are not null, the world space height gradient
+        * (dh/dx, dh/dz) in one pass. The other batched queries are built on it.
+        */
+        void sample(const float* worldX, const float* worldZ, size_t count, float* outHeights, float* gradientX, float* gradientZ) const;
+
+    private:
+
+        const float* heights = nullptr;
+        int stride = 1;
+        int width = 0;
+        int height = 0;
+
+        // Texel coordinates: tx = texelX.x * worldX + texelX.y * worldZ + texelX.z, same for tz
+        glm::vec3 texelX = glm::vec3(0.0f);
+        glm::vec3 texelZ = glm::vec3(0.0f);
+
+        float heightScale = 1.0f;   // Y scale of the transform
+    };
+}
@@ -0,0 +1,163 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "HeightmapImage.hpp"
+#include "TerrainNoise.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+
+// A private copy of the stb_image bundled with SOIL2, for the 16-bit and single channel
+// loads SOIL2 does not expose. Static and without the SOIL2 extensions (DDS, PVR, PKM), so
+// it does not clash with the one inside SOIL2. Static leaves the functions this file does not
+// call unused, which GCC and Clang would warn about once each
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STB_IMAGE_STATIC
+#define STBI_NO_EXT
+#define STBI_NO_DDS
+#define STBI_NO_PVR
+#define STBI_NO_PKM
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_BMP
+#define STBI_ONLY_TGA
+#include <stb_image.h>
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace space
+{
+    namespace
+    {
+        std::string getExtension(const std::string& path)
+        {
+            size_t dot = path.find_last_of('.');
+            if (dot == std::string::npos) return std::string();
+
+            std::string extension = path.substr(dot + 1);
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+
+            return extension;
+        }
+    }
+
+    size_t HeightmapImage::getTexelBytes() const
+    {
+        switch (format)
+        {
+        case SampleFormat::R8: return 1;
+        case SampleFormat::R16: return 2;
+        case SampleFormat::R32F: return 4;
+        default: return 3;
+        }
+    }
+
+    bool HeightmapImage::load(const std::string& path)
+    {
+        close();
+
+        const std::string extension = getExtension(path);
+
+        if (extension == "r16") return loadRaw(path, SampleFormat::R16);
+        if (extension == "r32" || extension == "r32f") return loadRaw(path, SampleFormat::R32F);
+
+        int channels = 0;
+
+        if (!stbi_info(path.c_str(), &width, &height, &channels))
+        {
+            std::cerr << "Failed to read heightmap " << path << ": " << stbi_failure_reason() << std::endl;
+            close();
+            return false;
+        }
+
+        // Gray (and gray + alpha) images keep a single channel at their own depth
+        if (channels <= 2 && stbi_is_16_bit(path.c_str()))
+        {
+            format = SampleFormat::R16;
+            decoded = stbi_load_16(path.c_str(), &width, &height, &channels, 1);
+        }
+        else if (channels <= 2)
+        {
+            format = SampleFormat::R8;
+            decoded = stbi_load(path.c_str(), &width, &height, &channels, 1);
+        }
+        else
+        {
+            format = SampleFormat::RGB8;
+            decoded = stbi_load(path.c_str(), &width, &height, &channels, 3);
+        }
+
+        if (!decoded)
+        {
+            std::cerr << "Failed to decode heightmap " << path << ": " << stbi_failure_reason() << std::endl;
+            close();
+            return false;
+        }
+
+        pixels = static_cast<const unsigned char*>(decoded);
+
+        return true;
+    }
+
+    bool HeightmapImage::loadRaw(const std::string& path, SampleFormat rawFormat)
+    {
+        if (!file.open(path)) return false;
+
+        format = rawFormat;
+
+        const size_t samples = file.getSize() / getTexelBytes();
+        const int side = int(std::lround(std::sqrt(double(samples))));
+
+        if (side < 2 || size_t(side) * side * getTexelBytes() != file.getSize())
+        {
+            std::cerr << "Raw heightmap " << path << " is not a square of " << getTexelBytes() << " byte samples" << std::endl;
+            close();
+            return false;
+        }
+
+        width = height = side;
+        pixels = file.getData();
+
+        return true;
+    }
+
+    void HeightmapImage::generate(const TerrainNoise& noise, float originX, float originZ, float spacing, int width, int height, ThreadPool& pool)
+    {
+        close();
+
+        generated.resize(size_t(width) * height);
+        noise.generate(originX, originZ, spacing, width, height, generated.data(), pool);
+
+        this->width = width;
+        this->height = height;
+        format = SampleFormat::R32F;
+        pixels = reinterpret_cast<const unsigned char*>(generated.data());
+    }
+
+    void HeightmapImage::close()
+    {
+        if (decoded)
+        {
+            stbi_image_free(decoded);
+        }
+
+        file.close();
+
+        generated.clear();
+        generated.shrink_to_fit();
+
+        decoded = nullptr;
+        pixels = nullptr;
+        width = height = 0;
+        format = SampleFormat::RGB8;
+    }
+}
@@ -0,0 +1,93 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "MappedFile.hpp"
+#include "TerrainKernels.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace space
+{
+    class TerrainNoise;
+    class ThreadPool;
+
+    /**
+    * Heightmap texels in the narrowest format that keeps their precision.
+    *
+    * Images (PNG and whatever else stb_image reads) with one or two channels decode to a
+    * single 8 or 16-bit channel, alpha dropped, and only colour ones to RGB, so a 16-bit
+    * heightmap keeps its 65536 levels instead of being cut to 256 and terraced. Raw files
+    * are mapped and read in place, without any decode or copy:
+    *
+    *   .r16           little endian unsigned 16-bit samples
+    *   .r32 / .r32f   little endian 32-bit floats, 0 to 1
+    *
+    * Raw files have no header, so they must be square; the side follows from their size.
+    * Rows are top to bottom, as in the images. Procedural heightmaps are generated into R32F
+    * samples instead (generate()).
+    */
+    class HeightmapImage
+    {
+    public:
+
+        using SampleFormat = terrain_kernels::SampleFormat;
+
+        HeightmapImage() = default;
+        ~HeightmapImage() { close(); }
+
+        HeightmapImage(const HeightmapImage&) = delete;
+        HeightmapImage& operator = (const HeightmapImage&) = delete;
+
+        // Returns false (and reports why) if the file cannot be read
+        bool load(const std::string& path);
+
+        /**
+        * Replaces the image with width x height samples of noise, spacing plane units apart
+        * from (originX, originZ), row z at plane z = originZ + z * spacing.
+        */
+        void generate(const TerrainNoise& noise, float originX, float originZ, float spacing, int width, int height, ThreadPool& pool);
+
+        void close();
+
+        bool isLoaded() const { return pixels != nullptr; }
+
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+        SampleFormat getFormat() const { return format; }
+
+        // True when the texels are read straight from the file mapping
+        bool isMapped() const { return file.isOpen(); }
+
+        size_t getTexelBytes() const;
+
+        // Bytes of the texels, decoded or mapped
+        size_t getBytes() const { return size_t(width) * height * getTexelBytes(); }
+
+        const void* getRow(int z) const { return pixels + size_t(z) * width * getTexelBytes(); }
+
+        // Heights of row z in world units, see terrain_kernels::buildHeightRow
+        void buildHeightRow(int z, float heightScale, float* heights) const
+        {
+            terrain_kernels::buildHeightRow(getRow(z), format, width, heightScale, heights);
+        }
+
+    private:
+
+        const unsigned char* pixels = nullptr;
+        void* decoded = nullptr;                // stb_image allocation, null when mapped
+        std::vector<float> generated;           // Procedural samples
+        MappedFile file;
+
+        int width = 0;
+        int height = 0;
+        SampleFormat format = SampleFormat::RGB8;
+
+        bool loadRaw(const std::string& path, SampleFormat rawFormat);
+    };
+}
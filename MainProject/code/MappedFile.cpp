@@ -0,0 +1,127 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "MappedFile.hpp"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace space
+{
+#ifdef _WIN32
+
+    bool MappedFile::open(const std::string& path)
+    {
+        close();
+
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            std::cerr << "Failed to open " << path << " for mapping" << std::endl;
+            return false;
+        }
+
+        LARGE_INTEGER file_size;
+
+        if (!GetFileSizeEx(handle, &file_size) || file_size.QuadPart == 0)
+        {
+            std::cerr << "Cannot map empty file " << path << std::endl;
+            CloseHandle(handle);
+            return false;
+        }
+
+        HANDLE file_mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* view = file_mapping ? MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+        if (!view)
+        {
+            std::cerr << "Failed to map " << path << std::endl;
+
+            if (file_mapping) CloseHandle(file_mapping);
+            CloseHandle(handle);
+            return false;
+        }
+
+        file = handle;
+        mapping = file_mapping;
+        data = static_cast<const unsigned char*>(view);
+        size = size_t(file_size.QuadPart);
+
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file) CloseHandle(file);
+
+        data = nullptr;
+        size = 0;
+        mapping = nullptr;
+        file = nullptr;
+    }
+
+#else
+
+    bool MappedFile::open(const std::string& path)
+    {
+        close();
+
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+
+        if (descriptor < 0)
+        {
+            std::cerr << "Failed to open " << path << " for mapping" << std::endl;
+            return false;
+        }
+
+        struct stat status;
+
+        if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+        {
+            std::cerr << "Cannot map empty file " << path << std::endl;
+            ::close(descriptor);
+            return false;
+        }
+
+        void* view = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+
+        // The mapping keeps its own reference to the file
+        ::close(descriptor);
+
+        if (view == MAP_FAILED)
+        {
+            std::cerr << "Failed to map " << path << std::endl;
+            return false;
+        }
+
+        data = static_cast<const unsigned char*>(view);
+        size = size_t(status.st_size);
+
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (data) munmap(const_cast<unsigned char*>(data), size);
+
+        data = nullptr;
+        size = 0;
+    }
+
+#endif
+}
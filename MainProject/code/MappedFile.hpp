@@ -0,0 +1,47 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace space
+{
+    /**
+    * Read-only view of a whole file mapped into memory (mmap, or a file mapping on Windows).
+    *
+    * Nothing is read on open(): pages come in from disk the first time they are touched and
+    * the OS may drop them again under memory pressure, so big files can be consumed in place
+    * without a private copy. The data stays valid until close() or destruction.
+    */
+    class MappedFile
+    {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+
+#ifdef _WIN32
+        void* file = nullptr;
+        void* mapping = nullptr;
+#endif
+
+    public:
+
+        MappedFile() = default;
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator = (const MappedFile&) = delete;
+
+        // Maps the file, closing the previous one. Returns false (and reports why) on failure
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const { return data != nullptr; }
+
+        const unsigned char* getData() const { return data; }
+        size_t getSize() const { return size; }
+    };
+}
@@ -4,11 +4,140 @@
 */
 
 #include "Mesh.hpp"
+#include "CpuProfiler.hpp"
+#include "GLExtensions.hpp"
+
+#include <algorithm>
 
 namespace space
 {
-	void Mesh::setUpMesh()
+	namespace
+	{
+		// Restart markers become the largest value of the narrow type
+		template<typename Index>
+		void packIndicesAs(const std::vector<GLuint>& indices, unsigned char* data)
+		{
+			Index* narrow = reinterpret_cast<Index*>(data);
+
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				narrow[i] = indices[i] == Mesh::PRIMITIVE_RESTART ? Index(~Index(0)) : Index(indices[i]);
+			}
+		}
+
+		size_t indexSize(GLenum type)
+		{
+			return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+		}
+	}
+
+	GLenum Mesh::selectIndexType() const
+	{
+		GLuint largest = 0;
+
+		for (GLuint index : indices)
+		{
+			if (index != PRIMITIVE_RESTART) largest = std::max(largest, index);
+		}
+
+		// With restart the largest value of the type is taken by the marker
+		const GLuint reserved = primitive_type == GL_TRIANGLE_STRIP ? 1 : 0;
+
+		if (largest + reserved <= 0xFF) return GL_UNSIGNED_BYTE;
+		if (largest + reserved <= 0xFFFF) return GL_UNSIGNED_SHORT;
+
+		return GL_UNSIGNED_INT;
+	}
+
+	std::vector < unsigned char > Mesh::packIndices(GLenum type) const
+	{
+		std::vector < unsigned char > data(indices.size() * indexSize(type));
+
+		if (type == GL_UNSIGNED_BYTE)
+		{
+			packIndicesAs<GLubyte>(indices, data.data());
+		}
+		else if (type == GL_UNSIGNED_SHORT)
+		{
+			packIndicesAs<GLushort>(indices, data.data());
+		}
+		else
+		{
+			packIndicesAs<GLuint>(indices, data.data());
+		}
+
+		return data;
+	}
+
+	size_t Mesh::getIndexBufferBytes() const
+	{
+		return indices.size() * indexSize(selectIndexType());
+	}
+
+	void Mesh::drawIndexed(GLsizei instance_count) const
+	{
+		const bool restart = primitive_type == GL_TRIANGLE_STRIP;
+
+		if (restart)
+		{
+			// The fixed index is the largest value of the index type, the marker the upload wrote
+			if (glext::ES3_compatibility)
+			{
+				glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+			}
+			else
+			{
+				glEnable(GL_PRIMITIVE_RESTART);
+				glPrimitiveRestartIndex(GLuint(0xFFFFFFFFu >> (32 - 8 * indexSize(index_type))));
+			}
+		}
+
+		auto draw = [&](size_t first, GLsizei count, GLint base_vertex)
+		{
+			const void* offset = reinterpret_cast<const void*>(first * indexSize(index_type));
+
+			if (instance_count == 1)
+			{
+				glDrawElementsBaseVertex(primitive_type, count, index_type, offset, base_vertex);
+			}
+			else
+			{
+				glDrawElementsInstancedBaseVertex(primitive_type, count, index_type, offset, instance_count, base_vertex);
+			}
+		};
+
+		if (index_ranges.empty())
+		{
+			draw(0, static_cast<GLsizei>(indices.size()), 0);
+		}
+
+		for (const IndexRange& range : index_ranges)
+		{
+			draw(range.first, range.count, range.base_vertex);
+		}
+
+		if (restart)
+		{
+			glDisable(glext::ES3_compatibility ? GL_PRIMITIVE_RESTART_FIXED_INDEX : GL_PRIMITIVE_RESTART);
+		}
+	}
+
+	void Mesh::uploadVertexRange(size_t offset, const void* data, size_t bytes)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_ids[VERTICES_VBO]);
+		glBufferSubData(GL_ARRAY_BUFFER, GLintptr(offset), GLsizeiptr(bytes), data);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void Mesh::uploadMesh(const void* vertex_data, size_t vertex_bytes, GLsizei stride, const VertexAttribute* attributes, size_t attribute_count,
+		const void* index_data, size_t index_bytes, GLenum type)
 	{
+		SPACE_PROFILE_ZONE("Mesh::setUpMesh");
+
+		/**
+		* Uploading again replaces the previous buffers.
+		*/
+		cleanUp();
 
 		/**
 		* Generate IDs for the VAO and VBOs.
@@ -22,37 +151,26 @@ namespace space
 		glBindVertexArray(vao_id);
 
 		/**
-		* Vertices vbo
+		* Interleaved vertices vbo, one attribute pointer per layout attribute
 		*/
 		glBindBuffer(GL_ARRAY_BUFFER, vbo_ids[VERTICES_VBO]);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
-		
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+		glBufferData(GL_ARRAY_BUFFER, vertex_bytes, vertex_data, GL_STATIC_DRAW);
 
-		/**
-		glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), normals.data(), GL_STATIC_DRAW);
-		* Normals vbo
-		*/
-		glBindBuffer(GL_ARRAY_BUFFER, vbo_ids[NORMALS_VBO]);
-		
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+		for (size_t i = 0; i < attribute_count; ++i)
+		{
+			const VertexAttribute& attribute = attributes[i];
 
-		/**
-		* Colors vbo
-		*/
-		glBindBuffer(GL_ARRAY_BUFFER, vbo_ids[COLORS_VBO]);
-		glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data(), GL_STATIC_DRAW);
-		
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+			glEnableVertexAttribArray(attribute.location);
+			glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, stride, reinterpret_cast<const void*>(attribute.offset));
+		}
 
 		/**
-		* Indices ebo
+		* Indices ebo, with 8 or 16 bits per index when the indices allow it
 		*/
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_ids[INDICES_EBO]);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, index_data, GL_STATIC_DRAW);
+
+		index_type = type;
 
 		/**
 		* Unbind vao
@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include "Bounds.hpp"
+#include "VertexLayout.hpp"
+
 #include <glad/glad.h>
 #include <glm.hpp>
 #include <vector>
@@ -15,13 +18,50 @@ namespace space
 {
 	class Mesh
 	{
+	public:
+
+		/**
+		* Strip separator in indices. Uploaded as the largest value of the index type, which is
+		* the fixed restart index of GL_PRIMITIVE_RESTART_FIXED_INDEX.
+		*/
+		static constexpr GLuint PRIMITIVE_RESTART = 0xFFFFFFFF;
+
+		/**
+		* Part of the indices drawn with its own base vertex, so that the indices of a big mesh
+		* can stay relative to their chunk and fit 16 bits.
+		*/
+		struct IndexRange
+		{
+			size_t first;
+			GLsizei count;
+			GLint base_vertex;
+		};
+
+		/**
+		* A mesh in the layout setUpMesh() uploads: interleaved vertices, indices in their
+		* narrowest type, and what the shader has to undo.
+		*/
+		struct Buffers
+		{
+			std::vector < unsigned char > vertex_data;
+			std::vector < unsigned char > index_data;
+			GLenum index_type = GL_UNSIGNED_INT;
+			VertexDecode vertex_decode;
+			BoundingBox bounds;
+		};
+
+	private:
+
+		void uploadMesh(const void* vertex_data, size_t vertex_bytes, GLsizei stride, const VertexAttribute* attributes, size_t attribute_count,
+			const void* index_data, size_t index_bytes, GLenum type);
+
+		void uploadVertexRange(size_t offset, const void* data, size_t bytes);
+
 	protected:
 
 		enum
 		{
-			VERTICES_VBO,
-			NORMALS_VBO,
-			COLORS_VBO,
+			VERTICES_VBO,		///< Every attribute, interleaved as the mesh layout says
 			INDICES_EBO,
 			VBO_COUNT
 		};
@@ -29,11 +69,25 @@ namespace space
 		GLuint vbo_ids[VBO_COUNT];
 		GLuint vao_id;
 
+		GLenum index_type = GL_UNSIGNED_INT;	///< Narrowest type that fits every index, chosen on upload
+		GLenum primitive_type = GL_TRIANGLES;	///< GL_TRIANGLE_STRIP enables primitive restart
+		VertexDecode vertex_decode;				///< What the shader must undo for the uploaded layout
+		BoundingBox bounds;						///< Of the vertices, computed on upload
+
 		std::vector < glm::vec3 > vertices;
 		std::vector < glm::vec3 > normals;
 		std::vector < glm::vec3 > colors;
 		std::vector <GLuint> indices;
 
+		// Drawn one after the other; empty draws every index at base vertex 0
+		std::vector < IndexRange > index_ranges;
+
+		/**
+		* Draws every index range, instanced when instance_count is not 1, with primitive
+		* restart enabled for strips. The VAO must be bound.
+		*/
+		void drawIndexed(GLsizei instance_count = 1) const;
+
 	public:
 
 		/**
@@ -50,7 +104,103 @@ namespace space
 		*/
 		virtual void initialize() = 0;
 
-		void setUpMesh();
+		/**
+		* Uploads the mesh into one interleaved vertex buffer plus the index buffer. Layout picks
+		* the attributes and their format (see VertexLayout.hpp), so meshes that need fewer
+		* attributes than position, normal and colour can use a tighter vertex, and big ones
+		* a quantized one (QuantizedVertexLayout).
+		*/
+		template<typename Layout = StandardVertexLayout>
+		void setUpMesh()
+		{
+			Buffers buffers = packBuffers< Layout >();
+
+			bounds = buffers.bounds;
+			vertex_decode = buffers.vertex_decode;
+
+			uploadBuffers< Layout >(buffers.vertex_data.data(), buffers.vertex_data.size(), buffers.index_data.data(), buffers.index_data.size(), buffers.index_type);
+		}
+
+		// The CPU arrays in the format setUpMesh< Layout >() uploads, without touching GL
+		template<typename Layout = StandardVertexLayout>
+		Buffers packBuffers() const
+		{
+			Buffers buffers;
+			buffers.bounds = BoundingBox::fromPoints(vertices);
+
+			const glm::vec3 position_min = buffers.bounds.isEmpty() ? glm::vec3(0.0f) : buffers.bounds.min;
+			const glm::vec3 position_extent = buffers.bounds.isEmpty() ? glm::vec3(0.0f) : buffers.bounds.getExtent();
+
+			VertexSource source{ vertices, normals, colors, position_min, position_extent };
+
+			buffers.vertex_data = Layout::interleave(source, vertices.size());
+			buffers.vertex_decode = Layout::decode(source);
+			buffers.index_type = selectIndexType();
+			buffers.index_data = packIndices(buffers.index_type);
+
+			return buffers;
+		}
+
+		/**
+		* Uploads buffers already in Layout and the given index type, e.g. straight from a
+		* mapped file. The indices array is not used: meshes uploaded this way need index
+		* ranges to be drawn, and set the bounds and vertex decode themselves.
+		*/
+		template<typename Layout>
+		void uploadBuffers(const void* vertex_data, size_t vertex_bytes, const void* index_data, size_t index_bytes, GLenum type)
+		{
+			auto attributes = Layout::attributes();
+
+			uploadMesh(vertex_data, vertex_bytes, GLsizei(Layout::STRIDE), attributes.data(), attributes.size(), index_data, index_bytes, type);
+		}
+
+		/**
+		* Packs vertices [first, first + count) in Layout with the current vertex decode and
+		* writes them over their place in the uploaded vertex buffer, for edits that keep the
+		* vertex count. Positions outside the range the decode was made for are clamped to it
+		* by the quantized layouts: widen it (and re-upload every vertex) first.
+		*/
+		template<typename Layout>
+		void updateVertices(size_t first, size_t count)
+		{
+			if (vao_id == 0 || count == 0) return;
+
+			VertexSource source{ vertices, normals, colors, vertex_decode.position_offset, vertex_decode.position_scale };
+
+			std::vector < unsigned char > data(count * Layout::STRIDE);
+			Layout::interleave(source, first, count, data.data());
+
+			uploadVertexRange(first * Layout::STRIDE, data.data(), data.size());
+		}
+
+		// Indices as type, restart markers turned into its largest value
+		std::vector < unsigned char > packIndices(GLenum type) const;
+
+		const std::vector < glm::vec3 >& getVertices() const { return vertices; }
+		const std::vector < glm::vec3 >& getNormals() const { return normals; }
+		const std::vector < glm::vec3 >& getColors() const { return colors; }
+		const std::vector < GLuint >& getIndices() const { return indices; }
+
+		GLenum getIndexType() const { return index_type; }
+		GLenum getPrimitiveType() const { return primitive_type; }
+		const std::vector < IndexRange >& getIndexRanges() const { return index_ranges; }
+
+		/**
+		* Narrowest index type the upload picks: the largest index (relative to its range base
+		* vertex) must fit, and with strips must stay below the restart value.
+		*/
+		GLenum selectIndexType() const;
+
+		// Bytes the index buffer takes once uploaded
+		size_t getIndexBufferBytes() const;
+		const VertexDecode& getVertexDecode() const { return vertex_decode; }
+
+		/**
+		* Local space bounds of what render() draws, for culling. Meshes whose vertices are
+		* placed by the shader override it.
+		*/
+		virtual BoundingBox getBounds() const { return bounds; }
+		BoundingSphere getBoundingSphere() const { return BoundingSphere(getBounds()); }
 
 		virtual void render() 
 		{
@@ -61,7 +211,7 @@ namespace space
 			}
 
 			glBindVertexArray(vao_id);
-			glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, nullptr);
+			drawIndexed();
 			glBindVertexArray(0);
 
 			GLenum error = glGetError(); 
@@ -72,10 +222,18 @@ namespace space
 
 		}
 
+		/**
+		* Only releases GL objects that were created, so meshes that never reached setUpMesh()
+		* (e.g. built headless for benchmarking) can be destroyed without a GL context.
+		*/
 		void cleanUp()
 		{
+			if (vao_id == 0) return;
+
 			glDeleteVertexArrays(1, &vao_id);
 			glDeleteBuffers(VBO_COUNT, vbo_ids);
+
+			vao_id = 0;
 		}
 
 	};
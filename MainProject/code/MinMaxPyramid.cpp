@@ -0,0 +1,340 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "MinMaxPyramid.hpp"
+#include "CpuProfiler.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace space
+{
+    namespace
+    {
+        thread_local int last_visited_nodes = 0;
+
+        /**
+        * Clips [tMin, tMax] to the part of the ray inside the box. NaNs from a zero direction
+        * component on a slab border are ignored by fmin / fmax, which leaves that slab open.
+        */
+        bool clipToBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boxMin, const glm::vec3& boxMax, float& tMin, float& tMax)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                float t0 = (boxMin[axis] - origin[axis]) * inverseDirection[axis];
+                float t1 = (boxMax[axis] - origin[axis]) * inverseDirection[axis];
+
+                tMin = std::fmax(tMin, std::fmin(t0, t1));
+                tMax = std::fmin(tMax, std::fmax(t0, t1));
+            }
+
+            return tMin <= tMax;
+        }
+
+        /**
+        * Smallest s in [0, span] where A + B s + C s^2 = 0, the ray height minus the bilinear
+        * patch height along the ray, or -1. A <= 0 means the ray is already below at s = 0.
+        */
+        double solvePatch(double a, double b, double c, double span)
+        {
+            if (a <= 0.0) return 0.0;
+
+            double best = -1.0;
+
+            auto consider = [&](double s)
+            {
+                if (s >= 0.0 && s <= span && (best < 0.0 || s < best)) best = s;
+            };
+
+            if (std::abs(c) < 1e-12)
+            {
+                if (b < 0.0) consider(-a / b);
+                return best;
+            }
+
+            double discriminant = b * b - 4.0 * a * c;
+            if (discriminant < 0.0) return -1.0;
+
+            // Numerically stable roots
+            double q = -0.5 * (b + std::copysign(std::sqrt(discriminant), b));
+
+            consider(q / c);
+            if (q != 0.0) consider(a / q);
+
+            return best;
+        }
+    }
+
+    void MinMaxPyramid::build(const float* heightData, int heightStride, int heightWidth, int heightHeight, ThreadPool& pool)
+    {
+        SPACE_PROFILE_ZONE("MinMaxPyramid::build");
+
+        levels.clear();
+        heights = nullptr;
+
+        if (!heightData || heightWidth < 2 || heightHeight < 2) return;
+
+        heights = heightData;
+        stride = heightStride;
+        width = heightWidth;
+        height = heightHeight;
+
+        Level leaves;
+        leaves.nodesX = (width - 1 + LEAF_QUADS - 1) / LEAF_QUADS;
+        leaves.nodesZ = (height - 1 + LEAF_QUADS - 1) / LEAF_QUADS;
+        leaves.ranges.resize(size_t(leaves.nodesX) * leaves.nodesZ);
+        levels.push_back(std::move(leaves));
+
+        while (levels.back().nodesX > 1 || levels.back().nodesZ > 1)
+        {
+            Level parent;
+            parent.nodesX = (levels.back().nodesX + 1) / 2;
+            parent.nodesZ = (levels.back().nodesZ + 1) / 2;
+            parent.ranges.resize(size_t(parent.nodesX) * parent.nodesZ);
+            levels.push_back(std::move(parent));
+        }
+
+        // Leaf rows read disjoint texel rows, the coarser levels are small enough to stay serial
+        pool.parallelFor(0, levels[0].nodesZ, 16, [&](size_t firstRow, size_t lastRow)
+            {
+                for (size_t z = firstRow; z < lastRow; ++z)
+                {
+                    for (int x = 0; x < levels[0].nodesX; ++x)
+                    {
+                        computeLeaf(x, int(z));
+                    }
+                }
+            });
+
+        for (int level = 1; level < int(levels.size()); ++level)
+        {
+            computeParents(level, 0, 0, levels[level].nodesX - 1, levels[level].nodesZ - 1);
+        }
+    }
+
+    void MinMaxPyramid::update(int firstX, int firstZ, int lastX, int lastZ)
+    {
+        if (!isBuilt()) return;
+
+        // A texel belongs to the quads on both of its sides
+        int leafX0 = std::max(0, (firstX - 1) / LEAF_QUADS);
+        int leafZ0 = std::max(0, (firstZ - 1) / LEAF_QUADS);
+        int leafX1 = std::min(levels[0].nodesX - 1, lastX / LEAF_QUADS);
+        int leafZ1 = std::min(levels[0].nodesZ - 1, lastZ / LEAF_QUADS);
+
+        if (leafX0 > leafX1 || leafZ0 > leafZ1) return;
+
+        for (int z = leafZ0; z <= leafZ1; ++z)
+        {
+            for (int x = leafX0; x <= leafX1; ++x)
+            {
+                computeLeaf(x, z);
+            }
+        }
+
+        for (int level = 1; level < int(levels.size()); ++level)
+        {
+            leafX0 >>= 1;
+            leafZ0 >>= 1;
+            leafX1 >>= 1;
+            leafZ1 >>= 1;
+
+            computeParents(level, leafX0, leafZ0, leafX1, leafZ1);
+        }
+    }
+
+    size_t MinMaxPyramid::getByteSize() const
+    {
+        size_t bytes = 0;
+
+        for (const Level& level : levels)
+        {
+            bytes += level.ranges.size() * sizeof(glm::vec2);
+        }
+
+        return bytes;
+    }
+
+    int MinMaxPyramid::getLastVisitedNodes()
+    {
+        return last_visited_nodes;
+    }
+
+    void MinMaxPyramid::computeLeaf(int x, int z)
+    {
+        const int lastX = std::min((x + 1) * LEAF_QUADS, width - 1);
+        const int lastZ = std::min((z + 1) * LEAF_QUADS, height - 1);
+
+        glm::vec2 range(FLT_MAX, -FLT_MAX);
+
+        for (int texelZ = z * LEAF_QUADS; texelZ <= lastZ; ++texelZ)
+        {
+            for (int texelX = x * LEAF_QUADS; texelX <= lastX; ++texelX)
+            {
+                const float value = getTexel(texelX, texelZ);
+                range.x = std::min(range.x, value);
+                range.y = std::max(range.y, value);
+            }
+        }
+
+        levels[0].ranges[size_t(z) * levels[0].nodesX + x] = range;
+    }
+
+    void MinMaxPyramid::computeParents(int level, int firstX, int firstZ, int lastX, int lastZ)
+    {
+        const Level& child = levels[level - 1];
+        Level& parent = levels[level];
+
+        for (int z = firstZ; z <= lastZ; ++z)
+        {
+            for (int x = firstX; x <= lastX; ++x)
+            {
+                glm::vec2 range(FLT_MAX, -FLT_MAX);
+
+                for (int childZ = z * 2; childZ <= std::min(z * 2 + 1, child.nodesZ - 1); ++childZ)
+                {
+                    for (int childX = x * 2; childX <= std::min(x * 2 + 1, child.nodesX - 1); ++childX)
+                    {
+                        const glm::vec2& childRange = child.ranges[size_t(childZ) * child.nodesX + childX];
+                        range.x = std::min(range.x, childRange.x);
+                        range.y = std::max(range.y, childRange.y);
+                    }
+                }
+
+                parent.ranges[size_t(z) * parent.nodesX + x] = range;
+            }
+        }
+    }
+
+    bool MinMaxPyramid::intersect(const glm::vec3& origin, const glm::vec3& direction, float minT, float maxT, float& t) const
+    {
+        last_visited_nodes = 0;
+
+        if (!isBuilt() || minT > maxT) return false;
+
+        const glm::vec3 inverseDirection = 1.0f / direction;
+
+        struct Node
+        {
+            int level;
+            int x;
+            int z;
+        };
+
+        // At most three children of each level wait on the stack, plus the one being expanded
+        Node stack[64 * 4];
+        int top = 0;
+
+        stack[top++] = { int(levels.size()) - 1, 0, 0 };
+
+        // Children in the order the ray meets them: the near one along each axis first
+        const int flipX = direction.x < 0.0f ? 1 : 0;
+        const int flipZ = direction.z < 0.0f ? 1 : 0;
+
+        while (top > 0)
+        {
+            const Node node = stack[--top];
+            ++last_visited_nodes;
+
+            const int quads = LEAF_QUADS << node.level;
+            const glm::vec2& range = levels[node.level].ranges[size_t(node.z) * levels[node.level].nodesX + node.x];
+
+            const glm::vec3 boxMin(float(node.x * quads), range.x, float(node.z * quads));
+            const glm::vec3 boxMax(float(std::min((node.x + 1) * quads, width - 1)), range.y, float(std::min((node.z + 1) * quads, height - 1)));
+
+            // Below the box counts as a hit too: clip the box from the bottom of the world
+            float enter = minT;
+            float exit = maxT;
+
+            if (!clipToBox(origin, inverseDirection, glm::vec3(boxMin.x, -FLT_MAX, boxMin.z), boxMax, enter, exit)) continue;
+
+            if (node.level == 0)
+            {
+                if (intersectLeaf(node.x, node.z, origin, direction, enter, exit, t)) return true;
+                continue;
+            }
+
+            const Level& children = levels[node.level - 1];
+
+            // Pushed in reverse so the nearest child is popped first
+            for (int i = 3; i >= 0; --i)
+            {
+                const int childX = node.x * 2 + ((i & 1) ^ flipX);
+                const int childZ = node.z * 2 + (((i >> 1) & 1) ^ flipZ);
+
+                if (childX < children.nodesX && childZ < children.nodesZ)
+                {
+                    stack[top++] = { node.level - 1, childX, childZ };
+                }
+            }
+        }
+
+        return false;
+    }
+
+    bool MinMaxPyramid::intersectLeaf(int leafX, int leafZ, const glm::vec3& origin, const glm::vec3& direction, float minT, float maxT, float& t) const
+    {
+        const glm::vec3 inverseDirection = 1.0f / direction;
+
+        // Only the quads under the footprint of the ray between minT and maxT
+        const float x0 = origin.x + minT * direction.x;
+        const float x1 = origin.x + maxT * direction.x;
+        const float z0 = origin.z + minT * direction.z;
+        const float z1 = origin.z + maxT * direction.z;
+
+        const int firstX = std::max(leafX * LEAF_QUADS, int(std::floor(std::min(x0, x1))));
+        const int firstZ = std::max(leafZ * LEAF_QUADS, int(std::floor(std::min(z0, z1))));
+        const int lastX = std::min(std::min((leafX + 1) * LEAF_QUADS, width - 1), int(std::floor(std::max(x0, x1))) + 1);
+        const int lastZ = std::min(std::min((leafZ + 1) * LEAF_QUADS, height - 1), int(std::floor(std::max(z0, z1))) + 1);
+
+        float best = FLT_MAX;
+
+        for (int z = firstZ; z < lastZ; ++z)
+        {
+            for (int x = firstX; x < lastX; ++x)
+            {
+                const float h00 = getTexel(x, z);
+                const float h10 = getTexel(x + 1, z);
+                const float h01 = getTexel(x, z + 1);
+                const float h11 = getTexel(x + 1, z + 1);
+
+                float enter = minT;
+                float exit = std::min(maxT, best);
+
+                const float top = std::max(std::max(h00, h10), std::max(h01, h11));
+
+                if (!clipToBox(origin, inverseDirection, glm::vec3(float(x), -FLT_MAX, float(z)), glm::vec3(float(x + 1), top, float(z + 1)), enter, exit)) continue;
+
+                // Patch a + b u + c v + e u v, u and v from the quad corner, along the ray from enter
+                const double a = h00;
+                const double b = double(h10) - h00;
+                const double c = double(h01) - h00;
+                const double e = double(h00) - h10 - h01 + h11;
+
+                const double u = origin.x + double(enter) * direction.x - x;
+                const double v = origin.z + double(enter) * direction.z - z;
+                const double y = origin.y + double(enter) * direction.y;
+
+                const double constant = y - (a + b * u + c * v + e * u * v);
+                const double linear = direction.y - (b * direction.x + c * direction.z + e * (u * direction.z + v * direction.x));
+                const double quadratic = -e * direction.x * direction.z;
+
+                const double s = solvePatch(constant, linear, quadratic, double(exit) - enter);
+
+                if (s >= 0.0)
+                {
+                    best = std::min(best, float(enter + s));
+                }
+            }
+        }
+
+        if (best == FLT_MAX) return false;
+
+        t = best;
+        return true;
+    }
+}
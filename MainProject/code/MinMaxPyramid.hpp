@@ -0,0 +1,94 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <glm.hpp>
+
+#include <vector>
+
+namespace space
+{
+    class ThreadPool;
+
+    /**
+    * Minimum and maximum height pyramid (a min/max mipmap) over a heightfield, and ray
+    * intersection against its bilinear surface.
+    *
+    * The finest level keeps the height range of every block of LEAF_QUADS x LEAF_QUADS quads;
+    * each coarser level merges 2x2 nodes of the one below, up to a single root. A ray walks
+    * the tree front to back and only descends into the nodes whose box it crosses, so a query
+    * visits a number of nodes proportional to the levels the ray passes through instead of
+    * every quad under it. Inside a leaf, each quad the ray crosses is intersected exactly
+    * with the bilinear patch of its four texels, the surface HeightfieldSampler interpolates.
+    *
+    * Everything is in texel space: x and z in texels, y in height units. The heights are
+    * read in place, so the heightfield must outlive the pyramid.
+    */
+    class MinMaxPyramid
+    {
+    public:
+
+        static constexpr int LEAF_QUADS = 4;
+
+        /**
+        * heights has width x height texels, texel (x, z) at heights[(z * width + x) * stride].
+        * The finest level is built in row bands over pool.
+        */
+        void build(const float* heights, int stride, int width, int height, ThreadPool& pool);
+
+        /**
+        * Recomputes the ranges over the texels [firstX, lastX] x [firstZ, lastZ] (inclusive)
+        * after they changed, and the ranges of every node above them.
+        */
+        void update(int firstX, int firstZ, int lastX, int lastZ);
+
+        bool isBuilt() const { return heights != nullptr; }
+
+        int getLevelCount() const { return int(levels.size()); }
+
+        // Nodes per side of a level, 0 the finest
+        int getNodesX(int level) const { return levels[level].nodesX; }
+        int getNodesZ(int level) const { return levels[level].nodesZ; }
+
+        // Height range of a node, .x the minimum and .y the maximum
+        glm::vec2 getRange(int level, int x, int z) const { return levels[level].ranges[size_t(z) * levels[level].nodesX + x]; }
+
+        size_t getByteSize() const;
+
+        /**
+        * First point of origin + t * direction, t in [minT, maxT], on or below the surface.
+        * Returns false when the ray misses it. A ray that starts below the surface hits at
+        * its first t. The direction need not be normalized: t is in its units.
+        */
+        bool intersect(const glm::vec3& origin, const glm::vec3& direction, float minT, float maxT, float& t) const;
+
+        // Nodes the last intersect() on this thread tested, for statistics
+        static int getLastVisitedNodes();
+
+    private:
+
+        struct Level
+        {
+            int nodesX = 0;
+            int nodesZ = 0;
+            std::vector<glm::vec2> ranges;
+        };
+
+        const float* heights = nullptr;
+        int stride = 1;
+        int width = 0;
+        int height = 0;
+
+        std::vector<Level> levels;
+
+        float getTexel(int x, int z) const { return heights[(size_t(z) * width + x) * stride]; }
+
+        void computeLeaf(int x, int z);
+        void computeParents(int level, int firstX, int firstZ, int lastX, int lastZ);
+
+        bool intersectLeaf(int leafX, int leafZ, const glm::vec3& origin, const glm::vec3& direction, float minT, float maxT, float& t) const;
+    };
+}
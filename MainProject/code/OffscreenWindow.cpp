@@ -0,0 +1,171 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "OffscreenWindow.hpp"
+#include "GLExtensions.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <SOIL2.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace space
+{
+    OffscreenWindow::OffscreenWindow(unsigned width, unsigned height, const Window::OpenGL_Context_Settings& context_details)
+        : display(nullptr), opengl_context(nullptr), framebuffer_id(0), color_buffer_id(0), depth_buffer_id(0), width(width), height(height)
+    {
+        //Prefer the surfaceless platform, it needs neither a display server nor a GPU
+
+        EGLDisplay egl_display = EGL_NO_DISPLAY;
+
+        auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+        if (get_platform_display)
+        {
+            egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+
+        if (egl_display == EGL_NO_DISPLAY)
+        {
+            egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+
+        EGLint egl_major = 0, egl_minor = 0;
+
+        if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &egl_major, &egl_minor))
+        {
+            throw "Failed to initialize an EGL display. ";
+        }
+
+        display = egl_display;
+
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            throw "EGL display does not support desktop OpenGL. ";
+        }
+
+        //No surface will be created, so any config able to render OpenGL is fine
+
+        const EGLint config_attributes[] =
+        {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_SURFACE_TYPE, 0,
+            EGL_NONE
+        };
+
+        EGLConfig config = nullptr;
+        EGLint config_count = 0;
+        eglChooseConfig(egl_display, config_attributes, &config, 1, &config_count);
+
+        const EGLint context_attributes[] =
+        {
+            EGL_CONTEXT_MAJOR_VERSION, EGLint(context_details.version_major),
+            EGL_CONTEXT_MINOR_VERSION, EGLint(context_details.version_minor),
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, context_details.core_profile ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+            EGL_NONE
+        };
+
+        EGLContext egl_context = eglCreateContext(egl_display, config_count > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attributes);
+
+        if (egl_context == EGL_NO_CONTEXT)
+        {
+            throw "Failed to create the EGL OpenGL context. ";
+        }
+
+        opengl_context = egl_context;
+
+        if (!eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context))
+        {
+            throw "Failed to make the EGL context current. ";
+        }
+
+        //Initialize GLAD through EGL instead of the platform window system
+
+        if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)))
+        {
+            throw "Failed to load the OpenGL functions. ";
+        }
+
+        glext::load(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+
+        std::cout << "Offscreen renderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+
+        //Framebuffer that stands in for the window's default framebuffer
+
+        glGenRenderbuffers(1, &color_buffer_id);
+        glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_id);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, GLsizei(width), GLsizei(height));
+
+        glGenRenderbuffers(1, &depth_buffer_id);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_id);
+        glRenderbufferStorage(GL_RENDERBUFFER, context_details.stencil_buffer_size ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24, GLsizei(width), GLsizei(height));
+
+        glGenFramebuffers(1, &framebuffer_id);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_id);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, context_details.stencil_buffer_size ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_id);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            throw "Offscreen framebuffer is incomplete. ";
+        }
+
+        //Left bound for the whole lifetime, the scene renders to whatever framebuffer is bound
+
+        glViewport(0, 0, GLsizei(width), GLsizei(height));
+    }
+
+    OffscreenWindow::~OffscreenWindow()
+    {
+        if (opengl_context)
+        {
+            glDeleteFramebuffers(1, &framebuffer_id);
+            glDeleteRenderbuffers(1, &color_buffer_id);
+            glDeleteRenderbuffers(1, &depth_buffer_id);
+
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(display, opengl_context);
+        }
+
+        if (display)
+        {
+            eglTerminate(display);
+        }
+    }
+
+    void OffscreenWindow::swap_buffers()
+    {
+        glFlush();
+    }
+
+    bool OffscreenWindow::save_frame(const std::string& path) const
+    {
+        std::vector<unsigned char> pixels(size_t(width) * height * 4);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_id);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, GLsizei(width), GLsizei(height), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        //OpenGL rows start at the bottom, image files at the top
+
+        std::vector<unsigned char> flipped(pixels.size());
+        size_t row_size = size_t(width) * 4;
+
+        for (unsigned row = 0; row < height; ++row)
+        {
+            std::copy_n(pixels.begin() + row * row_size, row_size, flipped.begin() + (height - 1 - row) * row_size);
+        }
+
+        if (!SOIL_save_image(path.c_str(), SOIL_SAVE_TYPE_PNG, int(width), int(height), 4, flipped.data()))
+        {
+            std::cerr << "Failed to save frame to " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,54 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+
+#include "Window.hpp"
+
+namespace space
+{
+    /**
+    * Replacement for Window on hosts without a display or GPU (render/CI nodes).
+    * Creates an EGL surfaceless OpenGL context (Mesa llvmpipe is enough) and renders
+    * into a framebuffer object instead of a window's back buffer.
+    */
+    class OffscreenWindow
+    {
+    private:
+
+        void* display;                  //EGLDisplay, kept opaque so EGL headers stay out of the header
+        void* opengl_context;           //EGLContext
+
+        GLuint framebuffer_id;          //Framebuffer everything is rendered to
+        GLuint color_buffer_id;         //RGBA8 color renderbuffer
+        GLuint depth_buffer_id;         //Depth renderbuffer
+
+        unsigned width;
+        unsigned height;
+
+    public:
+
+        OffscreenWindow(unsigned width, unsigned height, const Window::OpenGL_Context_Settings& context_details);
+
+        ~OffscreenWindow();
+
+    public:
+
+        //Prevents copying, the window owns the EGL display connection and the GL objects
+        OffscreenWindow(const OffscreenWindow&) = delete;
+        OffscreenWindow& operator = (const OffscreenWindow&) = delete;
+
+    public:
+
+        //There is nothing to present, so this only flushes the submitted commands to the driver.
+        void swap_buffers();
+
+        //Reads back the color buffer and writes it as a PNG, for image regression tests.
+        bool save_frame(const std::string& path) const;
+    };
+}
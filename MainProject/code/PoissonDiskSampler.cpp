@@ -0,0 +1,324 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "PoissonDiskSampler.hpp"
+#include "CpuProfiler.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <ext/scalar_constants.hpp>
+
+namespace space
+{
+    namespace
+    {
+        // Smallest tile, in cells; larger radii make the tiles larger still
+        constexpr int MIN_TILE_SHIFT = 5;
+
+        // Counter streams: (i, tile, SEED_STREAM) for the starting points, (step, tile, STEP_STREAM) for Bridson's steps
+        constexpr uint32_t SEED_STREAM = 0;
+        constexpr uint32_t STEP_STREAM = 1;
+
+        // Candidates go this many radii from their active point, just past the radius
+        constexpr float RING_DISTANCE = 1.0001f;
+
+        struct Tile
+        {
+            std::vector<glm::vec2> points;
+            std::vector<float> radii;
+        };
+
+        /**
+        * A point of the background grid, copied into its cell so a test reads the neighbouring
+        * cells in rows and follows no index. Empty cells are infinitely far from everything.
+        */
+        struct Cell
+        {
+            float x;
+            float z;
+            float radius;
+        };
+
+        constexpr Cell EMPTY_CELL = { INFINITY, INFINITY, 0.0f };
+
+        /**
+        * The background grid and the tiles. Each tile writes only the cells inside it, so the
+        * tiles of a phase fill the grid at the same time.
+        */
+        struct Background
+        {
+            glm::vec2 minCorner;
+            glm::vec2 maxCorner;
+            float inverseCellSize;
+            float minRadius;
+            float maxRadius;
+            int cellsX;
+            int cellsZ;
+            int reach;          // Cells within maxRadius of a cell, on each side
+            int tileShift;
+            int tilesX;
+
+            std::vector<Cell> cells;
+            std::vector<Tile> tiles;
+
+            // True when no point is closer than max(radius, its own radius) to position
+            bool fits(const glm::vec2& position, float radius, int cellX, int cellZ) const
+            {
+                if (cells[size_t(cellZ) * cellsX + cellX].radius > 0.0f) return false;
+
+                const int firstX = std::max(cellX - reach, 0);
+                const int lastX = std::min(cellX + reach, cellsX - 1);
+                const int firstZ = std::max(cellZ - reach, 0);
+                const int lastZ = std::min(cellZ + reach, cellsZ - 1);
+
+                for (int z = firstZ; z <= lastZ; ++z)
+                {
+                    const Cell* row = &cells[size_t(z) * cellsX];
+
+                    for (int x = firstX; x <= lastX; ++x)
+                    {
+                        const float offsetX = row[x].x - position.x;
+                        const float offsetZ = row[x].z - position.y;
+                        const float limit = std::max(radius, row[x].radius);
+
+                        if (offsetX * offsetX + offsetZ * offsetZ < limit * limit) return false;
+                    }
+                }
+
+                return true;
+            }
+
+            /**
+            * Whether a candidate is inside the tile, whose cells past the border belong to
+            * tiles of other phases, and not too close to a point even at the smallest radius,
+            * worth evaluating the radius function for.
+            */
+            bool isCandidate(const glm::vec2& candidate, const glm::vec2& low, const glm::vec2& high, int lastCellX, int lastCellZ) const
+            {
+                if (candidate.x < low.x || candidate.x >= high.x || candidate.y < low.y || candidate.y >= high.y) return false;
+
+                const int cellX = std::min(int((candidate.x - minCorner.x) * inverseCellSize), lastCellX);
+                const int cellZ = std::min(int((candidate.y - minCorner.y) * inverseCellSize), lastCellZ);
+
+                return fits(candidate, minRadius, cellX, cellZ);
+            }
+
+            void fillTile(int tileX, int tileZ, const PoissonDiskSampler::RadiusFunction& radiusFunction, const CounterRandom& random)
+            {
+                const uint32_t tileIndex = uint32_t(tileZ * tilesX + tileX);
+                Tile& tile = tiles[tileIndex];
+
+                // Cells and area of the tile, clipped to the rectangle
+                const int tileCells = 1 << tileShift;
+                const int firstCellX = tileX * tileCells;
+                const int firstCellZ = tileZ * tileCells;
+                const int lastCellX = std::min(firstCellX + tileCells, cellsX) - 1;
+                const int lastCellZ = std::min(firstCellZ + tileCells, cellsZ) - 1;
+
+                const glm::vec2 low = minCorner + glm::vec2(float(firstCellX), float(firstCellZ)) / inverseCellSize;
+                const glm::vec2 high = glm::min(minCorner + glm::vec2(float(lastCellX + 1), float(lastCellZ + 1)) / inverseCellSize, maxCorner);
+
+                std::vector<uint32_t> active;
+
+                // Rotation by one candidate's share of the circle
+                const glm::vec2 ring(std::cos(2.0f * glm::pi<float>() / PoissonDiskSampler::CANDIDATES), std::sin(2.0f * glm::pi<float>() / PoissonDiskSampler::CANDIDATES));
+
+                float x[PoissonDiskSampler::MAX_BATCH];
+                float z[PoissonDiskSampler::MAX_BATCH];
+                float radius[PoissonDiskSampler::MAX_BATCH];
+
+                auto tryInsert = [&](const glm::vec2& position, float candidateRadius)
+                {
+                    if (!(candidateRadius > 0.0f)) return false;
+
+                    candidateRadius = std::min(std::max(candidateRadius, minRadius), maxRadius);
+
+                    // Clamped so that rounding never writes a cell of another tile
+                    const int cellX = std::min(std::max(int((position.x - minCorner.x) * inverseCellSize), firstCellX), lastCellX);
+                    const int cellZ = std::min(std::max(int((position.y - minCorner.y) * inverseCellSize), firstCellZ), lastCellZ);
+
+                    if (!fits(position, candidateRadius, cellX, cellZ)) return false;
+
+                    tile.points.push_back(position);
+                    tile.radii.push_back(candidateRadius);
+                    cells[size_t(cellZ) * cellsX + cellX] = Cell{ position.x, position.y, candidateRadius };
+                    active.push_back(uint32_t(tile.points.size() - 1));
+
+                    return true;
+                };
+
+                // Starting points spread over the tile, two per block
+                for (int i = 0; i < PoissonDiskSampler::SEEDS_PER_TILE; i += 2)
+                {
+                    const CounterRandom::Block bits = random.generate(uint32_t(i), tileIndex, SEED_STREAM);
+
+                    x[i] = CounterRandom::toRange(bits[0], low.x, high.x);
+                    z[i] = CounterRandom::toRange(bits[1], low.y, high.y);
+                    x[i + 1] = CounterRandom::toRange(bits[2], low.x, high.x);
+                    z[i + 1] = CounterRandom::toRange(bits[3], low.y, high.y);
+                }
+
+                radiusFunction(x, z, PoissonDiskSampler::SEEDS_PER_TILE, radius);
+
+                for (int i = 0; i < PoissonDiskSampler::SEEDS_PER_TILE; ++i)
+                {
+                    tryInsert(glm::vec2(x[i], z[i]), radius[i]);
+                }
+
+                // Bridson, candidates on a ring around a random active point, retired when none fits
+                for (uint32_t step = 0; !active.empty(); ++step)
+                {
+                    const CounterRandom::Block pick = random.generate(step, tileIndex, STEP_STREAM);
+                    const size_t slot = size_t((uint64_t(pick[0]) * active.size()) >> 32);
+
+                    const glm::vec2 center = tile.points[active[slot]];
+                    const float centerRadius = tile.radii[active[slot]];
+
+                    // Evenly spaced just past r from a random angle: packs tighter than random
+                    // candidates in the annulus [r, 2r], and costs one rotation each
+                    const float angle = CounterRandom::toRange(pick[1], 0.0f, 2.0f * glm::pi<float>());
+                    glm::vec2 direction(std::cos(angle), std::sin(angle));
+                    glm::vec2 directions[PoissonDiskSampler::CANDIDATES];
+
+                    int count = 0;
+
+                    for (int i = 0; i < PoissonDiskSampler::CANDIDATES; ++i)
+                    {
+                        direction = glm::vec2(direction.x * ring.x - direction.y * ring.y, direction.x * ring.y + direction.y * ring.x);
+
+                        const glm::vec2 candidate = center + direction * (centerRadius * RING_DISTANCE);
+
+                        if (!isCandidate(candidate, low, high, lastCellX, lastCellZ)) continue;
+
+                        x[count] = candidate.x;
+                        z[count] = candidate.y;
+                        directions[count] = direction;
+                        ++count;
+                    }
+
+                    if (count > 0) radiusFunction(x, z, size_t(count), radius);
+
+                    // Where the radius grows past the ring the candidate can only fit farther out: moved out to its radius and tried again
+                    int moved = 0;
+                    float movedX[PoissonDiskSampler::CANDIDATES];
+                    float movedZ[PoissonDiskSampler::CANDIDATES];
+                    float movedRadius[PoissonDiskSampler::CANDIDATES];
+
+                    bool accepted = false;
+
+                    for (int i = 0; i < count; ++i)
+                    {
+                        const float candidateRadius = std::min(radius[i], maxRadius);
+
+                        if (candidateRadius > centerRadius * RING_DISTANCE)
+                        {
+                            const glm::vec2 candidate = center + directions[i] * (candidateRadius * RING_DISTANCE);
+                            if (!isCandidate(candidate, low, high, lastCellX, lastCellZ)) continue;
+
+                            movedX[moved] = candidate.x;
+                            movedZ[moved] = candidate.y;
+                            ++moved;
+                            continue;
+                        }
+
+                        accepted |= tryInsert(glm::vec2(x[i], z[i]), radius[i]);
+                    }
+
+                    if (moved > 0)
+                    {
+                        radiusFunction(movedX, movedZ, size_t(moved), movedRadius);
+
+                        for (int i = 0; i < moved; ++i)
+                        {
+                            accepted |= tryInsert(glm::vec2(movedX[i], movedZ[i]), movedRadius[i]);
+                        }
+                    }
+
+                    if (!accepted)
+                    {
+                        active[slot] = active.back();
+                        active.pop_back();
+                    }
+                }
+            }
+        };
+    }
+
+    void PoissonDiskSampler::generate(const glm::vec2& minCorner, const glm::vec2& size, float minRadius, float maxRadius,
+        const RadiusFunction& radiusFunction, const CounterRandom& random, ThreadPool& pool)
+    {
+        SPACE_PROFILE_ZONE("PoissonDiskSampler::generate");
+
+        points.clear();
+        radii.clear();
+        tilesX = 0;
+        tilesZ = 0;
+        gridBytes = 0;
+
+        if (!(minRadius > 0.0f) || !(size.x > 0.0f) || !(size.y > 0.0f)) return;
+
+        Background background;
+        background.minCorner = minCorner;
+        background.maxCorner = minCorner + size;
+        background.minRadius = minRadius;
+        background.maxRadius = std::max(maxRadius, minRadius);
+
+        // A cell's diagonal is the smallest radius, so no two points share a cell
+        const float cellSize = minRadius / std::sqrt(2.0f);
+        background.inverseCellSize = 1.0f / cellSize;
+        background.cellsX = std::max(1, int(std::ceil(size.x / cellSize)));
+        background.cellsZ = std::max(1, int(std::ceil(size.y / cellSize)));
+        background.reach = int(std::ceil(background.maxRadius / cellSize));
+
+        // A tile spans at least the reach, so the tiles of one phase never read each other's cells
+        background.tileShift = MIN_TILE_SHIFT;
+        while ((1 << background.tileShift) < background.reach) ++background.tileShift;
+
+        const int tileCells = 1 << background.tileShift;
+        tilesX = (background.cellsX + tileCells - 1) / tileCells;
+        tilesZ = (background.cellsZ + tileCells - 1) / tileCells;
+        background.tilesX = tilesX;
+
+        background.cells.assign(size_t(background.cellsX) * background.cellsZ, EMPTY_CELL);
+        background.tiles.resize(size_t(tilesX) * tilesZ);
+        gridBytes = background.cells.size() * sizeof(Cell);
+
+        std::vector<glm::ivec2> phaseTiles;
+
+        for (int phase = 0; phase < 4; ++phase)
+        {
+            phaseTiles.clear();
+
+            for (int tileZ = phase >> 1; tileZ < tilesZ; tileZ += 2)
+            {
+                for (int tileX = phase & 1; tileX < tilesX; tileX += 2)
+                {
+                    phaseTiles.push_back(glm::ivec2(tileX, tileZ));
+                }
+            }
+
+            pool.parallelFor(0, phaseTiles.size(), 1, [&](size_t first, size_t last)
+                {
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        background.fillTile(phaseTiles[i].x, phaseTiles[i].y, radiusFunction, random);
+                    }
+                });
+        }
+
+        size_t total = 0;
+        for (const Tile& tile : background.tiles) total += tile.points.size();
+
+        points.reserve(total);
+        radii.reserve(total);
+
+        for (const Tile& tile : background.tiles)
+        {
+            points.insert(points.end(), tile.points.begin(), tile.points.end());
+            radii.insert(radii.end(), tile.radii.begin(), tile.radii.end());
+        }
+    }
+}
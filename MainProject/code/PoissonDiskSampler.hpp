@@ -0,0 +1,84 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "CounterRandom.hpp"
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace space
+{
+    class ThreadPool;
+
+    /**
+    * Poisson-disk (blue noise) points over a rectangle with a minimum distance that varies with
+    * position, by Bridson's algorithm run per tile in parallel.
+    *
+    * Two points p and q are never closer than max(r(p), r(q)), r given by a radius function
+    * that returns 0 where no point may go. Accepted points are stored in a background grid of
+    * cells of minRadius / sqrt(2), so a cell holds at most one point and a candidate is tested
+    * against the cells within maxRadius of it only.
+    *
+    * The rectangle is split into square tiles of at least maxRadius, processed in four phases
+    * of a 2x2 checkerboard: the tiles of one phase are a whole tile apart, so they run at the
+    * same time without seeing each other, and each one grows its points against those the
+    * earlier phases left on its borders. A tile only places points inside itself and draws its
+    * numbers from counters keyed by its index, so the points depend on the seed alone, not on
+    * the number of threads.
+    */
+    class PoissonDiskSampler
+    {
+    public:
+
+        /**
+        * Radius at count positions at once (at most MAX_BATCH), 0 where no point may go.
+        * Called from several threads, only at positions inside the rectangle.
+        */
+        using RadiusFunction = std::function<void(const float* x, const float* z, size_t count, float* radius)>;
+
+        // Candidates tried around an active point before it is retired
+        static constexpr int CANDIDATES = 16;
+
+        // Random starting points per tile, so that eligible islands inside a tile are found
+        static constexpr int SEEDS_PER_TILE = 128;
+
+        // Most positions the radius function gets in one call
+        static constexpr int MAX_BATCH = SEEDS_PER_TILE > CANDIDATES ? SEEDS_PER_TILE : CANDIDATES;
+
+        /**
+        * Fills the rectangle [minCorner, minCorner + size] with points whose radius, as
+        * radiusFunction returns it, is within [minRadius, maxRadius]: larger radii are clamped
+        * to maxRadius, smaller ones to minRadius. The previous points are discarded.
+        */
+        void generate(const glm::vec2& minCorner, const glm::vec2& size, float minRadius, float maxRadius,
+            const RadiusFunction& radiusFunction, const CounterRandom& random, ThreadPool& pool);
+
+        // In tile order, then in the order each tile accepted them
+        const std::vector<glm::vec2>& getPoints() const { return points; }
+
+        // Radius each point was accepted with
+        const std::vector<float>& getRadii() const { return radii; }
+
+        int getTilesX() const { return tilesX; }
+        int getTilesZ() const { return tilesZ; }
+
+        // Bytes of the background grid of the last generate()
+        size_t getGridByteSize() const { return gridBytes; }
+
+    private:
+
+        std::vector<glm::vec2> points;
+        std::vector<float> radii;
+
+        int tilesX = 0;
+        int tilesZ = 0;
+        size_t gridBytes = 0;
+    };
+}
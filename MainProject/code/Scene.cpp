@@ -8,6 +8,11 @@
 #include <iostream>
 #include <cassert>
 #include "HeightMapTerrain.hpp"
+#include "StreamedTerrain.hpp"
+#include "TerrainPyramid.hpp"
+#include "CpuProfiler.hpp"
+
+#include <cstdio>
 
 
 namespace space
@@ -16,6 +21,8 @@ namespace space
 	Scene::Scene(unsigned width, unsigned height)
 		: angle(0.0f)
 	{
+		SPACE_PROFILE_ZONE("Scene::Scene");
+
 		glEnable(GL_CULL_FACE);
 		glDisable(GL_DEPTH_TEST);
 		glClearColor(0.2f, 0.2f, 0.2f, 1.f);
@@ -50,6 +57,7 @@ namespace space
 		model_view_matrix_id = glGetUniformLocation(shader_program->getProgramID(), "model_view_matrix");
 		normal_matrix_id = glGetUniformLocation(shader_program->getProgramID(), "normal_matrix");
 		projection_matrix_id = glGetUniformLocation(shader_program->getProgramID(), "projection_matrix");
+		octahedral_normals_id = glGetUniformLocation(shader_program->getProgramID(), "octahedral_normals");
 
 		//Root node
 		root = std::make_shared<SceneNode>("root");
@@ -63,13 +71,49 @@ namespace space
 		auto terrainNode = std::make_shared<SceneNode>("main_terrain");
 		auto terrainMesh = std::make_shared<HeightMapTerrain>(
 			"../../../shared/assets/textures/heightmaps/heightmap_010.png",
-			1.0f  // height scale
+			1.0f,  // height scale
+			true,
+			nullptr,
+			HeightMapTerrain::RenderMode::CDLOD
 		);
 		terrainNode->mesh = terrainMesh;
 		terrainNode->position = glm::vec3(0, 15, 20);
 		terrainNode->scale = glm::vec3(1.0f);
 		root->addChild(terrainNode);
 
+		// Initialize the displacement terrain shader
+		terrain_shader = std::make_unique<ShaderProgram>();
+
+		VertexShader terrain_vertex_shader;
+		if (!terrain_vertex_shader.loadFromFile("../../../shared/assets/shaders/vertex/terrain_vertex_shader.glsl"))
+		{
+			throw std::runtime_error("Failed to load terrain vertex shader.");
+		}
+
+		FragmentShader terrain_fragment_shader;
+		if (!terrain_fragment_shader.loadFromFile("../../../shared/assets/shaders/fragment/fragment_shader.glsl"))
+		{
+			throw std::runtime_error("Failed to load terrain fragment shader.");
+		}
+
+		terrain_shader->attachShader(terrain_vertex_shader);
+		terrain_shader->attachShader(terrain_fragment_shader);
+
+		if (!terrain_shader->link())
+		{
+			throw std::runtime_error("Failed to link terrain shader program.");
+		}
+
+		terrain_shader->detachAndDeleteShaders({ terrain_vertex_shader, terrain_fragment_shader });
+
+		terrain_shader->use();
+		terrain_model_view_matrix_id = glGetUniformLocation(terrain_shader->getProgramID(), "model_view_matrix");
+		terrain_normal_matrix_id = glGetUniformLocation(terrain_shader->getProgramID(), "normal_matrix");
+		terrain_projection_matrix_id = glGetUniformLocation(terrain_shader->getProgramID(), "projection_matrix");
+		terrain_camera_position_id = glGetUniformLocation(terrain_shader->getProgramID(), "camera_position");
+
+		terrainMesh->setDisplacementUniforms(terrain_shader->getProgramID());
+
 		/*auto planeNode = std::make_shared<SceneNode>("plane");
 		planeNode->mesh = std::make_shared<Plane>(5, 5, 10.0f, 10.0f);
 		planeNode->position = glm::vec3(0, -2, 0);
@@ -110,6 +154,7 @@ namespace space
 		transparent_model_view_matrix_id = glGetUniformLocation(transparent_shader->getProgramID(), "model_view_matrix");
 		transparent_normal_matrix_id = glGetUniformLocation(transparent_shader->getProgramID(), "normal_matrix");
 		transparent_projection_matrix_id = glGetUniformLocation(transparent_shader->getProgramID(), "projection_matrix");
+		transparent_octahedral_normals_id = glGetUniformLocation(transparent_shader->getProgramID(), "octahedral_normals");
 		transparency_uniform_id = glGetUniformLocation(transparent_shader->getProgramID(), "transparency");
 
 		// Set default transparency
@@ -171,7 +216,8 @@ namespace space
 			grassMesh = terrainMesh->createGrassForTerrain(
 				terrainTransform,
 				"../../../shared/assets/models/SM_Grass.fbx",
-				500000
+				500000,
+				HeightMapTerrain::GrassDistribution::POISSON_DISK	// As even as 500000 uniform instances with about half of them
 			);
 
 			if (grassMesh)
@@ -252,6 +298,10 @@ namespace space
 		// Enable depth testing
 		glEnable(GL_DEPTH_TEST);
 
+		// GPU timer queries per render pass, reported every few seconds
+		gpuProfiler = std::make_unique<GpuProfiler>(std::vector<std::string>{ "skybox", "opaque", "grass", "transparent", "restore_state" });
+		gpuProfiler->setReportInterval(5.0f);
+
 		resize(width, height);
 
 		GLenum error = glGetError();
@@ -261,8 +311,70 @@ namespace space
 		}
 	}
 
+	void Scene::setGrassCulling(GrassCuller::Path path)
+	{
+		grassCuller.reset();
+
+		if (path == GrassCuller::Path::NONE || !grassMesh) return;
+
+		grassCuller = std::make_unique<GrassCuller>();
+
+		if (!grassCuller->initialize("../../../shared/assets/shaders/", path))
+		{
+			std::cerr << "GPU grass culling is not available, culling the grass cells on the CPU" << std::endl;
+			grassCuller.reset();
+		}
+	}
+
+	void Scene::addStreamedWorld(const std::string& pyramidPath, size_t memoryBudget)
+	{
+		SPACE_PROFILE_ZONE("Scene::addStreamedWorld");
+
+		// heightmap_001 to heightmap_010 in 5 columns, 512 quads and 20 units per heightmap
+		constexpr int WORLD_CELLS = 10;
+		constexpr int WORLD_COLUMNS = 5;
+		constexpr int CELL_QUADS = 512;
+		constexpr int TILE_QUADS = 64;
+
+		auto world = std::make_shared<StreamedTerrain>(pyramidPath, memoryBudget);
+
+		if (!world->isLoaded())
+		{
+			std::vector<std::string> cells;
+
+			for (int cell = 1; cell <= WORLD_CELLS; ++cell)
+			{
+				char path[96];
+				std::snprintf(path, sizeof(path), "../../../shared/assets/textures/heightmaps/heightmap_%03d.png", cell);
+				cells.push_back(path);
+			}
+
+			std::cout << "Building the streamed world pyramid " << pyramidPath << std::endl;
+
+			if (!TerrainPyramid::buildFromImages(cells, WORLD_COLUMNS, CELL_QUADS, 1.0f, TILE_QUADS, pyramidPath))
+			{
+				throw std::runtime_error("Failed to build the streamed world pyramid.");
+			}
+
+			world = std::make_shared<StreamedTerrain>(pyramidPath, memoryBudget);
+
+			if (!world->isLoaded())
+			{
+				throw std::runtime_error("Failed to load the streamed world pyramid.");
+			}
+		}
+
+		// Behind the main terrain
+		auto worldNode = std::make_shared<SceneNode>("streamed_world");
+		worldNode->mesh = world;
+		worldNode->position = glm::vec3(0, 0, -40);
+		root->addChild(worldNode);
+	}
+
 	void Scene::update(float deltaTime)
 	{
+		SPACE_PROFILE_ZONE("Scene::update");
+
 		//angle += 0.01f;
 
 		 // Update the cube's rotation angle
@@ -303,9 +415,14 @@ namespace space
 			glm::mat4 model_view_matrix = viewMatrix * model_matrix;
 			glm::mat4 normal_matrix = glm::transpose(glm::inverse(model_view_matrix));
 
+			// Quantized positions are decoded by the model view matrix, before the normal matrix is taken
+			const VertexDecode& decode = node->mesh->getVertexDecode();
+			model_view_matrix = model_view_matrix * decode.getPositionMatrix();
+
 			// Send matrices to shader
 			glUniformMatrix4fv(model_view_matrix_id, 1, GL_FALSE, glm::value_ptr(model_view_matrix));
 			glUniformMatrix4fv(normal_matrix_id, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+			glUniform1i(octahedral_normals_id, decode.octahedral_normals);
 
 			// Render the mesh
 			node->mesh->render();
@@ -320,6 +437,8 @@ namespace space
 
 	void Scene::render()
 	{
+		SPACE_PROFILE_ZONE("Scene::render");
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		if (!activeCamera) return;
@@ -328,8 +447,12 @@ namespace space
 		glm::mat4 view_matrix = activeCamera->getViewMatrix();
 		glm::mat4 projection_matrix = activeCamera->getProjectionMatrix();
 
+		gpuProfiler->beginFrame();
+
 		// ===== STEP 1: Render Skybox (special case - rendered first) =====
 		// The skybox is rendered with depth testing in a special way
+		gpuProfiler->beginPass(SKYBOX_PASS);
+
 		skybox_shader->use();
 
 		// Remove translation from the view matrix to keep skybox centered around camera
@@ -342,16 +465,49 @@ namespace space
 
 		// ===== STEP 2: Render All Opaque Objects =====
 		// This includes terrain and any non-transparent objects
+		gpuProfiler->beginPass(OPAQUE_PASS);
+
+		terrain_shader->use();
+		glUniformMatrix4fv(terrain_projection_matrix_id, 1, GL_FALSE, glm::value_ptr(projection_matrix));
+
 		shader_program->use();
 		glUniformMatrix4fv(projection_matrix_id, 1, GL_FALSE, glm::value_ptr(projection_matrix));
 
-		// Render all opaque objects in the scene graph
-		// We'll modify renderNode to skip transparent objects
-		renderOpaqueNodes(root, view_matrix);
+		// Render the opaque objects of the scene graph that reach into the view
+		cullOpaqueNodes(activeCamera->getFrustum());
+		renderOpaqueNodes(view_matrix, projection_matrix);
 
 		// Render grass (also opaque)
+		gpuProfiler->beginPass(GRASS_PASS);
+
 		if (grassMesh && grassMesh->getInstanceCount() > 0)
 		{
+			// The instances are in world space, like the camera frustum
+			const glm::vec3 camera_position = glm::vec3(glm::inverse(view_matrix)[3]);
+
+			if (grassCuller)
+			{
+				// The depth buffer holds the opaque geometry so far, the terrain that hides the grass behind it
+				grassCuller->buildDepthPyramid(int(viewport_width), int(viewport_height));
+				grassCuller->cull(*grassMesh, projection_matrix * view_matrix, camera_position);
+
+				cullingStats.grassCellsSubmitted = grassMesh->getVisibleCellCount();
+				cullingStats.grassCellsCulled = grassMesh->getCells().size() - grassMesh->getVisibleCellCount();
+				cullingStats.grassInstancesSubmitted = grassCuller->getVisibleInstanceCount();
+				cullingStats.grassDraws = 1;
+				cullingStats.grassCulledOnGpu = true;
+			}
+			else
+			{
+				grassMesh->cull(activeCamera->getFrustum(), camera_position);
+
+				cullingStats.grassCellsSubmitted = grassMesh->getVisibleCellCount();
+				cullingStats.grassCellsCulled = grassMesh->getCells().size() - grassMesh->getVisibleCellCount();
+				cullingStats.grassInstancesSubmitted = grassMesh->getVisibleInstanceCount();
+				cullingStats.grassDraws = grassMesh->getDrawRanges().size();
+				cullingStats.grassCulledOnGpu = false;
+			}
+
 			grass_shader->use();
 
 			glm::mat4 model_matrix = glm::mat4(1.0f);
@@ -362,11 +518,20 @@ namespace space
 			glUniformMatrix4fv(grass_normal_matrix_id, 1, GL_FALSE, glm::value_ptr(normal_matrix));
 			glUniformMatrix4fv(grass_projection_matrix_id, 1, GL_FALSE, glm::value_ptr(projection_matrix));
 
-			grassMesh->render();
+			if (grassCuller)
+			{
+				grassCuller->render(*grassMesh);
+			}
+			else
+			{
+				grassMesh->render();
+			}
 		}
 
 		// ===== STEP 3: Set up for Transparency Rendering =====
 		// Enable blending for transparency
+		gpuProfiler->beginPass(TRANSPARENT_PASS);
+
 		glEnable(GL_BLEND);
 		// This is the standard transparency blending function
 		// It means: final_color = source_color * source_alpha + dest_color * (1 - source_alpha)
@@ -386,9 +551,13 @@ namespace space
 			glm::mat4 model_view_matrix = view_matrix * model_matrix;
 			glm::mat4 normal_matrix = glm::transpose(glm::inverse(model_view_matrix));
 
+			const VertexDecode& decode = transparentCubeNode->mesh->getVertexDecode();
+			model_view_matrix = model_view_matrix * decode.getPositionMatrix();
+
 			// Send matrices to shader
 			glUniformMatrix4fv(transparent_model_view_matrix_id, 1, GL_FALSE, glm::value_ptr(model_view_matrix));
 			glUniformMatrix4fv(transparent_normal_matrix_id, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+			glUniform1i(transparent_octahedral_normals_id, decode.octahedral_normals);
 
 			// Render the transparent cube
 			transparentCubeNode->mesh->render();
@@ -396,10 +565,15 @@ namespace space
 
 		// ===== STEP 5: Restore OpenGL State =====
 		// Re-enable depth writing for next frame
+		gpuProfiler->beginPass(RESTORE_STATE_PASS);
+
 		glDepthMask(GL_TRUE);
 		// Disable blending
 		glDisable(GL_BLEND);
 
+		gpuProfiler->endPass();
+		gpuProfiler->endFrame();
+
 		// Check for any OpenGL errors
 		GLenum error = glGetError();
 		if (error != GL_NO_ERROR)
@@ -408,8 +582,8 @@ namespace space
 		}
 	}
 
-	// Helper method to render only opaque nodes
-	void Scene::renderOpaqueNodes(const std::shared_ptr<SceneNode>& node, const glm::mat4& viewMatrix)
+	// World transforms and bounds of the opaque nodes, parents before children
+	void Scene::gatherOpaqueNodes(const std::shared_ptr<SceneNode>& node, const glm::mat4& parentTransform)
 	{
 		// Skip transparent objects during opaque pass
 		if (node->name == "transparent_cube") {
@@ -417,35 +591,127 @@ namespace space
 			return;
 		}
 
+		glm::mat4 world_transform = parentTransform * node->getLocalTransform();
+
 		if (node->mesh)
 		{
-			shader_program->use();
+			node->worldBounds = node->mesh->getBounds().transformed(world_transform);
 
-			// Calculate matrices
-			glm::mat4 model_matrix = node->getWorldTransform();
-			glm::mat4 model_view_matrix = viewMatrix * model_matrix;
-			glm::mat4 normal_matrix = glm::transpose(glm::inverse(model_view_matrix));
+			opaqueNodes.push_back(node.get());
+			opaqueTransforms.push_back(world_transform);
+		}
 
-			// Send matrices to shader
-			glUniformMatrix4fv(model_view_matrix_id, 1, GL_FALSE, glm::value_ptr(model_view_matrix));
-			glUniformMatrix4fv(normal_matrix_id, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+		for (const auto& child : node->children) {
+			gatherOpaqueNodes(child, world_transform);
+		}
+	}
 
-			// Render the mesh
-			node->mesh->render();
+	void Scene::cullOpaqueNodes(const Frustum& frustum)
+	{
+		SPACE_PROFILE_ZONE("Scene culling");
+
+		opaqueNodes.clear();
+		opaqueTransforms.clear();
+
+		gatherOpaqueNodes(root, glm::mat4(1.0f));
+
+		opaqueCuller.clear();
+		opaqueCuller.reserve(opaqueNodes.size());
+
+		for (SceneNode* node : opaqueNodes)
+		{
+			opaqueCuller.add(BoundingSphere(node->worldBounds));
 		}
 
-		// Recursively render children
-		for (const auto& child : node->children) {
-			renderOpaqueNodes(child, viewMatrix);
+		size_t visible = opaqueCuller.cull(frustum, opaqueVisibility);
+
+		cullingStats = CullingStats();
+		cullingStats.nodesSubmitted = visible;
+		cullingStats.nodesCulled = opaqueNodes.size() - visible;
+	}
+
+	// Draws the nodes cullOpaqueNodes() kept
+	void Scene::renderOpaqueNodes(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+	{
+		for (size_t i = 0; i < opaqueNodes.size(); ++i)
+		{
+			if (!opaqueVisibility[i]) continue;
+
+			SceneNode* node = opaqueNodes[i];
+			const glm::mat4& model_matrix = opaqueTransforms[i];
+
+			auto terrain = std::dynamic_pointer_cast<HeightMapTerrain>(node->mesh);
+
+			if (terrain && terrain->getRenderMode() != HeightMapTerrain::RenderMode::MESH)
+			{
+				renderTerrain(*terrain, model_matrix, viewMatrix, projectionMatrix);
+			}
+			else
+			{
+				shader_program->use();
+
+				glm::mat4 model_view_matrix = viewMatrix * model_matrix;
+				glm::mat4 normal_matrix = glm::transpose(glm::inverse(model_view_matrix));
+
+				// Streamed terrains pick and request their tiles for the camera first
+				if (auto streamed = std::dynamic_pointer_cast<StreamedTerrain>(node->mesh))
+				{
+					glm::vec3 local_camera = glm::vec3(glm::inverse(model_view_matrix) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+					Frustum local_frustum(projectionMatrix * model_view_matrix);
+
+					streamed->update(local_camera, &local_frustum);
+
+					cullingStats.streamedTilesSubmitted += streamed->getStats().drawnTiles;
+					cullingStats.streamedTilesCulled += streamed->getStats().culledTiles;
+				}
+
+				// Quantized positions are decoded by the model view matrix, before the normal matrix is taken
+				const VertexDecode& decode = node->mesh->getVertexDecode();
+				model_view_matrix = model_view_matrix * decode.getPositionMatrix();
+
+				// Send matrices to shader
+				glUniformMatrix4fv(model_view_matrix_id, 1, GL_FALSE, glm::value_ptr(model_view_matrix));
+				glUniformMatrix4fv(normal_matrix_id, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+				glUniform1i(octahedral_normals_id, decode.octahedral_normals);
+
+				// Render the mesh
+				node->mesh->render();
+			}
 		}
 	}
 
+	// Heightfield terrains build their vertices in terrain_vertex_shader.glsl
+	void Scene::renderTerrain(HeightMapTerrain& terrain, const glm::mat4& modelMatrix, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+	{
+		terrain_shader->use();
+
+		glm::mat4 model_view_matrix = viewMatrix * modelMatrix;
+		glm::mat4 normal_matrix = glm::transpose(glm::inverse(model_view_matrix));
+
+		// LOD selection, culling and morph work in the terrain local space
+		glm::vec3 local_camera = glm::vec3(glm::inverse(model_view_matrix) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		Frustum local_frustum(projectionMatrix * model_view_matrix);
+
+		terrain.updateLod(local_camera, float(viewport_height), glm::radians(activeCamera->fov), &local_frustum);
+
+		cullingStats.terrainPatchesSubmitted += terrain.getPatchCount();
+		cullingStats.terrainNodesCulled += terrain.getCulledLodNodeCount();
+
+		glUniformMatrix4fv(terrain_model_view_matrix_id, 1, GL_FALSE, glm::value_ptr(model_view_matrix));
+		glUniformMatrix4fv(terrain_normal_matrix_id, 1, GL_FALSE, glm::value_ptr(normal_matrix));
+		glUniform3fv(terrain_camera_position_id, 1, glm::value_ptr(local_camera));
+
+		terrain.render();
+	}
+
 	void Scene::resize(unsigned width, unsigned height)
 	{
 		if (activeCamera) {
 			activeCamera->aspect = float(width) / height;
 		}
 		glViewport(0, 0, width, height);
+		viewport_width = width;
+		viewport_height = height;
 
 		GLenum error = glGetError(); 
 
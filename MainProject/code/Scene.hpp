@@ -26,13 +26,48 @@
 #include "Camera.hpp"
 #include "Skybox.hpp"
 #include "GrassMesh.hpp"
+#include "GrassCuller.hpp"
 #include "Cube.hpp"
+#include "GpuProfiler.hpp"
+#include "Frustum.hpp"
 
 namespace space
 {
+    class HeightMapTerrain;
+    class StreamedTerrain;
 
     class Scene
     {
+    public:
+
+        // Passes of render(), in submission order, as reported by the GPU profiler
+        enum RenderPass
+        {
+            SKYBOX_PASS,
+            OPAQUE_PASS,
+            GRASS_PASS,
+            TRANSPARENT_PASS,
+            RESTORE_STATE_PASS,
+            RENDER_PASS_COUNT
+        };
+
+        // What the frustum culling of the last frame kept and dropped
+        struct CullingStats
+        {
+            size_t nodesSubmitted = 0;
+            size_t nodesCulled = 0;
+            size_t terrainPatchesSubmitted = 0;
+            size_t terrainNodesCulled = 0;      // Quadtree nodes and quadrants, see TerrainQuadtree::select()
+            size_t streamedTilesSubmitted = 0;
+            size_t streamedTilesCulled = 0;
+            size_t grassCellsSubmitted = 0;
+            size_t grassCellsCulled = 0;
+            size_t grassInstancesSubmitted = 0;
+            size_t grassDraws = 0;              // Runs of neighbouring cells, see GrassMesh::cull()
+            bool grassCulledOnGpu = false;      // Per instance by a GrassCuller, no cells involved
+        };
+
+    private:
 
         std::unique_ptr<ShaderProgram> shader_program;
         std::shared_ptr<SceneNode> root;
@@ -46,6 +81,7 @@ namespace space
         GLuint model_view_matrix_id = -1;
         GLuint projection_matrix_id = -1;
         GLint normal_matrix_id = -1;
+        GLint octahedral_normals_id = -1;
 
         std::unique_ptr<ShaderProgram> skybox_shader;
         std::shared_ptr<Skybox> skybox;
@@ -53,6 +89,15 @@ namespace space
         GLuint skybox_projection_matrix_id = -1;
 
         float angle;
+        unsigned viewport_width = 1;
+        unsigned viewport_height = 1;
+
+        // Heightfield terrain (HeightMapTerrain::RenderMode::DISPLACEMENT)
+        std::unique_ptr<ShaderProgram> terrain_shader;
+        GLuint terrain_model_view_matrix_id = -1;
+        GLuint terrain_projection_matrix_id = -1;
+        GLint terrain_normal_matrix_id = -1;
+        GLint terrain_camera_position_id = -1;
 
         // Grass system
         std::shared_ptr<GrassMesh> grassMesh;
@@ -60,6 +105,7 @@ namespace space
         GLuint grass_model_view_matrix_id = -1;
         GLuint grass_projection_matrix_id = -1;
         GLint grass_normal_matrix_id = -1;
+        std::unique_ptr<GrassCuller> grassCuller;      // Null: the cells are culled on the CPU
 
         //Transparent objects
         std::shared_ptr<SceneNode> transparentCubeNode;
@@ -67,21 +113,49 @@ namespace space
         GLuint transparent_model_view_matrix_id = -1;
         GLuint transparent_projection_matrix_id = -1;
         GLint transparent_normal_matrix_id = -1;
+        GLint transparent_octahedral_normals_id = -1;
         GLint transparency_uniform_id = -1;
 
         // Rotation control for the transparent cube
         float cubeRotationSpeed = 1.0f;  // Radians per second
         float cubeRotationAngle = 0.0f;  // Current rotation angle
 
+        // Per-pass GPU timings
+        std::unique_ptr<GpuProfiler> gpuProfiler;
+
+        // Opaque nodes with a mesh, gathered every frame with their world transforms, and
+        // their bounding spheres for the batched frustum test
+        std::vector<SceneNode*> opaqueNodes;
+        std::vector<glm::mat4> opaqueTransforms;
+        std::vector<unsigned char> opaqueVisibility;
+        FrustumCuller opaqueCuller;
+        CullingStats cullingStats;
 
 
     public:
         
         Scene(unsigned width, unsigned height);
 
+        /**
+        * Adds the bundled heightmaps, stitched into a grid, as a StreamedTerrain read from the
+        * pyramid at pyramidPath, which is built first if it does not load. memoryBudget is the
+        * byte budget of the resident tiles.
+        */
+        void addStreamedWorld(const std::string& pyramidPath, size_t memoryBudget);
+
+        /**
+        * Culls the grass per instance on the GPU through a GrassCuller of path, or per cell on
+        * the CPU with NONE, which is also what a path the context cannot build falls back to.
+        */
+        void setGrassCulling(GrassCuller::Path path);
+        GrassCuller::Path getGrassCulling() const { return grassCuller ? grassCuller->getPath() : GrassCuller::Path::NONE; }
+
         void update(float deltaTime);
         void render();
-        void renderOpaqueNodes(const std::shared_ptr<SceneNode>& node, const glm::mat4& viewMatrix);
+        void gatherOpaqueNodes(const std::shared_ptr<SceneNode>& node, const glm::mat4& parentTransform);
+        void cullOpaqueNodes(const Frustum& frustum);
+        void renderOpaqueNodes(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+        void renderTerrain(HeightMapTerrain& terrain, const glm::mat4& modelMatrix, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
         void resize(unsigned width, unsigned height);
         void renderNode(const std::shared_ptr<SceneNode>& node, const glm::mat4& viewMatrix);
         std::shared_ptr<SceneNode> createNode(const std::string& name, std::shared_ptr<SceneNode> parent = nullptr);
@@ -93,6 +167,9 @@ namespace space
 
         void updateTransparencyAnimation(float deltaTime);
 
+        const GpuProfiler& getGpuProfiler() const { return *gpuProfiler; }
+        const CullingStats& getCullingStats() const { return cullingStats; }
+
         void setTransparency(float alpha) {
             if (transparent_shader && transparency_uniform_id != -1) {
                 transparent_shader->use();
@@ -14,6 +14,8 @@
 #include <string>
 #include <vector>
 
+#include "Bounds.hpp"
+
 namespace space
 {
 
@@ -32,6 +34,9 @@ namespace space
 
         std::shared_ptr<Mesh> mesh;
 
+        // Mesh bounds in world space, refreshed by the scene every frame before culling
+        BoundingBox worldBounds;
+
         SceneNode(const std::string& nodeName = "node") : name(nodeName){}
 
         void addChild(std::shared_ptr<SceneNode> child)
@@ -4,6 +4,7 @@
 */
 
 #include"Shader.hpp"
+#include "CpuProfiler.hpp"
 #include <string>
 #include <iostream>
 #include <fstream>
@@ -12,24 +13,53 @@
 
 namespace space
 {
-	bool Shader::loadFromFile(const std::string& file_path)
+	namespace
 	{
-		std::fstream file(file_path);
-		if (!file.is_open())
+		bool readFile(const std::string& file_path, std::string& source)
 		{
-			std::cerr << "Failed to open shader file: " << file_path << std::endl; 
-			return false;
+			std::fstream file(file_path);
+			if (!file.is_open())
+			{
+				std::cerr << "Failed to open shader file: " << file_path << std::endl; 
+				return false;
+			}
+
+			std::stringstream buffer;
+			buffer << file.rdbuf();
+			file.close();
+
+			source += buffer.str();
+			return true;
 		}
+	}
+
+	bool Shader::loadFromFile(const std::string& file_path)
+	{
+		std::string source;
+		if (!readFile(file_path, source)) return false;
 
-		std::stringstream buffer;
-		buffer << file.rdbuf();
-		file.close();
+		return compile(source);
+	}
+
+	bool Shader::loadFromFiles(const std::string& preamble, const std::vector<std::string>& file_paths)
+	{
+		std::string source = preamble;
+
+		for (const std::string& file_path : file_paths)
+		{
+			if (!readFile(file_path, source)) return false;
+
+			// In case the file does not end with a line break
+			source += '\n';
+		}
 
-		return compile(buffer.str());
+		return compile(source);
 	}
 
 	bool Shader::compile(const std::string& source)
 	{
+		SPACE_PROFILE_ZONE("Shader::compile");
+
 		shader_id = glCreateShader(shader_type);
 		const char* source_cstr[]{ source.c_str() };	///< Transform to c_str because openGL is written in C not C++
 		const GLint source_size[]{ GLint(source.size()) };
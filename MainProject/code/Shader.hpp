@@ -6,6 +6,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <glad/glad.h>
 
 #include "Plane.hpp"
@@ -33,6 +34,12 @@ namespace space
 
 		bool loadFromFile(const std::string& file_path);
 
+		/**
+		* Compiles preamble (the #version line) followed by the files in order, so that
+		* shaders can share the functions of a file that has no #version of its own.
+		*/
+		bool loadFromFiles(const std::string& preamble, const std::vector<std::string>& file_paths);
+
 		bool loadFromString(const std::string& source)
 		{
 			return compile(source);
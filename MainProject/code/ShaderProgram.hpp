@@ -11,6 +11,7 @@
 #include <string>
 
 #include "Shader.hpp"
+#include "CpuProfiler.hpp"
 
 namespace space
 {
@@ -37,8 +38,19 @@ namespace space
 			glAttachShader(program_id, shader.getShaderID());
 		}
 
+		/**
+		* Outputs captured by transform feedback, in buffer order; takes effect on the next
+		* link(). GL_INTERLEAVED_ATTRIBS writes them one vertex after another to one buffer.
+		*/
+		void setTransformFeedbackVaryings(const std::vector<const char*>& varyings, GLenum buffer_mode) const
+		{
+			glTransformFeedbackVaryings(program_id, GLsizei(varyings.size()), varyings.data(), buffer_mode);
+		}
+
 		bool link() const
 		{
+			SPACE_PROFILE_ZONE("ShaderProgram::link");
+
 			glLinkProgram(program_id);
 
 			/**
@@ -4,6 +4,7 @@
 */
 
 #include "Skybox.hpp"
+#include "CpuProfiler.hpp"
 #include <SOIL2.h>
 #include <iostream>
 
@@ -11,6 +12,8 @@ namespace space
 {
     Skybox::Skybox(const std::vector<std::string>& facePaths)
     {
+        SPACE_PROFILE_ZONE("Skybox::Skybox");
+
         // Generate and bind cubemap texture
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
@@ -113,15 +116,13 @@ namespace space
                 skyboxVertices[i * 3 + 2]
             ));
 
-            // Since we're using the position as texture coordinates in the shader,
-            // we don't need specific texture coords. Add placeholder normals and colors.
-            normals.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
-            colors.push_back(glm::vec3(1.0f, 1.0f, 1.0f));
+            // The position doubles as the cubemap direction in the shader, so it is
+            // the only attribute the skybox needs
             indices.push_back(i);
         }
 
-        // Set up mesh buffers
-        setUpMesh();
+        // Set up mesh buffers, positions only
+        setUpMesh< VertexLayout< vertex::Position > >();
     }
 
     void Skybox::render()
@@ -0,0 +1,515 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "StreamedTerrain.hpp"
+#include "TerrainKernels.hpp"
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace space
+{
+    namespace
+    {
+        // 20 bytes per vertex; tiles stay small, so positions need no quantization
+        using TileLayout = VertexLayout< vertex::Position, vertex::OctahedralNormal, vertex::ColorRgba8 >;
+
+        float distanceToBox(const BoundingBox& box, const glm::vec3& point)
+        {
+            return glm::length(glm::clamp(point, box.min, box.max) - point);
+        }
+    }
+
+    void StreamedTerrain::Tile::build(const TerrainPyramid& pyramid, int x, int z, bool forGpu)
+    {
+        SPACE_PROFILE_ZONE("Terrain tile build");
+
+        const int quads = pyramid.getTileQuads();
+        const int samples = quads + 1;
+        const size_t gridVertices = size_t(samples) * samples;
+        const uint16_t* heights = pyramid.getTileSamples(level, x, z);
+        const glm::vec2 origin = pyramid.getOrigin();
+        const float spacing = pyramid.getSpacing();
+
+        // Sample coordinates; past the heightfield edge they repeat and the quads collapse
+        std::vector<float> columnX(samples), rowZ(samples);
+
+        for (int i = 0; i < samples; ++i)
+        {
+            columnX[i] = origin.x + pyramid.getSampleIndex(level, x, i, pyramid.getWidth()) * spacing;
+            rowZ[i] = origin.y + pyramid.getSampleIndex(level, z, i, pyramid.getHeight()) * spacing;
+        }
+
+        // Grid, then one skirt row per edge: top, bottom, left and right
+        vertices.resize(gridVertices + 4 * samples);
+        normals.resize(vertices.size());
+        colors.resize(vertices.size());
+
+        for (int j = 0; j < samples; ++j)
+        {
+            for (int i = 0; i < samples; ++i)
+            {
+                const size_t index = size_t(j) * samples + i;
+                const float y = pyramid.toHeight(heights[index]);
+
+                vertices[index] = glm::vec3(columnX[i], y, rowZ[j]);
+
+                // Central differences inside the tile, one-sided on its border
+                const int left = std::max(i - 1, 0), right = std::min(i + 1, quads);
+                const int up = std::max(j - 1, 0), down = std::min(j + 1, quads);
+
+                const float dx = columnX[right] - columnX[left];
+                const float dz = rowZ[down] - rowZ[up];
+
+                const float slopeX = dx > 0.0f ? (pyramid.toHeight(heights[size_t(j) * samples + right]) - pyramid.toHeight(heights[size_t(j) * samples + left])) / dx : 0.0f;
+                const float slopeZ = dz > 0.0f ? (pyramid.toHeight(heights[size_t(down) * samples + i]) - pyramid.toHeight(heights[size_t(up) * samples + i])) / dz : 0.0f;
+
+                normals[index] = glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+
+                terrain_kernels::rampColor(y / pyramid.getHeightRange(), &colors[index].x);
+            }
+        }
+
+        // The tile minimum is below every edge of a coarser neighbour, whose edge samples are
+        // a subset of this tile's ones
+        const float skirtHeight = pyramid.getTileBounds(level, x, z).min.y;
+
+        auto edgeVertex = [&](int edge, int k) -> GLuint
+        {
+            switch (edge)
+            {
+            case 0: return GLuint(k);
+            case 1: return GLuint(quads * samples + k);
+            case 2: return GLuint(k * samples);
+            default: return GLuint(k * samples + quads);
+            }
+        };
+
+        auto skirtVertex = [&](int edge, int k) { return GLuint(gridVertices + edge * samples + k); };
+
+        for (int edge = 0; edge < 4; ++edge)
+        {
+            for (int k = 0; k < samples; ++k)
+            {
+                GLuint source = edgeVertex(edge, k);
+                GLuint skirt = skirtVertex(edge, k);
+
+                vertices[skirt] = glm::vec3(vertices[source].x, skirtHeight, vertices[source].z);
+                normals[skirt] = normals[source];
+                colors[skirt] = colors[source];
+            }
+        }
+
+        // One strip per quad row, top and bottom vertex of every column as HeightMapTerrain does,
+        // then one strip per skirt, facing outwards
+        primitive_type = GL_TRIANGLE_STRIP;
+        indices.clear();
+        indices.reserve(size_t(quads + 4) * (samples * 2 + 1));
+
+        for (int j = 0; j < quads; ++j)
+        {
+            for (int i = 0; i < samples; ++i)
+            {
+                indices.push_back(GLuint(j * samples + i));
+                indices.push_back(GLuint((j + 1) * samples + i));
+            }
+
+            indices.push_back(PRIMITIVE_RESTART);
+        }
+
+        for (int edge = 0; edge < 4; ++edge)
+        {
+            // Top and right skirts start from the lowered vertex, bottom and left ones from the edge
+            const bool skirtFirst = edge == 0 || edge == 3;
+
+            for (int k = 0; k < samples; ++k)
+            {
+                indices.push_back(skirtFirst ? skirtVertex(edge, k) : edgeVertex(edge, k));
+                indices.push_back(skirtFirst ? edgeVertex(edge, k) : skirtVertex(edge, k));
+            }
+
+            if (edge < 3) indices.push_back(PRIMITIVE_RESTART);
+        }
+
+        if (forGpu)
+        {
+            bytes = vertices.size() * TileLayout::STRIDE + getIndexBufferBytes();
+        }
+        else
+        {
+            bytes = (vertices.size() + normals.size() + colors.size()) * sizeof(glm::vec3) + indices.size() * sizeof(GLuint);
+        }
+    }
+
+    void StreamedTerrain::Tile::upload()
+    {
+        setUpMesh< TileLayout >();
+
+        // Only the buffers stay resident
+        index_ranges.assign(1, IndexRange{ 0, GLsizei(indices.size()), 0 });
+
+        std::vector< glm::vec3 >().swap(vertices);
+        std::vector< glm::vec3 >().swap(normals);
+        std::vector< glm::vec3 >().swap(colors);
+        std::vector< GLuint >().swap(indices);
+    }
+
+    void StreamedTerrain::Tile::draw() const
+    {
+        glBindVertexArray(vao_id);
+        drawIndexed();
+    }
+
+    StreamedTerrain::StreamedTerrain(const std::string& pyramidPath, size_t memoryBudget, bool uploadToGpu)
+        : pyramidPath(pyramidPath), memoryBudget(memoryBudget), uploadToGpu(uploadToGpu)
+    {
+        initialize();
+    }
+
+    StreamedTerrain::~StreamedTerrain()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+
+        queueChanged.notify_all();
+
+        if (streamer.joinable())
+        {
+            streamer.join();
+        }
+    }
+
+    void StreamedTerrain::initialize()
+    {
+        SPACE_PROFILE_ZONE("StreamedTerrain::initialize");
+
+        if (!pyramid.open(pyramidPath)) return;
+
+        // The tiles share one vertex format
+        vertex_decode.octahedral_normals = true;
+
+        // The top level is always resident
+        const int top = pyramid.getLevelCount() - 1;
+
+        for (int z = 0; z < pyramid.getTilesZ(top); ++z)
+        {
+            for (int x = 0; x < pyramid.getTilesX(top); ++x)
+            {
+                std::unique_ptr<Tile> tile = buildTile(makeKey(top, x, z));
+
+                tileBytes = tile->getBytes();
+                pinnedBytes += tile->getBytes();
+
+                makeResident(std::move(tile));
+            }
+        }
+
+        streamer = std::thread([this]()
+            {
+                if (CpuProfiler::isEnabled())
+                {
+                    CpuProfiler::setThreadName("terrain streamer");
+                }
+
+                streamLoop();
+            });
+    }
+
+    std::unique_ptr<StreamedTerrain::Tile> StreamedTerrain::buildTile(TileKey key) const
+    {
+        const int level = int(key >> 48);
+        const int z = int(key >> 24 & 0xFFFFFF);
+        const int x = int(key & 0xFFFFFF);
+
+        auto tile = std::make_unique<Tile>(key, level);
+        tile->build(pyramid, x, z, uploadToGpu);
+
+        return tile;
+    }
+
+    void StreamedTerrain::streamLoop()
+    {
+        for (;;)
+        {
+            TileKey key;
+
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueChanged.wait(lock, [this]() { return stopping || !requests.empty(); });
+
+                if (stopping) return;
+
+                key = requests.back().key;
+                requests.pop_back();
+                building = key;
+            }
+
+            std::unique_ptr<Tile> tile = buildTile(key);
+
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                completed.push_back(std::move(tile));
+                building = ~TileKey(0);
+            }
+
+            queueChanged.notify_all();
+        }
+    }
+
+    void StreamedTerrain::waitForIdle()
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        queueChanged.wait(lock, [this]() { return stopping || (requests.empty() && building == ~TileKey(0)); });
+    }
+
+    StreamedTerrain::Tile* StreamedTerrain::findTile(TileKey key)
+    {
+        auto found = cache.find(key);
+        return found == cache.end() ? nullptr : found->second->get();
+    }
+
+    void StreamedTerrain::makeResident(std::unique_ptr<Tile> tile)
+    {
+        if (uploadToGpu)
+        {
+            tile->upload();
+        }
+
+        tile->lastUsed = updateCount;
+
+        stats.residentBytes += tile->getBytes();
+        stats.peakBytes = std::max(stats.peakBytes, stats.residentBytes);
+        ++stats.residentTiles;
+        ++stats.loads;
+
+        TileKey key = tile->key;
+        lru.push_front(std::move(tile));
+        cache[key] = lru.begin();
+    }
+
+    bool StreamedTerrain::makeRoom(size_t bytes)
+    {
+        const int top = pyramid.getLevelCount() - 1;
+
+        // The list is sorted by last use: stop at the first tile the last selection visited
+        auto tile = lru.end();
+
+        while (stats.residentBytes + bytes > memoryBudget && tile != lru.begin())
+        {
+            --tile;
+
+            if ((*tile)->lastUsed + 1 >= updateCount) return false;
+            if ((*tile)->level == top) continue;
+
+            stats.residentBytes -= (*tile)->getBytes();
+            --stats.residentTiles;
+            ++stats.evictions;
+
+            cache.erase((*tile)->key);
+            tile = lru.erase(tile);
+        }
+
+        return stats.residentBytes + bytes <= memoryBudget;
+    }
+
+    void StreamedTerrain::update(const glm::vec3& localCameraPosition, const Frustum* localFrustum)
+    {
+        SPACE_PROFILE_ZONE("StreamedTerrain::update");
+
+        drawList.clear();
+
+        if (!isLoaded()) return;
+
+        ++updateCount;
+
+        // Tiles the streaming thread finished since the last update
+        std::vector<std::unique_ptr<Tile>> finished;
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            finished.swap(completed);
+        }
+
+        for (std::unique_ptr<Tile>& tile : finished)
+        {
+            // A tile requested again while its first build waited here is already resident
+            if (cache.count(tile->key) != 0) continue;
+
+            if (makeRoom(tile->getBytes()))
+            {
+                makeResident(std::move(tile));
+            }
+            else
+            {
+                ++stats.dropped;
+            }
+        }
+
+        // Selection from the top level down
+        wanted.clear();
+        selectedBytes = 0;
+        stats.culledTiles = 0;
+
+        const int top = pyramid.getLevelCount() - 1;
+
+        for (int z = 0; z < pyramid.getTilesZ(top); ++z)
+        {
+            for (int x = 0; x < pyramid.getTilesX(top); ++x)
+            {
+                selectTile(*findTile(makeKey(top, x, z)), x, z, localCameraPosition, localFrustum);
+            }
+        }
+
+        stats.drawnTiles = drawList.size();
+
+        // Only as many requests as can be resident next to what this selection uses, nearest last
+        size_t used = pinnedBytes + selectedBytes;
+        size_t room = used < memoryBudget && tileBytes > 0 ? (memoryBudget - used) / tileBytes : 0;
+
+        std::sort(wanted.begin(), wanted.end(), [](const Request& a, const Request& b) { return a.distance < b.distance; });
+
+        if (wanted.size() > room)
+        {
+            wanted.resize(room);
+        }
+
+        std::reverse(wanted.begin(), wanted.end());
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+
+            // The tile being built, or built since the finished tiles were taken, is already on its way
+            wanted.erase(std::remove_if(wanted.begin(), wanted.end(), [this](const Request& r)
+                {
+                    if (r.key == building) return true;
+
+                    for (const std::unique_ptr<Tile>& tile : completed)
+                    {
+                        if (tile->key == r.key) return true;
+                    }
+
+                    return false;
+                }), wanted.end());
+            requests.swap(wanted);
+        }
+
+        queueChanged.notify_all();
+    }
+
+    void StreamedTerrain::touch(Tile& tile)
+    {
+        if (tile.lastUsed != updateCount && tile.level != pyramid.getLevelCount() - 1)
+        {
+            selectedBytes += tile.getBytes();
+        }
+
+        tile.lastUsed = updateCount;
+
+        auto entry = cache[tile.key];
+        lru.splice(lru.begin(), lru, entry);
+    }
+
+    void StreamedTerrain::selectTile(Tile& tile, int x, int z, const glm::vec3& camera, const Frustum* frustum)
+    {
+        touch(tile);
+
+        const int level = tile.level;
+        const BoundingBox box = pyramid.getTileBounds(level, x, z);
+
+        if (frustum)
+        {
+            Frustum::Containment containment = frustum->classify(box);
+
+            if (containment == Frustum::OUTSIDE)
+            {
+                ++stats.culledTiles;
+                return;
+            }
+
+            if (containment == Frustum::INSIDE) frustum = nullptr;
+        }
+
+        if (level > 0 && distanceToBox(box, camera) < getRange(level - 1))
+        {
+            // The children replace this tile only if all the visible ones are resident
+            Tile* children[4] = {};
+            bool complete = true;
+
+            for (int quadrant = 0; quadrant < 4; ++quadrant)
+            {
+                const int childX = 2 * x + (quadrant & 1);
+                const int childZ = 2 * z + (quadrant >> 1);
+
+                if (childX >= pyramid.getTilesX(level - 1) || childZ >= pyramid.getTilesZ(level - 1)) continue;
+
+                if (frustum && frustum->classify(pyramid.getTileBounds(level - 1, childX, childZ)) == Frustum::OUTSIDE)
+                {
+                    ++stats.culledTiles;
+                    continue;
+                }
+
+                children[quadrant] = findTile(makeKey(level - 1, childX, childZ));
+
+                if (!children[quadrant])
+                {
+                    request(level - 1, childX, childZ, camera);
+                    complete = false;
+                }
+            }
+
+            if (complete)
+            {
+                for (int quadrant = 0; quadrant < 4; ++quadrant)
+                {
+                    if (children[quadrant])
+                    {
+                        selectTile(*children[quadrant], 2 * x + (quadrant & 1), 2 * z + (quadrant >> 1), camera, frustum);
+                    }
+                }
+
+                return;
+            }
+
+            // Keep the children already resident until the rest arrive
+            for (Tile* child : children)
+            {
+                if (child) touch(*child);
+            }
+        }
+
+        drawList.push_back(&tile);
+    }
+
+    void StreamedTerrain::request(int level, int x, int z, const glm::vec3& camera)
+    {
+        wanted.push_back({ makeKey(level, x, z), distanceToBox(pyramid.getTileBounds(level, x, z), camera) });
+    }
+
+    float StreamedTerrain::getRange(int level) const
+    {
+        return lodRange * pyramid.getTileQuads() * pyramid.getSpacing() * float(1 << level);
+    }
+
+    void StreamedTerrain::render()
+    {
+        if (drawList.empty()) return;
+
+        for (const Tile* tile : drawList)
+        {
+            tile->draw();
+        }
+
+        glBindVertexArray(0);
+
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR)
+        {
+            std::cerr << "OpenGL error in StreamedTerrain::render: " << error << std::endl;
+        }
+    }
+}
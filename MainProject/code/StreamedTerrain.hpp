@@ -0,0 +1,176 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "Frustum.hpp"
+#include "Mesh.hpp"
+#include "TerrainPyramid.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace space
+{
+    /**
+    * Terrain streamed from a TerrainPyramid, for heightfields too big to keep resident.
+    *
+    * update() selects, for a camera in the terrain local space, the pyramid tiles to draw:
+    * starting from the top level, a tile is replaced by its children while its bounding box is
+    * within the range of the finer level (ranges double per level) and every visible child is
+    * resident; otherwise the tile itself is drawn and the missing children are requested.
+    * Tiles outside the frustum are skipped. The top level is loaded up front and never
+    * evicted, so there is always something to draw.
+    *
+    * A background thread builds the requested tiles (nearest first) from the mapped samples:
+    * positions, normals, colour ramp and strip indices, with skirts down to the tile minimum
+    * that hide the cracks between levels. update() uploads the finished ones and keeps the
+    * resident tiles in an LRU cache under a byte budget: a new tile evicts the least recently
+    * used ones, never the ones the last selection used, and is dropped if there is no room.
+    * Memory therefore stays bounded however big the pyramid is.
+    */
+    class StreamedTerrain : public Mesh
+    {
+    public:
+
+        struct Stats
+        {
+            size_t residentTiles = 0;
+            size_t residentBytes = 0;
+            size_t peakBytes = 0;           // Highest residentBytes so far
+            size_t loads = 0;               // Tiles built and made resident
+            size_t evictions = 0;
+            size_t dropped = 0;             // Tiles built but left out for lack of room
+            size_t drawnTiles = 0;          // In the last selection
+            size_t culledTiles = 0;
+        };
+
+        // Level 0 tile widths the finest level reaches from the camera
+        static constexpr float DEFAULT_LOD_RANGE = 2.0f;
+
+        /**
+        * memoryBudget is in bytes: GPU buffers of the uploaded tiles, or their CPU arrays when
+        * uploadToGpu is false (the benchmark streams without a GL context that way).
+        */
+        StreamedTerrain(const std::string& pyramidPath, size_t memoryBudget, bool uploadToGpu = true);
+        ~StreamedTerrain() override;
+
+        // Maps the pyramid, loads the top level and starts the streaming thread
+        void initialize() override;
+
+        bool isLoaded() const { return pyramid.isOpen(); }
+
+        /**
+        * Makes the tiles finished since the last call resident, selects the tiles to draw
+        * for a camera (and optional frustum) in the terrain local space, and requests the
+        * missing ones.
+        */
+        void update(const glm::vec3& localCameraPosition, const Frustum* localFrustum = nullptr);
+
+        // Draws the last selection; the scene sets the matrices of vertex_shader.glsl
+        void render() override;
+
+        // Blocks until the streaming thread has built every pending request
+        void waitForIdle();
+
+        void setLodRange(float tileWidths) { lodRange = tileWidths; }
+
+        BoundingBox getBounds() const override { return pyramid.getBounds(); }
+
+        const TerrainPyramid& getPyramid() const { return pyramid; }
+        const Stats& getStats() const { return stats; }
+        size_t getMemoryBudget() const { return memoryBudget; }
+
+    private:
+
+        using TileKey = uint64_t;
+
+        class Tile : public Mesh
+        {
+        public:
+
+            TileKey key;
+            int level;
+            uint64_t lastUsed = 0;          // update() count of the last selection that visited it
+
+            Tile(TileKey key, int level) : key(key), level(level) {}
+
+            void initialize() override {}
+
+            /**
+            * Builds the CPU arrays (on the streaming thread). Its bytes are those of the GPU
+            * buffers if it is going to be uploaded, of the arrays otherwise.
+            */
+            void build(const TerrainPyramid& pyramid, int x, int z, bool forGpu);
+
+            // Uploads the arrays and frees them (on the GL thread)
+            void upload();
+
+            void draw() const;
+
+            size_t getBytes() const { return bytes; }
+
+        private:
+
+            size_t bytes = 0;
+        };
+
+        struct Request
+        {
+            TileKey key;
+            float distance;
+        };
+
+        TerrainPyramid pyramid;
+        std::string pyramidPath;
+        size_t memoryBudget;
+        bool uploadToGpu;
+        float lodRange = DEFAULT_LOD_RANGE;
+        uint64_t updateCount = 0;
+
+        // Resident tiles, most recently used first
+        std::list<std::unique_ptr<Tile>> lru;
+        std::unordered_map<TileKey, std::list<std::unique_ptr<Tile>>::iterator> cache;
+
+        std::vector<Tile*> drawList;
+        std::vector<Request> wanted;
+        size_t tileBytes = 0;               // Every tile has the same vertex and index count
+        size_t pinnedBytes = 0;             // Top level
+        size_t selectedBytes = 0;           // Tiles the last selection visited, pinned ones apart
+        Stats stats;
+
+        // Shared with the streaming thread
+        std::thread streamer;
+        std::mutex queueMutex;
+        std::condition_variable queueChanged;
+        std::vector<Request> requests;                  // Nearest last
+        std::vector<std::unique_ptr<Tile>> completed;
+        TileKey building = ~TileKey(0);
+        bool stopping = false;
+
+        static TileKey makeKey(int level, int x, int z) { return TileKey(level) << 48 | TileKey(z) << 24 | TileKey(x); }
+
+        Tile* findTile(TileKey key);
+        std::unique_ptr<Tile> buildTile(TileKey key) const;
+
+        void makeResident(std::unique_ptr<Tile> tile);
+        bool makeRoom(size_t bytes);
+
+        // Draws a resident tile or, in range of the finer level, its children
+        void selectTile(Tile& tile, int x, int z, const glm::vec3& camera, const Frustum* frustum);
+        void touch(Tile& tile);
+        void request(int level, int x, int z, const glm::vec3& camera);
+        float getRange(int level) const;
+
+        void streamLoop();
+    };
+}
@@ -0,0 +1,463 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "TerrainKernels.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+#ifdef SPACE_SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+namespace space
+{
+    namespace terrain_kernels
+    {
+        namespace
+        {
+            SimdLevel detectSimdLevel()
+            {
+#if defined(SPACE_SIMD_X86) && defined(_MSC_VER)
+                int info[4];
+                __cpuid(info, 0);
+                int max_leaf = info[0];
+
+                __cpuid(info, 1);
+                bool sse41 = (info[2] & (1 << 19)) != 0;
+                bool osxsave = (info[2] & (1 << 27)) != 0;
+                bool avx = (info[2] & (1 << 28)) != 0;
+
+                // The OS must also save the YMM registers on context switches
+                bool avx_enabled = osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+
+                bool avx2 = false;
+
+                if (max_leaf >= 7)
+                {
+                    __cpuidex(info, 7, 0);
+                    avx2 = avx_enabled && (info[1] & (1 << 5)) != 0;
+                }
+
+                if (avx2) return SimdLevel::AVX2;
+                if (sse41) return SimdLevel::SSE41;
+#elif defined(SPACE_SIMD_X86)
+                // libgcc only reports AVX2 when the OS saves the YMM registers
+                __builtin_cpu_init();
+
+                if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+                if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE41;
+#endif
+                return SimdLevel::SCALAR;
+            }
+
+            const SimdLevel supported_level = detectSimdLevel();
+            std::atomic<SimdLevel> active_level{ supported_level };
+
+            void buildVertexRowScalar(const unsigned char* rgb_row, int first_x, int width, int height, int z, float height_scale, float* vertex_row, float* color_row)
+            {
+                float zPos = ((float)z / (height - 1) - 0.5f) * EXTENT;
+
+                for (int x = first_x; x < width; x++)
+                {
+                    //Get pixel data
+                    const unsigned char* texel = rgb_row + x * 3;
+
+                    unsigned char r = texel[0];
+                    unsigned char g = texel[1];
+                    unsigned char b = texel[2];
+
+                    //Normalize coordinates and scale terrain
+                    float xPos = ((float)x / (width - 1) - 0.5f) * EXTENT;
+
+                    //Height based on pixel intensity, weighted grayscale for more natural height
+                    float yPos = (RED_WEIGHT * r + GREEN_WEIGHT * g + BLUE_WEIGHT * b) / 255.0f * height_scale * HEIGHT_RANGE;
+
+                    float* vertex = vertex_row + x * 3;
+                    vertex[0] = xPos;
+                    vertex[1] = yPos;
+                    vertex[2] = zPos;
+
+                    // Color ramp over the normalized height (0-1)
+                    rampColor(yPos / (HEIGHT_RANGE * height_scale), color_row + x * 3);
+                }
+            }
+
+            void buildNormalRowScalar(const float* up_row, const float* vertex_row, const float* down_row, int first_x, int width, float* normal_row)
+            {
+                for (int x = first_x; x < width - 1; ++x)
+                {
+                    const float* left = vertex_row + (x - 1) * 3;
+                    const float* right = vertex_row + (x + 1) * 3;
+                    const float* up = up_row + x * 3;
+                    const float* down = down_row + x * 3;
+
+                    // normalize(cross(down - up, right - left)), in glm's operation order
+                    float a[3] = { down[0] - up[0], down[1] - up[1], down[2] - up[2] };
+                    float b[3] = { right[0] - left[0], right[1] - left[1], right[2] - left[2] };
+
+                    float nx = a[1] * b[2] - b[1] * a[2];
+                    float ny = a[2] * b[0] - b[2] * a[0];
+                    float nz = a[0] * b[1] - b[0] * a[1];
+
+                    float inverseLength = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz);
+
+                    float* normal = normal_row + x * 3;
+                    normal[0] = nx * inverseLength;
+                    normal[1] = ny * inverseLength;
+                    normal[2] = nz * inverseLength;
+                }
+            }
+
+            void sampleBilinearScalar(const float* heights, int stride, int width, int height, const float* tx, const float* tz, int first, int count,
+                float* out_height, float* dx, float* dz)
+            {
+                const float last_x = float(width - 1);
+                const float last_z = float(height - 1);
+
+                for (int i = first; i < count; ++i)
+                {
+                    // Same operations, in the same order, as the vector versions
+                    float fx = std::fmin(std::fmax(tx[i], 0.0f), last_x);
+                    float fz = std::fmin(std::fmax(tz[i], 0.0f), last_z);
+
+                    int x0 = int(fx);
+                    int z0 = int(fz);
+                    int x1 = x0 + 1 < width ? x0 + 1 : x0;
+                    int z1 = z0 + 1 < height ? z0 + 1 : z0;
+
+                    float wx = fx - float(x0);
+                    float wz = fz - float(z0);
+
+                    float h00 = heights[(size_t(z0) * width + x0) * stride];
+                    float h10 = heights[(size_t(z0) * width + x1) * stride];
+                    float h01 = heights[(size_t(z1) * width + x0) * stride];
+                    float h11 = heights[(size_t(z1) * width + x1) * stride];
+
+                    float rx = 1.0f - wx;
+                    float rz = 1.0f - wz;
+
+                    float h0 = h00 * rx + h10 * wx;
+                    float h1 = h01 * rx + h11 * wx;
+
+                    out_height[i] = h0 * rz + h1 * wz;
+
+                    if (dx && dz)
+                    {
+                        dx[i] = (h10 - h00) * rz + (h11 - h01) * wz;
+                        dz[i] = (h01 - h00) * rx + (h11 - h10) * wx;
+                    }
+                }
+            }
+
+            void hashGradient(int ix, int iz, unsigned int seed, float& gx, float& gz)
+            {
+                using namespace detail;
+
+                uint32_t h = (uint32_t(ix) * NOISE_PRIME_X) ^ (uint32_t(iz) * NOISE_PRIME_Z) ^ seed;
+                h = (h ^ (h >> 16)) * NOISE_MIX_1;
+                h = (h ^ (h >> 15)) * NOISE_MIX_2;
+                h = h ^ (h >> 16);
+
+                gx = float(int32_t(h) >> 16) * NOISE_GRADIENT_SCALE;
+                gz = float(int32_t(h << 16) >> 16) * NOISE_GRADIENT_SCALE;
+            }
+
+            // Gradient noise with quintic fade, about -1 to 1
+            float gradientNoise(float x, float z, unsigned int seed)
+            {
+                float cell_x = std::floor(x);
+                float cell_z = std::floor(z);
+
+                int ix = int(cell_x);
+                int iz = int(cell_z);
+
+                float fx = x - cell_x;
+                float fz = z - cell_z;
+
+                float u = fx * fx * fx * (fx * (fx * 6.0f - 15.0f) + 10.0f);
+                float v = fz * fz * fz * (fz * (fz * 6.0f - 15.0f) + 10.0f);
+
+                float gx, gz;
+
+                hashGradient(ix, iz, seed, gx, gz);
+                float d00 = gx * fx + gz * fz;
+
+                hashGradient(ix + 1, iz, seed, gx, gz);
+                float d10 = gx * (fx - 1.0f) + gz * fz;
+
+                hashGradient(ix, iz + 1, seed, gx, gz);
+                float d01 = gx * fx + gz * (fz - 1.0f);
+
+                hashGradient(ix + 1, iz + 1, seed, gx, gz);
+                float d11 = gx * (fx - 1.0f) + gz * (fz - 1.0f);
+
+                float n0 = d00 + u * (d10 - d00);
+                float n1 = d01 + u * (d11 - d01);
+
+                return n0 + v * (n1 - n0);
+            }
+
+            void noiseRowScalar(const detail::NoiseOctaves& octaves, float x, float z, float step, int first, int count, float* out)
+            {
+                using namespace detail;
+
+                for (int i = first; i < count; ++i)
+                {
+                    // Same operations, in the same order, as the vector versions
+                    float px = (x + float(i) * step) * octaves.frequency;
+                    float pz = z * octaves.frequency;
+
+                    if (octaves.warp != 0.0f)
+                    {
+                        float warp_x = (gradientNoise(px, pz, octaves.warp_seed_x)
+                            + gradientNoise(px * 2.0f, pz * 2.0f, octaves.warp_seed_x + NOISE_OCTAVE_SEED) * 0.5f) * NOISE_WARP_NORMALIZE;
+                        float warp_z = (gradientNoise(px, pz, octaves.warp_seed_z)
+                            + gradientNoise(px * 2.0f, pz * 2.0f, octaves.warp_seed_z + NOISE_OCTAVE_SEED) * 0.5f) * NOISE_WARP_NORMALIZE;
+
+                        px = px + octaves.warp * warp_x;
+                        pz = pz + octaves.warp * warp_z;
+                    }
+
+                    float sum = 0.0f;
+                    float weight = 1.0f;
+
+                    for (int octave = 0; octave < octaves.count; ++octave)
+                    {
+                        float n = gradientNoise(px * octaves.frequencies[octave], pz * octaves.frequencies[octave], octaves.seeds[octave]);
+
+                        if (octaves.ridged)
+                        {
+                            float ridge = 1.0f - std::fabs(n);
+                            ridge = ridge * ridge * weight;
+                            weight = std::fmin(ridge * NOISE_RIDGE_WEIGHT, 1.0f);
+                            n = ridge;
+                        }
+
+                        sum = sum + n * octaves.amplitudes[octave];
+                    }
+
+                    out[i] = std::fmin(std::fmax(octaves.bias + sum * octaves.scale, 0.0f), 1.0f);
+                }
+            }
+        }
+
+        void rampColor(float normalized_height, float* color)
+        {
+            int segment = RAMP_SEGMENTS - 1;
+            while (segment > 0 && normalized_height < RAMP_STARTS[segment]) --segment;
+
+            float t = (normalized_height - RAMP_STARTS[segment]) / RAMP_LENGTHS[segment];
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const float from = RAMP_COLORS[segment][c];
+                const float to = RAMP_COLORS[segment + 1][c];
+
+                color[c] = from + t * (to - from);
+            }
+        }
+
+        SimdLevel getSupportedSimdLevel()
+        {
+            return supported_level;
+        }
+
+        SimdLevel getSimdLevel()
+        {
+            return active_level.load(std::memory_order_relaxed);
+        }
+
+        void setSimdLevel(SimdLevel level)
+        {
+            active_level.store(level > supported_level ? supported_level : level, std::memory_order_relaxed);
+        }
+
+        const char* getSimdLevelName(SimdLevel level)
+        {
+            switch (level)
+            {
+            case SimdLevel::AVX2: return "avx2";
+            case SimdLevel::SSE41: return "sse4.1";
+            default: return "scalar";
+            }
+        }
+
+        void buildVertexRow(const unsigned char* rgb_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row)
+        {
+            int x = 0;
+
+#ifdef SPACE_SIMD_X86
+            switch (getSimdLevel())
+            {
+            case SimdLevel::AVX2:
+                x = detail::buildVertexRowAvx2(rgb_row, width, height, z, height_scale, vertex_row, color_row);
+                break;
+            case SimdLevel::SSE41:
+                x = detail::buildVertexRowSse41(rgb_row, width, height, z, height_scale, vertex_row, color_row);
+                break;
+            default:
+                break;
+            }
+#endif
+
+            buildVertexRowScalar(rgb_row, x, width, height, z, height_scale, vertex_row, color_row);
+        }
+
+        void buildNormalRow(const float* up_row, const float* vertex_row, const float* down_row, int width, float* normal_row)
+        {
+            int x = 1;
+
+#ifdef SPACE_SIMD_X86
+            switch (getSimdLevel())
+            {
+            case SimdLevel::AVX2:
+                x = detail::buildNormalRowAvx2(up_row, vertex_row, down_row, width, normal_row);
+                break;
+            case SimdLevel::SSE41:
+                x = detail::buildNormalRowSse41(up_row, vertex_row, down_row, width, normal_row);
+                break;
+            default:
+                break;
+            }
+#endif
+
+            buildNormalRowScalar(up_row, vertex_row, down_row, x, width, normal_row);
+        }
+
+        void sampleBilinear(const float* heights, int stride, int width, int height, const float* tx, const float* tz, int count,
+            float* out_height, float* dx, float* dz)
+        {
+            int i = 0;
+
+#ifdef SPACE_SIMD_X86
+            switch (getSimdLevel())
+            {
+            case SimdLevel::AVX2:
+                i = detail::sampleBilinearAvx2(heights, stride, width, height, tx, tz, count, out_height, dx, dz);
+                break;
+            case SimdLevel::SSE41:
+                i = detail::sampleBilinearSse41(heights, stride, width, height, tx, tz, count, out_height, dx, dz);
+                break;
+            default:
+                break;
+            }
+#endif
+
+            sampleBilinearScalar(heights, stride, width, height, tx, tz, i, count, out_height, dx, dz);
+        }
+
+        void noiseRow(const NoiseParameters& parameters, float x, float z, float step, int count, float* out)
+        {
+            using namespace detail;
+
+            NoiseOctaves octaves;
+            octaves.count = parameters.octaves < 1 ? 1 : parameters.octaves > MAX_NOISE_OCTAVES ? MAX_NOISE_OCTAVES : parameters.octaves;
+            octaves.ridged = parameters.fractal == NoiseFractal::RIDGED;
+            octaves.frequency = parameters.frequency;
+            octaves.warp = parameters.warp;
+            octaves.warp_seed_x = parameters.seed ^ NOISE_WARP_SEED_X;
+            octaves.warp_seed_z = parameters.seed ^ NOISE_WARP_SEED_Z;
+
+            float frequency = 1.0f;
+            float amplitude = 1.0f;
+            float total = 0.0f;
+
+            for (int octave = 0; octave < octaves.count; ++octave)
+            {
+                octaves.seeds[octave] = parameters.seed + unsigned(octave) * NOISE_OCTAVE_SEED;
+                octaves.frequencies[octave] = frequency;
+                octaves.amplitudes[octave] = amplitude;
+
+                total += amplitude;
+                frequency *= parameters.lacunarity;
+                amplitude *= parameters.gain;
+            }
+
+            // fBm is signed around 0, a ridge goes from 0 to its weight
+            octaves.bias = octaves.ridged ? 0.0f : 0.5f;
+            octaves.scale = (octaves.ridged ? 1.0f : 0.5f) / total;
+
+            int i = 0;
+
+#ifdef SPACE_SIMD_X86
+            switch (getSimdLevel())
+            {
+            case SimdLevel::AVX2:
+                i = detail::noiseRowAvx2(octaves, x, z, step, count, out);
+                break;
+            case SimdLevel::SSE41:
+                i = detail::noiseRowSse41(octaves, x, z, step, count, out);
+                break;
+            default:
+                break;
+            }
+#endif
+
+            noiseRowScalar(octaves, x, z, step, i, count, out);
+        }
+
+        void buildHeightRow(const unsigned char* rgb_row, int width, float height_scale, float* height_row)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const unsigned char* texel = rgb_row + x * 3;
+
+                // Same expression as buildVertexRowScalar, so both modes agree on every height
+                height_row[x] = (RED_WEIGHT * texel[0] + GREEN_WEIGHT * texel[1] + BLUE_WEIGHT * texel[2]) / 255.0f * height_scale * HEIGHT_RANGE;
+            }
+        }
+
+        void buildHeightRow(const void* row, SampleFormat format, int width, float height_scale, float* height_row)
+        {
+            switch (format)
+            {
+            case SampleFormat::RGB8:
+                buildHeightRow(static_cast<const unsigned char*>(row), width, height_scale, height_row);
+                break;
+
+            case SampleFormat::R8:
+            {
+                const unsigned char* samples = static_cast<const unsigned char*>(row);
+                for (int x = 0; x < width; ++x) height_row[x] = samples[x] / 255.0f * height_scale * HEIGHT_RANGE;
+                break;
+            }
+
+            case SampleFormat::R16:
+            {
+                const unsigned short* samples = static_cast<const unsigned short*>(row);
+                for (int x = 0; x < width; ++x) height_row[x] = samples[x] / 65535.0f * height_scale * HEIGHT_RANGE;
+                break;
+            }
+
+            case SampleFormat::R32F:
+            {
+                const float* samples = static_cast<const float*>(row);
+                for (int x = 0; x < width; ++x) height_row[x] = samples[x] * height_scale * HEIGHT_RANGE;
+                break;
+            }
+            }
+        }
+
+        void buildVertexRowFromHeights(const float* height_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row)
+        {
+            float zPos = ((float)z / (height - 1) - 0.5f) * EXTENT;
+
+            for (int x = 0; x < width; ++x)
+            {
+                float* vertex = vertex_row + x * 3;
+                vertex[0] = ((float)x / (width - 1) - 0.5f) * EXTENT;
+                vertex[1] = height_row[x];
+                vertex[2] = zPos;
+
+                rampColor(height_row[x] / (HEIGHT_RANGE * height_scale), color_row + x * 3);
+            }
+        }
+    }
+}
@@ -0,0 +1,212 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SPACE_SIMD_X86
+#endif
+
+/**
+* Row kernels of the heightmap terrain build: RGB to height, height colour ramp and
+* central-difference normals, plus the bilinear heightfield sampling of HeightfieldSampler
+* and the fractal noise of TerrainNoise.
+*
+* Each kernel has a scalar version and SSE4.1 / AVX2 versions that handle 8 pixels per
+* iteration; the widest one the CPU supports is picked at runtime. The vector versions do
+* the same float operations in the same order as the scalar one (no FMA, no approximate
+* reciprocals), so all of them produce bit-identical vertices, colours and normals.
+*
+* This header is included by the SIMD translation units, which are compiled with wider
+* instruction sets: keep it free of glm and standard library inline code.
+*/
+
+namespace space
+{
+    namespace terrain_kernels
+    {
+        enum class SimdLevel
+        {
+            SCALAR,
+            SSE41,
+            AVX2
+        };
+
+        /**
+        * Texel formats a heightmap row can come in. RGB8 is collapsed to grayscale with the
+        * weights below; the single channel ones are fractions of their largest value (R32F
+        * is read as is, 0 to 1).
+        */
+        enum class SampleFormat
+        {
+            RGB8,
+            R8,
+            R16,
+            R32F
+        };
+
+        /**
+        * Fractal sums of gradient noise. FBM adds the octaves, RIDGED adds the squared
+        * complement of their absolute value, each octave weighted by the previous one, which
+        * gives sharp crests and smooth valleys.
+        */
+        enum class NoiseFractal
+        {
+            FBM,
+            RIDGED
+        };
+
+        /**
+        * What noiseRow computes at (x, z): the position is scaled by frequency and, when
+        * warp is not 0, displaced by warp times two 2-octave fBm fields (domain warping).
+        * Octave i is sampled at lacunarity^i times that position with its own seed and adds
+        * with weight gain^i; the sum is normalized to 0 to 1.
+        */
+        constexpr int MAX_NOISE_OCTAVES = 16;
+
+        struct NoiseParameters
+        {
+            unsigned int seed;
+            NoiseFractal fractal;
+            int octaves;                // 1 to MAX_NOISE_OCTAVES
+            float frequency;
+            float lacunarity;
+            float gain;
+            float warp;
+        };
+
+        // Terrain spans [-HALF_EXTENT, HALF_EXTENT] in X and Z, heights go up to HEIGHT_RANGE * heightScale
+        constexpr float EXTENT = 20.0f;
+        constexpr float HEIGHT_RANGE = 5.0f;
+
+        // Grayscale weights of rgbToHeight
+        constexpr float RED_WEIGHT = 0.299f;
+        constexpr float GREEN_WEIGHT = 0.587f;
+        constexpr float BLUE_WEIGHT = 0.114f;
+
+        // Colour ramp: segment i goes from RAMP_COLORS[i] to RAMP_COLORS[i + 1] over
+        // [RAMP_STARTS[i], RAMP_STARTS[i] + RAMP_LENGTHS[i]) of the normalized height
+        constexpr int RAMP_SEGMENTS = 4;
+        constexpr float RAMP_STARTS[RAMP_SEGMENTS] = { 0.0f, 0.2f, 0.4f, 0.7f };
+        constexpr float RAMP_LENGTHS[RAMP_SEGMENTS] = { 0.2f, 0.2f, 0.3f, 0.3f };
+        constexpr float RAMP_COLORS[RAMP_SEGMENTS + 1][3] =
+        {
+            { 0.0f, 0.3f, 1.0f },   // Deep blue for lowest areas
+            { 0.0f, 0.8f, 0.8f },   // Teal/light blue for shallow water
+            { 0.0f, 0.7f, 0.0f },   // Green for mid elevations
+            { 0.5f, 0.5f, 0.5f },   // Gray for higher elevations
+            { 0.9f, 0.9f, 0.9f }    // White for peaks
+        };
+
+        // Best level this CPU (and OS) supports
+        SimdLevel getSupportedSimdLevel();
+
+        // Level used by the kernels, the supported one unless changed with setSimdLevel
+        SimdLevel getSimdLevel();
+
+        // Clamped to the supported level. Meant for benchmarks and comparisons
+        void setSimdLevel(SimdLevel level);
+
+        const char* getSimdLevelName(SimdLevel level);
+
+        /**
+        * Fills one row of vertices and colours (xyz float triplets, width of each) from a row
+        * of RGB texels. z is the row index in a heightmap of width x height texels.
+        */
+        void buildVertexRow(const unsigned char* rgb_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row);
+
+        /**
+        * Writes the normals of the interior texels of a row (x in [1, width - 1)) from the
+        * row above, the row itself and the row below. Border normals are left untouched.
+        */
+        void buildNormalRow(const float* up_row, const float* vertex_row, const float* down_row, int width, float* normal_row);
+
+        /**
+        * Heights only (the y that buildVertexRow writes), one float per texel. Used by the
+        * displacement terrain, where positions, normals and colours are built on the GPU.
+        */
+        void buildHeightRow(const unsigned char* rgb_row, int width, float height_scale, float* height_row);
+
+        // Same for a row in any sample format
+        void buildHeightRow(const void* row, SampleFormat format, int width, float height_scale, float* height_row);
+
+        // buildVertexRow from a row of heights (as buildHeightRow writes them) instead of RGB texels
+        void buildVertexRowFromHeights(const float* height_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row);
+
+        // Colour ramp (rgb) of a single height normalized to 0-1, as buildVertexRow computes it
+        void rampColor(float normalized_height, float* color);
+
+        /**
+        * Bilinear heights at count texel positions (tx[i], tz[i]), clamped to a heightfield of
+        * width x height texels whose texel (x, z) is heights[(z * width + x) * stride]. When dx
+        * and dz are not null they get the gradient of the bilinear patch under each position,
+        * in height units per texel (0 across the last row or column).
+        */
+        void sampleBilinear(const float* heights, int stride, int width, int height, const float* tx, const float* tz, int count,
+            float* out_height, float* dx, float* dz);
+
+        /**
+        * Noise of parameters, 0 to 1, at (x + i * step, z) for i in [0, count). The integer
+        * hashing is done in 32-bit lanes by every version, so the result only depends on the
+        * parameters and the position.
+        */
+        void noiseRow(const NoiseParameters& parameters, float x, float z, float step, int count, float* out);
+
+        // Per instruction set entry points. Each one handles the 8-texel blocks and returns
+        // the first x left for the scalar code
+        namespace detail
+        {
+            // Hash constants of the gradient noise and seed offsets of its octaves and warp fields
+            constexpr unsigned int NOISE_PRIME_X = 0x8da6b343u;
+            constexpr unsigned int NOISE_PRIME_Z = 0xd8163841u;
+            constexpr unsigned int NOISE_MIX_1 = 0x7feb352du;
+            constexpr unsigned int NOISE_MIX_2 = 0x846ca68bu;
+            constexpr unsigned int NOISE_OCTAVE_SEED = 0x9e3779b9u;
+            constexpr unsigned int NOISE_WARP_SEED_X = 0x68bc21ebu;
+            constexpr unsigned int NOISE_WARP_SEED_Z = 0x02e5be93u;
+
+            // Gradient components are 16-bit signed fractions of the hash
+            constexpr float NOISE_GRADIENT_SCALE = 1.0f / 32768.0f;
+
+            // A ridge weights the next octave by up to twice its height
+            constexpr float NOISE_RIDGE_WEIGHT = 2.0f;
+
+            // The two warp octaves weigh 1 and 0.5
+            constexpr float NOISE_WARP_NORMALIZE = 1.0f / 1.5f;
+
+            // NoiseParameters expanded by noiseRow once per row, the same for every version
+            struct NoiseOctaves
+            {
+                int count;
+                bool ridged;
+                unsigned int seeds[MAX_NOISE_OCTAVES];
+                float frequencies[MAX_NOISE_OCTAVES];   // Multiples of the base frequency
+                float amplitudes[MAX_NOISE_OCTAVES];
+                float frequency;
+                float warp;
+                unsigned int warp_seed_x;
+                unsigned int warp_seed_z;
+                float bias;                             // The result is bias + sum * scale
+                float scale;
+            };
+
+            int buildVertexRowSse41(const unsigned char* rgb_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row);
+            int buildNormalRowSse41(const float* up_row, const float* vertex_row, const float* down_row, int width, float* normal_row);
+
+            int buildVertexRowAvx2(const unsigned char* rgb_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row);
+            int buildNormalRowAvx2(const float* up_row, const float* vertex_row, const float* down_row, int width, float* normal_row);
+
+            int sampleBilinearSse41(const float* heights, int stride, int width, int height, const float* tx, const float* tz, int count,
+                float* out_height, float* dx, float* dz);
+            int sampleBilinearAvx2(const float* heights, int stride, int width, int height, const float* tx, const float* tz, int count,
+                float* out_height, float* dx, float* dz);
+
+            int noiseRowSse41(const NoiseOctaves& octaves, float x, float z, float step, int count, float* out);
+            int noiseRowAvx2(const NoiseOctaves& octaves, float x, float z, float step, int count, float* out);
+        }
+    }
+}
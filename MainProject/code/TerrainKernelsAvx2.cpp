@@ -0,0 +1,165 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+// Compiled with AVX2 enabled (-mavx2, /arch:AVX2) but not FMA, so that no multiply-add gets
+// fused and the results match the scalar kernels. Only called after the runtime check
+
+#include "TerrainKernels.hpp"
+
+#ifdef SPACE_SIMD_X86
+
+#include <immintrin.h>
+
+#include "TerrainKernelsSimd.hpp"
+
+namespace space
+{
+    namespace terrain_kernels
+    {
+        namespace
+        {
+            struct Avx2Ops
+            {
+                using Float = __m256;
+                using Int = __m256i;
+
+                static Float set1(float value) { return _mm256_set1_ps(value); }
+                static Float iota() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+
+                static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+                static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+                static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+                static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+                static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+
+                static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+                static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+
+                // Toward zero, as (float)(int)a
+                static Float truncate(Float a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a)); }
+
+                static Float floor(Float a) { return _mm256_floor_ps(a); }
+                static Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+                // 32-bit lanes, wrapping as unsigned arithmetic does
+                static Int set1i(unsigned int value) { return _mm256_set1_epi32(int(value)); }
+                static Int toInt(Float a) { return _mm256_cvttps_epi32(a); }
+                static Float toFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+
+                static Int addi(Int a, Int b) { return _mm256_add_epi32(a, b); }
+                static Int muli(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+                static Int xori(Int a, Int b) { return _mm256_xor_si256(a, b); }
+
+                template<int N> static Int shiftLeft(Int a) { return _mm256_slli_epi32(a, N); }
+                template<int N> static Int shiftRight(Int a) { return _mm256_srli_epi32(a, N); }
+                template<int N> static Int shiftRightSigned(Int a) { return _mm256_srai_epi32(a, N); }
+
+                static Float load(const float* p) { return _mm256_loadu_ps(p); }
+                static void store(float* p, Float a) { _mm256_storeu_ps(p, a); }
+
+                // base[(int(row) * row_stride + int(column)) * stride] per lane
+                static Float gather(const float* base, Float row, Float column, int row_stride, int stride)
+                {
+                    __m256i offsets = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(row), _mm256_set1_epi32(row_stride)), _mm256_cvttps_epi32(column));
+
+                    return _mm256_i32gather_ps(base, _mm256_mullo_epi32(offsets, _mm256_set1_epi32(stride)), 4);
+                }
+
+                static Float lessThan(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+
+                // mask ? a : b
+                static Float select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+
+                /**
+                * Splits 8 RGB texels (24 bytes) in three float vectors. The two 16-byte loads
+                * overlap, so nothing past the 24th byte is read.
+                */
+                static void loadRgb8(const unsigned char* rgb, Float& r, Float& g, Float& b)
+                {
+                    __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb));         // Texels 0-3 at bytes 0-11
+                    __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 8));    // Texels 4-7 at bytes 4-15
+
+                    // Same byte shuffle in both 128-bit lanes, with the texels 4-7 in the high one
+                    __m256i texels = _mm256_setr_m128i(first, second);
+
+                    const __m256i red = _mm256_setr_epi8(
+                        0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1,
+                        4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1, 13, -1, -1, -1);
+                    const __m256i next = _mm256_set1_epi32(1);
+
+                    r = _mm256_cvtepi32_ps(_mm256_shuffle_epi8(texels, red));
+                    g = _mm256_cvtepi32_ps(_mm256_shuffle_epi8(texels, _mm256_add_epi32(red, next)));
+                    b = _mm256_cvtepi32_ps(_mm256_shuffle_epi8(texels, _mm256_add_epi32(red, _mm256_add_epi32(next, next))));
+                }
+
+                /**
+                * 8 xyz triplets (24 floats) to x, y and z vectors. Triplets 0-3 go to the low
+                * 128-bit lane and 4-7 to the high one; the in-lane shuffles are the SSE ones.
+                */
+                static void loadXyz8(const float* p, Float xyz[3])
+                {
+                    __m256 l0 = _mm256_setr_m128(_mm_loadu_ps(p), _mm_loadu_ps(p + 12));
+                    __m256 l1 = _mm256_setr_m128(_mm_loadu_ps(p + 4), _mm_loadu_ps(p + 16));
+                    __m256 l2 = _mm256_setr_m128(_mm_loadu_ps(p + 8), _mm_loadu_ps(p + 20));
+
+                    __m256 t0 = _mm256_shuffle_ps(l0, l1, _MM_SHUFFLE(1, 0, 2, 1));
+                    __m256 t1 = _mm256_shuffle_ps(l1, l2, _MM_SHUFFLE(2, 1, 3, 2));
+                    __m256 t2 = _mm256_shuffle_ps(l2, l2, _MM_SHUFFLE(3, 0, 3, 0));
+
+                    xyz[0] = _mm256_shuffle_ps(l0, t1, _MM_SHUFFLE(2, 0, 3, 0));
+                    xyz[1] = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 1, 2, 0));
+                    xyz[2] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 3, 1));
+                }
+
+                static void storeXyz8(float* p, Float x, Float y, Float z)
+                {
+                    __m256 a = _mm256_unpacklo_ps(x, y);
+                    __m256 b = _mm256_unpackhi_ps(x, y);
+                    __m256 c = _mm256_shuffle_ps(z, a, _MM_SHUFFLE(2, 2, 0, 0));
+                    __m256 d = _mm256_shuffle_ps(a, z, _MM_SHUFFLE(1, 1, 3, 3));
+                    __m256 e = _mm256_shuffle_ps(z, b, _MM_SHUFFLE(2, 2, 2, 2));
+                    __m256 f = _mm256_shuffle_ps(b, z, _MM_SHUFFLE(3, 3, 3, 3));
+
+                    __m256 out0 = _mm256_shuffle_ps(a, c, _MM_SHUFFLE(2, 0, 1, 0));
+                    __m256 out1 = _mm256_shuffle_ps(d, b, _MM_SHUFFLE(1, 0, 2, 0));
+                    __m256 out2 = _mm256_shuffle_ps(e, f, _MM_SHUFFLE(2, 0, 2, 0));
+
+                    _mm_storeu_ps(p, _mm256_castps256_ps128(out0));
+                    _mm_storeu_ps(p + 4, _mm256_castps256_ps128(out1));
+                    _mm_storeu_ps(p + 8, _mm256_castps256_ps128(out2));
+                    _mm_storeu_ps(p + 12, _mm256_extractf128_ps(out0, 1));
+                    _mm_storeu_ps(p + 16, _mm256_extractf128_ps(out1, 1));
+                    _mm_storeu_ps(p + 20, _mm256_extractf128_ps(out2, 1));
+                }
+            };
+        }
+
+        namespace detail
+        {
+            int buildVertexRowAvx2(const unsigned char* rgb_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row)
+            {
+                return buildVertexRowSimd<Avx2Ops>(rgb_row, width, height, z, height_scale, vertex_row, color_row);
+            }
+
+            int buildNormalRowAvx2(const float* up_row, const float* vertex_row, const float* down_row, int width, float* normal_row)
+            {
+                return buildNormalRowSimd<Avx2Ops>(up_row, vertex_row, down_row, width, normal_row);
+            }
+
+            int sampleBilinearAvx2(const float* heights, int stride, int width, int height, const float* tx, const float* tz, int count,
+                float* out_height, float* dx, float* dz)
+            {
+                return sampleBilinearSimd<Avx2Ops>(heights, stride, width, height, tx, tz, count, out_height, dx, dz);
+            }
+
+            int noiseRowAvx2(const NoiseOctaves& octaves, float x, float z, float step, int count, float* out)
+            {
+                return noiseRowSimd<Avx2Ops>(octaves, x, z, step, count, out);
+            }
+        }
+    }
+}
+
+#endif
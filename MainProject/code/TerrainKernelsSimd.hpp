@@ -0,0 +1,316 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "TerrainKernels.hpp"
+
+/**
+* Vector bodies of the terrain kernels, written once over an Ops type that provides 8-wide
+* float operations (and 32-bit integer ones for the noise hash). Only included by TerrainKernelsSse41.cpp and TerrainKernelsAvx2.cpp,
+* each with its own Ops in an anonymous namespace, so every instantiation stays local to
+* the translation unit compiled for its instruction set.
+*/
+
+namespace space
+{
+    namespace terrain_kernels
+    {
+        namespace
+        {
+            template<typename Ops>
+            int buildVertexRowSimd(const unsigned char* rgb_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row)
+            {
+                using Float = typename Ops::Float;
+
+                const Float width_minus_one = Ops::set1(float(width - 1));
+                const Float half = Ops::set1(0.5f);
+                const Float extent = Ops::set1(EXTENT);
+                const Float z_position = Ops::set1(((float)z / (height - 1) - 0.5f) * EXTENT);
+
+                const Float red_weight = Ops::set1(RED_WEIGHT);
+                const Float green_weight = Ops::set1(GREEN_WEIGHT);
+                const Float blue_weight = Ops::set1(BLUE_WEIGHT);
+                const Float max_texel = Ops::set1(255.0f);
+                const Float scale = Ops::set1(height_scale);
+                const Float height_range = Ops::set1(HEIGHT_RANGE);
+                const Float normalize_height = Ops::set1(HEIGHT_RANGE * height_scale);
+
+                const Float lane = Ops::iota();
+
+                int x = 0;
+
+                for (; x + 8 <= width; x += 8)
+                {
+                    Float r, g, b;
+                    Ops::loadRgb8(rgb_row + x * 3, r, g, b);
+
+                    Float x_position = Ops::mul(Ops::sub(Ops::div(Ops::add(Ops::set1(float(x)), lane), width_minus_one), half), extent);
+
+                    Float gray = Ops::add(Ops::add(Ops::mul(red_weight, r), Ops::mul(green_weight, g)), Ops::mul(blue_weight, b));
+                    Float y_position = Ops::mul(Ops::mul(Ops::div(gray, max_texel), scale), height_range);
+
+                    Ops::storeXyz8(vertex_row + x * 3, x_position, y_position, z_position);
+
+                    // Pick the ramp segment per lane, from the top one down, as the scalar if/else chain does
+                    Float normalized = Ops::div(y_position, normalize_height);
+
+                    const int top = RAMP_SEGMENTS - 1;
+                    Float start = Ops::set1(RAMP_STARTS[top]);
+                    Float length = Ops::set1(RAMP_LENGTHS[top]);
+                    Float base[3], delta[3];
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        base[c] = Ops::set1(RAMP_COLORS[top][c]);
+                        delta[c] = Ops::set1(RAMP_COLORS[top + 1][c] - RAMP_COLORS[top][c]);
+                    }
+
+                    for (int segment = top - 1; segment >= 0; --segment)
+                    {
+                        auto below = Ops::lessThan(normalized, Ops::set1(RAMP_STARTS[segment + 1]));
+
+                        start = Ops::select(below, Ops::set1(RAMP_STARTS[segment]), start);
+                        length = Ops::select(below, Ops::set1(RAMP_LENGTHS[segment]), length);
+
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            base[c] = Ops::select(below, Ops::set1(RAMP_COLORS[segment][c]), base[c]);
+                            delta[c] = Ops::select(below, Ops::set1(RAMP_COLORS[segment + 1][c] - RAMP_COLORS[segment][c]), delta[c]);
+                        }
+                    }
+
+                    Float t = Ops::div(Ops::sub(normalized, start), length);
+
+                    Ops::storeXyz8(color_row + x * 3,
+                        Ops::add(base[0], Ops::mul(t, delta[0])),
+                        Ops::add(base[1], Ops::mul(t, delta[1])),
+                        Ops::add(base[2], Ops::mul(t, delta[2])));
+                }
+
+                return x;
+            }
+
+            template<typename Ops>
+            int buildNormalRowSimd(const float* up_row, const float* vertex_row, const float* down_row, int width, float* normal_row)
+            {
+                using Float = typename Ops::Float;
+
+                const Float one = Ops::set1(1.0f);
+
+                int x = 1;
+
+                for (; x + 8 <= width - 1; x += 8)
+                {
+                    Float left[3], right[3], up[3], down[3];
+                    Ops::loadXyz8(vertex_row + (x - 1) * 3, left);
+                    Ops::loadXyz8(vertex_row + (x + 1) * 3, right);
+                    Ops::loadXyz8(up_row + x * 3, up);
+                    Ops::loadXyz8(down_row + x * 3, down);
+
+                    // normalize(cross(down - up, right - left)) with glm's operation order
+                    Float a[3], b[3];
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        a[c] = Ops::sub(down[c], up[c]);
+                        b[c] = Ops::sub(right[c], left[c]);
+                    }
+
+                    Float nx = Ops::sub(Ops::mul(a[1], b[2]), Ops::mul(b[1], a[2]));
+                    Float ny = Ops::sub(Ops::mul(a[2], b[0]), Ops::mul(b[2], a[0]));
+                    Float nz = Ops::sub(Ops::mul(a[0], b[1]), Ops::mul(b[0], a[1]));
+
+                    Float length_squared = Ops::add(Ops::add(Ops::mul(nx, nx), Ops::mul(ny, ny)), Ops::mul(nz, nz));
+                    Float inverse_length = Ops::div(one, Ops::sqrt(length_squared));
+
+                    Ops::storeXyz8(normal_row + x * 3, Ops::mul(nx, inverse_length), Ops::mul(ny, inverse_length), Ops::mul(nz, inverse_length));
+                }
+
+                return x;
+            }
+
+            template<typename Ops>
+            int sampleBilinearSimd(const float* heights, int stride, int width, int height, const float* tx, const float* tz, int count,
+                float* out_height, float* dx, float* dz)
+            {
+                using Float = typename Ops::Float;
+
+                const Float zero = Ops::set1(0.0f);
+                const Float one = Ops::set1(1.0f);
+                const Float last_x = Ops::set1(float(width - 1));
+                const Float last_z = Ops::set1(float(height - 1));
+
+                int i = 0;
+
+                for (; i + 8 <= count; i += 8)
+                {
+                    Float fx = Ops::min(Ops::max(Ops::load(tx + i), zero), last_x);
+                    Float fz = Ops::min(Ops::max(Ops::load(tz + i), zero), last_z);
+
+                    Float x0 = Ops::truncate(fx);
+                    Float z0 = Ops::truncate(fz);
+                    Float x1 = Ops::min(Ops::add(x0, one), last_x);
+                    Float z1 = Ops::min(Ops::add(z0, one), last_z);
+
+                    Float wx = Ops::sub(fx, x0);
+                    Float wz = Ops::sub(fz, z0);
+
+                    Float h00 = Ops::gather(heights, z0, x0, width, stride);
+                    Float h10 = Ops::gather(heights, z0, x1, width, stride);
+                    Float h01 = Ops::gather(heights, z1, x0, width, stride);
+                    Float h11 = Ops::gather(heights, z1, x1, width, stride);
+
+                    Float rx = Ops::sub(one, wx);
+                    Float rz = Ops::sub(one, wz);
+
+                    Float h0 = Ops::add(Ops::mul(h00, rx), Ops::mul(h10, wx));
+                    Float h1 = Ops::add(Ops::mul(h01, rx), Ops::mul(h11, wx));
+
+                    Ops::store(out_height + i, Ops::add(Ops::mul(h0, rz), Ops::mul(h1, wz)));
+
+                    if (dx && dz)
+                    {
+                        Ops::store(dx + i, Ops::add(Ops::mul(Ops::sub(h10, h00), rz), Ops::mul(Ops::sub(h11, h01), wz)));
+                        Ops::store(dz + i, Ops::add(Ops::mul(Ops::sub(h01, h00), rx), Ops::mul(Ops::sub(h11, h10), wx)));
+                    }
+                }
+
+                return i;
+            }
+
+            // hashGradient of TerrainKernels.cpp on 8 cells
+            template<typename Ops>
+            void hashGradient(typename Ops::Int ix, typename Ops::Int iz, typename Ops::Int seed, typename Ops::Float& gx, typename Ops::Float& gz)
+            {
+                using Int = typename Ops::Int;
+                using namespace detail;
+
+                const typename Ops::Float gradient_scale = Ops::set1(NOISE_GRADIENT_SCALE);
+
+                Int h = Ops::xori(Ops::xori(Ops::muli(ix, Ops::set1i(NOISE_PRIME_X)), Ops::muli(iz, Ops::set1i(NOISE_PRIME_Z))), seed);
+                h = Ops::muli(Ops::xori(h, Ops::template shiftRight<16>(h)), Ops::set1i(NOISE_MIX_1));
+                h = Ops::muli(Ops::xori(h, Ops::template shiftRight<15>(h)), Ops::set1i(NOISE_MIX_2));
+                h = Ops::xori(h, Ops::template shiftRight<16>(h));
+
+                gx = Ops::mul(Ops::toFloat(Ops::template shiftRightSigned<16>(h)), gradient_scale);
+                gz = Ops::mul(Ops::toFloat(Ops::template shiftRightSigned<16>(Ops::template shiftLeft<16>(h))), gradient_scale);
+            }
+
+            template<typename Ops>
+            typename Ops::Float gradientNoise(typename Ops::Float x, typename Ops::Float z, typename Ops::Int seed)
+            {
+                using Float = typename Ops::Float;
+                using Int = typename Ops::Int;
+
+                const Float one = Ops::set1(1.0f);
+                const Float six = Ops::set1(6.0f);
+                const Float fifteen = Ops::set1(15.0f);
+                const Float ten = Ops::set1(10.0f);
+                const Int next = Ops::set1i(1);
+
+                Float cell_x = Ops::floor(x);
+                Float cell_z = Ops::floor(z);
+
+                Int ix = Ops::toInt(cell_x);
+                Int iz = Ops::toInt(cell_z);
+
+                Float fx = Ops::sub(x, cell_x);
+                Float fz = Ops::sub(z, cell_z);
+
+                Float u = Ops::mul(Ops::mul(Ops::mul(fx, fx), fx), Ops::add(Ops::mul(fx, Ops::sub(Ops::mul(fx, six), fifteen)), ten));
+                Float v = Ops::mul(Ops::mul(Ops::mul(fz, fz), fz), Ops::add(Ops::mul(fz, Ops::sub(Ops::mul(fz, six), fifteen)), ten));
+
+                Float fx1 = Ops::sub(fx, one);
+                Float fz1 = Ops::sub(fz, one);
+
+                Float gx, gz;
+
+                hashGradient<Ops>(ix, iz, seed, gx, gz);
+                Float d00 = Ops::add(Ops::mul(gx, fx), Ops::mul(gz, fz));
+
+                hashGradient<Ops>(Ops::addi(ix, next), iz, seed, gx, gz);
+                Float d10 = Ops::add(Ops::mul(gx, fx1), Ops::mul(gz, fz));
+
+                hashGradient<Ops>(ix, Ops::addi(iz, next), seed, gx, gz);
+                Float d01 = Ops::add(Ops::mul(gx, fx), Ops::mul(gz, fz1));
+
+                hashGradient<Ops>(Ops::addi(ix, next), Ops::addi(iz, next), seed, gx, gz);
+                Float d11 = Ops::add(Ops::mul(gx, fx1), Ops::mul(gz, fz1));
+
+                Float n0 = Ops::add(d00, Ops::mul(u, Ops::sub(d10, d00)));
+                Float n1 = Ops::add(d01, Ops::mul(u, Ops::sub(d11, d01)));
+
+                return Ops::add(n0, Ops::mul(v, Ops::sub(n1, n0)));
+            }
+
+            template<typename Ops>
+            int noiseRowSimd(const detail::NoiseOctaves& octaves, float x, float z, float step, int count, float* out)
+            {
+                using Float = typename Ops::Float;
+                using namespace detail;
+
+                const Float zero = Ops::set1(0.0f);
+                const Float one = Ops::set1(1.0f);
+                const Float two = Ops::set1(2.0f);
+                const Float half = Ops::set1(0.5f);
+                const Float frequency = Ops::set1(octaves.frequency);
+                const Float warp = Ops::set1(octaves.warp);
+                const Float warp_normalize = Ops::set1(NOISE_WARP_NORMALIZE);
+                const Float ridge_weight = Ops::set1(NOISE_RIDGE_WEIGHT);
+                const Float bias = Ops::set1(octaves.bias);
+                const Float scale = Ops::set1(octaves.scale);
+                const Float start = Ops::set1(x);
+                const Float spacing = Ops::set1(step);
+                const Float lane = Ops::iota();
+
+                const Float pz_row = Ops::mul(Ops::set1(z), frequency);
+
+                int i = 0;
+
+                for (; i + 8 <= count; i += 8)
+                {
+                    Float px = Ops::mul(Ops::add(start, Ops::mul(Ops::add(Ops::set1(float(i)), lane), spacing)), frequency);
+                    Float pz = pz_row;
+
+                    if (octaves.warp != 0.0f)
+                    {
+                        Float warp_x = Ops::mul(Ops::add(gradientNoise<Ops>(px, pz, Ops::set1i(octaves.warp_seed_x)),
+                            Ops::mul(gradientNoise<Ops>(Ops::mul(px, two), Ops::mul(pz, two), Ops::set1i(octaves.warp_seed_x + NOISE_OCTAVE_SEED)), half)), warp_normalize);
+                        Float warp_z = Ops::mul(Ops::add(gradientNoise<Ops>(px, pz, Ops::set1i(octaves.warp_seed_z)),
+                            Ops::mul(gradientNoise<Ops>(Ops::mul(px, two), Ops::mul(pz, two), Ops::set1i(octaves.warp_seed_z + NOISE_OCTAVE_SEED)), half)), warp_normalize);
+
+                        px = Ops::add(px, Ops::mul(warp, warp_x));
+                        pz = Ops::add(pz, Ops::mul(warp, warp_z));
+                    }
+
+                    Float sum = zero;
+                    Float weight = one;
+
+                    for (int octave = 0; octave < octaves.count; ++octave)
+                    {
+                        const Float octave_frequency = Ops::set1(octaves.frequencies[octave]);
+
+                        Float n = gradientNoise<Ops>(Ops::mul(px, octave_frequency), Ops::mul(pz, octave_frequency), Ops::set1i(octaves.seeds[octave]));
+
+                        if (octaves.ridged)
+                        {
+                            Float ridge = Ops::sub(one, Ops::abs(n));
+                            ridge = Ops::mul(Ops::mul(ridge, ridge), weight);
+                            weight = Ops::min(Ops::mul(ridge, ridge_weight), one);
+                            n = ridge;
+                        }
+
+                        sum = Ops::add(sum, Ops::mul(n, Ops::set1(octaves.amplitudes[octave])));
+                    }
+
+                    Ops::store(out + i, Ops::min(Ops::max(Ops::add(bias, Ops::mul(sum, scale)), zero), one));
+                }
+
+                return i;
+            }
+        }
+    }
+}
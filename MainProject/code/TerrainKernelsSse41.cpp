@@ -0,0 +1,176 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+// Compiled with SSE4.1 enabled (-msse4.1); only called after the runtime check
+
+#include "TerrainKernels.hpp"
+
+#ifdef SPACE_SIMD_X86
+
+#include <smmintrin.h>
+
+#include "TerrainKernelsSimd.hpp"
+
+namespace space
+{
+    namespace terrain_kernels
+    {
+        namespace
+        {
+            // 8 lanes as two SSE registers
+            struct Sse41Ops
+            {
+                struct Float
+                {
+                    __m128 lo, hi;
+                };
+
+                struct Int
+                {
+                    __m128i lo, hi;
+                };
+
+                static Float set1(float value) { return { _mm_set1_ps(value), _mm_set1_ps(value) }; }
+                static Float iota() { return { _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f) }; }
+
+                static Float add(Float a, Float b) { return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) }; }
+                static Float sub(Float a, Float b) { return { _mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi) }; }
+                static Float mul(Float a, Float b) { return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) }; }
+                static Float div(Float a, Float b) { return { _mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi) }; }
+                static Float sqrt(Float a) { return { _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) }; }
+
+                static Float min(Float a, Float b) { return { _mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi) }; }
+                static Float max(Float a, Float b) { return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) }; }
+
+                // Toward zero, as (float)(int)a
+                static Float truncate(Float a) { return { _mm_cvtepi32_ps(_mm_cvttps_epi32(a.lo)), _mm_cvtepi32_ps(_mm_cvttps_epi32(a.hi)) }; }
+
+                static Float floor(Float a) { return { _mm_floor_ps(a.lo), _mm_floor_ps(a.hi) }; }
+                static Float abs(Float a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.lo), _mm_andnot_ps(_mm_set1_ps(-0.0f), a.hi) }; }
+
+                // 32-bit lanes, wrapping as unsigned arithmetic does
+                static Int set1i(unsigned int value) { return { _mm_set1_epi32(int(value)), _mm_set1_epi32(int(value)) }; }
+                static Int toInt(Float a) { return { _mm_cvttps_epi32(a.lo), _mm_cvttps_epi32(a.hi) }; }
+                static Float toFloat(Int a) { return { _mm_cvtepi32_ps(a.lo), _mm_cvtepi32_ps(a.hi) }; }
+
+                static Int addi(Int a, Int b) { return { _mm_add_epi32(a.lo, b.lo), _mm_add_epi32(a.hi, b.hi) }; }
+                static Int muli(Int a, Int b) { return { _mm_mullo_epi32(a.lo, b.lo), _mm_mullo_epi32(a.hi, b.hi) }; }
+                static Int xori(Int a, Int b) { return { _mm_xor_si128(a.lo, b.lo), _mm_xor_si128(a.hi, b.hi) }; }
+
+                template<int N> static Int shiftLeft(Int a) { return { _mm_slli_epi32(a.lo, N), _mm_slli_epi32(a.hi, N) }; }
+                template<int N> static Int shiftRight(Int a) { return { _mm_srli_epi32(a.lo, N), _mm_srli_epi32(a.hi, N) }; }
+                template<int N> static Int shiftRightSigned(Int a) { return { _mm_srai_epi32(a.lo, N), _mm_srai_epi32(a.hi, N) }; }
+
+                static Float load(const float* p) { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+                static void store(float* p, Float a) { _mm_storeu_ps(p, a.lo); _mm_storeu_ps(p + 4, a.hi); }
+
+                // base[(int(row) * row_stride + int(column)) * stride] per lane; no gather in SSE, one load each
+                static Float gather(const float* base, Float row, Float column, int row_stride, int stride)
+                {
+                    const __m128i row_step = _mm_set1_epi32(row_stride);
+                    const __m128i step = _mm_set1_epi32(stride);
+
+                    alignas(16) int offsets[8];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(offsets), _mm_mullo_epi32(_mm_add_epi32(_mm_mullo_epi32(_mm_cvttps_epi32(row.lo), row_step), _mm_cvttps_epi32(column.lo)), step));
+                    _mm_store_si128(reinterpret_cast<__m128i*>(offsets + 4), _mm_mullo_epi32(_mm_add_epi32(_mm_mullo_epi32(_mm_cvttps_epi32(row.hi), row_step), _mm_cvttps_epi32(column.hi)), step));
+
+                    return { _mm_setr_ps(base[offsets[0]], base[offsets[1]], base[offsets[2]], base[offsets[3]]),
+                        _mm_setr_ps(base[offsets[4]], base[offsets[5]], base[offsets[6]], base[offsets[7]]) };
+                }
+
+                static Float lessThan(Float a, Float b) { return { _mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi) }; }
+
+                // mask ? a : b
+                static Float select(Float mask, Float a, Float b) { return { _mm_blendv_ps(b.lo, a.lo, mask.lo), _mm_blendv_ps(b.hi, a.hi, mask.hi) }; }
+
+                /**
+                * Splits 8 RGB texels (24 bytes) in three float vectors. The two 16-byte loads
+                * overlap, so nothing past the 24th byte is read.
+                */
+                static void loadRgb8(const unsigned char* rgb, Float& r, Float& g, Float& b)
+                {
+                    __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb));         // Texels 0-3 at bytes 0-11
+                    __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 8));    // Texels 4-7 at bytes 4-15
+
+                    const __m128i red_lo = _mm_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1);
+                    const __m128i red_hi = _mm_setr_epi8(4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1, 13, -1, -1, -1);
+                    const __m128i next = _mm_set1_epi32(1);
+
+                    r = { _mm_cvtepi32_ps(_mm_shuffle_epi8(first, red_lo)), _mm_cvtepi32_ps(_mm_shuffle_epi8(second, red_hi)) };
+                    g = { _mm_cvtepi32_ps(_mm_shuffle_epi8(first, _mm_add_epi32(red_lo, next))), _mm_cvtepi32_ps(_mm_shuffle_epi8(second, _mm_add_epi32(red_hi, next))) };
+                    b = { _mm_cvtepi32_ps(_mm_shuffle_epi8(first, _mm_add_epi32(red_lo, _mm_add_epi32(next, next)))), _mm_cvtepi32_ps(_mm_shuffle_epi8(second, _mm_add_epi32(red_hi, _mm_add_epi32(next, next)))) };
+                }
+
+                // 4 xyz triplets (12 floats) to x, y and z vectors
+                static void loadXyz4(const float* p, __m128& x, __m128& y, __m128& z)
+                {
+                    __m128 l0 = _mm_loadu_ps(p);            // x0 y0 z0 x1
+                    __m128 l1 = _mm_loadu_ps(p + 4);        // y1 z1 x2 y2
+                    __m128 l2 = _mm_loadu_ps(p + 8);        // z2 x3 y3 z3
+
+                    __m128 t0 = _mm_shuffle_ps(l0, l1, _MM_SHUFFLE(1, 0, 2, 1));    // y0 z0 y1 z1
+                    __m128 t1 = _mm_shuffle_ps(l1, l2, _MM_SHUFFLE(2, 1, 3, 2));    // x2 y2 x3 y3
+                    __m128 t2 = _mm_shuffle_ps(l2, l2, _MM_SHUFFLE(3, 0, 3, 0));    // z2 z3 z2 z3
+
+                    x = _mm_shuffle_ps(l0, t1, _MM_SHUFFLE(2, 0, 3, 0));
+                    y = _mm_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 1, 2, 0));
+                    z = _mm_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 3, 1));
+                }
+
+                static void storeXyz4(float* p, __m128 x, __m128 y, __m128 z)
+                {
+                    __m128 a = _mm_unpacklo_ps(x, y);                               // x0 y0 x1 y1
+                    __m128 b = _mm_unpackhi_ps(x, y);                               // x2 y2 x3 y3
+                    __m128 c = _mm_shuffle_ps(z, a, _MM_SHUFFLE(2, 2, 0, 0));       // z0 z0 x1 x1
+                    __m128 d = _mm_shuffle_ps(a, z, _MM_SHUFFLE(1, 1, 3, 3));       // y1 y1 z1 z1
+                    __m128 e = _mm_shuffle_ps(z, b, _MM_SHUFFLE(2, 2, 2, 2));       // z2 z2 x3 x3
+                    __m128 f = _mm_shuffle_ps(b, z, _MM_SHUFFLE(3, 3, 3, 3));       // y3 y3 z3 z3
+
+                    _mm_storeu_ps(p, _mm_shuffle_ps(a, c, _MM_SHUFFLE(2, 0, 1, 0)));
+                    _mm_storeu_ps(p + 4, _mm_shuffle_ps(d, b, _MM_SHUFFLE(1, 0, 2, 0)));
+                    _mm_storeu_ps(p + 8, _mm_shuffle_ps(e, f, _MM_SHUFFLE(2, 0, 2, 0)));
+                }
+
+                static void loadXyz8(const float* p, Float xyz[3])
+                {
+                    loadXyz4(p, xyz[0].lo, xyz[1].lo, xyz[2].lo);
+                    loadXyz4(p + 12, xyz[0].hi, xyz[1].hi, xyz[2].hi);
+                }
+
+                static void storeXyz8(float* p, Float x, Float y, Float z)
+                {
+                    storeXyz4(p, x.lo, y.lo, z.lo);
+                    storeXyz4(p + 12, x.hi, y.hi, z.hi);
+                }
+            };
+        }
+
+        namespace detail
+        {
+            int buildVertexRowSse41(const unsigned char* rgb_row, int width, int height, int z, float height_scale, float* vertex_row, float* color_row)
+            {
+                return buildVertexRowSimd<Sse41Ops>(rgb_row, width, height, z, height_scale, vertex_row, color_row);
+            }
+
+            int buildNormalRowSse41(const float* up_row, const float* vertex_row, const float* down_row, int width, float* normal_row)
+            {
+                return buildNormalRowSimd<Sse41Ops>(up_row, vertex_row, down_row, width, normal_row);
+            }
+
+            int sampleBilinearSse41(const float* heights, int stride, int width, int height, const float* tx, const float* tz, int count,
+                float* out_height, float* dx, float* dz)
+            {
+                return sampleBilinearSimd<Sse41Ops>(heights, stride, width, height, tx, tz, count, out_height, dx, dz);
+            }
+
+            int noiseRowSse41(const NoiseOctaves& octaves, float x, float z, float step, int count, float* out)
+            {
+                return noiseRowSimd<Sse41Ops>(octaves, x, z, step, count, out);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,302 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "TerrainMeshCache.hpp"
+#include "CpuProfiler.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace space
+{
+    namespace
+    {
+        const char CACHE_MAGIC[8] = { 'S', 'P', 'T', 'R', 'M', 'S', 'H', '\0' };
+
+        // Vertex bytes start on a page boundary, index bytes right after on a 16 byte one
+        constexpr size_t VERTEX_ALIGNMENT = 4096;
+        constexpr size_t INDEX_ALIGNMENT = 16;
+
+        size_t alignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        uint64_t rotateLeft(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        // Final avalanche of MurmurHash3
+        uint64_t mix(uint64_t value)
+        {
+            value ^= value >> 33;
+            value *= 0xFF51AFD7ED558CCDull;
+            value ^= value >> 33;
+            value *= 0xC4CEB9FE1A85EC53ull;
+            value ^= value >> 33;
+            return value;
+        }
+
+        void toArray(const glm::vec3& vector, float* array)
+        {
+            array[0] = vector.x;
+            array[1] = vector.y;
+            array[2] = vector.z;
+        }
+
+        glm::vec3 fromArray(const float* array)
+        {
+            return glm::vec3(array[0], array[1], array[2]);
+        }
+
+        std::string& directory()
+        {
+            static std::string value;
+            return value;
+        }
+    }
+
+    void TerrainMeshCache::setDirectory(const std::string& path)
+    {
+        directory() = path;
+    }
+
+    const std::string& TerrainMeshCache::getDirectory()
+    {
+        return directory();
+    }
+
+    uint64_t TerrainMeshCache::hash(const void* data, size_t bytes, uint64_t seed)
+    {
+        constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+        // Four independent lanes so the multiplies overlap, merged at the end
+        const unsigned char* bytePointer = static_cast<const unsigned char*>(data);
+        uint64_t lanes[4] = { seed + PRIME_1, seed + PRIME_2, seed, seed - PRIME_1 };
+
+        size_t offset = 0;
+
+        for (; offset + 32 <= bytes; offset += 32)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                uint64_t word;
+                std::memcpy(&word, bytePointer + offset + lane * 8, sizeof(word));
+                lanes[lane] = rotateLeft(lanes[lane] + word * PRIME_2, 31) * PRIME_1;
+            }
+        }
+
+        uint64_t result = bytes;
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            result = rotateLeft(result ^ mix(lanes[lane]), 27) * PRIME_1;
+        }
+
+        // Up to 31 bytes left, one at a time
+        for (; offset < bytes; ++offset)
+        {
+            result = rotateLeft(result ^ (bytePointer[offset] * PRIME_2), 11) * PRIME_1;
+        }
+
+        return mix(result);
+    }
+
+    bool TerrainMeshCache::makeKey(const std::string& path, float heightScale, uint32_t renderMode, uint32_t indexMode, uint64_t generation, Key& key)
+    {
+        SPACE_PROFILE_ZONE("TerrainMeshCache::makeKey");
+
+        MappedFile heightmap;
+
+        if (!heightmap.open(path)) return false;
+
+        key = Key{};
+        key.contentHash = hash(heightmap.getData(), heightmap.getSize());
+        key.contentSize = heightmap.getSize();
+        key.generation = generation;
+        key.heightScale = heightScale;
+        key.renderMode = renderMode;
+        key.indexMode = indexMode;
+
+        return true;
+    }
+
+    std::string TerrainMeshCache::getPath(const Key& key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.terrain", static_cast<unsigned long long>(hash(&key, sizeof(key))));
+
+        return (std::filesystem::path(getDirectory()) / name).string();
+    }
+
+    bool TerrainMeshCache::write(const Key& key, const Contents& contents)
+    {
+        SPACE_PROFILE_ZONE("TerrainMeshCache::write");
+
+        const std::string path = getPath(key);
+        const std::string temporaryPath = path + ".tmp";
+
+        std::error_code error;
+        std::filesystem::create_directories(getDirectory(), error);
+
+        Header header{};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = VERSION;
+        header.key = key;
+        header.width = contents.width;
+        header.height = contents.height;
+        header.primitiveType = contents.primitiveType;
+        header.indexType = contents.indexType;
+        header.vertexStride = contents.vertexStride;
+        header.rangeCount = uint32_t(contents.ranges.size());
+        toArray(contents.vertexDecode.position_offset, header.positionOffset);
+        toArray(contents.vertexDecode.position_scale, header.positionScale);
+        header.octahedralNormals = contents.vertexDecode.octahedral_normals ? 1 : 0;
+        toArray(contents.bounds.min, header.boundsMin);
+        toArray(contents.bounds.max, header.boundsMax);
+        toArray(contents.heightfieldBounds.min, header.heightfieldMin);
+        toArray(contents.heightfieldBounds.max, header.heightfieldMax);
+        header.heightCount = contents.heightCount;
+        header.vertexBytes = contents.vertexBytes;
+        header.indexBytes = contents.indexBytes;
+
+        std::vector<RangeEntry> ranges;
+        ranges.reserve(contents.ranges.size());
+
+        for (const Mesh::IndexRange& range : contents.ranges)
+        {
+            ranges.push_back({ uint64_t(range.first), int32_t(range.count), int32_t(range.base_vertex) });
+        }
+
+        const size_t tablesSize = sizeof(Header) + ranges.size() * sizeof(RangeEntry) + contents.heightCount * sizeof(float);
+
+        header.vertexOffset = alignUp(tablesSize, VERTEX_ALIGNMENT);
+        header.indexOffset = alignUp(header.vertexOffset + contents.vertexBytes, INDEX_ALIGNMENT);
+
+        std::vector<char> vertexPadding(header.vertexOffset - tablesSize, 0);
+        std::vector<char> indexPadding(header.indexOffset - header.vertexOffset - contents.vertexBytes, 0);
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+            if (!file)
+            {
+                std::cerr << "Failed to create the terrain mesh cache " << temporaryPath << std::endl;
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(ranges.data()), ranges.size() * sizeof(RangeEntry));
+            file.write(reinterpret_cast<const char*>(contents.heights), contents.heightCount * sizeof(float));
+            file.write(vertexPadding.data(), vertexPadding.size());
+            file.write(static_cast<const char*>(contents.vertexData), contents.vertexBytes);
+            file.write(indexPadding.data(), indexPadding.size());
+            file.write(static_cast<const char*>(contents.indexData), contents.indexBytes);
+
+            if (!file)
+            {
+                std::cerr << "Failed to write the terrain mesh cache " << temporaryPath << std::endl;
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, path, error);
+
+        if (error)
+        {
+            std::cerr << "Failed to write the terrain mesh cache " << path << ": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool TerrainMeshCache::open(const Key& key)
+    {
+        close();
+
+        const std::string path = getPath(key);
+
+        // A miss is the normal case on the first run, not an error
+        std::error_code error;
+        if (!std::filesystem::exists(path, error)) return false;
+
+        if (!file.open(path)) return false;
+
+        const unsigned char* data = file.getData();
+        const size_t size = file.getSize();
+
+        Header header;
+
+        if (size < sizeof(Header))
+        {
+            std::cerr << "Truncated terrain mesh cache " << path << std::endl;
+            close();
+            return false;
+        }
+
+        std::memcpy(&header, data, sizeof(Header));
+
+        if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != VERSION
+            || std::memcmp(&header.key, &key, sizeof(Key)) != 0)
+        {
+            std::cerr << path << " is not a version " << VERSION << " terrain mesh cache of this heightmap" << std::endl;
+            close();
+            return false;
+        }
+
+        const size_t tablesSize = sizeof(Header) + size_t(header.rangeCount) * sizeof(RangeEntry) + size_t(header.heightCount) * sizeof(float);
+
+        if (header.width < 2 || header.height < 2 || header.vertexOffset < tablesSize || header.indexOffset < header.vertexOffset + header.vertexBytes
+            || size < header.indexOffset + header.indexBytes)
+        {
+            std::cerr << "Corrupt terrain mesh cache " << path << std::endl;
+            close();
+            return false;
+        }
+
+        const RangeEntry* ranges = reinterpret_cast<const RangeEntry*>(data + sizeof(Header));
+
+        contents.width = header.width;
+        contents.height = header.height;
+        contents.primitiveType = header.primitiveType;
+        contents.indexType = header.indexType;
+        contents.vertexStride = header.vertexStride;
+        contents.vertexDecode.position_offset = fromArray(header.positionOffset);
+        contents.vertexDecode.position_scale = fromArray(header.positionScale);
+        contents.vertexDecode.octahedral_normals = header.octahedralNormals != 0;
+        contents.bounds = BoundingBox(fromArray(header.boundsMin), fromArray(header.boundsMax));
+        contents.heightfieldBounds = BoundingBox(fromArray(header.heightfieldMin), fromArray(header.heightfieldMax));
+
+        for (uint32_t i = 0; i < header.rangeCount; ++i)
+        {
+            contents.ranges.push_back({ size_t(ranges[i].first), GLsizei(ranges[i].count), GLint(ranges[i].baseVertex) });
+        }
+
+        contents.heights = reinterpret_cast<const float*>(ranges + header.rangeCount);
+        contents.heightCount = size_t(header.heightCount);
+        contents.vertexData = data + header.vertexOffset;
+        contents.vertexBytes = size_t(header.vertexBytes);
+        contents.indexData = data + header.indexOffset;
+        contents.indexBytes = size_t(header.indexBytes);
+
+        return true;
+    }
+
+    void TerrainMeshCache::close()
+    {
+        file.close();
+        contents = Contents{};
+    }
+}
@@ -0,0 +1,148 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "Bounds.hpp"
+#include "MappedFile.hpp"
+#include "Mesh.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace space
+{
+    /**
+    * Baked HeightMapTerrain buffers on disk, so later runs skip decoding the heightmap and
+    * building the mesh.
+    *
+    * A cache file is named after its Key: a hash of the heightmap file contents plus
+    * everything else the result depends on (height scale, render and index modes, and a hash
+    * of the generation constants the terrain passes in). Changing any of them, or VERSION,
+    * simply misses; stale files are never read, only left behind.
+    *
+    * File layout, little endian:
+    *   Header
+    *   RangeEntry[rangeCount]
+    *   float heights[heightCount]   (texel heights, the CPU copy every mode keeps)
+    *   vertex bytes, GPU layout     (from a page boundary)
+    *   index bytes, GPU type        (from a 16 byte boundary)
+    *
+    * The vertex and index bytes are the exact Mesh::Buffers the terrain uploads, so a hit
+    * hands pointers into the mapping straight to glBufferData.
+    */
+    class TerrainMeshCache
+    {
+    public:
+
+        static constexpr uint32_t VERSION = 1;
+
+        struct Key
+        {
+            uint64_t contentHash;       // Of the heightmap file bytes, or of the noise settings
+            uint64_t contentSize;
+            uint64_t generation;        // Hash of the generation constants
+            float heightScale;
+            uint32_t renderMode;
+            uint32_t indexMode;
+            uint32_t reserved;
+        };
+
+        struct Header
+        {
+            char magic[8];              // "SPTRMSH\0"
+            uint32_t version;
+            uint32_t reserved;
+            Key key;
+            int32_t width;              // Heightmap texels
+            int32_t height;
+            uint32_t primitiveType;
+            uint32_t indexType;
+            uint32_t vertexStride;
+            uint32_t rangeCount;
+            float positionOffset[3];    // VertexDecode of the vertex bytes
+            float positionScale[3];
+            uint32_t octahedralNormals;
+            float boundsMin[3];         // Of the uploaded vertices
+            float boundsMax[3];
+            float heightfieldMin[3];    // Of the whole heightfield
+            float heightfieldMax[3];
+            uint64_t heightCount;
+            uint64_t vertexOffset;
+            uint64_t vertexBytes;
+            uint64_t indexOffset;
+            uint64_t indexBytes;
+        };
+
+        struct RangeEntry
+        {
+            uint64_t first;
+            int32_t count;
+            int32_t baseVertex;
+        };
+
+        /**
+        * What a terrain stores and gets back. When read from a file the pointers point into
+        * the mapping, valid until the cache is closed.
+        */
+        struct Contents
+        {
+            int width = 0;
+            int height = 0;
+            GLenum primitiveType = GL_TRIANGLES;
+            GLenum indexType = GL_UNSIGNED_INT;
+            uint32_t vertexStride = 0;
+            VertexDecode vertexDecode;
+            BoundingBox bounds;
+            BoundingBox heightfieldBounds;
+            std::vector < Mesh::IndexRange > ranges;
+            const float* heights = nullptr;
+            size_t heightCount = 0;
+            const void* vertexData = nullptr;
+            size_t vertexBytes = 0;
+            const void* indexData = nullptr;
+            size_t indexBytes = 0;
+        };
+
+        // Directory the cache files go to; empty (the default) disables the cache
+        static void setDirectory(const std::string& directory);
+        static const std::string& getDirectory();
+        static bool isEnabled() { return !getDirectory().empty(); }
+
+        // 64-bit hash of bytes, 8 at a time; fast enough to key files of hundreds of MB
+        static uint64_t hash(const void* data, size_t bytes, uint64_t seed = 0);
+
+        /**
+        * Key of a terrain built from the heightmap at path. Maps and hashes the whole file;
+        * returns false if it cannot be read.
+        */
+        static bool makeKey(const std::string& path, float heightScale, uint32_t renderMode, uint32_t indexMode, uint64_t generation, Key& key);
+
+        static std::string getPath(const Key& key);
+
+        /**
+        * Writes contents under key, through a temporary file renamed into place so readers
+        * never see a partial one. Returns false (and reports why) on failure.
+        */
+        static bool write(const Key& key, const Contents& contents);
+
+        /**
+        * Maps the file of key and validates it. A missing file returns false silently, a
+        * corrupt or mismatching one is reported. The previous file, if any, is closed.
+        */
+        bool open(const Key& key);
+        void close();
+
+        bool isOpen() const { return file.isOpen(); }
+
+        const Contents& getContents() const { return contents; }
+
+    private:
+
+        MappedFile file;
+        Contents contents;
+    };
+}
@@ -0,0 +1,72 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "TerrainNoise.hpp"
+#include "CpuProfiler.hpp"
+#include "TerrainMeshCache.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace space
+{
+    namespace
+    {
+        // Rows per task, around 64k samples
+        constexpr size_t BAND_SAMPLES = 64 * 1024;
+    }
+
+    float TerrainNoise::sample(float x, float z) const
+    {
+        const terrain_kernels::NoiseParameters parameters = getParameters();
+
+        float height;
+        terrain_kernels::noiseRow(parameters, x, z, 0.0f, 1, &height);
+
+        return height;
+    }
+
+    void TerrainNoise::generate(float originX, float originZ, float spacing, int width, int height, float* heights, ThreadPool& pool) const
+    {
+        SPACE_PROFILE_ZONE("TerrainNoise::generate");
+
+        if (width <= 0 || height <= 0) return;
+
+        const terrain_kernels::NoiseParameters parameters = getParameters();
+        const size_t rowsPerBand = std::max<size_t>(1, BAND_SAMPLES / width);
+
+        pool.parallelFor(0, height, rowsPerBand, [&](size_t firstRow, size_t lastRow)
+            {
+                for (size_t z = firstRow; z < lastRow; ++z)
+                {
+                    terrain_kernels::noiseRow(parameters, originX, originZ + float(z) * spacing, spacing, width, heights + z * width);
+                }
+            });
+    }
+
+    uint64_t TerrainNoise::hash() const
+    {
+        // Field by field, so that padding never reaches the hash
+        struct Packed
+        {
+            uint32_t seed;
+            uint32_t fractal;
+            int32_t octaves;
+            float frequency;
+            float lacunarity;
+            float gain;
+            float warp;
+        };
+
+        const Packed packed{ settings.seed, uint32_t(settings.fractal), settings.octaves, settings.frequency, settings.lacunarity, settings.gain, settings.warp };
+
+        return TerrainMeshCache::hash(&packed, sizeof(packed));
+    }
+
+    terrain_kernels::NoiseParameters TerrainNoise::getParameters() const
+    {
+        return { settings.seed, settings.fractal, settings.octaves, settings.frequency, settings.lacunarity, settings.gain, settings.warp };
+    }
+}
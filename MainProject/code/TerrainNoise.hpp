@@ -0,0 +1,67 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "TerrainKernels.hpp"
+
+#include <cstdint>
+
+namespace space
+{
+    class ThreadPool;
+
+    /**
+    * Procedural heightfield over an unbounded plane: fBm, ridged multifractal and
+    * domain-warped gradient noise, for terrains generated on demand instead of shipped as
+    * heightmaps.
+    *
+    * A height depends only on the settings and the position, so any window of the plane can
+    * be generated on its own: windows that touch agree on the samples they share, and a seed
+    * gives the same heights on any thread count and SIMD level. generate() fills a window
+    * through terrain_kernels::noiseRow, 8 samples at a time, in row bands over a ThreadPool.
+    */
+    class TerrainNoise
+    {
+    public:
+
+        using Fractal = terrain_kernels::NoiseFractal;
+
+        struct Settings
+        {
+            uint32_t seed = 1;
+            Fractal fractal = Fractal::FBM;
+            int octaves = 6;                // Up to terrain_kernels::MAX_NOISE_OCTAVES
+            float frequency = 0.15f;        // Of the first octave, in cycles per plane unit
+            float lacunarity = 2.0f;        // Frequency ratio between octaves
+            float gain = 0.5f;              // Amplitude ratio between octaves
+            float warp = 0.0f;              // Domain warp offset, in first octave cycles
+        };
+
+        TerrainNoise() = default;
+        explicit TerrainNoise(const Settings& settings) : settings(settings) {}
+
+        const Settings& getSettings() const { return settings; }
+
+        // Height at a point of the plane, 0 to 1
+        float sample(float x, float z) const;
+
+        /**
+        * Heights of width x height samples spacing units apart, sample (x, z) at plane
+        * position (originX + x * spacing, originZ + z * spacing) and heights[z * width + x].
+        * Row bands go to pool; the result does not depend on how they are split.
+        */
+        void generate(float originX, float originZ, float spacing, int width, int height, float* heights, ThreadPool& pool) const;
+
+        // Everything the heights depend on, for cache keys
+        uint64_t hash() const;
+
+    private:
+
+        Settings settings;
+
+        terrain_kernels::NoiseParameters getParameters() const;
+    };
+}
@@ -0,0 +1,339 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "TerrainPyramid.hpp"
+#include "HeightmapImage.hpp"
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace space
+{
+    namespace
+    {
+        const char PYRAMID_MAGIC[8] = { 'S', 'P', 'T', 'R', 'P', 'Y', 'R', '\0' };
+
+        // Tile samples start on a page boundary, so each mapped page holds samples only
+        constexpr size_t SAMPLE_ALIGNMENT = 4096;
+
+        size_t alignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // Samples per side of a level
+        int getLevelSamples(int samples, int level)
+        {
+            return ((samples - 1 + (1 << level) - 1) >> level) + 1;
+        }
+
+        size_t getTablesSize(size_t levelCount, size_t tileCount)
+        {
+            return sizeof(TerrainPyramid::Header) + levelCount * sizeof(TerrainPyramid::LevelInfo) + tileCount * 2 * sizeof(uint16_t);
+        }
+    }
+
+    bool TerrainPyramid::write(const Source& source, int tileQuads, const std::string& path)
+    {
+        SPACE_PROFILE_ZONE("TerrainPyramid::write");
+
+        if (source.width < 2 || source.height < 2 || tileQuads < 1 || source.heightRange <= 0.0f)
+        {
+            std::cerr << "Invalid heightfield for the terrain pyramid " << path << std::endl;
+            return false;
+        }
+
+        // Levels down to the first one a single tile covers
+        std::vector<LevelInfo> levelInfos;
+        size_t tileCount = 0;
+
+        for (int level = 0; ; ++level)
+        {
+            LevelInfo info;
+            info.tilesX = uint32_t((getLevelSamples(source.width, level) - 2) / tileQuads + 1);
+            info.tilesZ = uint32_t((getLevelSamples(source.height, level) - 2) / tileQuads + 1);
+            info.firstTile = tileCount;
+
+            levelInfos.push_back(info);
+            tileCount += size_t(info.tilesX) * info.tilesZ;
+
+            if (info.tilesX == 1 && info.tilesZ == 1) break;
+        }
+
+        Header header{};
+        std::memcpy(header.magic, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC));
+        header.version = VERSION;
+        header.tileQuads = uint32_t(tileQuads);
+        header.levelCount = uint32_t(levelInfos.size());
+        header.width = uint32_t(source.width);
+        header.height = uint32_t(source.height);
+        header.spacing = source.spacing;
+        header.heightRange = source.heightRange;
+        header.originX = source.origin.x;
+        header.originZ = source.origin.y;
+
+        const int tileSamples = tileQuads + 1;
+
+        std::vector<uint16_t> heights(tileCount * 2);
+        std::vector<uint16_t> samples(size_t(tileSamples) * tileSamples);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+        if (!file)
+        {
+            std::cerr << "Failed to create the terrain pyramid " << path << std::endl;
+            return false;
+        }
+
+        // Tables first, with the heights filled in once every tile has been written
+        const size_t tablesSize = getTablesSize(levelInfos.size(), tileCount);
+        std::vector<char> padding(alignUp(tablesSize, SAMPLE_ALIGNMENT) - tablesSize, 0);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(levelInfos.data()), levelInfos.size() * sizeof(LevelInfo));
+        file.write(reinterpret_cast<const char*>(heights.data()), heights.size() * sizeof(uint16_t));
+        file.write(padding.data(), padding.size());
+
+        const float quantization = 65535.0f / source.heightRange;
+
+        for (int level = 0; level < int(levelInfos.size()); ++level)
+        {
+            const LevelInfo& info = levelInfos[level];
+
+            for (int tileZ = 0; tileZ < int(info.tilesZ); ++tileZ)
+            {
+                for (int tileX = 0; tileX < int(info.tilesX); ++tileX)
+                {
+                    uint16_t lowest = 0xFFFF;
+                    uint16_t highest = 0;
+
+                    for (int z = 0; z < tileSamples; ++z)
+                    {
+                        const int sourceZ = std::min((tileZ * tileQuads + z) << level, source.height - 1);
+                        const float* row = source.heights + size_t(sourceZ) * source.width;
+
+                        for (int x = 0; x < tileSamples; ++x)
+                        {
+                            const int sourceX = std::min((tileX * tileQuads + x) << level, source.width - 1);
+
+                            float value = std::round(std::min(std::max(row[sourceX], 0.0f), source.heightRange) * quantization);
+                            uint16_t sample = uint16_t(value);
+
+                            samples[size_t(z) * tileSamples + x] = sample;
+                            lowest = std::min(lowest, sample);
+                            highest = std::max(highest, sample);
+                        }
+                    }
+
+                    size_t tile = size_t(info.firstTile) + size_t(tileZ) * info.tilesX + tileX;
+                    heights[tile * 2] = lowest;
+                    heights[tile * 2 + 1] = highest;
+
+                    file.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(uint16_t));
+                }
+            }
+        }
+
+        file.seekp(sizeof(header) + levelInfos.size() * sizeof(LevelInfo));
+        file.write(reinterpret_cast<const char*>(heights.data()), heights.size() * sizeof(uint16_t));
+
+        if (!file)
+        {
+            std::cerr << "Failed to write the terrain pyramid " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool TerrainPyramid::buildFromImages(const std::vector<std::string>& cells, int columns, int cellQuads, float heightScale, int tileQuads,
+        const std::string& path)
+    {
+        SPACE_PROFILE_ZONE("TerrainPyramid::buildFromImages");
+
+        if (cells.empty() || columns < 1 || cellQuads < 1) return false;
+
+        const int rows = (int(cells.size()) + columns - 1) / columns;
+        const int width = columns * cellQuads + 1;
+        const int height = rows * cellQuads + 1;
+
+        // The stitched heightfield only exists while the pyramid is written
+        std::vector<float> heights(size_t(width) * height, 0.0f);
+        std::vector<float> imageHeights;
+        HeightmapImage image;
+
+        for (size_t cell = 0; cell < cells.size(); ++cell)
+        {
+            if (!image.load(cells[cell])) return false;
+
+            const int imageWidth = image.getWidth();
+            const int imageHeight = image.getHeight();
+
+            imageHeights.resize(size_t(imageWidth) * imageHeight);
+
+            for (int z = 0; z < imageHeight; ++z)
+            {
+                image.buildHeightRow(z, heightScale, imageHeights.data() + size_t(z) * imageWidth);
+            }
+
+            // Bilinear resampling into the cell; the shared border goes to the later cell
+            const int firstX = int(cell % columns) * cellQuads;
+            const int firstZ = int(cell / columns) * cellQuads;
+
+            for (int z = 0; z <= cellQuads; ++z)
+            {
+                float sourceZ = float(z) / cellQuads * (imageHeight - 1);
+                int z0 = std::min(int(sourceZ), imageHeight - 1);
+                int z1 = std::min(z0 + 1, imageHeight - 1);
+                float tz = sourceZ - z0;
+
+                float* row = heights.data() + size_t(firstZ + z) * width + firstX;
+
+                for (int x = 0; x <= cellQuads; ++x)
+                {
+                    float sourceX = float(x) / cellQuads * (imageWidth - 1);
+                    int x0 = std::min(int(sourceX), imageWidth - 1);
+                    int x1 = std::min(x0 + 1, imageWidth - 1);
+                    float tx = sourceX - x0;
+
+                    const float* top = imageHeights.data() + size_t(z0) * imageWidth;
+                    const float* bottom = imageHeights.data() + size_t(z1) * imageWidth;
+
+                    float upper = top[x0] + tx * (top[x1] - top[x0]);
+                    float lower = bottom[x0] + tx * (bottom[x1] - bottom[x0]);
+
+                    row[x] = upper + tz * (lower - upper);
+                }
+            }
+        }
+
+        Source source;
+        source.heights = heights.data();
+        source.width = width;
+        source.height = height;
+        source.spacing = terrain_kernels::EXTENT / cellQuads;
+        source.heightRange = terrain_kernels::HEIGHT_RANGE * heightScale;
+        source.origin = -0.5f * glm::vec2(width - 1, height - 1) * source.spacing;
+
+        return write(source, tileQuads, path);
+    }
+
+    bool TerrainPyramid::open(const std::string& path)
+    {
+        close();
+
+        if (!file.open(path)) return false;
+
+        const unsigned char* data = file.getData();
+        const size_t size = file.getSize();
+
+        if (size < sizeof(Header))
+        {
+            std::cerr << "Truncated terrain pyramid " << path << std::endl;
+            close();
+            return false;
+        }
+
+        std::memcpy(&header, data, sizeof(Header));
+
+        if (std::memcmp(header.magic, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC)) != 0 || header.version != VERSION)
+        {
+            std::cerr << path << " is not a version " << VERSION << " terrain pyramid" << std::endl;
+            close();
+            return false;
+        }
+
+        if (header.levelCount == 0 || header.tileQuads == 0 || header.width < 2 || header.height < 2
+            || size < sizeof(Header) + size_t(header.levelCount) * sizeof(LevelInfo))
+        {
+            std::cerr << "Corrupt terrain pyramid " << path << std::endl;
+            close();
+            return false;
+        }
+
+        levels.resize(header.levelCount);
+        std::memcpy(levels.data(), data + sizeof(Header), levels.size() * sizeof(LevelInfo));
+
+        const LevelInfo& top = levels.back();
+        tileCount = size_t(top.firstTile) + size_t(top.tilesX) * top.tilesZ;
+
+        const size_t tablesSize = getTablesSize(levels.size(), tileCount);
+        const size_t samplesOffset = alignUp(tablesSize, SAMPLE_ALIGNMENT);
+        const size_t tileBytes = size_t(header.tileQuads + 1) * (header.tileQuads + 1) * sizeof(uint16_t);
+
+        if (size < samplesOffset + tileCount * tileBytes)
+        {
+            std::cerr << "Truncated terrain pyramid " << path << std::endl;
+            close();
+            return false;
+        }
+
+        tileHeights = reinterpret_cast<const uint16_t*>(data + sizeof(Header) + levels.size() * sizeof(LevelInfo));
+        tileSamples = reinterpret_cast<const uint16_t*>(data + samplesOffset);
+
+        return true;
+    }
+
+    void TerrainPyramid::close()
+    {
+        file.close();
+        header = Header{};
+        levels.clear();
+        tileHeights = nullptr;
+        tileSamples = nullptr;
+        tileCount = 0;
+    }
+
+    const uint16_t* TerrainPyramid::getTileSamples(int level, int x, int z) const
+    {
+        const size_t samples = size_t(header.tileQuads + 1) * (header.tileQuads + 1);
+        return tileSamples + getTileIndex(level, x, z) * samples;
+    }
+
+    int TerrainPyramid::getSampleIndex(int level, int tile, int i, int samples) const
+    {
+        return std::min((tile * int(header.tileQuads) + i) << level, samples - 1);
+    }
+
+    BoundingBox TerrainPyramid::getTileBounds(int level, int x, int z) const
+    {
+        const size_t tile = getTileIndex(level, x, z);
+        const int quads = int(header.tileQuads);
+
+        const int firstX = getSampleIndex(level, x, 0, int(header.width));
+        const int lastX = getSampleIndex(level, x, quads, int(header.width));
+        const int firstZ = getSampleIndex(level, z, 0, int(header.height));
+        const int lastZ = getSampleIndex(level, z, quads, int(header.height));
+
+        const glm::vec2 origin = getOrigin();
+
+        return BoundingBox(
+            glm::vec3(origin.x + firstX * header.spacing, toHeight(tileHeights[tile * 2]), origin.y + firstZ * header.spacing),
+            glm::vec3(origin.x + lastX * header.spacing, toHeight(tileHeights[tile * 2 + 1]), origin.y + lastZ * header.spacing));
+    }
+
+    BoundingBox TerrainPyramid::getBounds() const
+    {
+        BoundingBox bounds;
+
+        if (levels.empty()) return bounds;
+
+        const int top = int(levels.size()) - 1;
+
+        for (int z = 0; z < getTilesZ(top); ++z)
+        {
+            for (int x = 0; x < getTilesX(top); ++x)
+            {
+                bounds.extend(getTileBounds(top, x, z));
+            }
+        }
+
+        return bounds;
+    }
+}
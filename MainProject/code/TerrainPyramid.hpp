@@ -0,0 +1,144 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "Bounds.hpp"
+#include "MappedFile.hpp"
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace space
+{
+    /**
+    * Tiled heightmap pyramid on disk, read in place through a memory mapping.
+    *
+    * Level 0 is the full resolution heightfield; level L keeps every (1 << L)th sample of it
+    * in both axes, so the samples of a coarse level are a subset of the finer ones and tiles
+    * of different levels agree where they meet. Every level is cut into tiles of
+    * tileQuads x tileQuads quads ((tileQuads + 1)^2 samples, neighbours share their border
+    * row), down to the level where a single tile covers the whole heightfield. Samples past
+    * the heightfield edge repeat the last one.
+    *
+    * File layout, little endian:
+    *   Header
+    *   LevelInfo[levelCount]
+    *   uint16 min and max height per tile, every tile of every level in order
+    *   uint16 tile samples, row by row, every tile in the same order, from a page boundary
+    *
+    * Heights are stored as fractions of heightRange. The min/max table gives the bounds of a
+    * tile without touching its samples, which is what LOD selection and culling need.
+    */
+    class TerrainPyramid
+    {
+    public:
+
+        static constexpr uint32_t VERSION = 1;
+
+        struct Header
+        {
+            char magic[8];              // "SPTRPYR\0"
+            uint32_t version;
+            uint32_t tileQuads;
+            uint32_t levelCount;
+            uint32_t width;             // Level 0 samples
+            uint32_t height;
+            float spacing;              // World units between level 0 samples
+            float heightRange;          // Height of the largest stored value
+            float originX;              // World position of sample (0, 0)
+            float originZ;
+            uint32_t reserved;
+        };
+
+        struct LevelInfo
+        {
+            uint32_t tilesX;
+            uint32_t tilesZ;
+            uint64_t firstTile;         // Index of the level's first tile in the tile arrays
+        };
+
+        /**
+        * Heightfield to cut into a pyramid: width x height samples in world units, row by row,
+        * sample (x, z) at (origin.x + x * spacing, heights[z * width + x], origin.y + z * spacing).
+        */
+        struct Source
+        {
+            const float* heights;
+            int width;
+            int height;
+            float spacing;
+            float heightRange;
+            glm::vec2 origin;
+        };
+
+        /**
+        * Writes the pyramid of source to path. Heights outside [0, heightRange] are clamped.
+        * Returns false (and reports why) if the file cannot be written.
+        */
+        static bool write(const Source& source, int tileQuads, const std::string& path);
+
+        /**
+        * Stitches heightmap images (cells) into a grid with the given number of columns and
+        * writes its pyramid. Each cell is resampled to cellQuads quads per side over
+        * terrain_kernels::EXTENT world units, with heights as HeightMapTerrain computes them
+        * (any format HeightmapImage reads).
+        */
+        static bool buildFromImages(const std::vector<std::string>& cells, int columns, int cellQuads, float heightScale, int tileQuads,
+            const std::string& path);
+
+        // Maps and validates the file. The previous pyramid, if any, is closed
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const { return file.isOpen(); }
+
+        int getTileQuads() const { return int(header.tileQuads); }
+        int getLevelCount() const { return int(header.levelCount); }
+        int getTilesX(int level) const { return int(levels[level].tilesX); }
+        int getTilesZ(int level) const { return int(levels[level].tilesZ); }
+        size_t getTileCount() const { return tileCount; }
+
+        // Level 0 samples per side
+        int getWidth() const { return int(header.width); }
+        int getHeight() const { return int(header.height); }
+
+        float getSpacing() const { return header.spacing; }
+        float getHeightRange() const { return header.heightRange; }
+        glm::vec2 getOrigin() const { return glm::vec2(header.originX, header.originZ); }
+
+        // (tileQuads + 1)^2 samples of a tile, pointing into the mapping
+        const uint16_t* getTileSamples(int level, int x, int z) const;
+
+        // World height of a stored sample
+        float toHeight(uint16_t sample) const { return sample * (header.heightRange / 65535.0f); }
+
+        /**
+        * Level 0 sample index of sample i of a tile row or column starting at tile index
+        * tile, at the given level; samples past the edge land on the last one.
+        */
+        int getSampleIndex(int level, int tile, int i, int samples) const;
+
+        BoundingBox getTileBounds(int level, int x, int z) const;
+        BoundingBox getBounds() const;
+
+        // Bytes of the mapped file
+        size_t getFileSize() const { return file.getSize(); }
+
+    private:
+
+        MappedFile file;
+        Header header{};
+        std::vector<LevelInfo> levels;
+        const uint16_t* tileHeights = nullptr;      // Min and max per tile
+        const uint16_t* tileSamples = nullptr;
+        size_t tileCount = 0;
+
+        size_t getTileIndex(int level, int x, int z) const { return size_t(levels[level].firstTile) + size_t(z) * levels[level].tilesX + x; }
+    };
+}
@@ -0,0 +1,306 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "TerrainQuadtree.hpp"
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace space
+{
+    void TerrainQuadtree::build(const float* heights, int width, int height, const glm::vec2& origin, const glm::vec2& spacing, int patchQuads)
+    {
+        SPACE_PROFILE_ZONE("TerrainQuadtree::build");
+
+        this->width = width;
+        this->height = height;
+        this->origin = origin;
+        this->spacing = spacing;
+        this->patchQuads = patchQuads;
+
+        levels.clear();
+        ranges.clear();
+        leafHeightSpan = 0.0f;
+
+        if (width < 2 || height < 2) return;
+
+        // Leaves: height bounds over the texels of each node, its far edge included
+        Level leaves;
+        const int leafQuads = getNodeQuads(0);
+        leaves.nodesX = (width - 2) / leafQuads + 1;
+        leaves.nodesZ = (height - 2) / leafQuads + 1;
+        leaves.heightBounds.resize(size_t(leaves.nodesX) * leaves.nodesZ);
+
+        for (int nodeZ = 0; nodeZ < leaves.nodesZ; ++nodeZ)
+        {
+            for (int nodeX = 0; nodeX < leaves.nodesX; ++nodeX)
+            {
+                glm::vec2 bounds = computeLeafBounds(heights, nodeX, nodeZ);
+
+                leaves.heightBounds[size_t(nodeZ) * leaves.nodesX + nodeX] = bounds;
+                leafHeightSpan = std::max(leafHeightSpan, bounds.y - bounds.x);
+            }
+        }
+
+        levels.push_back(std::move(leaves));
+
+        // Parents merge up to four children, until a single level covers the whole heightmap
+        while (levels.back().nodesX > 1 || levels.back().nodesZ > 1)
+        {
+            Level parents;
+            parents.nodesX = (levels.back().nodesX + 1) / 2;
+            parents.nodesZ = (levels.back().nodesZ + 1) / 2;
+            parents.heightBounds.resize(size_t(parents.nodesX) * parents.nodesZ);
+
+            levels.push_back(std::move(parents));
+            mergeChildren(int(levels.size()) - 1, 0, 0, levels.back().nodesX - 1, levels.back().nodesZ - 1);
+        }
+
+        ranges.assign(levels.size(), FLT_MAX);
+    }
+
+    void TerrainQuadtree::update(const float* heights, int firstX, int firstZ, int lastX, int lastZ)
+    {
+        if (levels.empty()) return;
+
+        // A texel on a node border belongs to the nodes on both sides
+        const int leafQuads = getNodeQuads(0);
+
+        int nodeX0 = std::max(0, (firstX - 1) / leafQuads);
+        int nodeZ0 = std::max(0, (firstZ - 1) / leafQuads);
+        int nodeX1 = std::min(levels[0].nodesX - 1, lastX / leafQuads);
+        int nodeZ1 = std::min(levels[0].nodesZ - 1, lastZ / leafQuads);
+
+        if (nodeX0 > nodeX1 || nodeZ0 > nodeZ1) return;
+
+        for (int nodeZ = nodeZ0; nodeZ <= nodeZ1; ++nodeZ)
+        {
+            for (int nodeX = nodeX0; nodeX <= nodeX1; ++nodeX)
+            {
+                glm::vec2 bounds = computeLeafBounds(heights, nodeX, nodeZ);
+
+                levels[0].heightBounds[size_t(nodeZ) * levels[0].nodesX + nodeX] = bounds;
+                leafHeightSpan = std::max(leafHeightSpan, bounds.y - bounds.x);
+            }
+        }
+
+        for (int level = 1; level < int(levels.size()); ++level)
+        {
+            nodeX0 >>= 1;
+            nodeZ0 >>= 1;
+            nodeX1 >>= 1;
+            nodeZ1 >>= 1;
+
+            mergeChildren(level, nodeX0, nodeZ0, nodeX1, nodeZ1);
+        }
+    }
+
+    glm::vec2 TerrainQuadtree::computeLeafBounds(const float* heights, int nodeX, int nodeZ) const
+    {
+        // Height bounds over the texels of the node, its far edge included
+        const int leafQuads = getNodeQuads(0);
+        const int lastX = std::min((nodeX + 1) * leafQuads, width - 1);
+        const int lastZ = std::min((nodeZ + 1) * leafQuads, height - 1);
+
+        glm::vec2 bounds(FLT_MAX, -FLT_MAX);
+
+        for (int z = nodeZ * leafQuads; z <= lastZ; ++z)
+        {
+            const float* row = heights + size_t(z) * width;
+
+            for (int x = nodeX * leafQuads; x <= lastX; ++x)
+            {
+                bounds.x = std::min(bounds.x, row[x]);
+                bounds.y = std::max(bounds.y, row[x]);
+            }
+        }
+
+        return bounds;
+    }
+
+    void TerrainQuadtree::mergeChildren(int level, int firstX, int firstZ, int lastX, int lastZ)
+    {
+        const Level& children = levels[level - 1];
+        Level& parents = levels[level];
+
+        for (int z = firstZ; z <= lastZ; ++z)
+        {
+            for (int x = firstX; x <= lastX; ++x)
+            {
+                glm::vec2 bounds(FLT_MAX, -FLT_MAX);
+
+                for (int childZ = z * 2; childZ <= std::min(z * 2 + 1, children.nodesZ - 1); ++childZ)
+                {
+                    for (int childX = x * 2; childX <= std::min(x * 2 + 1, children.nodesX - 1); ++childX)
+                    {
+                        const glm::vec2& child = children.heightBounds[size_t(childZ) * children.nodesX + childX];
+
+                        bounds.x = std::min(bounds.x, child.x);
+                        bounds.y = std::max(bounds.y, child.y);
+                    }
+                }
+
+                parents.heightBounds[size_t(z) * parents.nodesX + x] = bounds;
+            }
+        }
+    }
+
+    void TerrainQuadtree::setScreenSpaceError(float pixelError, float viewportHeight, float verticalFov)
+    {
+        if (levels.empty()) return;
+
+        // Pixels per world unit at distance 1
+        float projection = viewportHeight / (2.0f * std::tan(verticalFov * 0.5f));
+
+        // Level 1 may start where its spacing, twice the texel one, drops under the error...
+        float range = 2.0f * std::max(spacing.x, spacing.y) * projection / std::max(pixelError, 0.01f);
+
+        // ...but a node must stay small next to its range, or a coarser neighbour could still
+        // be morphing where a finer node ends and leave a crack
+        int leafQuads = getNodeQuads(0);
+        float leafDiagonal = glm::length(glm::vec3(leafQuads * spacing.x, leafHeightSpan, leafQuads * spacing.y));
+        range = std::max(range, 2.5f * leafDiagonal);
+
+        for (size_t level = 0; level + 1 < levels.size(); ++level)
+        {
+            ranges[level] = range;
+            range *= 2.0f;
+        }
+
+        // The roots cover everything at any distance
+        ranges.back() = FLT_MAX;
+    }
+
+    int TerrainQuadtree::select(const glm::vec3& camera, const Frustum* frustum, std::vector<Patch>& patches) const
+    {
+        patches.clear();
+
+        if (levels.empty()) return 0;
+
+        Selection selection{ camera, patches, 0 };
+        const int top = int(levels.size()) - 1;
+
+        for (int z = 0; z < levels[top].nodesZ; ++z)
+        {
+            for (int x = 0; x < levels[top].nodesX; ++x)
+            {
+                selectNode(top, x, z, frustum, selection);
+            }
+        }
+
+        return selection.culled;
+    }
+
+    BoundingBox TerrainQuadtree::getNodeBounds(int level, int x, int z) const
+    {
+        const Level& nodes = levels[level];
+        const glm::vec2& bounds = nodes.heightBounds[size_t(z) * nodes.nodesX + x];
+        const int quads = getNodeQuads(level);
+
+        glm::vec3 boxMin(origin.x + x * quads * spacing.x, bounds.x, origin.y + z * quads * spacing.y);
+        glm::vec3 boxMax(origin.x + std::min((x + 1) * quads, width - 1) * spacing.x, bounds.y,
+            origin.y + std::min((z + 1) * quads, height - 1) * spacing.y);
+
+        return BoundingBox(boxMin, boxMax);
+    }
+
+    bool TerrainQuadtree::intersectsSphere(int level, int x, int z, const glm::vec3& center, float radius) const
+    {
+        if (radius == FLT_MAX) return true;
+
+        BoundingBox box = getNodeBounds(level, x, z);
+
+        glm::vec3 closest = glm::clamp(center, box.min, box.max);
+        glm::vec3 offset = closest - center;
+
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    bool TerrainQuadtree::selectNode(int level, int x, int z, const Frustum* frustum, Selection& selection) const
+    {
+        if (!intersectsSphere(level, x, z, selection.camera, ranges[level]))
+        {
+            // Out of this level's range, the parent draws the area
+            return false;
+        }
+
+        if (frustum)
+        {
+            Frustum::Containment containment = frustum->classify(getNodeBounds(level, x, z));
+
+            if (containment == Frustum::OUTSIDE)
+            {
+                // Handled: nothing of it is drawn, not even by the parent
+                ++selection.culled;
+                return true;
+            }
+
+            if (containment == Frustum::INSIDE) frustum = nullptr;
+        }
+
+        if (level == 0 || !intersectsSphere(level, x, z, selection.camera, ranges[level - 1]))
+        {
+            for (int quadrant = 0; quadrant < 4; ++quadrant)
+            {
+                addQuadrant(level, x, z, quadrant, frustum, selection);
+            }
+
+            return true;
+        }
+
+        // Finer children where they are in range, this level for the rest
+        const Level& children = levels[level - 1];
+
+        for (int quadrant = 0; quadrant < 4; ++quadrant)
+        {
+            int childX = 2 * x + (quadrant & 1);
+            int childZ = 2 * z + (quadrant >> 1);
+
+            if (childX >= children.nodesX || childZ >= children.nodesZ) continue;
+
+            if (!selectNode(level - 1, childX, childZ, frustum, selection))
+            {
+                addQuadrant(level, x, z, quadrant, frustum, selection);
+            }
+        }
+
+        return true;
+    }
+
+    void TerrainQuadtree::addQuadrant(int level, int x, int z, int quadrant, const Frustum* frustum, Selection& selection) const
+    {
+        const int quads = getNodeQuads(level);
+        const int originX = x * quads + (quadrant & 1) * quads / 2;
+        const int originZ = z * quads + (quadrant >> 1) * quads / 2;
+
+        // Quadrants past the last texel have nothing to draw
+        if (originX >= width - 1 || originZ >= height - 1) return;
+
+        // Above the leaves a quadrant is the area of a child node, which has its own bounds
+        if (frustum && level > 0)
+        {
+            if (frustum->classify(getNodeBounds(level - 1, 2 * x + (quadrant & 1), 2 * z + (quadrant >> 1))) == Frustum::OUTSIDE)
+            {
+                ++selection.culled;
+                return;
+            }
+        }
+
+        std::vector<Patch>& patches = selection.patches;
+
+        const float range = ranges[level];
+
+        if (range == FLT_MAX)
+        {
+            patches.push_back({ originX, originZ, level, 0.0f, 0.0f });
+        }
+        else
+        {
+            patches.push_back({ originX, originZ, level, range * MORPH_START_RATIO, range });
+        }
+    }
+}
@@ -0,0 +1,120 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include "Bounds.hpp"
+#include "Frustum.hpp"
+
+#include <glm.hpp>
+
+#include <vector>
+
+namespace space
+{
+    /**
+    * Quadtree over a heightfield for continuous distance-based LOD (CDLOD, Strugar 2009).
+    *
+    * A node of level L covers 2 * patchQuads << L quads of the heightmap and is drawn as four
+    * quadrants, each a grid of patchQuads quads spaced 1 << L texels apart. select() walks the
+    * tree from the roots: a node is split while its bounding box reaches into the range of the
+    * finer level, and the quadrants whose children were not selected are drawn at the node
+    * level. Ranges double per level and follow from the allowed screen-space error, so the
+    * number of patches depends on the view and not on the heightmap size.
+    *
+    * Over the last part of its range every patch morphs its vertices into the grid of the
+    * next level (terrain_vertex_shader.glsl), so neighbouring levels meet without cracks and
+    * levels change without popping.
+    *
+    * With a frustum, nodes and quadrants whose bounding box is outside of it are skipped, and
+    * the test stops for the subtrees that are completely inside.
+    */
+    class TerrainQuadtree
+    {
+    public:
+
+        // Quadrant to draw: first texel, level (texel step 1 << level) and morph distances
+        struct Patch
+        {
+            int originX;
+            int originZ;
+            int level;
+            float morphStart;
+            float morphEnd;
+        };
+
+        // Fraction of its range where a level starts morphing into the next one
+        static constexpr float MORPH_START_RATIO = 0.7f;
+
+        /**
+        * heights has width x height texels; texel (x, z) is at local position
+        * (origin.x + x * spacing.x, heights[z * width + x], origin.y + z * spacing.y).
+        */
+        void build(const float* heights, int width, int height, const glm::vec2& origin, const glm::vec2& spacing, int patchQuads);
+
+        /**
+        * Recomputes the node height bounds over the texels [firstX, lastX] x [firstZ, lastZ]
+        * (inclusive) of heights, the same array build() got, after they changed. The leaf
+        * height span that bounds the level ranges can only grow here.
+        */
+        void update(const float* heights, int firstX, int firstZ, int lastX, int lastZ);
+
+        /**
+        * Sets the level ranges so that a level is only used where its vertex spacing projects
+        * to at most pixelError pixels, for a viewport viewportHeight pixels tall with the given
+        * vertical field of view (radians).
+        */
+        void setScreenSpaceError(float pixelError, float viewportHeight, float verticalFov);
+
+        /**
+        * Replaces patches with the selection for a camera in the heightfield local space. The
+        * frustum, if any, must be in that space too. Returns how many nodes and quadrants the
+        * frustum rejected.
+        */
+        int select(const glm::vec3& camera, const Frustum* frustum, std::vector<Patch>& patches) const;
+
+        int getLevelCount() const { return int(levels.size()); }
+        float getRange(int level) const { return ranges[level]; }
+
+    private:
+
+        struct Level
+        {
+            int nodesX = 0;
+            int nodesZ = 0;
+            std::vector<glm::vec2> heightBounds;    // Min and max height per node
+        };
+
+        std::vector<Level> levels;
+        std::vector<float> ranges;
+
+        int width = 0;
+        int height = 0;
+        int patchQuads = 0;
+        float leafHeightSpan = 0.0f;            // Largest height difference inside a leaf
+        glm::vec2 origin = glm::vec2(0.0f);
+        glm::vec2 spacing = glm::vec2(1.0f);
+
+        // Selection state shared by the recursion
+        struct Selection
+        {
+            glm::vec3 camera;
+            std::vector<Patch>& patches;
+            int culled;
+        };
+
+        int getNodeQuads(int level) const { return (2 * patchQuads) << level; }
+
+        glm::vec2 computeLeafBounds(const float* heights, int nodeX, int nodeZ) const;
+        void mergeChildren(int level, int firstX, int firstZ, int lastX, int lastZ);
+
+        BoundingBox getNodeBounds(int level, int x, int z) const;
+        bool intersectsSphere(int level, int x, int z, const glm::vec3& center, float radius) const;
+
+        // frustum is null once a parent was found completely inside
+        bool selectNode(int level, int x, int z, const Frustum* frustum, Selection& selection) const;
+        void addQuadrant(int level, int x, int z, int quadrant, const Frustum* frustum, Selection& selection) const;
+    };
+}
@@ -0,0 +1,173 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#include "ThreadPool.hpp"
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace space
+{
+    ThreadPool::ThreadPool(unsigned thread_count)
+    {
+        if (thread_count == 0)
+        {
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (unsigned i = 1; i < thread_count; ++i)
+        {
+            workers.emplace_back([this, i]()
+                {
+                    if (CpuProfiler::isEnabled())
+                    {
+                        CpuProfiler::setThreadName("worker " + std::to_string(i));
+                    }
+
+                    workerLoop();
+                });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(tasks_mutex);
+            stopping = true;
+        }
+
+        tasks_available.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(tasks_mutex);
+                tasks_available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                if (tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    void ThreadPool::enqueue(std::function<void()> task)
+    {
+        if (workers.empty())
+        {
+            task();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(tasks_mutex);
+            tasks.push_back(std::move(task));
+        }
+
+        tasks_available.notify_one();
+    }
+
+    void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+
+        grain = std::max<size_t>(grain, 1);
+        size_t chunk_count = (end - begin + grain - 1) / grain;
+
+        if (workers.empty() || chunk_count == 1)
+        {
+            body(begin, end);
+            return;
+        }
+
+        // Shared with the helper tasks, which may only get to run after this call returned
+        struct Job
+        {
+            std::atomic<size_t> next_chunk{ 0 };
+            std::atomic<size_t> finished_chunks{ 0 };
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+
+        auto job = std::make_shared<Job>();
+
+        // Returns false once every chunk has been taken
+        auto run_chunk = [job, &body, begin, end, grain, chunk_count]() -> bool
+            {
+                size_t chunk = job->next_chunk.fetch_add(1, std::memory_order_relaxed);
+
+                if (chunk >= chunk_count)
+                {
+                    return false;
+                }
+
+                size_t chunk_begin = begin + chunk * grain;
+                body(chunk_begin, std::min(chunk_begin + grain, end));
+
+                if (job->finished_chunks.fetch_add(1, std::memory_order_acq_rel) + 1 == chunk_count)
+                {
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    job->done.notify_all();
+                }
+
+                return true;
+            };
+
+        size_t helpers = std::min(workers.size(), chunk_count - 1);
+
+        {
+            std::lock_guard<std::mutex> lock(tasks_mutex);
+
+            for (size_t i = 0; i < helpers; ++i)
+            {
+                // A helper that starts after the last chunk was taken returns without
+                // touching body, which may no longer exist by then
+                tasks.push_back([run_chunk]()
+                    {
+                        while (run_chunk())
+                        {
+                        }
+                    });
+            }
+        }
+
+        tasks_available.notify_all();
+
+        while (run_chunk())
+        {
+        }
+
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->done.wait(lock, [&job, chunk_count]() { return job->finished_chunks.load(std::memory_order_acquire) == chunk_count; });
+    }
+
+    ThreadPool& ThreadPool::shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace space
+{
+    /**
+    * Fixed set of worker threads for data-parallel CPU work (terrain and grass generation...).
+    *
+    * parallelFor() splits a range in chunks that the workers and the calling thread pull
+    * until none is left, so the caller always makes progress and nested calls from inside
+    * a worker cannot deadlock. Which thread runs a chunk is not deterministic: bodies must
+    * only write the part of the output that belongs to their chunk.
+    */
+    class ThreadPool
+    {
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+
+        std::mutex tasks_mutex;
+        std::condition_variable tasks_available;
+        bool stopping = false;
+
+    public:
+
+        /**
+        * thread_count counts the calling thread, so ThreadPool(1) runs everything inline.
+        * 0 uses one thread per hardware core.
+        */
+        explicit ThreadPool(unsigned thread_count = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator = (const ThreadPool&) = delete;
+
+        // Workers plus the calling thread
+        unsigned getThreadCount() const { return unsigned(workers.size()) + 1; }
+
+        /**
+        * Calls body(chunk_begin, chunk_end) over [begin, end) in chunks of at most grain
+        * elements and returns once all of them finished.
+        */
+        void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+        // Runs task on a worker (inline when there are none)
+        void enqueue(std::function<void()> task);
+
+        // Pool shared by the whole application, created on first use
+        static ThreadPool& shared();
+
+    private:
+
+        void workerLoop();
+    };
+}
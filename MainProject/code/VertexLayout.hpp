@@ -0,0 +1,286 @@
+/*
+* Este cdigo es de dominio pblico
+* Realizado por Hugo Montas Garca
+*/
+
+#pragma once
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/packing.hpp>
+#include <gtc/type_precision.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace space
+{
+	/**
+	* CPU side vertex arrays a layout reads from (the ones every Mesh fills in initialize()).
+	* Arrays a layout does not use may be empty.
+	*/
+	struct VertexSource
+	{
+		const std::vector < glm::vec3 >& positions;
+		const std::vector < glm::vec3 >& normals;
+		const std::vector < glm::vec3 >& colors;
+
+		// Bounding box of the positions, for the mesh-relative formats
+		glm::vec3 position_min;
+		glm::vec3 position_extent;
+	};
+
+	/**
+	* What the vertex shader has to undo for a layout. Positions decode as
+	* position_offset + position * position_scale, which the renderer folds into the model
+	* matrix (see getPositionMatrix()), so only the normal format needs a uniform.
+	*/
+	struct VertexDecode
+	{
+		glm::vec3 position_offset = glm::vec3(0.0f);
+		glm::vec3 position_scale = glm::vec3(1.0f);
+		bool octahedral_normals = false;
+
+		glm::mat4 getPositionMatrix() const
+		{
+			glm::mat4 matrix(1.0f);
+			matrix[0][0] = position_scale.x;
+			matrix[1][1] = position_scale.y;
+			matrix[2][2] = position_scale.z;
+			matrix[3] = glm::vec4(position_offset, 1.0f);
+			return matrix;
+		}
+	};
+
+	/**
+	* Where one attribute sits inside an interleaved vertex, as glVertexAttribPointer wants it.
+	*/
+	struct VertexAttribute
+	{
+		GLuint location;
+		GLint components;
+		GLenum type;
+		GLboolean normalized;
+		size_t offset;
+	};
+
+	/**
+	* Vertex attribute descriptors. Each one names its shader location, its GPU format,
+	* how to produce its value for vertex i from the mesh arrays and, through describe(),
+	* what the shader needs to decode it.
+	*/
+	namespace vertex
+	{
+		struct Attribute
+		{
+			static void describe(VertexDecode&, const VertexSource&) {}
+		};
+
+		struct Position : Attribute
+		{
+			using Type = glm::vec3;
+
+			static constexpr GLuint LOCATION = 0;
+			static constexpr GLint COMPONENTS = 3;
+			static constexpr GLenum GL_TYPE = GL_FLOAT;
+			static constexpr GLboolean NORMALIZED = GL_FALSE;
+
+			static Type encode(const VertexSource& source, size_t i) { return source.positions[i]; }
+		};
+
+		struct Normal : Attribute
+		{
+			using Type = glm::vec3;
+
+			static constexpr GLuint LOCATION = 1;
+			static constexpr GLint COMPONENTS = 3;
+			static constexpr GLenum GL_TYPE = GL_FLOAT;
+			static constexpr GLboolean NORMALIZED = GL_FALSE;
+
+			static Type encode(const VertexSource& source, size_t i) { return source.normals[i]; }
+		};
+
+		struct Color : Attribute
+		{
+			using Type = glm::vec3;
+
+			static constexpr GLuint LOCATION = 2;
+			static constexpr GLint COMPONENTS = 3;
+			static constexpr GLenum GL_TYPE = GL_FLOAT;
+			static constexpr GLboolean NORMALIZED = GL_FALSE;
+
+			static Type encode(const VertexSource& source, size_t i) { return source.colors[i]; }
+		};
+
+		/**
+		* Quantized formats. The position ones take 8 bytes (the fourth component is padding
+		* that keeps every attribute 4-byte aligned), the normal and colour ones 4 bytes each.
+		*/
+
+		// Half float positions, for meshes with small local coordinates
+		struct PositionHalf : Attribute
+		{
+			using Type = glm::u16vec4;
+
+			static constexpr GLuint LOCATION = 0;
+			static constexpr GLint COMPONENTS = 3;
+			static constexpr GLenum GL_TYPE = GL_HALF_FLOAT;
+			static constexpr GLboolean NORMALIZED = GL_FALSE;
+
+			static Type encode(const VertexSource& source, size_t i)
+			{
+				const glm::vec3& position = source.positions[i];
+				return Type(glm::packHalf1x16(position.x), glm::packHalf1x16(position.y), glm::packHalf1x16(position.z), 0);
+			}
+		};
+
+		// Positions as 16-bit fractions of the mesh bounding box. Chunked meshes share it too: their
+		// chunks share boundary vertices, which can only hold one encoding (see README.md for the
+		// precision this gives)
+		struct PositionUnorm16 : Attribute
+		{
+			using Type = glm::u16vec4;
+
+			static constexpr GLuint LOCATION = 0;
+			static constexpr GLint COMPONENTS = 3;
+			static constexpr GLenum GL_TYPE = GL_UNSIGNED_SHORT;
+			static constexpr GLboolean NORMALIZED = GL_TRUE;
+
+			static Type encode(const VertexSource& source, size_t i)
+			{
+				// Flat axes have no extent, every position on them encodes to 0
+				glm::vec3 extent = glm::max(source.position_extent, glm::vec3(std::numeric_limits<float>::min()));
+				glm::vec3 fraction = glm::clamp((source.positions[i] - source.position_min) / extent, 0.0f, 1.0f);
+				glm::vec3 quantized = glm::round(fraction * 65535.0f);
+
+				return Type(quantized.x, quantized.y, quantized.z, 0);
+			}
+
+			static void describe(VertexDecode& decode, const VertexSource& source)
+			{
+				decode.position_offset = source.position_min;
+				decode.position_scale = source.position_extent;
+			}
+		};
+
+		// Unit normals folded onto an octahedron and stored as two snorm16
+		struct OctahedralNormal : Attribute
+		{
+			using Type = glm::i16vec2;
+
+			static constexpr GLuint LOCATION = 1;
+			static constexpr GLint COMPONENTS = 2;
+			static constexpr GLenum GL_TYPE = GL_SHORT;
+			static constexpr GLboolean NORMALIZED = GL_TRUE;
+
+			static Type encode(const VertexSource& source, size_t i)
+			{
+				const glm::vec3& normal = source.normals[i];
+				float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+
+				glm::vec2 folded = length > 0.0f ? glm::vec2(normal.x, normal.y) / length : glm::vec2(0.0f);
+
+				// The lower half goes over the corners of the upper one
+				if (normal.z < 0.0f)
+				{
+					glm::vec2 sign(folded.x >= 0.0f ? 1.0f : -1.0f, folded.y >= 0.0f ? 1.0f : -1.0f);
+					folded = (1.0f - glm::abs(glm::vec2(folded.y, folded.x))) * sign;
+				}
+
+				glm::vec2 quantized = glm::round(glm::clamp(folded, -1.0f, 1.0f) * 32767.0f);
+				return Type(quantized.x, quantized.y);
+			}
+
+			static void describe(VertexDecode& decode, const VertexSource&)
+			{
+				decode.octahedral_normals = true;
+			}
+		};
+
+		// Colours as normalized bytes, alpha is always opaque
+		struct ColorRgba8 : Attribute
+		{
+			using Type = glm::u8vec4;
+
+			static constexpr GLuint LOCATION = 2;
+			static constexpr GLint COMPONENTS = 4;
+			static constexpr GLenum GL_TYPE = GL_UNSIGNED_BYTE;
+			static constexpr GLboolean NORMALIZED = GL_TRUE;
+
+			static Type encode(const VertexSource& source, size_t i)
+			{
+				glm::vec3 quantized = glm::round(glm::clamp(source.colors[i], 0.0f, 1.0f) * 255.0f);
+				return Type(quantized.x, quantized.y, quantized.z, 255);
+			}
+		};
+	}
+
+	/**
+	* Compile-time description of an interleaved vertex: the attributes are stored one after
+	* the other, in the order given, with no padding. Mesh::setUpMesh<Layout>() uploads the
+	* mesh arrays in this format into a single vertex buffer.
+	*
+	*     using SkyboxLayout = VertexLayout< vertex::Position >;
+	*/
+	template<typename... Attributes>
+	struct VertexLayout
+	{
+		static constexpr size_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+		static constexpr size_t STRIDE = (sizeof(typename Attributes::Type) + ...);
+
+		static std::array<VertexAttribute, ATTRIBUTE_COUNT> attributes()
+		{
+			std::array<VertexAttribute, ATTRIBUTE_COUNT> result{};
+			size_t index = 0;
+			size_t offset = 0;
+
+			((result[index++] = VertexAttribute{ Attributes::LOCATION, Attributes::COMPONENTS, Attributes::GL_TYPE, Attributes::NORMALIZED, offset },
+				offset += sizeof(typename Attributes::Type)), ...);
+
+			return result;
+		}
+
+		static std::vector<unsigned char> interleave(const VertexSource& source, size_t vertex_count)
+		{
+			std::vector<unsigned char> data(vertex_count * STRIDE);
+			interleave(source, 0, vertex_count, data.data());
+
+			return data;
+		}
+
+		// Vertices [first, first + count) into out, which takes count * STRIDE bytes
+		static void interleave(const VertexSource& source, size_t first, size_t count, unsigned char* out)
+		{
+			for (size_t i = first; i < first + count; ++i)
+			{
+				(write<Attributes>(out, source, i), ...);
+			}
+		}
+
+		static VertexDecode decode(const VertexSource& source)
+		{
+			VertexDecode result;
+			(Attributes::describe(result, source), ...);
+			return result;
+		}
+
+	private:
+
+		template<typename Attribute>
+		static void write(unsigned char*& out, const VertexSource& source, size_t i)
+		{
+			typename Attribute::Type value = Attribute::encode(source, i);
+			std::memcpy(out, &value, sizeof(value));
+			out += sizeof(value);
+		}
+	};
+
+	// Position, normal and colour as floats: 36 bytes per vertex
+	using StandardVertexLayout = VertexLayout< vertex::Position, vertex::Normal, vertex::Color >;
+
+	// The same attributes quantized, 16 bytes per vertex. vertex_shader.glsl decodes both
+	using QuantizedVertexLayout = VertexLayout< vertex::PositionUnorm16, vertex::OctahedralNormal, vertex::ColorRgba8 >;
+}
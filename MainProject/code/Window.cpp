@@ -7,6 +7,7 @@
 #include <glad/glad.h>
 #include <SDL_opengl.h>
 #include "Window.hpp"
+#include "GLExtensions.hpp"
 
 namespace space
 {
@@ -47,6 +48,10 @@ namespace space
 
         assert(glad_is_initialized);
 
+        //Entry points newer than the 3.3 core glad was generated for
+
+        glext::load(reinterpret_cast<GLADloadproc>(SDL_GL_GetProcAddress));
+
         //Activate sync with vertical display refresh
 
         SDL_GL_SetSwapInterval(context_details.enable_vsync ? 1 : 0);
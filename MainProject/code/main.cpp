@@ -5,17 +5,206 @@
 
 #include "Scene.hpp"
 #include "Window.hpp"
+#include "CpuProfiler.hpp"
+#include "FrameStats.hpp"
+#include "TerrainMeshCache.hpp"
+
+#ifdef SPACE_WITH_EGL
+#include "OffscreenWindow.hpp"
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
 
 using space::Window;
 
-int main(int, char* [])
+namespace
+{
+    struct RunOptions
+    {
+        bool offscreen = false;         // --offscreen: render into an FBO through EGL, no window
+        int frames = 0;                 // --frames N: stop after N frames (0 = run until closed)
+        std::string capture_path;       // --capture file.png: save the last offscreen frame
+        std::string trace_path;         // --trace file.json: record CPU zones, written at exit
+        std::string stats_path;         // --stats file.json: frame time percentiles, written at exit
+        float stats_interval = 5.0f;    // --stats-interval S: seconds between console reports (0 = off)
+        std::string streamed_world;     // --streamed-world file.pyramid: add the streamed terrain world
+        int streaming_budget_mb = 64;   // --streaming-budget MB: resident tile budget of that world
+        std::string terrain_cache = "terrain_cache";    // --terrain-cache dir: baked terrain buffers (--no-terrain-cache: off)
+        space::GrassCuller::Path grass_culling = space::GrassCuller::Path::COMPUTE;  // --grass-culling cpu|transform-feedback|compute
+    };
+
+    RunOptions parseArguments(int argc, char* argv[])
+    {
+        RunOptions options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--offscreen") == 0) options.offscreen = true;
+            else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) options.frames = std::atoi(argv[++i]);
+            else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) options.capture_path = argv[++i];
+            else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) options.trace_path = argv[++i];
+            else if (std::strcmp(argv[i], "--stats") == 0 && i + 1 < argc) options.stats_path = argv[++i];
+            else if (std::strcmp(argv[i], "--stats-interval") == 0 && i + 1 < argc) options.stats_interval = float(std::atof(argv[++i]));
+            else if (std::strcmp(argv[i], "--streamed-world") == 0 && i + 1 < argc) options.streamed_world = argv[++i];
+            else if (std::strcmp(argv[i], "--streaming-budget") == 0 && i + 1 < argc) options.streaming_budget_mb = std::atoi(argv[++i]);
+            else if (std::strcmp(argv[i], "--terrain-cache") == 0 && i + 1 < argc) options.terrain_cache = argv[++i];
+            else if (std::strcmp(argv[i], "--no-terrain-cache") == 0) options.terrain_cache.clear();
+            else if (std::strcmp(argv[i], "--grass-culling") == 0 && i + 1 < argc)
+            {
+                const char* mode = argv[++i];
+
+                if (std::strcmp(mode, "cpu") == 0) options.grass_culling = space::GrassCuller::Path::NONE;
+                else if (std::strcmp(mode, "transform-feedback") == 0) options.grass_culling = space::GrassCuller::Path::TRANSFORM_FEEDBACK;
+                else if (std::strcmp(mode, "compute") == 0) options.grass_culling = space::GrassCuller::Path::COMPUTE;
+                else std::cerr << "Ignoring unknown grass culling: " << mode << std::endl;
+            }
+            else std::cerr << "Ignoring unknown argument: " << argv[i] << std::endl;
+        }
+
+        return options;
+    }
+
+    double elapsedMs(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // Prints the whole-run summary and writes it as JSON to --stats, or to stdout without it
+    void reportFrameStats(const space::FrameStats& stats, const RunOptions& options)
+    {
+        stats.report();
+
+        if (options.stats_path.empty())
+        {
+            stats.writeJson(std::cout);
+        }
+        else
+        {
+            stats.writeJson(options.stats_path);
+        }
+    }
+
+    void reportCulling(const space::Scene& scene)
+    {
+        const space::Scene::CullingStats& culling = scene.getCullingStats();
+
+        std::cout << "Culling (last frame): " << culling.nodesSubmitted << " nodes submitted, " << culling.nodesCulled << " culled; "
+            << culling.terrainPatchesSubmitted << " terrain patches submitted, " << culling.terrainNodesCulled << " terrain nodes culled; "
+            << culling.streamedTilesSubmitted << " streamed tiles submitted, " << culling.streamedTilesCulled << " culled; ";
+
+        if (culling.grassCulledOnGpu)
+        {
+            std::cout << culling.grassCellsSubmitted << " grass cells tested on the GPU (" << culling.grassInstancesSubmitted
+                << " instances kept), " << culling.grassCellsCulled << " culled" << std::endl;
+        }
+        else
+        {
+            std::cout << culling.grassCellsSubmitted << " grass cells submitted (" << culling.grassInstancesSubmitted << " instances in "
+                << culling.grassDraws << " draws), " << culling.grassCellsCulled << " culled" << std::endl;
+        }
+    }
+
+    void addStreamedWorld(space::Scene& scene, const RunOptions& options)
+    {
+        if (!options.streamed_world.empty())
+        {
+            scene.addStreamedWorld(options.streamed_world, size_t(options.streaming_budget_mb) << 20);
+        }
+    }
+
+#ifdef SPACE_WITH_EGL
+
+    /**
+    * Renders a fixed number of frames without a window, advancing the scene with a fixed
+    * time step so that captured frames are reproducible, and reports the CPU cost per frame.
+    * The swap time includes glFinish, so it is where the GPU work shows up.
+    */
+    int runOffscreen(const RunOptions& options, unsigned viewport_width, unsigned viewport_height)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        space::OffscreenWindow window(viewport_width, viewport_height, { 3,3 });
+
+        space::Scene scene(viewport_width, viewport_height);
+        addStreamedWorld(scene, options);
+        scene.setGrassCulling(options.grass_culling);
+
+        const int frame_count = options.frames > 0 ? options.frames : 60;
+        const float fixed_delta_time = 1.0f / 60.0f;
+
+        space::FrameStats stats(options.stats_interval);
+
+        for (int frame = 0; frame < frame_count; ++frame)
+        {
+            auto start = Clock::now();
+            scene.update(fixed_delta_time);
+            auto updated = Clock::now();
+            scene.render();
+            auto submitted = Clock::now();
+            window.swap_buffers();
+            glFinish();
+            auto finished = Clock::now();
+
+            stats.addFrame(elapsedMs(start, finished), elapsedMs(start, updated), elapsedMs(updated, submitted), elapsedMs(submitted, finished));
+        }
+
+        std::cout << "Rendered " << frame_count << " offscreen frames" << std::endl;
+
+        reportFrameStats(stats, options);
+        reportCulling(scene);
+
+        if (!options.capture_path.empty() && !window.save_frame(options.capture_path))
+        {
+            return 1;
+        }
+
+        return 0;
+    }
+
+#endif
+}
+
+int main(int argc, char* argv[])
 {
     constexpr unsigned viewport_width = 1024;
     constexpr unsigned viewport_height = 576;
 
+    RunOptions options = parseArguments(argc, argv);
+
+    if (!options.trace_path.empty())
+    {
+        space::CpuProfiler::setEnabled(true);
+        space::CpuProfiler::setThreadName("main");
+    }
+
+    space::TerrainMeshCache::setDirectory(options.terrain_cache);
+
+    if (options.offscreen)
+    {
+#ifdef SPACE_WITH_EGL
+        int result = runOffscreen(options, viewport_width, viewport_height);
+
+        if (!options.trace_path.empty())
+        {
+            space::CpuProfiler::writeChromeTrace(options.trace_path);
+        }
+
+        return result;
+#else
+        std::cerr << "This build has no offscreen (EGL) backend." << std::endl;
+        return 1;
+#endif
+    }
+
     Window window("Plane example", Window::Position::CENTERED, Window::Position::CENTERED, viewport_width, viewport_height, { 3,3 });
 
     space::Scene scene(viewport_width, viewport_height);
+    addStreamedWorld(scene, options);
+    scene.setGrassCulling(options.grass_culling);
 
     bool running = true;
     SDL_Event event;
@@ -23,6 +212,9 @@ int main(int, char* [])
     Uint64 NOW = SDL_GetPerformanceCounter();
     Uint64 LAST = 0;
     double deltaTime = 0;
+    int frame = 0;
+
+    space::FrameStats stats(options.stats_interval);
 
     while (running)
     {
@@ -45,14 +237,29 @@ int main(int, char* [])
         NOW = SDL_GetPerformanceCounter();
         deltaTime = (double)((NOW - LAST) / (double)SDL_GetPerformanceFrequency());
 
+        auto start = std::chrono::steady_clock::now();
         scene.update(deltaTime);
+        auto updated = std::chrono::steady_clock::now();
         scene.render();
+        auto submitted = std::chrono::steady_clock::now();
         window.swap_buffers();
-    }
+        auto swapped = std::chrono::steady_clock::now();
 
-    return 0;
-}
+        stats.addFrame(deltaTime * 1000.0, elapsedMs(start, updated), elapsedMs(updated, submitted), elapsedMs(submitted, swapped));
 
+        if (options.frames > 0 && ++frame >= options.frames)
+        {
+            running = false;
+        }
+    }
 
+    reportFrameStats(stats, options);
+    reportCulling(scene);
 
+    if (!options.trace_path.empty())
+    {
+        space::CpuProfiler::writeChromeTrace(options.trace_path);
+    }
 
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Visibility test of a grass instance, shared by the culling shaders of GrassCuller. This
+// file has no #version: they are compiled with one in front of it.
+
+uniform vec4 frustum_planes[6];         // World space, normals pointing inwards
+uniform vec3 camera_position;
+uniform float draw_distance;
+uniform vec3 blade_extent;              // XZ radius, bottom and top of a blade at scale 1
+
+uniform mat4 view_projection_matrix;
+uniform sampler2D depth_pyramid;        // Level 0 keeps the farthest depth of 2x2 pixels
+uniform int depth_pyramid_levels;       // 0 skips the occlusion test
+uniform ivec2 viewport_size;
+
+bool isInsideFrustum(vec3 low, vec3 high)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        // The corner of the box farthest along the plane normal
+        vec3 corner = mix(low, high, step(0.0, frustum_planes[i].xyz));
+
+        if (dot(frustum_planes[i].xyz, corner) + frustum_planes[i].w < 0.0) return false;
+    }
+
+    return true;
+}
+
+bool isOccluded(vec3 low, vec3 high)
+{
+    if (depth_pyramid_levels == 0) return false;
+
+    vec2 screenLow = vec2(1.0e30);
+    vec2 screenHigh = vec2(-1.0e30);
+    float nearest = 1.0;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        vec3 corner = vec3((i & 1) != 0 ? high.x : low.x, (i & 2) != 0 ? high.y : low.y, (i & 4) != 0 ? high.z : low.z);
+        vec4 clip = view_projection_matrix * vec4(corner, 1.0);
+
+        // A corner behind the eye leaves the projection unbounded
+        if (clip.w <= 0.0) return false;
+
+        vec3 ndc = clip.xyz / clip.w;
+
+        screenLow = min(screenLow, ndc.xy);
+        screenHigh = max(screenHigh, ndc.xy);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+
+    ivec2 pixelLow = clamp(ivec2(floor((screenLow * 0.5 + 0.5) * vec2(viewport_size))), ivec2(0), viewport_size - 1);
+    ivec2 pixelHigh = clamp(ivec2(floor((screenHigh * 0.5 + 0.5) * vec2(viewport_size))), ivec2(0), viewport_size - 1);
+
+    // A texel of level k covers 2^(k + 1) pixels a side: the first level where the box spans 2 x 2 texels at most
+    int extent = max(pixelHigh.x - pixelLow.x, pixelHigh.y - pixelLow.y);
+    int level = 0;
+
+    while (level + 1 < depth_pyramid_levels && (extent >> (level + 1)) > 0) ++level;
+
+    // The pixels left over by an odd size belong to the last texel of their row or column.
+    // Each level halves the one below rounding down, so its size follows from the viewport
+    ivec2 lastTexel = max(viewport_size >> (level + 1), ivec2(1)) - 1;
+    ivec2 texelLow = min(pixelLow >> (level + 1), lastTexel);
+    ivec2 texelHigh = min(pixelHigh >> (level + 1), lastTexel);
+
+    float farthest = max(
+        max(texelFetch(depth_pyramid, texelLow, level).r, texelFetch(depth_pyramid, ivec2(texelHigh.x, texelLow.y), level).r),
+        max(texelFetch(depth_pyramid, ivec2(texelLow.x, texelHigh.y), level).r, texelFetch(depth_pyramid, texelHigh, level).r));
+
+    return nearest > farthest;
+}
+
+bool isGrassVisible(vec3 position, float scale)
+{
+    // The box a blade fills as GrassMesh pads its cells
+    vec3 low = position + vec3(-blade_extent.x, blade_extent.y, -blade_extent.x) * scale;
+    vec3 high = position + vec3(blade_extent.x, blade_extent.z, blade_extent.x) * scale;
+
+    // Nearest point of the box to the camera
+    vec3 offset = clamp(camera_position, low, high) - camera_position;
+
+    if (dot(offset, offset) > draw_distance * draw_distance) return false;
+
+    return isInsideFrustum(low, high) && !isOccluded(low, high);
+}
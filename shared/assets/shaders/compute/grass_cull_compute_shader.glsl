@@ -0,0 +1,47 @@
+// Culls the grass instances with one invocation each, see GrassCuller. Compiled after
+// common/grass_cull.glsl, with the #version line and GROUP_SIZE defined in front.
+
+layout (local_size_x = GROUP_SIZE) in;
+
+// Instances as GrassMesh packs them: position, color, scale and rotation, 8 floats
+layout (std430, binding = 0) readonly buffer Instances
+{
+    float instances[];
+};
+
+layout (std430, binding = 1) writeonly buffer VisibleInstances
+{
+    float visible_instances[];
+};
+
+// The DrawElementsIndirect command of the grass, its instance count reset to 0 before the dispatch
+layout (std430, binding = 2) buffer DrawCommand
+{
+    uint index_count;
+    uint visible_count;
+    uint first_index;
+    int base_vertex;
+    uint base_instance;
+};
+
+// Instances tested, a span of the buffer
+uniform uint first_instance;
+uniform uint instance_count;
+
+void main()
+{
+    if (gl_GlobalInvocationID.x >= instance_count) return;
+
+    uint source = (first_instance + gl_GlobalInvocationID.x) * 8u;
+
+    vec3 position = vec3(instances[source], instances[source + 1u], instances[source + 2u]);
+
+    if (!isGrassVisible(position, instances[source + 6u])) return;
+
+    uint target = atomicAdd(visible_count, 1u) * 8u;
+
+    for (uint i = 0u; i < 8u; ++i)
+    {
+        visible_instances[target + i] = instances[source + i];
+    }
+}
@@ -0,0 +1,32 @@
+#version 330 core
+
+// One level of the depth pyramid of GrassCuller: each texel keeps the farthest depth of the
+// 2x2 texels under it, in the level below or the depth buffer copy. Only that source level
+// is visible in source, so it is fetched at level 0.
+
+uniform sampler2D source;
+
+layout (location = 0) out float farthest_depth;
+
+void main()
+{
+    ivec2 sourceSize = textureSize(source, 0);
+    ivec2 first = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = min(first + 1, sourceSize - 1);
+
+    // With an odd size, the last texel of a row or column also takes the one left over
+    if (last.x == sourceSize.x - 2) last.x = sourceSize.x - 1;
+    if (last.y == sourceSize.y - 2) last.y = sourceSize.y - 1;
+
+    float depth = 0.0;
+
+    for (int y = first.y; y <= last.y; ++y)
+    {
+        for (int x = first.x; x <= last.x; ++x)
+        {
+            depth = max(depth, texelFetch(source, ivec2(x, y), 0).r);
+        }
+    }
+
+    farthest_depth = depth;
+}
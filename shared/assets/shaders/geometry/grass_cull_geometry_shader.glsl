@@ -0,0 +1,30 @@
+#version 330 core
+
+// Emits the instances grass_cull_vertex_shader.glsl kept, which transform feedback packs one
+// after another in the layout of the instance buffer
+
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec3 cull_position[];
+in vec3 cull_color[];
+in float cull_scale[];
+in float cull_rotation[];
+flat in int cull_visible[];
+
+out vec3 visible_position;
+out vec3 visible_color;
+out float visible_scale;
+out float visible_rotation;
+
+void main()
+{
+    if (cull_visible[0] == 0) return;
+
+    visible_position = cull_position[0];
+    visible_color = cull_color[0];
+    visible_scale = cull_scale[0];
+    visible_rotation = cull_rotation[0];
+
+    EmitVertex();
+}
@@ -0,0 +1,23 @@
+// Culls the grass instances drawn as points, one per instance, for transform feedback: see
+// GrassCuller. Compiled after common/grass_cull.glsl, with the #version line in front.
+
+layout (location = 0) in vec3 instance_position;
+layout (location = 1) in vec3 instance_color;
+layout (location = 2) in float instance_scale;
+layout (location = 3) in float instance_rotation;
+
+out vec3 cull_position;
+out vec3 cull_color;
+out float cull_scale;
+out float cull_rotation;
+flat out int cull_visible;
+
+void main()
+{
+    cull_position = instance_position;
+    cull_color = instance_color;
+    cull_scale = instance_scale;
+    cull_rotation = instance_rotation;
+
+    cull_visible = isGrassVisible(instance_position, instance_scale) ? 1 : 0;
+}
@@ -2,8 +2,7 @@
 
 // Regular vertex attributes
 layout (location = 0) in vec3 vertex_coordinates;
-layout (location = 1) in vec3 vertex_normal;
-layout (location = 2) in vec3 vertex_color;
+layout (location = 1) in vec2 vertex_normal;       // Octahedral encoded
 
 // Instance attributes
 layout (location = 3) in vec3 instance_position;
@@ -21,6 +20,14 @@ out vec3 fragment_position;
 out vec3 fragment_normal;
 out vec3 base_color;
 
+vec3 octahedralDecode(vec2 folded)
+{
+    vec3 normal = vec3(folded, 1.0 - abs(folded.x) - abs(folded.y));
+    float lower = max(-normal.z, 0.0);
+    normal.xy += vec2(normal.x >= 0.0 ? -lower : lower, normal.y >= 0.0 ? -lower : lower);
+    return normalize(normal);
+}
+
 void main()
 {
     // Create rotation matrix for Y-axis rotation
@@ -42,12 +49,11 @@ void main()
     fragment_position = viewPosition.xyz;
     
     // Transform normal (also apply rotation)
-    vec3 rotatedNormal = rotationMatrix * vertex_normal;
+    vec3 rotatedNormal = rotationMatrix * octahedralDecode(vertex_normal);
     fragment_normal = normalize((normal_matrix * vec4(rotatedNormal, 0.0)).xyz);
     
-    // Combine vertex color with instance color
-    // Since we set vertex colors to white, this effectively uses instance color
-    base_color = vertex_color * instance_color;
+    // The blades have no vertex color, each instance brings its own
+    base_color = instance_color;
     
     // Final position
     gl_Position = projection_matrix * viewPosition;
@@ -0,0 +1,87 @@
+#version 330
+
+uniform mat4 model_view_matrix;
+uniform mat4 projection_matrix;
+uniform mat4 normal_matrix;
+
+// Heightfield of HeightMapTerrain in displacement or CDLOD mode, one height per texel
+uniform sampler2D height_map;
+uniform ivec2 height_map_size;
+uniform float terrain_extent;
+uniform float height_range;
+
+// Camera in the terrain local space, for the LOD morph
+uniform vec3 camera_position;
+
+// Height colour ramp (the tables in TerrainKernels.hpp)
+const int RAMP_SEGMENTS = 4;
+uniform float ramp_starts[RAMP_SEGMENTS];
+uniform float ramp_lengths[RAMP_SEGMENTS];
+uniform vec3 ramp_colors[RAMP_SEGMENTS + 1];
+
+// Shared patch vertex, x and z in grid steps from the patch corner
+layout (location = 0) in vec3 vertex_coordinates;
+
+// Patch instance: first texel x and z and texel step, morph start and end distances
+layout (location = 3) in vec3 patch_placement;
+layout (location = 4) in vec2 patch_morph;
+
+out vec3 fragment_position;
+out vec3 fragment_normal;
+out vec3 base_color;
+
+// Same placement as the CPU mesh: the grid spans terrain_extent centered on the origin.
+// texel may fall between texels while morphing, the height is then interpolated
+vec3 terrainPosition(vec2 texel)
+{
+    texel = clamp(texel, vec2(0.0), vec2(height_map_size - 1));
+
+    vec2 xz = (texel / vec2(height_map_size - 1) - 0.5) * terrain_extent;
+    float height = textureLod(height_map, (texel + 0.5) / vec2(height_map_size), 0.0).r;
+
+    return vec3(xz.x, height, xz.y);
+}
+
+void main()
+{
+    vec2 grid = vertex_coordinates.xz;
+    vec2 texel = patch_placement.xy + grid * patch_placement.z;
+
+    // Odd grid vertices slide onto their even neighbours over the morph range, so a patch
+    // reaches the next coarser grid where that level takes over. Vertices past the last
+    // texel collapse onto it, leaving degenerate triangles
+    if (patch_morph.y > patch_morph.x)
+    {
+        float distance_to_camera = distance(terrainPosition(texel), camera_position);
+        float morph = clamp((distance_to_camera - patch_morph.x) / (patch_morph.y - patch_morph.x), 0.0, 1.0);
+
+        grid -= fract(grid * 0.5) * 2.0 * morph;
+        texel = patch_placement.xy + grid * patch_placement.z;
+    }
+
+    vec3 local_position = terrainPosition(texel);
+
+    // Central differences over the full resolution texels, one-sided on the borders
+    vec3 left = terrainPosition(texel - vec2(1.0, 0.0));
+    vec3 right = terrainPosition(texel + vec2(1.0, 0.0));
+    vec3 up = terrainPosition(texel - vec2(0.0, 1.0));
+    vec3 down = terrainPosition(texel + vec2(0.0, 1.0));
+
+    vec3 normal = normalize(cross(down - up, right - left));
+
+    // Colour ramp over the normalized height
+    float normalized_height = local_position.y / height_range;
+
+    int segment = RAMP_SEGMENTS - 1;
+    while (segment > 0 && normalized_height < ramp_starts[segment]) --segment;
+
+    float t = (normalized_height - ramp_starts[segment]) / ramp_lengths[segment];
+    base_color = mix(ramp_colors[segment], ramp_colors[segment + 1], t);
+
+    // Transform to view space
+    vec4 position = model_view_matrix * vec4(local_position, 1.0);
+    fragment_position = position.xyz;
+    fragment_normal = normalize((normal_matrix * vec4(normal, 0.0)).xyz);
+
+    gl_Position = projection_matrix * position;
+}
@@ -4,6 +4,10 @@ uniform mat4 model_view_matrix;
 uniform mat4 projection_matrix;
 uniform mat4 normal_matrix;
 
+// Set for meshes uploaded with octahedral normals (vertex::OctahedralNormal), which
+// arrive in xy. Quantized positions are decoded by model_view_matrix
+uniform bool octahedral_normals;
+
 layout (location = 0) in vec3 vertex_coordinates;
 layout (location = 1) in vec3 vertex_normal;
 layout (location = 2) in vec3 vertex_color;
@@ -12,6 +16,14 @@ out vec3 fragment_position;
 out vec3 fragment_normal;
 out vec3 base_color;
 
+vec3 octahedralDecode(vec2 folded)
+{
+    vec3 normal = vec3(folded, 1.0 - abs(folded.x) - abs(folded.y));
+    float lower = max(-normal.z, 0.0);
+    normal.xy += vec2(normal.x >= 0.0 ? -lower : lower, normal.y >= 0.0 ? -lower : lower);
+    return normalize(normal);
+}
+
 void main()
 {
     // Transform vertex position to view space
@@ -19,7 +31,8 @@ void main()
     fragment_position = position.xyz;
     
     // Transform normal to view space
-    fragment_normal = normalize((normal_matrix * vec4(vertex_normal, 0.0)).xyz);
+    vec3 normal = octahedral_normals ? octahedralDecode(vertex_normal.xy) : vertex_normal;
+    fragment_normal = normalize((normal_matrix * vec4(normal, 0.0)).xyz);
     
     // Pass color to fragment shader
     base_color = vertex_color;